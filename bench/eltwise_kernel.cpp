@@ -0,0 +1,191 @@
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <instant/eltwise_kernel.hpp>
+
+namespace instant {
+    namespace {
+
+        // Throughput of an eltwise kernel over an activation of ResNet
+        // (256 x 56 x 56 per sample). "reference" is the scalar loop of the
+        // standard library and "native" is the kernel of the running CPU
+        void BM_eltwise_kernel(benchmark::State& state, eltwise_op op,
+                               std::string const& isa_name) {
+            std::size_t size = state.range(0) * 256 * 56 * 56;
+            std::vector<float> x(size), y(size);
+            for(std::size_t i = 0; i < size; ++i) {
+                x[i] = (i % 2000 + 0.5f) / 1000.f; // positive for log
+            }
+            auto kernel = isa_name == "native" ? get_eltwise_kernel()
+                                               : get_eltwise_kernel(isa_name);
+            for(auto _ : state) {
+                run_eltwise_kernel(kernel, op, x.data(), y.data(), size);
+                benchmark::DoNotOptimize(y.data());
+            }
+            state.SetBytesProcessed(state.iterations() * size * 2 *
+                                    sizeof(float));
+        }
+        BENCHMARK_CAPTURE(BM_eltwise_kernel, clip_reference,
+                          eltwise_op{eltwise_kind::clip, 0.f, 6.f}, "reference")
+          ->Arg(1)
+          ->Arg(8);
+        BENCHMARK_CAPTURE(BM_eltwise_kernel, clip_native,
+                          eltwise_op{eltwise_kind::clip, 0.f, 6.f}, "native")
+          ->Arg(1)
+          ->Arg(8);
+        BENCHMARK_CAPTURE(BM_eltwise_kernel, exp_reference,
+                          eltwise_op{eltwise_kind::exp, 0.f, 0.f}, "reference")
+          ->Arg(1)
+          ->Arg(8);
+        BENCHMARK_CAPTURE(BM_eltwise_kernel, exp_native,
+                          eltwise_op{eltwise_kind::exp, 0.f, 0.f}, "native")
+          ->Arg(1)
+          ->Arg(8);
+        BENCHMARK_CAPTURE(BM_eltwise_kernel, hard_sigmoid_reference,
+                          eltwise_op{eltwise_kind::hard_sigmoid, 0.2f, 0.5f},
+                          "reference")
+          ->Arg(1)
+          ->Arg(8);
+        BENCHMARK_CAPTURE(BM_eltwise_kernel, hard_sigmoid_native,
+                          eltwise_op{eltwise_kind::hard_sigmoid, 0.2f, 0.5f},
+                          "native")
+          ->Arg(1)
+          ->Arg(8);
+        BENCHMARK_CAPTURE(BM_eltwise_kernel, log_reference,
+                          eltwise_op{eltwise_kind::log, 0.f, 0.f}, "reference")
+          ->Arg(1)
+          ->Arg(8);
+        BENCHMARK_CAPTURE(BM_eltwise_kernel, log_native,
+                          eltwise_op{eltwise_kind::log, 0.f, 0.f}, "native")
+          ->Arg(1)
+          ->Arg(8);
+        BENCHMARK_CAPTURE(BM_eltwise_kernel, sigmoid_reference,
+                          eltwise_op{eltwise_kind::sigmoid, 0.f, 0.f},
+                          "reference")
+          ->Arg(1)
+          ->Arg(8);
+        BENCHMARK_CAPTURE(BM_eltwise_kernel, sigmoid_native,
+                          eltwise_op{eltwise_kind::sigmoid, 0.f, 0.f}, "native")
+          ->Arg(1)
+          ->Arg(8);
+        BENCHMARK_CAPTURE(BM_eltwise_kernel, sqrt_reference,
+                          eltwise_op{eltwise_kind::sqrt, 0.f, 0.f}, "reference")
+          ->Arg(1)
+          ->Arg(8);
+        BENCHMARK_CAPTURE(BM_eltwise_kernel, sqrt_native,
+                          eltwise_op{eltwise_kind::sqrt, 0.f, 0.f}, "native")
+          ->Arg(1)
+          ->Arg(8);
+        BENCHMARK_CAPTURE(BM_eltwise_kernel, tanh_reference,
+                          eltwise_op{eltwise_kind::tanh, 0.f, 0.f}, "reference")
+          ->Arg(1)
+          ->Arg(8);
+        BENCHMARK_CAPTURE(BM_eltwise_kernel, tanh_native,
+                          eltwise_op{eltwise_kind::tanh, 0.f, 0.f}, "native")
+          ->Arg(1)
+          ->Arg(8);
+
+        // A chain of eltwise operators run by the native kernel, node by
+        // node (a pass over memory per operator) or fused into one chain
+        // kernel (see fuse_eltwise_chain)
+        void BM_eltwise_chain(benchmark::State& state,
+                              std::vector<eltwise_op> const& op_list,
+                              bool is_fused) {
+            std::size_t size = state.range(0) * 256 * 56 * 56;
+            std::vector<float> x(size), y(size);
+            for(std::size_t i = 0; i < size; ++i) {
+                x[i] = (i % 2000 + 0.5f) / 1000.f - 1.f;
+            }
+            auto kernel = get_eltwise_kernel();
+            auto chain_kernel = get_eltwise_chain_kernel();
+            for(auto _ : state) {
+                if(is_fused) {
+                    run_eltwise_kernel(chain_kernel, op_list, x.data(),
+                                       y.data(), size);
+                } else {
+                    auto* input = x.data();
+                    for(auto const& op : op_list) {
+                        run_eltwise_kernel(kernel, op, input, y.data(), size);
+                        input = y.data();
+                    }
+                }
+                benchmark::DoNotOptimize(y.data());
+            }
+            state.SetBytesProcessed(state.iterations() * size * 2 *
+                                    sizeof(float));
+        }
+        const std::vector<eltwise_op> relu_clip_op_list{
+          {eltwise_kind::relu, 0.f, 0.f}, {eltwise_kind::clip, 0.f, 6.f}};
+        const std::vector<eltwise_op> neg_exp_sigmoid_op_list{
+          {eltwise_kind::neg, 0.f, 0.f},
+          {eltwise_kind::exp, 0.f, 0.f},
+          {eltwise_kind::sigmoid, 0.f, 0.f}};
+        BENCHMARK_CAPTURE(BM_eltwise_chain, relu_clip_unfused,
+                          relu_clip_op_list, false)
+          ->Arg(1)
+          ->Arg(8);
+        BENCHMARK_CAPTURE(BM_eltwise_chain, relu_clip_fused,
+                          relu_clip_op_list, true)
+          ->Arg(1)
+          ->Arg(8);
+        BENCHMARK_CAPTURE(BM_eltwise_chain, neg_exp_sigmoid_unfused,
+                          neg_exp_sigmoid_op_list, false)
+          ->Arg(1)
+          ->Arg(8);
+        BENCHMARK_CAPTURE(BM_eltwise_chain, neg_exp_sigmoid_fused,
+                          neg_exp_sigmoid_op_list, true)
+          ->Arg(1)
+          ->Arg(8);
+
+        // Add of an activation of ResNet (256 x 56 x 56 per sample) and
+        // another one, or a per-channel bias broadcast to it as add_broadcast
+        // runs it. "reference" is the scalar loop and "native" is the kernel
+        // of the running CPU
+        void BM_add_kernel(benchmark::State& state, bool is_broadcast,
+                           std::string const& isa_name) {
+            std::size_t channel_num = state.range(0) * 256;
+            std::size_t channel_size = 56 * 56;
+            std::size_t size = channel_num * channel_size;
+            std::vector<float> a(size), c(size);
+            std::vector<float> b(is_broadcast ? channel_num : size);
+            for(std::size_t i = 0; i < size; ++i) {
+                a[i] = (i % 2000 + 0.5f) / 1000.f;
+            }
+            for(std::size_t i = 0; i < b.size(); ++i) {
+                b[i] = (i % 1000 + 0.5f) / 1000.f;
+            }
+            auto kernel = isa_name == "native" ? get_add_kernel()
+                                               : get_add_kernel(isa_name);
+            for(auto _ : state) {
+                if(is_broadcast) {
+                    for(std::size_t ch = 0; ch < channel_num; ++ch) {
+                        kernel(a.data() + ch * channel_size, 1, b.data() + ch,
+                               0, c.data() + ch * channel_size,
+                               channel_size);
+                    }
+                } else {
+                    kernel(a.data(), 1, b.data(), 1, c.data(), size);
+                }
+                benchmark::DoNotOptimize(c.data());
+            }
+            state.SetBytesProcessed(state.iterations() * size *
+                                    (is_broadcast ? 2 : 3) * sizeof(float));
+        }
+        BENCHMARK_CAPTURE(BM_add_kernel, dense_reference, false, "reference")
+          ->Arg(1)
+          ->Arg(8);
+        BENCHMARK_CAPTURE(BM_add_kernel, dense_native, false, "native")
+          ->Arg(1)
+          ->Arg(8);
+        BENCHMARK_CAPTURE(BM_add_kernel, broadcast_reference, true,
+                          "reference")
+          ->Arg(1)
+          ->Arg(8);
+        BENCHMARK_CAPTURE(BM_add_kernel, broadcast_native, true, "native")
+          ->Arg(1)
+          ->Arg(8);
+
+    } // namespace
+} // namespace instant
@@ -0,0 +1,111 @@
+#include "synthetic_graph.hpp"
+
+namespace instant {
+    namespace {
+
+        // Time to optimize the graph, pack parameters and make nets
+        void BM_build(benchmark::State& state,
+                      onnx::ModelProto const& onnx_model,
+                      std::vector<int> input_dims) {
+            auto parameter_table = make_parameter_table(onnx_model.graph());
+            input_dims.insert(input_dims.begin(), state.range(0));
+            for(auto _ : state) {
+                auto compiled =
+                  make_compiled_model(onnx_model, parameter_table,
+                                      make_nchw_input_list(input_dims), {"y"});
+                auto context = make_execution_context(compiled);
+                benchmark::DoNotOptimize(context);
+            }
+        }
+
+        // Latency of run(). Throughput is reported as items_per_second
+        void BM_run(benchmark::State& state,
+                    onnx::ModelProto const& onnx_model,
+                    std::vector<int> input_dims) {
+            input_dims.insert(input_dims.begin(), state.range(0));
+            auto compiled = make_compiled_model(
+              onnx_model, make_parameter_table(onnx_model.graph()),
+              make_nchw_input_list(input_dims), {"y"});
+            auto context = make_execution_context(compiled);
+            run_context_benchmark(state, context, input_dims[0]);
+        }
+
+        BENCHMARK_CAPTURE(BM_build, vgg_like, make_vgg_like_model(),
+                          std::vector<int>{3, 64, 64})
+          ->Arg(1)
+          ->Unit(benchmark::kMillisecond);
+        BENCHMARK_CAPTURE(BM_run, vgg_like, make_vgg_like_model(),
+                          std::vector<int>{3, 64, 64})
+          ->Arg(1)
+          ->Arg(8)
+          ->Arg(32)
+          ->Unit(benchmark::kMillisecond);
+
+        BENCHMARK_CAPTURE(BM_build, conv_bn_relu_8, make_conv_bn_relu_model(8),
+                          std::vector<int>{64, 56, 56})
+          ->Arg(1)
+          ->Unit(benchmark::kMillisecond);
+        BENCHMARK_CAPTURE(BM_run, conv_bn_relu_8, make_conv_bn_relu_model(8),
+                          std::vector<int>{64, 56, 56})
+          ->Arg(1)
+          ->Arg(8)
+          ->Arg(32)
+          ->Unit(benchmark::kMillisecond);
+
+        // Bottleneck blocks with and without the residual Add fused into
+        // the last Conv of each block (see fuse_residual_add)
+        void BM_run_bottleneck(benchmark::State& state, bool fuses_residual) {
+            auto onnx_model = make_bottleneck_model(3);
+            auto parameter_table = make_parameter_table(onnx_model.graph());
+            auto input_list = make_nchw_input_list(
+              {static_cast<int>(state.range(0)), 256, 56, 56});
+            std::shared_ptr<const compiled_model> compiled;
+            if(fuses_residual) {
+                compiled = make_compiled_model(onnx_model, parameter_table,
+                                               input_list, {"y"});
+            } else {
+                std::set<std::string> required_output_set{"y"};
+                auto& graph = *onnx_model.mutable_graph();
+                fuse_post_eltwise(graph, required_output_set);
+                propagate_layouts_for_cpu(graph, parameter_table, input_list,
+                                          required_output_set);
+                compiled = compile_optimized_model(
+                  onnx_model, parameter_table, input_list,
+                  required_output_set, get_context().engine());
+            }
+            auto context = make_execution_context(compiled);
+            run_context_benchmark(state, context, state.range(0));
+        }
+        BENCHMARK_CAPTURE(BM_run_bottleneck, unfused, false)
+          ->Arg(1)
+          ->Arg(8)
+          ->Unit(benchmark::kMillisecond);
+        BENCHMARK_CAPTURE(BM_run_bottleneck, fused, true)
+          ->Arg(1)
+          ->Arg(8)
+          ->Unit(benchmark::kMillisecond);
+
+        // 4 branches at batch size 1 with the given number of inter-op
+        // threads
+        void BM_run_multi_branch(benchmark::State& state) {
+            constexpr int branch_num = 4;
+            std::vector<std::string> output_name_list;
+            for(int b = 0; b < branch_num; ++b) {
+                output_name_list.push_back("y" + std::to_string(b));
+            }
+            auto onnx_model = make_multi_branch_model(branch_num, 4);
+            auto compiled = make_compiled_model(
+              onnx_model, make_parameter_table(onnx_model.graph()),
+              make_nchw_input_list({1, 64, 28, 28}), output_name_list);
+            auto context = make_execution_context(compiled, state.range(0));
+            run_context_benchmark(state, context, 1);
+        }
+        BENCHMARK(BM_run_multi_branch)
+          ->Arg(1)
+          ->Arg(2)
+          ->Arg(4)
+          ->Unit(benchmark::kMillisecond)
+          ->UseRealTime();
+
+    } // namespace
+} // namespace instant
@@ -0,0 +1,251 @@
+#include "synthetic_graph.hpp"
+
+namespace instant {
+    namespace {
+
+        // Makes a model of one node whose input is "x" and output is "y".
+        // "x" is in the plain format of its dims (nc for FC and Gemm)
+        auto run_single_node_benchmark(benchmark::State& state,
+                                       onnx::ModelProto const& onnx_model,
+                                       std::vector<int> const& input_dims) {
+            auto compiled = make_compiled_model(
+              onnx_model, make_parameter_table(onnx_model.graph()),
+              {std::make_tuple("x", dtype_t::float_, input_dims,
+                               get_plain_format(input_dims.size()))},
+              {"y"});
+            auto context = make_execution_context(compiled);
+            run_context_benchmark(state, context, input_dims[0]);
+        }
+
+        void BM_conv(benchmark::State& state, int input_channel_num,
+                     int output_channel_num, int size, int kernel, int stride,
+                     int pad) {
+            onnx::ModelProto onnx_model;
+            add_conv(*onnx_model.mutable_graph(), "x", "y", input_channel_num,
+                     output_channel_num, kernel, stride, pad);
+            run_single_node_benchmark(
+              state, onnx_model,
+              {static_cast<int>(state.range(0)), input_channel_num, size,
+               size});
+        }
+        BENCHMARK_CAPTURE(BM_conv, vgg_conv1_2, 64, 64, 224, 3, 1, 1)
+          ->Arg(1)
+          ->Arg(8);
+        BENCHMARK_CAPTURE(BM_conv, vgg_conv3_2, 256, 256, 56, 3, 1, 1)
+          ->Arg(1)
+          ->Arg(8)
+          ->Arg(32);
+        BENCHMARK_CAPTURE(BM_conv, resnet_conv2_3x3, 64, 64, 56, 3, 1, 1)
+          ->Arg(1)
+          ->Arg(8)
+          ->Arg(32);
+        BENCHMARK_CAPTURE(BM_conv, resnet_conv2_1x1, 256, 64, 56, 1, 1, 0)
+          ->Arg(1)
+          ->Arg(8)
+          ->Arg(32);
+        BENCHMARK_CAPTURE(BM_conv, resnet_conv5_1x1, 512, 2048, 7, 1, 1, 0)
+          ->Arg(1)
+          ->Arg(8)
+          ->Arg(32);
+        BENCHMARK_CAPTURE(BM_conv, mobilenet_conv1, 3, 32, 224, 3, 2, 1)
+          ->Arg(1)
+          ->Arg(8)
+          ->Arg(32);
+        BENCHMARK_CAPTURE(BM_conv, mobilenet_pointwise, 32, 64, 112, 1, 1, 0)
+          ->Arg(1)
+          ->Arg(8)
+          ->Arg(32);
+
+        // group == input_channel_num is depthwise
+        void BM_grouped_conv(benchmark::State& state, int input_channel_num,
+                             int output_channel_num, int size, int kernel,
+                             int stride, int pad, int group) {
+            onnx::ModelProto onnx_model;
+            add_conv(*onnx_model.mutable_graph(), "x", "y", input_channel_num,
+                     output_channel_num, kernel, stride, pad, group);
+            run_single_node_benchmark(
+              state, onnx_model,
+              {static_cast<int>(state.range(0)), input_channel_num, size,
+               size});
+        }
+        BENCHMARK_CAPTURE(BM_grouped_conv, mobilenet_dw2, 32, 32, 112, 3, 1,
+                          1, 32)
+          ->Arg(1)
+          ->Arg(8);
+        BENCHMARK_CAPTURE(BM_grouped_conv, mobilenet_dw3, 64, 64, 112, 3, 2,
+                          1, 64)
+          ->Arg(1)
+          ->Arg(8);
+        BENCHMARK_CAPTURE(BM_grouped_conv, mobilenet_dw8, 512, 512, 14, 3, 1,
+                          1, 512)
+          ->Arg(1)
+          ->Arg(8);
+        BENCHMARK_CAPTURE(BM_grouped_conv, mobilenet_dw14, 1024, 1024, 7, 3,
+                          1, 1, 1024)
+          ->Arg(1)
+          ->Arg(8);
+        BENCHMARK_CAPTURE(BM_grouped_conv, resnext_conv2_3x3, 128, 128, 56, 3,
+                          1, 1, 32)
+          ->Arg(1)
+          ->Arg(8);
+
+        void BM_pool(benchmark::State& state, std::string const& op_type,
+                     int channel_num, int size, int kernel, int stride,
+                     int pad) {
+            onnx::ModelProto onnx_model;
+            add_node(*onnx_model.mutable_graph(), op_type, {"x"}, {"y"},
+                     make_conv_attribute_list(kernel, stride, pad));
+            run_single_node_benchmark(
+              state, onnx_model,
+              {static_cast<int>(state.range(0)), channel_num, size, size});
+        }
+        BENCHMARK_CAPTURE(BM_pool, vgg_pool1, "MaxPool", 64, 224, 2, 2, 0)
+          ->Arg(1)
+          ->Arg(8);
+        BENCHMARK_CAPTURE(BM_pool, resnet_pool1, "MaxPool", 64, 112, 3, 2, 1)
+          ->Arg(1)
+          ->Arg(8)
+          ->Arg(32);
+        BENCHMARK_CAPTURE(BM_pool, resnet_global_pool, "AveragePool", 2048, 7,
+                          7, 1, 0)
+          ->Arg(1)
+          ->Arg(8)
+          ->Arg(32);
+
+        void BM_fc(benchmark::State& state, int input_size, int output_size) {
+            onnx::ModelProto onnx_model;
+            add_fc(*onnx_model.mutable_graph(), "x", "y", input_size,
+                   output_size);
+            run_single_node_benchmark(
+              state, onnx_model,
+              {static_cast<int>(state.range(0)), input_size});
+        }
+        BENCHMARK_CAPTURE(BM_fc, vgg_fc6, 25088, 4096)
+          ->Arg(1)
+          ->Arg(8)
+          ->Arg(32);
+        BENCHMARK_CAPTURE(BM_fc, vgg_fc7, 4096, 4096)
+          ->Arg(1)
+          ->Arg(8)
+          ->Arg(32)
+          ->Arg(64);
+        BENCHMARK_CAPTURE(BM_fc, resnet_fc, 2048, 1000)
+          ->Arg(1)
+          ->Arg(8)
+          ->Arg(32)
+          ->Arg(64);
+
+        // Batch sizes 1 and 256 stand for a single request and a batch
+        // of requests (or of tokens for BERT)
+        void BM_gemm(benchmark::State& state, int input_size,
+                     int output_size) {
+            onnx::ModelProto onnx_model;
+            add_gemm(*onnx_model.mutable_graph(), "x", "y", input_size,
+                     output_size);
+            run_single_node_benchmark(
+              state, onnx_model,
+              {static_cast<int>(state.range(0)), input_size});
+        }
+        BENCHMARK_CAPTURE(BM_gemm, vgg_fc6, 25088, 4096)->Arg(1)->Arg(256);
+        BENCHMARK_CAPTURE(BM_gemm, vgg_fc7, 4096, 4096)->Arg(1)->Arg(256);
+        BENCHMARK_CAPTURE(BM_gemm, bert_base_attention, 768, 768)
+          ->Arg(1)
+          ->Arg(256);
+        BENCHMARK_CAPTURE(BM_gemm, bert_base_intermediate, 768, 3072)
+          ->Arg(1)
+          ->Arg(256);
+        BENCHMARK_CAPTURE(BM_gemm, bert_base_output, 3072, 768)
+          ->Arg(1)
+          ->Arg(256);
+
+        // x is (N, sequence_length, input_size) unless sequence_length is 0
+        void BM_matmul(benchmark::State& state, int input_size,
+                       int output_size, int sequence_length = 0) {
+            onnx::ModelProto onnx_model;
+            add_matmul(*onnx_model.mutable_graph(), "x", "y", input_size,
+                       output_size);
+            std::vector<int> input_dims{static_cast<int>(state.range(0))};
+            if(sequence_length != 0) {
+                input_dims.push_back(sequence_length);
+            }
+            input_dims.push_back(input_size);
+            run_single_node_benchmark(state, onnx_model, input_dims);
+        }
+        BENCHMARK_CAPTURE(BM_matmul, bert_base_attention, 768, 768)
+          ->Arg(1)
+          ->Arg(256);
+        BENCHMARK_CAPTURE(BM_matmul, bert_base_intermediate, 768, 3072)
+          ->Arg(1)
+          ->Arg(256);
+        BENCHMARK_CAPTURE(BM_matmul, bert_base_output, 3072, 768)
+          ->Arg(1)
+          ->Arg(256);
+        BENCHMARK_CAPTURE(BM_matmul, bert_base_attention_3d, 768, 768, 128)
+          ->Arg(1)
+          ->Arg(8);
+
+        void BM_batch_norm(benchmark::State& state, int channel_num,
+                           int size) {
+            onnx::ModelProto onnx_model;
+            add_batch_norm(*onnx_model.mutable_graph(), "x", "y", channel_num);
+            run_single_node_benchmark(
+              state, onnx_model,
+              {static_cast<int>(state.range(0)), channel_num, size, size});
+        }
+        BENCHMARK_CAPTURE(BM_batch_norm, resnet_bn2, 64, 56)
+          ->Arg(1)
+          ->Arg(8)
+          ->Arg(32);
+
+        // Operators whose only input is "x"
+        void BM_unary(benchmark::State& state, std::string const& op_type,
+                      std::vector<onnx::AttributeProto> const& attribute_list,
+                      std::vector<int> input_dims) {
+            onnx::ModelProto onnx_model;
+            add_node(*onnx_model.mutable_graph(), op_type, {"x"}, {"y"},
+                     attribute_list);
+            input_dims.insert(input_dims.begin(), state.range(0));
+            run_single_node_benchmark(state, onnx_model, input_dims);
+        }
+        BENCHMARK_CAPTURE(BM_unary, relu, "Relu", {},
+                          std::vector<int>{64, 56, 56})
+          ->Arg(1)
+          ->Arg(8)
+          ->Arg(32);
+        BENCHMARK_CAPTURE(BM_unary, leaky_relu, "LeakyRelu",
+                          {make_float_attribute("alpha", 0.1f)},
+                          std::vector<int>{64, 56, 56})
+          ->Arg(1)
+          ->Arg(8)
+          ->Arg(32);
+        BENCHMARK_CAPTURE(BM_unary, elu, "Elu",
+                          {make_float_attribute("alpha", 1.f)},
+                          std::vector<int>{64, 56, 56})
+          ->Arg(1)
+          ->Arg(8)
+          ->Arg(32);
+        BENCHMARK_CAPTURE(BM_unary, tanh, "Tanh", {},
+                          std::vector<int>{64, 56, 56})
+          ->Arg(1)
+          ->Arg(8)
+          ->Arg(32);
+        BENCHMARK_CAPTURE(BM_unary, softmax, "Softmax", {},
+                          std::vector<int>{1000})
+          ->Arg(1)
+          ->Arg(8)
+          ->Arg(32)
+          ->Arg(64);
+        BENCHMARK_CAPTURE(BM_unary, reshape, "Reshape",
+                          {make_ints_attribute("shape", {1, -1})},
+                          std::vector<int>{512, 7, 7})
+          ->Arg(1)
+          ->Arg(8)
+          ->Arg(32);
+        BENCHMARK_CAPTURE(BM_unary, dropout, "Dropout", {},
+                          std::vector<int>{4096, 1, 1})
+          ->Arg(1)
+          ->Arg(8)
+          ->Arg(32);
+
+    } // namespace
+} // namespace instant
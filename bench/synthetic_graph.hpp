@@ -0,0 +1,228 @@
+#ifndef INSTANT_BENCH_SYNTHETIC_GRAPH_HPP
+#define INSTANT_BENCH_SYNTHETIC_GRAPH_HPP
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <instant/instant.hpp>
+
+#include "../test/onnx_builder.hpp"
+
+namespace instant {
+
+    inline auto make_conv_attribute_list(int kernel, int stride, int pad) {
+        return std::vector<onnx::AttributeProto>{
+          make_ints_attribute("strides", {stride, stride}),
+          make_ints_attribute("kernel_shape", {kernel, kernel}),
+          make_ints_attribute("pads", {pad, pad, pad, pad})};
+    }
+
+    // Values are scaled by 1/fan_in to keep activations in a sane range
+    inline auto make_weight_array(std::vector<int> const& dims) {
+        auto arr = make_test_array(dims);
+        auto fan_in = total_size(arr) / dims[0];
+        std::transform(fbegin(arr), fend(arr), fbegin(arr),
+                       [fan_in](float w) { return w / fan_in; });
+        return arr;
+    }
+
+    inline auto add_conv(onnx::GraphProto& graph, std::string const& input,
+                         std::string const& output, int input_channel_num,
+                         int output_channel_num, int kernel, int stride,
+                         int pad, int group = 1) {
+        add_initializer(graph, output + "_w",
+                        make_weight_array({output_channel_num,
+                                           input_channel_num / group, kernel,
+                                           kernel}));
+        add_initializer(graph, output + "_b",
+                        make_test_array({output_channel_num}));
+        auto attribute_list = make_conv_attribute_list(kernel, stride, pad);
+        if(group != 1) {
+            attribute_list.push_back(make_int_attribute("group", group));
+        }
+        add_node(graph, "Conv", {input, output + "_w", output + "_b"},
+                 {output}, attribute_list);
+    }
+
+    inline auto add_fc(onnx::GraphProto& graph, std::string const& input,
+                       std::string const& output, int input_size,
+                       int output_size) {
+        add_initializer(graph, output + "_w",
+                        make_weight_array({output_size, input_size}));
+        add_initializer(graph, output + "_b", make_test_array({output_size}));
+        add_node(graph, "FC", {input, output + "_w", output + "_b"},
+                 {output},
+                 {make_int_attribute("axis", 1),
+                  make_int_attribute("axis_w", 1)});
+    }
+
+    // Gemm of an FC layer as exported from PyTorch, whose weight is
+    // (output_size, input_size) with transB
+    inline auto add_gemm(onnx::GraphProto& graph, std::string const& input,
+                         std::string const& output, int input_size,
+                         int output_size) {
+        add_initializer(graph, output + "_w",
+                        make_weight_array({output_size, input_size}));
+        add_initializer(graph, output + "_b", make_test_array({output_size}));
+        add_node(graph, "Gemm", {input, output + "_w", output + "_b"},
+                 {output}, {make_int_attribute("transB", 1)});
+    }
+
+    // MatMul of a projection whose weight is (input_size, output_size)
+    inline auto add_matmul(onnx::GraphProto& graph, std::string const& input,
+                           std::string const& output, int input_size,
+                           int output_size) {
+        auto weight = make_test_array({input_size, output_size});
+        std::transform(fbegin(weight), fend(weight), fbegin(weight),
+                       [input_size](float w) { return w / input_size; });
+        add_initializer(graph, output + "_w", weight);
+        add_node(graph, "MatMul", {input, output + "_w"}, {output});
+    }
+
+    inline auto add_batch_norm(onnx::GraphProto& graph,
+                               std::string const& input,
+                               std::string const& output, int channel_num) {
+        add_initializer(graph, output + "_scale",
+                        make_test_array({channel_num}, 1));
+        add_initializer(graph, output + "_b",
+                        make_test_array({channel_num}, 2));
+        add_initializer(graph, output + "_mean",
+                        make_test_array({channel_num}, 3));
+        add_initializer(graph, output + "_var",
+                        uniforms(dtype_t::float_, {channel_num}, 1.));
+        add_node(graph, "BatchNormalization",
+                 {input, output + "_scale", output + "_b", output + "_mean",
+                  output + "_var"},
+                 {output},
+                 {make_float_attribute("epsilon", 1e-5f),
+                  make_int_attribute("is_test", 1),
+                  make_int_attribute("spatial", 1)});
+    }
+
+    // VGG-style network for 3x64x64 input:
+    // [conv-relu-conv-relu-maxpool] x 3 (64, 128, 256 channels),
+    // FC(1024)-relu-FC(1000)-softmax
+    inline auto make_vgg_like_model() {
+        onnx::ModelProto onnx_model;
+        auto& graph = *onnx_model.mutable_graph();
+        std::string x = "x";
+        int channel_num = 3;
+        for(auto output_channel_num : {64, 128, 256}) {
+            for(int i = 0; i < 2; ++i) {
+                auto name = "conv" + std::to_string(output_channel_num) +
+                            "_" + std::to_string(i);
+                add_conv(graph, x, name, channel_num, output_channel_num, 3,
+                         1, 1);
+                add_node(graph, "Relu", {name}, {name + "_relu"});
+                x = name + "_relu";
+                channel_num = output_channel_num;
+            }
+            auto name = "pool" + std::to_string(output_channel_num);
+            add_node(graph, "MaxPool", {x}, {name},
+                     make_conv_attribute_list(2, 2, 0));
+            x = name;
+        }
+        add_node(graph, "Reshape", {x}, {"flatten"},
+                 {make_ints_attribute("shape", {1, -1})});
+        add_fc(graph, "flatten", "fc1", 256 * 8 * 8, 1024);
+        add_node(graph, "Relu", {"fc1"}, {"fc1_relu"});
+        add_fc(graph, "fc1_relu", "fc2", 1024, 1000);
+        add_node(graph, "Softmax", {"fc2"}, {"y"});
+        return onnx_model;
+    }
+
+    // ResNet-style stack of conv-bn-relu for 64x56x56 input
+    inline auto make_conv_bn_relu_model(int depth) {
+        onnx::ModelProto onnx_model;
+        auto& graph = *onnx_model.mutable_graph();
+        std::string x = "x";
+        for(int i = 0; i < depth; ++i) {
+            auto name = "conv" + std::to_string(i);
+            add_conv(graph, x, name, 64, 64, 3, 1, 1);
+            add_batch_norm(graph, name, name + "_bn", 64);
+            add_node(graph, "Relu", {name + "_bn"},
+                     {i + 1 == depth ? "y" : name + "_relu"});
+            x = name + "_relu";
+        }
+        return onnx_model;
+    }
+
+    // ResNet-50 conv2_x bottleneck blocks for 256x56x56 input:
+    // conv1x1(64)-relu-conv3x3(64)-relu-conv1x1(256), Add of the block
+    // input, relu. BatchNormalization is assumed folded into Conv
+    inline auto make_bottleneck_model(int block_num) {
+        onnx::ModelProto onnx_model;
+        auto& graph = *onnx_model.mutable_graph();
+        std::string x = "x";
+        for(int i = 0; i < block_num; ++i) {
+            auto name = "block" + std::to_string(i);
+            add_conv(graph, x, name + "_conv0", 256, 64, 1, 1, 0);
+            add_node(graph, "Relu", {name + "_conv0"}, {name + "_relu0"});
+            add_conv(graph, name + "_relu0", name + "_conv1", 64, 64, 3, 1, 1);
+            add_node(graph, "Relu", {name + "_conv1"}, {name + "_relu1"});
+            add_conv(graph, name + "_relu1", name + "_conv2", 64, 256, 1, 1,
+                     0);
+            add_node(graph, "Add", {name + "_conv2", x}, {name + "_add"});
+            x = i + 1 == block_num ? "y" : name + "_relu";
+            add_node(graph, "Relu", {name + "_add"}, {x});
+        }
+        return onnx_model;
+    }
+
+    // Inception-style graph for 64x28x28 input: branch_num independent
+    // branches of depth conv-relu pairs. Outputs are "y0", "y1", ...
+    inline auto make_multi_branch_model(int branch_num, int depth) {
+        onnx::ModelProto onnx_model;
+        auto& graph = *onnx_model.mutable_graph();
+        for(int b = 0; b < branch_num; ++b) {
+            std::string x = "x";
+            for(int i = 0; i < depth; ++i) {
+                auto name =
+                  "conv" + std::to_string(b) + "_" + std::to_string(i);
+                add_conv(graph, x, name, 64, 64, 3, 1, 1);
+                x = i + 1 == depth ? "y" + std::to_string(b) : name + "_relu";
+                add_node(graph, "Relu", {name}, {x});
+            }
+        }
+        return onnx_model;
+    }
+
+    inline auto make_nchw_input_list(std::vector<int> const& input_dims) {
+        return std::vector<std::tuple<std::string, dtype_t, std::vector<int>,
+                                      mkldnn::memory::format>>{
+          std::make_tuple("x", dtype_t::float_, input_dims,
+                          mkldnn::memory::format::nchw)};
+    }
+
+    // Runs context repeatedly and reports FLOP/s and samples per second
+    inline auto run_context_benchmark(benchmark::State& state,
+                                      execution_context& context,
+                                      int batch_size) {
+        for(auto const& input_name_dtype_dims_format :
+            context.compiled()->input_name_dtype_dims_format_list()) {
+            auto& input =
+              context.input(std::get<0>(input_name_dtype_dims_format));
+            std::fill(fbegin(input), fend(input), 1.f);
+        }
+        context.set_profiling_enabled(true);
+        context.run();
+        double flops = 0.;
+        for(auto const& p : context.profile()) {
+            flops += p.flops;
+        }
+        context.set_profiling_enabled(false);
+
+        for(auto _ : state) {
+            context.run();
+        }
+        state.SetItemsProcessed(state.iterations() * batch_size);
+        state.counters["FLOPs"] = benchmark::Counter(
+          flops, benchmark::Counter::kIsIterationInvariantRate);
+    }
+
+} // namespace instant
+
+#endif // INSTANT_BENCH_SYNTHETIC_GRAPH_HPP
@@ -0,0 +1,23 @@
+# Download and unpack google benchmark at configure time
+configure_file(cmake/benchmark-download.cmake benchmark-download/CMakeLists.txt)
+execute_process(COMMAND ${CMAKE_COMMAND} -G "${CMAKE_GENERATOR}" .
+        RESULT_VARIABLE result
+        WORKING_DIRECTORY ${CMAKE_BINARY_DIR}/benchmark-download )
+if(result)
+    message(FATAL_ERROR "CMake step for benchmark failed: ${result}")
+endif()
+execute_process(COMMAND ${CMAKE_COMMAND} --build .
+        RESULT_VARIABLE result
+        WORKING_DIRECTORY ${CMAKE_BINARY_DIR}/benchmark-download )
+if(result)
+    message(FATAL_ERROR "Build step for benchmark failed: ${result}")
+endif()
+
+# Benchmark's own tests need googletest, which is not required here
+set(BENCHMARK_ENABLE_TESTING OFF CACHE BOOL "" FORCE)
+set(BENCHMARK_ENABLE_GTEST_TESTS OFF CACHE BOOL "" FORCE)
+
+# Add benchmark directly to our build. This defines the benchmark target.
+add_subdirectory(${CMAKE_BINARY_DIR}/benchmark-src
+        ${CMAKE_BINARY_DIR}/benchmark-build
+        EXCLUDE_FROM_ALL)
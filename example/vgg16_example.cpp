@@ -105,21 +105,23 @@ int main(int argc, char** argv) {
     auto fc6_out_name = "140326200777976";
     auto softmax_out_name = "140326200803680";
 
-    // Load ONNX model
-    auto onnx_model = instant::load_onnx(onnx_model_path);
+    // Load ONNX model (parameters are mapped from the file, not copied)
+    onnx::ModelProto onnx_model;
+    std::unordered_map<std::string, instant::array> parameter_table;
+    std::tie(onnx_model, parameter_table) =
+      instant::load_onnx_with_mapped_parameter_table(onnx_model_path);
 
     // Construct computation primitive list and memories
     auto model = instant::make_model(
-      onnx_model,
+      onnx_model, std::move(parameter_table),
       {std::make_tuple(conv1_1_in_name, instant::dtype_t::float_, input_dims,
         mkldnn::memory::format::nchw)},  // input's (name, dtype, dims, format)
                                          // list
       {fc6_out_name, softmax_out_name}); // required output's name list
 
-    // Copy input image data to model's input array
-    auto& input_array = model.input(conv1_1_in_name);
-    std::copy(image_data.begin(), image_data.end(),
-              instant::fbegin(input_array));
+    // Bind input image data to model's input without copy
+    model.bind_input(conv1_1_in_name, image_data.data(),
+                     image_data.size() * sizeof(float));
 
     // Run inference
     auto const& output_table = model.run();
@@ -1,7 +1,9 @@
 #ifndef INSTANT_ARRAY_HPP
 #define INSTANT_ARRAY_HPP
 #include <algorithm>
+#include <cstdlib>
 #include <memory>
+#include <new>
 #include <numeric>
 #include <vector>
 
@@ -24,6 +26,15 @@ namespace instant {
                                  std::to_string(static_cast<int>(d)));
     }
 
+    inline std::shared_ptr<void> allocate_aligned_data(std::size_t size,
+                                                       std::size_t alignment) {
+        void* p = nullptr;
+        if(::posix_memalign(&p, alignment, size) != 0) {
+            throw std::bad_alloc();
+        }
+        return std::shared_ptr<void>(p, ::free);
+    }
+
     class array {
     public:
         array() = default;
@@ -0,0 +1,190 @@
+#ifndef INSTANT_BATCHING_SERVER_HPP
+#define INSTANT_BATCHING_SERVER_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+
+#include <instant/instant.hpp>
+
+namespace instant {
+
+    // Coalesces single sample requests into batches. A batch is run when
+    // max_batch_size requests are queued or when the oldest queued request
+    // has waited for max_wait_time. Each input and output of a request has
+    // batch size 1
+    class batching_server {
+    public:
+        using input_table_t = std::unordered_map<std::string, array>;
+        using output_table_t = std::unordered_map<std::string, array>;
+
+        batching_server(std::shared_ptr<const compiled_model> const& compiled,
+                        std::size_t max_batch_size,
+                        std::chrono::microseconds max_wait_time)
+          : context_cache_(compiled, max_batch_size),
+            max_batch_size_(max_batch_size), max_wait_time_(max_wait_time),
+            queue_depth_histogram_(4 * max_batch_size + 1, 0),
+            batch_size_histogram_(max_batch_size + 1, 0),
+            worker_([this]() { serve(); }) {}
+
+        batching_server(batching_server const&) = delete;
+        batching_server& operator=(batching_server const&) = delete;
+
+        ~batching_server() {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                is_stopped_ = true;
+            }
+            request_arrived_.notify_one();
+            worker_.join();
+        }
+
+        auto submit(input_table_t input_table) {
+            for(auto const& input_name_dtype_dims_format :
+                context_cache_.compiled()
+                  ->input_name_dtype_dims_format_list()) {
+                auto const& name = std::get<0>(input_name_dtype_dims_format);
+                auto dims = std::get<2>(input_name_dtype_dims_format);
+                dims[0] = 1;
+                if(find_value(input_table, name).dims() != dims) {
+                    throw std::runtime_error("invalid input dims: " + name);
+                }
+            }
+            request r{std::move(input_table), std::promise<output_table_t>(),
+                      std::chrono::steady_clock::now()};
+            auto future = r.output_promise.get_future();
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                ++queue_depth_histogram_[std::min(
+                  request_queue_.size(), queue_depth_histogram_.size() - 1)];
+                request_queue_.push_back(std::move(r));
+            }
+            request_arrived_.notify_one();
+            return future;
+        }
+
+        // The i-th element is the number of requests which found i requests
+        // queued on arrival (the last element counts 4 * max_batch_size or
+        // more)
+        auto queue_depth_histogram() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return queue_depth_histogram_;
+        }
+
+        // The i-th element is the number of batches of size i
+        auto batch_size_histogram() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return batch_size_histogram_;
+        }
+
+    private:
+        struct request {
+            input_table_t input_table;
+            std::promise<output_table_t> output_promise;
+            std::chrono::steady_clock::time_point arrival_time;
+        };
+
+        void serve() {
+            while(true) {
+                std::vector<request> batch;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    request_arrived_.wait(lock, [this]() {
+                        return is_stopped_ || !request_queue_.empty();
+                    });
+                    if(request_queue_.empty()) {
+                        return; // stopped
+                    }
+                    auto deadline =
+                      request_queue_.front().arrival_time + max_wait_time_;
+                    request_arrived_.wait_until(lock, deadline, [this]() {
+                        return is_stopped_ ||
+                               request_queue_.size() >= max_batch_size_;
+                    });
+                    auto batch_size =
+                      std::min(request_queue_.size(), max_batch_size_);
+                    ++batch_size_histogram_[batch_size];
+                    std::move(request_queue_.begin(),
+                              request_queue_.begin() + batch_size,
+                              std::back_inserter(batch));
+                    request_queue_.erase(request_queue_.begin(),
+                                         request_queue_.begin() + batch_size);
+                }
+                run_batch(batch);
+            }
+        }
+
+        void run_batch(std::vector<request>& batch) {
+            try {
+                auto const& compiled = context_cache_.compiled();
+                std::vector<std::vector<int>> input_dims_list;
+                for(auto const& input_name_dtype_dims_format :
+                    compiled->input_name_dtype_dims_format_list()) {
+                    auto dims = std::get<2>(input_name_dtype_dims_format);
+                    dims[0] = batch.size();
+                    input_dims_list.push_back(dims);
+                }
+                auto& context = context_cache_.get(input_dims_list);
+
+                // gather
+                for(auto const& input_name_dtype_dims_format :
+                    compiled->input_name_dtype_dims_format_list()) {
+                    auto const& name =
+                      std::get<0>(input_name_dtype_dims_format);
+                    auto* first = fbegin(context.input(name));
+                    for(auto const& r : batch) {
+                        auto const& arr = find_value(r.input_table, name);
+                        first = std::copy(fbegin(arr), fend(arr), first);
+                    }
+                }
+
+                auto const& output_table = context.run();
+
+                // scatter
+                std::vector<output_table_t> sample_output_table_list(
+                  batch.size());
+                for(auto const& name_and_arr : output_table) {
+                    auto const& arr = name_and_arr.second;
+                    auto sample_dims = arr.dims();
+                    sample_dims[0] = 1;
+                    auto sample_size = calc_total_size(sample_dims);
+                    for(std::size_t i = 0; i < batch.size(); ++i) {
+                        array sample_arr(arr.dtype(), sample_dims);
+                        std::copy(fbegin(arr) + i * sample_size,
+                                  fbegin(arr) + (i + 1) * sample_size,
+                                  fbegin(sample_arr));
+                        sample_output_table_list[i].insert(
+                          {name_and_arr.first, sample_arr});
+                    }
+                }
+                for(std::size_t i = 0; i < batch.size(); ++i) {
+                    batch[i].output_promise.set_value(
+                      std::move(sample_output_table_list[i]));
+                }
+            } catch(...) {
+                for(auto& r : batch) {
+                    r.output_promise.set_exception(std::current_exception());
+                }
+            }
+        }
+
+        execution_context_cache context_cache_;
+        std::size_t max_batch_size_;
+        std::chrono::microseconds max_wait_time_;
+
+        mutable std::mutex mutex_;
+        std::condition_variable request_arrived_;
+        std::deque<request> request_queue_;
+        bool is_stopped_ = false;
+        std::vector<std::size_t> queue_depth_histogram_;
+        std::vector<std::size_t> batch_size_histogram_;
+
+        std::thread worker_; // constructed last
+    };
+
+} // namespace instant
+
+#endif // INSTANT_BATCHING_SERVER_HPP
@@ -0,0 +1,415 @@
+#ifndef INSTANT_COMPILED_MODEL_FILE_HPP
+#define INSTANT_COMPILED_MODEL_FILE_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <dlfcn.h>
+#include <sys/stat.h>
+
+#include <instant/instant.hpp>
+#include <instant/isa.hpp>
+
+namespace instant {
+
+    class compiled_model_file_error : public std::runtime_error {
+    public:
+        compiled_model_file_error(std::string const& message)
+          : runtime_error(message) {}
+    };
+
+    // Bumped whenever the file layout or the meaning of packed parameters
+    // changes
+    constexpr std::uint32_t compiled_model_file_version = 1;
+    constexpr char compiled_model_file_magic[8] = {'I', 'N', 'S', 'T',
+                                                   'A', 'N', 'T', 'C'};
+    // Parameter data is aligned to this in the file (and so in memory)
+    constexpr std::size_t compiled_model_file_alignment = 64;
+
+    // Identifies the MKL-DNN build by its version. Builds not exporting
+    // the version are identified by the path, size and modification time
+    // of the shared object (or executable) defining the MKL-DNN API.
+    // Empty when neither is available
+    inline std::string get_mkldnn_fingerprint() {
+#ifdef MKLDNN_VERSION_MAJOR
+        auto const* v = mkldnn_version();
+        return std::to_string(v->major) + "." + std::to_string(v->minor) +
+               "." + std::to_string(v->patch) + "." + v->hash;
+#else
+        Dl_info info;
+        if(::dladdr(reinterpret_cast<void*>(&mkldnn_primitive_desc_query),
+                    &info) == 0 ||
+           !info.dli_fname) {
+            return std::string();
+        }
+        struct stat st;
+        if(::stat(info.dli_fname, &st) != 0) {
+            return std::string();
+        }
+        return std::string(info.dli_fname) + ":" +
+               std::to_string(st.st_size) + ":" +
+               std::to_string(st.st_mtime);
+#endif
+    }
+
+    // Packed parameters depend on the ISA and the MKL-DNN build, so a file
+    // is used only when they are the same as the ones it is made with.
+    // Throws when the build cannot be identified, so that no file made by
+    // another build is ever accepted
+    inline auto get_compiled_model_file_environment() {
+        auto fingerprint = get_mkldnn_fingerprint();
+        if(fingerprint.empty()) {
+            throw compiled_model_file_error(
+              "MKL-DNN build cannot be identified");
+        }
+        return get_cpu_isa_name() + " mkldnn-" + fingerprint;
+    }
+
+    class compiled_model_file_writer {
+    public:
+        explicit compiled_model_file_writer(std::string const& filename)
+          : ofs_(filename, std::ios::binary), filename_(filename) {
+            if(!ofs_) {
+                throw compiled_model_file_error("File open error: " +
+                                                filename);
+            }
+        }
+
+        template <typename T>
+        void write(T value) {
+            ofs_.write(reinterpret_cast<char const*>(&value), sizeof(T));
+            offset_ += sizeof(T);
+        }
+
+        void write_bytes(void const* data, std::size_t size) {
+            write<std::uint64_t>(size);
+            ofs_.write(static_cast<char const*>(data), size);
+            offset_ += size;
+        }
+
+        void write_string(std::string const& str) {
+            write_bytes(str.data(), str.size());
+        }
+
+        void write_dims(std::vector<int> const& dims) {
+            write<std::uint32_t>(dims.size());
+            for(auto d : dims) {
+                write<std::int32_t>(d);
+            }
+        }
+
+        // Data is aligned in the file (and so after mapping) by padding
+        // between its size and itself
+        void write_aligned_bytes(void const* data, std::size_t size) {
+            static const char zeros[compiled_model_file_alignment] = {};
+            write<std::uint64_t>(size);
+            auto padding = (compiled_model_file_alignment -
+                            (offset_ + sizeof(std::uint64_t)) %
+                              compiled_model_file_alignment) %
+                           compiled_model_file_alignment;
+            write<std::uint64_t>(padding);
+            ofs_.write(zeros, padding);
+            ofs_.write(static_cast<char const*>(data), size);
+            offset_ += padding + size;
+        }
+
+        void close() {
+            ofs_.close();
+            if(!ofs_) {
+                throw compiled_model_file_error("File write error: " +
+                                                filename_);
+            }
+        }
+
+    private:
+        std::ofstream ofs_;
+        std::string filename_;
+        std::size_t offset_ = 0;
+    };
+
+    class compiled_model_file_reader {
+    public:
+        compiled_model_file_reader(char const* data, std::size_t size)
+          : data_(data), size_(size) {}
+
+        template <typename T>
+        T read() {
+            T value;
+            std::memcpy(&value, consume(sizeof(T)), sizeof(T));
+            return value;
+        }
+
+        // Returns the pointer to the bytes in place
+        auto read_bytes(std::size_t& size) {
+            size = read<std::uint64_t>();
+            return consume(size);
+        }
+
+        auto read_string() {
+            std::size_t size;
+            auto const* data = read_bytes(size);
+            return std::string(data, size);
+        }
+
+        auto read_dims() {
+            std::vector<int> dims(read<std::uint32_t>());
+            for(auto& d : dims) {
+                d = read<std::int32_t>();
+            }
+            return dims;
+        }
+
+        // Enums are validated here. A corrupt value would otherwise make
+        // MKL-DNN throw instead of compiled_model_file_error
+        auto read_dtype() {
+            auto value = read<std::int32_t>();
+            for(auto dtype : {dtype_t::float_, dtype_t::uint8, dtype_t::int8,
+                              dtype_t::int32}) {
+                if(static_cast<std::int32_t>(dtype) == value) {
+                    return dtype;
+                }
+            }
+            throw compiled_model_file_error("Invalid dtype: " +
+                                            std::to_string(value));
+        }
+
+        auto read_data_type() {
+            auto value = read<std::int32_t>();
+            for(auto data_type :
+                {mkldnn::memory::data_type::f32, mkldnn::memory::data_type::s32,
+                 mkldnn::memory::data_type::s16, mkldnn::memory::data_type::s8,
+                 mkldnn::memory::data_type::u8}) {
+                if(static_cast<std::int32_t>(data_type) == value) {
+                    return data_type;
+                }
+            }
+            throw compiled_model_file_error("Invalid data type: " +
+                                            std::to_string(value));
+        }
+
+        auto read_format() {
+            auto value = read<std::int32_t>();
+            // undef and any are not layouts of actual memories
+            auto any = static_cast<std::int32_t>(mkldnn::memory::format::any);
+            if(value <= any ||
+               value >= static_cast<std::int32_t>(mkldnn_format_last)) {
+                throw compiled_model_file_error("Invalid format: " +
+                                                std::to_string(value));
+            }
+            return static_cast<mkldnn::memory::format>(value);
+        }
+
+        auto read_aligned_bytes(std::size_t& size) {
+            size = read<std::uint64_t>();
+            consume(read<std::uint64_t>()); // padding
+            return consume(size);
+        }
+
+    private:
+        char const* consume(std::size_t size) {
+            if(size_ - offset_ < size) {
+                throw compiled_model_file_error("Truncated compiled model");
+            }
+            auto const* p = data_ + offset_;
+            offset_ += size;
+            return p;
+        }
+
+        char const* data_;
+        std::size_t size_;
+        std::size_t offset_ = 0;
+    };
+
+    // Saves the optimized graph, inputs, required outputs and parameter
+    // memories already packed to the formats primitives require. Raw
+    // data of initializers is dropped since parameters are saved as
+    // memories
+    inline auto save_compiled_model(std::string const& filename,
+                                    compiled_model const& compiled) {
+        // checked before the file is created
+        auto environment = get_compiled_model_file_environment();
+        compiled_model_file_writer writer(filename);
+        for(auto c : compiled_model_file_magic) {
+            writer.write(c);
+        }
+        writer.write(compiled_model_file_version);
+        writer.write_string(environment);
+
+        auto onnx_model = compiled.onnx_model();
+        for(auto& initializer :
+            *onnx_model.mutable_graph()->mutable_initializer()) {
+            initializer.clear_raw_data();
+            initializer.clear_float_data();
+        }
+        writer.write_string(onnx_model.SerializeAsString());
+
+        auto const& input_list = compiled.input_name_dtype_dims_format_list();
+        writer.write<std::uint32_t>(input_list.size());
+        for(auto const& input : input_list) {
+            writer.write_string(std::get<0>(input));
+            writer.write<std::int32_t>(static_cast<int>(std::get<1>(input)));
+            writer.write_dims(std::get<2>(input));
+            writer.write<std::int32_t>(static_cast<int>(std::get<3>(input)));
+        }
+
+        writer.write<std::uint32_t>(compiled.required_output_set().size());
+        for(auto const& name : compiled.required_output_set()) {
+            writer.write_string(name);
+        }
+
+        auto const& parameter_memory_table = compiled.parameter_memory_table();
+        writer.write<std::uint32_t>(parameter_memory_table.size());
+        for(auto const& name_and_memory : parameter_memory_table) {
+            auto const& mem = name_and_memory.second;
+            auto format = extract_format(mem);
+            // these can not be remade from the format alone
+            if(format == mkldnn::memory::format::blocked ||
+               format == mkldnn::memory::format::wino_fmt) {
+                throw compiled_model_file_error(
+                  "Not serializable parameter format: " +
+                  name_and_memory.first);
+            }
+            writer.write_string(name_and_memory.first);
+            writer.write_dims(extract_dims(mem));
+            writer.write<std::int32_t>(
+              static_cast<int>(extract_data_type(mem)));
+            writer.write<std::int32_t>(static_cast<int>(format));
+            writer.write_aligned_bytes(mem.get_data_handle(),
+                                       mem.get_primitive_desc().get_size());
+        }
+        writer.close();
+    }
+
+    // Loads a file saved by save_compiled_model without parsing ONNX or
+    // packing parameters. Parameter memories point into the mapped file.
+    // Throws compiled_model_file_error when the file is made for another
+    // ISA, MKL-DNN or file version
+    inline std::shared_ptr<const compiled_model> load_compiled_model(
+      std::string const& filename,
+      mkldnn::engine const& engine = ::instant::get_context().engine()) {
+        std::shared_ptr<char const> mapped_file;
+        std::size_t file_size;
+        try {
+            std::tie(mapped_file, file_size) = map_file(filename);
+        } catch(onnx_load_error const& e) {
+            throw compiled_model_file_error(e.what());
+        }
+        compiled_model_file_reader reader(mapped_file.get(), file_size);
+        for(auto c : compiled_model_file_magic) {
+            if(reader.read<char>() != c) {
+                throw compiled_model_file_error("Not a compiled model: " +
+                                                filename);
+            }
+        }
+        if(reader.read<std::uint32_t>() != compiled_model_file_version) {
+            throw compiled_model_file_error("File version mismatch: " +
+                                            filename);
+        }
+        if(reader.read_string() != get_compiled_model_file_environment()) {
+            throw compiled_model_file_error(
+              "ISA or MKL-DNN version mismatch: " + filename);
+        }
+
+        onnx::ModelProto onnx_model;
+        std::size_t model_size;
+        auto const* model_data = reader.read_bytes(model_size);
+        if(!onnx_model.ParseFromArray(model_data,
+                                      static_cast<int>(model_size))) {
+            throw compiled_model_file_error("ONNX parse error: " + filename);
+        }
+
+        std::vector<std::tuple<std::string, dtype_t, std::vector<int>,
+                               mkldnn::memory::format>>
+          input_list(reader.read<std::uint32_t>());
+        for(auto& input : input_list) {
+            auto name = reader.read_string();
+            auto dtype = reader.read_dtype();
+            auto dims = reader.read_dims();
+            auto format = reader.read_format();
+            input = std::make_tuple(name, dtype, dims, format);
+        }
+
+        std::set<std::string> required_output_set;
+        auto required_output_num = reader.read<std::uint32_t>();
+        for(std::uint32_t i = 0; i < required_output_num; ++i) {
+            required_output_set.insert(reader.read_string());
+        }
+
+        std::unordered_map<std::string, const mkldnn::memory>
+          parameter_memory_table;
+        auto parameter_num = reader.read<std::uint32_t>();
+        for(std::uint32_t i = 0; i < parameter_num; ++i) {
+            auto name = reader.read_string();
+            auto dims = reader.read_dims();
+            auto data_type = reader.read_data_type();
+            auto format = reader.read_format();
+            std::size_t size;
+            auto const* data = reader.read_aligned_bytes(size);
+            std::unique_ptr<mkldnn::memory::primitive_desc> pd_p;
+            try {
+                pd_p = std::make_unique<mkldnn::memory::primitive_desc>(
+                  mkldnn::memory::desc({dims}, data_type, format), engine);
+            } catch(mkldnn::error const&) {
+                // e.g. the format does not match the number of dims
+                throw compiled_model_file_error("Invalid parameter: " + name);
+            }
+            auto const& pd = *pd_p;
+            if(pd.get_size() != size) {
+                throw compiled_model_file_error("Invalid parameter size: " +
+                                                name);
+            }
+            parameter_memory_table.insert(
+              {name, mkldnn::memory(pd, const_cast<char*>(data))});
+        }
+
+        auto shared_onnx_model =
+          std::make_shared<const onnx::ModelProto>(std::move(onnx_model));
+        return std::make_shared<const compiled_model>(
+          shared_onnx_model, graph_ir(shared_onnx_model->graph()),
+          std::unordered_map<std::string, array>(),
+          std::vector<array>(), parameter_memory_table,
+          std::vector<std::pair<std::string, mkldnn::memory>>(), input_list,
+          required_output_set, engine, mapped_file);
+    }
+
+    // Loads compiled_model_filename when it is usable. Otherwise builds
+    // the model from onnx_filename and saves it to compiled_model_filename
+    // for the next start
+    inline auto load_or_make_compiled_model(
+      std::string const& compiled_model_filename,
+      std::string const& onnx_filename,
+      std::vector<std::tuple<std::string, dtype_t, std::vector<int>,
+                             mkldnn::memory::format>> const&
+        input_name_dtype_dims_format_list,
+      std::vector<std::string> const& required_output_name_list,
+      mkldnn::engine const& engine = ::instant::get_context().engine()) {
+        if(std::ifstream(compiled_model_filename)) {
+            try {
+                return load_compiled_model(compiled_model_filename, engine);
+            } catch(compiled_model_file_error const&) {
+                // made for another environment. It is rebuilt
+            }
+        }
+        onnx::ModelProto onnx_model;
+        std::unordered_map<std::string, array> parameter_table;
+        std::tie(onnx_model, parameter_table) =
+          load_onnx_with_mapped_parameter_table(onnx_filename);
+        auto compiled = make_compiled_model(
+          onnx_model, std::move(parameter_table),
+          input_name_dtype_dims_format_list, required_output_name_list,
+          engine);
+        try {
+            save_compiled_model(compiled_model_filename, *compiled);
+        } catch(compiled_model_file_error const&) {
+            // the MKL-DNN build cannot be identified. It is not cached
+        }
+        return compiled;
+    }
+
+} // namespace instant
+
+#endif // INSTANT_COMPILED_MODEL_FILE_HPP
@@ -3,6 +3,8 @@
 #include <cassert>
 #include <climits>
 #include <cstdint>
+#include <stdexcept>
+#include <string>
 
 #include <mkldnn.hpp>
 
@@ -51,8 +53,19 @@ namespace instant {
         if (d == dtype_t::float_) {
             return mkldnn::memory::data_type::f32;
         }
+        if (d == dtype_t::uint8) {
+            return mkldnn::memory::data_type::u8;
+        }
+        if (d == dtype_t::int8) {
+            return mkldnn::memory::data_type::s8;
+        }
+        if (d == dtype_t::int32) {
+            return mkldnn::memory::data_type::s32;
+        }
         // TODO other types
-        assert(!"Not come here");
+        throw std::runtime_error(
+          "Not supported dtype: " +
+          std::to_string(dtype_t_to_tensor_proto_data_type(d)));
     }
 
     template<dtype_t> constexpr int size_in_bytes = 0;
@@ -67,6 +80,31 @@ namespace instant {
     template<> constexpr int size_in_bytes<dtype_t::string_> = 1; // TODO check size
     template<> constexpr int size_in_bytes<dtype_t::bool_> = 1;
 
+    inline int get_size_in_bytes(dtype_t d) {
+        switch (d) {
+        case dtype_t::float_:
+            return size_in_bytes<dtype_t::float_>;
+        case dtype_t::uint8:
+            return size_in_bytes<dtype_t::uint8>;
+        case dtype_t::int8:
+            return size_in_bytes<dtype_t::int8>;
+        case dtype_t::uint16:
+            return size_in_bytes<dtype_t::uint16>;
+        case dtype_t::int16:
+            return size_in_bytes<dtype_t::int16>;
+        case dtype_t::int32:
+            return size_in_bytes<dtype_t::int32>;
+        case dtype_t::int64:
+            return size_in_bytes<dtype_t::int64>;
+        case dtype_t::bool_:
+            return size_in_bytes<dtype_t::bool_>;
+        default:
+            throw std::runtime_error(
+              "Not supported dtype: " +
+              std::to_string(dtype_t_to_tensor_proto_data_type(d)));
+        }
+    }
+
     template<dtype_t> struct dtype_t_to_type {};
 
     template<> struct dtype_t_to_type<dtype_t::float_> { using type = float; };
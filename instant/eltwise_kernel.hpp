@@ -0,0 +1,630 @@
+#ifndef INSTANT_ELTWISE_KERNEL_HPP
+#define INSTANT_ELTWISE_KERNEL_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <instant/isa.hpp>
+
+namespace instant {
+
+    // Element-wise operations run by host kernels. Some of them have
+    // MKL-DNN primitives too but are here so that they can be chained
+    enum class eltwise_kind {
+        abs,
+        affine,
+        clip,
+        elu,
+        exp,
+        hard_sigmoid,
+        lane_affine,
+        leaky_relu,
+        log,
+        neg,
+        reciprocal,
+        relu,
+        sigmoid,
+        sqrt,
+        tanh
+    };
+
+    // alpha and beta are min and max of clip, alpha and beta of
+    // hard_sigmoid, alpha of elu and leaky_relu and scale and shift of
+    // affine (alpha * x + beta). lane_affine takes scale_list[k % period]
+    // and shift_list[k % period] for the k-th element of a kernel call
+    // instead, e.g. the constants of the channels of the elements. period
+    // is a multiple of 16 and is shared by the lane_affine operations of a
+    // call
+    struct eltwise_op {
+        eltwise_kind kind;
+        float alpha;
+        float beta;
+        float const* scale_list = nullptr;
+        float const* shift_list = nullptr;
+        std::size_t period = 0;
+    };
+
+    // y = op(x) by the standard library, where x is the k-th element of a
+    // kernel call. Kernels are tested against it
+    inline float apply_eltwise_op_reference(eltwise_op const& op, float x,
+                                            std::size_t k = 0) {
+        switch(op.kind) {
+        case eltwise_kind::abs:
+            return std::abs(x);
+        case eltwise_kind::affine:
+            return op.alpha * x + op.beta;
+        case eltwise_kind::clip:
+            return std::min(std::max(x, op.alpha), op.beta);
+        case eltwise_kind::elu:
+            return x > 0.f ? x : op.alpha * (std::exp(x) - 1.f);
+        case eltwise_kind::exp:
+            return std::exp(x);
+        case eltwise_kind::hard_sigmoid:
+            return std::min(std::max(op.alpha * x + op.beta, 0.f), 1.f);
+        case eltwise_kind::lane_affine:
+            return op.scale_list[k % op.period] * x +
+                   op.shift_list[k % op.period];
+        case eltwise_kind::leaky_relu:
+            return x > 0.f ? x : op.alpha * x;
+        case eltwise_kind::log:
+            return std::log(x);
+        case eltwise_kind::neg:
+            return -x;
+        case eltwise_kind::reciprocal:
+            return 1.f / x;
+        case eltwise_kind::relu:
+            return std::max(x, 0.f);
+        case eltwise_kind::sigmoid:
+            return 1.f / (1.f + std::exp(-x));
+        case eltwise_kind::sqrt:
+            return std::sqrt(x);
+        case eltwise_kind::tanh:
+            return std::tanh(x);
+        }
+        throw std::runtime_error("Unknown eltwise kind");
+    }
+
+    // Kernel applying op to n elements of x into y, which may be x
+    using eltwise_kernel =
+      void (*)(eltwise_op const&, float const*, float*, std::size_t);
+
+    // Kernel applying the operations of op_list in order to n elements of x
+    // into y, which may be x. Each element is read and written once
+    using eltwise_chain_kernel = void (*)(std::vector<eltwise_op> const&,
+                                          float const*, float*, std::size_t);
+
+    // Kernel computing c = a + b for n elements. a_step and b_step are 1
+    // for an operand of n elements and 0 for a scalar broadcast to them. c
+    // may be a or b
+    using add_kernel = void (*)(float const*, int, float const*, int, float*,
+                                std::size_t);
+
+    inline void run_add_reference(float const* a, int a_step, float const* b,
+                                  int b_step, float* c, std::size_t n) {
+        for(std::size_t i = 0; i < n; ++i) {
+            c[i] = a[i * a_step] + b[i * b_step];
+        }
+    }
+
+    inline void run_eltwise_op_reference(eltwise_op const& op,
+                                         float const* x, float* y,
+                                         std::size_t n) {
+        for(std::size_t i = 0; i < n; ++i) {
+            y[i] = apply_eltwise_op_reference(op, x[i], i);
+        }
+    }
+
+    inline void run_eltwise_chain_reference(
+      std::vector<eltwise_op> const& op_list, float const* x, float* y,
+      std::size_t n) {
+        for(std::size_t i = 0; i < n; ++i) {
+            auto v = x[i];
+            for(auto const& op : op_list) {
+                v = apply_eltwise_op_reference(op, v, i);
+            }
+            y[i] = v;
+        }
+    }
+
+#if defined(__GNUC__)
+    // Kernels are written once on vectors of the GCC vector extension and
+    // are compiled for each ISA by being flattened into a function of its
+    // target. Selects are made of masks since the compiler vectorizes no
+    // branch of floats. Vectors are passed by reference so that no
+    // function out of the targets takes them in registers
+
+    template <int N>
+    struct float_vec {
+        typedef float type __attribute__((vector_size(N * sizeof(float))));
+    };
+
+    // dst = mask ? src : dst for each element
+    template <typename V, typename I>
+    inline void blend_vec(V& dst, I const& mask, V const& src) {
+        dst = reinterpret_cast<V>((mask & reinterpret_cast<I>(src)) |
+                                  (~mask & reinterpret_cast<I>(dst)));
+    }
+
+    template <typename V>
+    inline void min_vec(V& x, float y) {
+        V v = V{} + y;
+        blend_vec(x, v < x, v);
+    }
+
+    template <typename V>
+    inline void max_vec(V& x, float y) {
+        V v = V{} + y;
+        blend_vec(x, x < v, v);
+    }
+
+    // exp of Cephes expf over the whole range of float. Results below the
+    // normal range are flushed to 0, and x beyond the range makes inf
+    template <typename V>
+    inline void exp_vec(V& x) {
+        using I = decltype(x < x);
+        constexpr auto max_x = 88.7228391f;  // log(FLT_MAX)
+        constexpr auto min_x = -87.3365448f; // log(FLT_MIN)
+        I is_overflow = x > max_x;
+        I is_underflow = x < min_x;
+        max_vec(x, min_x);
+        min_vec(x, max_x);
+        // i = floor(x / log(2) + 1/2) by truncation of a positive value
+        I i = __builtin_convertvector(x * 1.44269504f + 128.5f, I) - 128;
+        V n = __builtin_convertvector(i, V);
+        V r = x - n * 0.693359375f + n * 2.12194440e-4f;
+        V p = V{} + 1.9875691500e-4f;
+        p = p * r + 1.3981999507e-3f;
+        p = p * r + 8.3334519073e-3f;
+        p = p * r + 4.1665795894e-2f;
+        p = p * r + 1.6666665459e-1f;
+        p = p * r + 5.0000001201e-1f;
+        p = p * r * r + r + 1.f;
+        // 2^i is applied in two halves since 2^128 is not a float
+        I half_i = i >> 1;
+        x = p * reinterpret_cast<V>((half_i + 127) << 23) *
+            reinterpret_cast<V>((i - half_i + 127) << 23);
+        blend_vec(x, is_underflow, V{});
+        blend_vec(x, is_overflow, V{} + std::numeric_limits<float>::infinity());
+    }
+
+    // x = m * 2^e with m in [sqrt(1/2), sqrt(2)) taken from the bits of x
+    // as musl logf does, and log(m) = 2 * atanh((m - 1) / (m + 1)).
+    // Denormal x is not supported
+    template <typename V>
+    inline void log_vec(V& x) {
+        using I = decltype(x < x);
+        I bits = reinterpret_cast<I>(x) + (0x3f800000 - 0x3f3504f3);
+        I e = (bits >> 23) - 127;
+        V m = reinterpret_cast<V>((bits & 0x007fffff) + 0x3f3504f3);
+        V s = (m - 1.f) / (m + 1.f);
+        V s2 = s * s;
+        V p = V{} + 2.f / 9.f;
+        p = p * s2 + 2.f / 7.f;
+        p = p * s2 + 2.f / 5.f;
+        p = p * s2 + 2.f / 3.f;
+        p = p * s2 + 2.f;
+        V y = p * s + __builtin_convertvector(e, V) * 0.693147181f;
+        constexpr auto inf = std::numeric_limits<float>::infinity();
+        blend_vec(y, x == inf, V{} + inf);
+        blend_vec(y, x == 0.f, V{} - inf);
+        // negative or NaN
+        blend_vec(y, !(x >= 0.f),
+                  V{} + std::numeric_limits<float>::quiet_NaN());
+        x = y;
+    }
+
+    // 1 / sqrt(x) guessed from the bits of x is refined by Newton's method,
+    // since the extension has no sqrt of vectors
+    template <typename V>
+    inline void sqrt_vec(V& x) {
+        using I = decltype(x < x);
+        V r = reinterpret_cast<V>(0x5f375a86 - (reinterpret_cast<I>(x) >> 1));
+        V half_x = 0.5f * x;
+        for(int i = 0; i < 3; ++i) {
+            r = r * (1.5f - half_x * r * r);
+        }
+        V y = x * r;
+        y += 0.5f * r * (x - y * y);
+        constexpr auto inf = std::numeric_limits<float>::infinity();
+        blend_vec(y, x == inf, V{} + inf);
+        // negative or NaN
+        blend_vec(y, !(x >= 0.f),
+                  V{} + std::numeric_limits<float>::quiet_NaN());
+        x = y;
+    }
+
+    // Small x takes the polynomial of Cephes tanhf to keep the relative
+    // error
+    template <typename V>
+    inline void tanh_vec(V& x) {
+        using I = decltype(x < x);
+        V z = x * x;
+        V p = V{} - 5.70498872745e-3f;
+        p = p * z + 2.06390887954e-2f;
+        p = p * z - 5.37397155531e-2f;
+        p = p * z + 1.33314422036e-1f;
+        p = p * z - 3.33332819422e-1f;
+        V small = p * z * x + x;
+        I abs_bits = reinterpret_cast<I>(x) & 0x7fffffff;
+        I is_small = abs_bits < reinterpret_cast<I>(V{} + 0.625f);
+        V e = x + x;
+        exp_vec(e);
+        x = 1.f - 2.f / (e + 1.f);
+        blend_vec(x, is_small, small);
+    }
+
+    // lane is the offset of x in the lists of lane_affine
+    template <typename V>
+    inline void apply_eltwise_op_vec(eltwise_op const& op, V& x,
+                                     std::size_t lane) {
+        using I = decltype(x < x);
+        switch(op.kind) {
+        case eltwise_kind::abs:
+            x = reinterpret_cast<V>(reinterpret_cast<I>(x) & 0x7fffffff);
+            break;
+        case eltwise_kind::affine:
+            x = op.alpha * x + op.beta;
+            break;
+        case eltwise_kind::clip:
+            max_vec(x, op.alpha);
+            min_vec(x, op.beta);
+            break;
+        case eltwise_kind::elu: {
+            V negative = x;
+            min_vec(negative, 0.f);
+            exp_vec(negative);
+            max_vec(x, 0.f);
+            x += op.alpha * (negative - 1.f);
+            break;
+        }
+        case eltwise_kind::exp:
+            exp_vec(x);
+            break;
+        case eltwise_kind::hard_sigmoid:
+            x = op.alpha * x + op.beta;
+            max_vec(x, 0.f);
+            min_vec(x, 1.f);
+            break;
+        case eltwise_kind::lane_affine: {
+            V scale, shift;
+            std::memcpy(&scale, op.scale_list + lane, sizeof(V));
+            std::memcpy(&shift, op.shift_list + lane, sizeof(V));
+            x = scale * x + shift;
+            break;
+        }
+        case eltwise_kind::leaky_relu: {
+            V negative = x;
+            min_vec(negative, 0.f);
+            max_vec(x, 0.f);
+            x += op.alpha * negative;
+            break;
+        }
+        case eltwise_kind::log:
+            log_vec(x);
+            break;
+        case eltwise_kind::neg:
+            x = -x;
+            break;
+        case eltwise_kind::reciprocal:
+            x = 1.f / x;
+            break;
+        case eltwise_kind::relu:
+            max_vec(x, 0.f);
+            break;
+        case eltwise_kind::sigmoid: {
+            V e = -x;
+            exp_vec(e);
+            x = 1.f / (1.f + e);
+            break;
+        }
+        case eltwise_kind::sqrt:
+            sqrt_vec(x);
+            break;
+        case eltwise_kind::tanh:
+            tanh_vec(x);
+            break;
+        }
+    }
+
+    // Operations of op_list are applied to each vector in registers. The
+    // remainder of n is computed in a vector padded with zeros. The lane
+    // offset wraps by comparison rather than by division of each index
+    template <int N>
+    inline void apply_eltwise_op_loop(eltwise_op const* op_list, int op_num,
+                                      float const* x, float* y,
+                                      std::size_t n) {
+        using V = typename float_vec<N>::type;
+        std::size_t period = N;
+        for(int j = 0; j < op_num; ++j) {
+            if(op_list[j].kind == eltwise_kind::lane_affine) {
+                period = op_list[j].period;
+            }
+        }
+        std::size_t i = 0, lane = 0;
+        for(; i + N <= n; i += N) {
+            V v;
+            std::memcpy(&v, x + i, sizeof(V));
+            for(int j = 0; j < op_num; ++j) {
+                apply_eltwise_op_vec(op_list[j], v, lane);
+            }
+            std::memcpy(y + i, &v, sizeof(V));
+            lane += N;
+            if(lane == period) {
+                lane = 0;
+            }
+        }
+        if(i < n) {
+            V v{};
+            std::memcpy(&v, x + i, (n - i) * sizeof(float));
+            for(int j = 0; j < op_num; ++j) {
+                apply_eltwise_op_vec(op_list[j], v, lane);
+            }
+            std::memcpy(y + i, &v, (n - i) * sizeof(float));
+        }
+    }
+
+    // Loads size elements of p from i, or broadcasts *p when it is a
+    // scalar
+    template <bool IsScalar, typename V>
+    inline void load_add_operand_vec(V& v, float const* p, std::size_t i,
+                                     std::size_t size) {
+        if(IsScalar) {
+            v = V{} + *p;
+        } else {
+            std::memcpy(&v, p + i, size * sizeof(float));
+        }
+    }
+
+    template <int N, bool IsAScalar, bool IsBScalar>
+    inline void add_loop(float const* a, float const* b, float* c,
+                         std::size_t n) {
+        using V = typename float_vec<N>::type;
+        std::size_t i = 0;
+        for(; i + N <= n; i += N) {
+            V va, vb;
+            load_add_operand_vec<IsAScalar>(va, a, i, N);
+            load_add_operand_vec<IsBScalar>(vb, b, i, N);
+            va += vb;
+            std::memcpy(c + i, &va, sizeof(V));
+        }
+        if(i < n) {
+            V va{}, vb{};
+            load_add_operand_vec<IsAScalar>(va, a, i, n - i);
+            load_add_operand_vec<IsBScalar>(vb, b, i, n - i);
+            va += vb;
+            std::memcpy(c + i, &va, (n - i) * sizeof(float));
+        }
+    }
+
+    // Steps are dispatched out of the loop so that each loop has no branch
+    template <int N>
+    inline void add_loop(float const* a, int a_step, float const* b,
+                         int b_step, float* c, std::size_t n) {
+        if(a_step != 0 && b_step != 0) {
+            add_loop<N, false, false>(a, b, c, n);
+        } else if(a_step != 0) {
+            add_loop<N, false, true>(a, b, c, n);
+        } else if(b_step != 0) {
+            add_loop<N, true, false>(a, b, c, n);
+        } else {
+            add_loop<N, true, true>(a, b, c, n);
+        }
+    }
+
+    __attribute__((flatten)) inline void
+    run_add_generic(float const* a, int a_step, float const* b, int b_step,
+                    float* c, std::size_t n) {
+        add_loop<4>(a, a_step, b, b_step, c, n);
+    }
+
+    __attribute__((flatten)) inline void
+    run_eltwise_op_generic(eltwise_op const& op, float const* x, float* y,
+                           std::size_t n) {
+        apply_eltwise_op_loop<4>(&op, 1, x, y, n);
+    }
+
+    __attribute__((flatten)) inline void
+    run_eltwise_chain_generic(std::vector<eltwise_op> const& op_list,
+                              float const* x, float* y, std::size_t n) {
+        apply_eltwise_op_loop<4>(op_list.data(),
+                                 static_cast<int>(op_list.size()), x, y, n);
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    __attribute__((target("avx2,fma"), flatten)) inline void
+    run_eltwise_op_avx2(eltwise_op const& op, float const* x, float* y,
+                        std::size_t n) {
+        apply_eltwise_op_loop<8>(&op, 1, x, y, n);
+    }
+
+    __attribute__((target("avx2,fma"), flatten)) inline void
+    run_eltwise_chain_avx2(std::vector<eltwise_op> const& op_list,
+                           float const* x, float* y, std::size_t n) {
+        apply_eltwise_op_loop<8>(op_list.data(),
+                                 static_cast<int>(op_list.size()), x, y, n);
+    }
+
+    __attribute__((target("avx2,fma"), flatten)) inline void
+    run_add_avx2(float const* a, int a_step, float const* b, int b_step,
+                 float* c, std::size_t n) {
+        add_loop<8>(a, a_step, b, b_step, c, n);
+    }
+
+    __attribute__((target("avx512f,avx2,fma"), flatten)) inline void
+    run_add_avx512(float const* a, int a_step, float const* b, int b_step,
+                   float* c, std::size_t n) {
+        add_loop<16>(a, a_step, b, b_step, c, n);
+    }
+
+    __attribute__((target("avx512f,avx2,fma"), flatten)) inline void
+    run_eltwise_op_avx512(eltwise_op const& op, float const* x, float* y,
+                          std::size_t n) {
+        apply_eltwise_op_loop<16>(&op, 1, x, y, n);
+    }
+
+    __attribute__((target("avx512f,avx2,fma"), flatten)) inline void
+    run_eltwise_chain_avx512(std::vector<eltwise_op> const& op_list,
+                             float const* x, float* y, std::size_t n) {
+        apply_eltwise_op_loop<16>(op_list.data(),
+                                  static_cast<int>(op_list.size()), x, y, n);
+    }
+#endif
+#endif
+
+    // Kernel for the ISA named as get_cpu_isa_name does. "reference" is
+    // the scalar loop of the standard library. ISAs without their own
+    // kernel take the generic one of 4-float vectors
+    inline eltwise_kernel get_eltwise_kernel(std::string const& isa_name) {
+#if defined(__GNUC__)
+#if defined(__x86_64__) || defined(__i386__)
+        if(isa_name == "avx512") {
+            return run_eltwise_op_avx512;
+        }
+        if(isa_name == "avx2") {
+            return run_eltwise_op_avx2;
+        }
+#endif
+        if(isa_name != "reference") {
+            return run_eltwise_op_generic;
+        }
+#endif
+        return run_eltwise_op_reference;
+    }
+
+    // Kernel for the running CPU
+    inline eltwise_kernel get_eltwise_kernel() {
+        static const auto kernel = get_eltwise_kernel(get_cpu_isa_name());
+        return kernel;
+    }
+
+    // Chain kernel for the ISA as get_eltwise_kernel
+    inline eltwise_chain_kernel
+    get_eltwise_chain_kernel(std::string const& isa_name) {
+#if defined(__GNUC__)
+#if defined(__x86_64__) || defined(__i386__)
+        if(isa_name == "avx512") {
+            return run_eltwise_chain_avx512;
+        }
+        if(isa_name == "avx2") {
+            return run_eltwise_chain_avx2;
+        }
+#endif
+        if(isa_name != "reference") {
+            return run_eltwise_chain_generic;
+        }
+#endif
+        return run_eltwise_chain_reference;
+    }
+
+    // Chain kernel for the running CPU
+    inline eltwise_chain_kernel get_eltwise_chain_kernel() {
+        static const auto kernel =
+          get_eltwise_chain_kernel(get_cpu_isa_name());
+        return kernel;
+    }
+
+    // Add kernel for the ISA as get_eltwise_kernel
+    inline add_kernel get_add_kernel(std::string const& isa_name) {
+#if defined(__GNUC__)
+#if defined(__x86_64__) || defined(__i386__)
+        if(isa_name == "avx512") {
+            return run_add_avx512;
+        }
+        if(isa_name == "avx2") {
+            return run_add_avx2;
+        }
+#endif
+        if(isa_name != "reference") {
+            return run_add_generic;
+        }
+#endif
+        return run_add_reference;
+    }
+
+    // Add kernel for the running CPU
+    inline add_kernel get_add_kernel() {
+        static const auto kernel = get_add_kernel(get_cpu_isa_name());
+        return kernel;
+    }
+
+    // Elements of a chunk of eltwise kernels. Chunks are of whole cache
+    // lines so that threads never share one, and fit in L2 cache
+    constexpr std::size_t eltwise_chunk_size = 16 * 1024;
+
+    // Calls f(first, size) for chunks of n elements divided among threads
+    template <typename F>
+    inline void for_each_eltwise_chunk(std::size_t n, F f) {
+        constexpr auto chunk_size = eltwise_chunk_size;
+        auto chunk_num = static_cast<long>((n + chunk_size - 1) / chunk_size);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+        for(long i = 0; i < chunk_num; ++i) {
+            auto first = static_cast<std::size_t>(i) * chunk_size;
+            f(first, std::min(chunk_size, n - first));
+        }
+    }
+
+    // Operations applied to spans of span_size elements, where the s-th
+    // span takes op_list_list[s % op_list_list.size()]. Its lane_affine
+    // operations see the constants of the elements of the span from its
+    // first one. period is theirs (16 without them). list_data holds their
+    // lists
+    struct eltwise_segment {
+        std::vector<std::vector<eltwise_op>> op_list_list;
+        std::size_t span_size;
+        std::size_t period;
+        std::shared_ptr<std::vector<float>> list_data;
+    };
+
+    inline void run_eltwise_kernel(eltwise_kernel kernel,
+                                   eltwise_op const& op, float const* x,
+                                   float* y, std::size_t n) {
+        for_each_eltwise_chunk(n, [&](std::size_t first, std::size_t size) {
+            kernel(op, x + first, y + first, size);
+        });
+    }
+
+    inline void run_eltwise_kernel(eltwise_chain_kernel kernel,
+                                   std::vector<eltwise_op> const& op_list,
+                                   float const* x, float* y, std::size_t n) {
+        for_each_eltwise_chunk(n, [&](std::size_t first, std::size_t size) {
+            kernel(op_list, x + first, y + first, size);
+        });
+    }
+
+    // Chunks of a span start at multiples of the period of the segment
+    inline void run_eltwise_kernel(eltwise_chain_kernel kernel,
+                                   eltwise_segment const& segment,
+                                   float const* x, float* y, std::size_t n) {
+        auto span_size = segment.span_size;
+        auto chunk_size =
+          std::max(eltwise_chunk_size / segment.period, std::size_t(1)) *
+          segment.period;
+        auto chunk_num_per_span = (span_size + chunk_size - 1) / chunk_size;
+        auto chunk_num = static_cast<long>(n / span_size * chunk_num_per_span);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+        for(long i = 0; i < chunk_num; ++i) {
+            auto span_index = static_cast<std::size_t>(i) / chunk_num_per_span;
+            auto first_in_span =
+              static_cast<std::size_t>(i) % chunk_num_per_span * chunk_size;
+            auto first = span_index * span_size + first_in_span;
+            auto const& op_list =
+              segment.op_list_list[span_index % segment.op_list_list.size()];
+            kernel(op_list, x + first, y + first,
+                   std::min(chunk_size, span_size - first_in_span));
+        }
+    }
+
+} // namespace instant
+
+#endif // INSTANT_ELTWISE_KERNEL_HPP
@@ -0,0 +1,388 @@
+#ifndef INSTANT_GRAPH_HPP
+#define INSTANT_GRAPH_HPP
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <instant/load_onnx.hpp>
+#include <instant/onnx.pb.h>
+
+namespace instant {
+
+    using attribute_table_t =
+      decltype(make_attribute_table(std::declval<onnx::NodeProto>()));
+
+    // Node of graph_ir. Tensors are referred to by their IDs
+    struct graph_node {
+        onnx::NodeProto const* proto;
+        std::vector<int> input_id_list;
+        std::vector<int> output_id_list;
+        attribute_table_t attribute_table;
+
+        std::string const& op_type() const { return proto->op_type(); }
+        std::string const& name() const { return proto->name(); }
+        int input_size() const { return proto->input_size(); }
+        std::string const& input(int i) const { return proto->input(i); }
+        int output_size() const { return proto->output_size(); }
+        std::string const& output(int i) const { return proto->output(i); }
+    };
+
+    // Dense view of an ONNX graph made once before passes and kept until
+    // nets are made. Tensor names are interned to IDs in [0, tensor_num()),
+    // so per tensor data is held in vectors indexed by ID instead of tables
+    // keyed by names. Nodes keep the order of the graph and their
+    // attributes are parsed once. It refers to the graph, which has to
+    // outlive it. Passes change the graph only through the mutating
+    // members below, which keep the view in sync without parsing it again.
+    // They need the graph given as non-const
+    class graph_ir {
+    public:
+        explicit graph_ir(onnx::GraphProto const& graph) : graph_(&graph) {
+            node_list_.reserve(graph.node_size());
+            for(int i = 0; i < graph.node_size(); ++i) {
+                node_list_.push_back(make_node(i));
+                link_node(i);
+            }
+
+            // shapes declared in the graph
+            for(auto const& initializer : graph.initializer()) {
+                auto id = intern(initializer.name());
+                dims_list_[id].assign(initializer.dims().begin(),
+                                      initializer.dims().end());
+            }
+            for(auto const& input : graph.input()) {
+                load_value_info_dims(input);
+            }
+            for(auto const& value_info : graph.value_info()) {
+                load_value_info_dims(value_info);
+            }
+            for(auto const& output : graph.output()) {
+                is_graph_output_list_[load_value_info_dims(output)] = true;
+            }
+        }
+        explicit graph_ir(onnx::GraphProto& graph)
+          : graph_ir(static_cast<onnx::GraphProto const&>(graph)) {
+            mutable_graph_ = &graph;
+        }
+
+        auto const& graph() const { return *graph_; }
+
+        int node_num() const { return node_list_.size(); }
+        auto const& node(int node_index) const {
+            return node_list_[node_index];
+        }
+        auto const& node_list() const { return node_list_; }
+
+        int tensor_num() const { return name_list_.size(); }
+        auto const& tensor_name(int tensor_id) const {
+            return name_list_[tensor_id];
+        }
+        // Returns -1 when the graph does not have the tensor
+        int find_tensor_id(std::string const& name) const {
+            auto found = id_table_.find(name);
+            return found == id_table_.end() ? -1 : found->second;
+        }
+        int tensor_id(std::string const& name) const {
+            auto id = find_tensor_id(name);
+            if(id == -1) {
+                throw std::runtime_error("Tensor not found: " + name);
+            }
+            return id;
+        }
+
+        // Index of the node producing the tensor. -1 for model inputs and
+        // parameters
+        int producer(int tensor_id) const { return producer_list_[tensor_id]; }
+        // Indices of nodes taking the tensor as an input in node order. A
+        // node is listed as many times as it takes the tensor
+        auto const& consumer_list(int tensor_id) const {
+            return consumer_list_[tensor_id];
+        }
+        bool is_graph_output(int tensor_id) const {
+            return is_graph_output_list_[tensor_id];
+        }
+
+        // Empty when the shape is not known
+        auto const& dims(int tensor_id) const { return dims_list_[tensor_id]; }
+        void set_dims(int tensor_id, std::vector<int> const& dims) {
+            dims_list_[tensor_id] = dims;
+        }
+
+        onnx::GraphProto& mutable_graph() {
+            if(!mutable_graph_) {
+                throw std::runtime_error("graph_ir of a const graph");
+            }
+            return *mutable_graph_;
+        }
+
+        // Returns the attribute of the node. It is added with type when the
+        // node does not have it
+        onnx::AttributeProto&
+        mutable_attribute(int node_index, std::string const& name,
+                          onnx::AttributeProto_AttributeType type) {
+            auto& proto = *mutable_graph().mutable_node(node_index);
+            for(auto& attr : *proto.mutable_attribute()) {
+                if(attr.name() == name) {
+                    return attr;
+                }
+            }
+            auto& attr = *proto.add_attribute();
+            attr.set_name(name);
+            attr.set_type(type);
+            node_list_[node_index].attribute_table.insert(
+              {name, std::cref(attr)});
+            return attr;
+        }
+
+        void add_input(int node_index, int tensor_id) {
+            mutable_graph().mutable_node(node_index)->add_input(
+              name_list_[tensor_id]);
+            node_list_[node_index].input_id_list.push_back(tensor_id);
+            add_consumer(tensor_id, node_index);
+        }
+        void set_input(int node_index, int k, int tensor_id) {
+            auto& input_id = node_list_[node_index].input_id_list[k];
+            remove_consumer(input_id, node_index);
+            mutable_graph().mutable_node(node_index)->set_input(
+              k, name_list_[tensor_id]);
+            input_id = tensor_id;
+            add_consumer(tensor_id, node_index);
+        }
+        // The tensor may still be listed as an output of the node producing
+        // it until that node is removed
+        void set_output(int node_index, int k, int tensor_id) {
+            auto& output_id = node_list_[node_index].output_id_list[k];
+            if(producer_list_[output_id] == node_index) {
+                producer_list_[output_id] = -1;
+            }
+            mutable_graph().mutable_node(node_index)->set_output(
+              k, name_list_[tensor_id]);
+            output_id = tensor_id;
+            producer_list_[tensor_id] = node_index;
+        }
+
+        // Replaces the node with proto, whose tensors have to be in the
+        // graph already. Only the new node is parsed
+        void replace_node(int node_index, onnx::NodeProto proto) {
+            unlink_node(node_index);
+            mutable_graph().mutable_node(node_index)->Swap(&proto);
+            node_list_[node_index] = make_node(node_index);
+            link_node(node_index);
+        }
+
+        // Removes the nodes and keeps the order of the others. Node protos
+        // stay at their addresses, so nothing is parsed again. Tensor IDs
+        // are kept. Returns the number of removed nodes
+        int remove_nodes(std::vector<bool> const& is_removed_list) {
+            auto& node_protos = *mutable_graph().mutable_node();
+            int kept_node_num = 0;
+            for(int i = 0; i < node_num(); ++i) {
+                if(is_removed_list[i]) {
+                    continue;
+                }
+                if(i != kept_node_num) {
+                    node_protos.SwapElements(i, kept_node_num);
+                    node_list_[kept_node_num] = std::move(node_list_[i]);
+                }
+                ++kept_node_num;
+            }
+            auto removed_node_num = node_num() - kept_node_num;
+            node_protos.DeleteSubrange(kept_node_num, removed_node_num);
+            node_list_.resize(kept_node_num);
+
+            std::fill(producer_list_.begin(), producer_list_.end(), -1);
+            for(auto& consumer_list : consumer_list_) {
+                consumer_list.clear();
+            }
+            for(int i = 0; i < node_num(); ++i) {
+                link_node(i);
+            }
+            return removed_node_num;
+        }
+
+        // Removes initializers, inputs and outputs of the graph whose
+        // tensors are not retained
+        void retain_graph_values(std::vector<bool> const& is_retained_list) {
+            auto retain = [this, &is_retained_list](auto& value_list) {
+                int retained_num = 0;
+                for(int i = 0; i < value_list.size(); ++i) {
+                    auto id = find_tensor_id(value_list.Get(i).name());
+                    if(is_retained_list[id]) {
+                        value_list.SwapElements(i, retained_num++);
+                    }
+                }
+                value_list.DeleteSubrange(retained_num,
+                                          value_list.size() - retained_num);
+            };
+            auto& graph = mutable_graph();
+            retain(*graph.mutable_initializer());
+            retain(*graph.mutable_input());
+            retain(*graph.mutable_output());
+            for(int id = 0; id < tensor_num(); ++id) {
+                is_graph_output_list_[id] =
+                  is_graph_output_list_[id] && is_retained_list[id];
+            }
+        }
+
+        // Returns the ID of the tensor. It is added when the graph does not
+        // have it yet
+        int intern(std::string const& name) {
+            auto inserted = id_table_.insert({name, tensor_num()});
+            if(inserted.second) {
+                name_list_.push_back(name);
+                producer_list_.push_back(-1);
+                consumer_list_.emplace_back();
+                dims_list_.emplace_back();
+                is_graph_output_list_.push_back(false);
+            }
+            return inserted.first->second;
+        }
+
+        // Adds the initializer and returns the ID of its tensor
+        int add_initializer(onnx::TensorProto initializer) {
+            auto& added = *mutable_graph().add_initializer();
+            added.Swap(&initializer);
+            auto id = intern(added.name());
+            dims_list_[id].assign(added.dims().begin(), added.dims().end());
+            return id;
+        }
+
+    private:
+        graph_node make_node(int node_index) {
+            auto const& proto = graph_->node(node_index);
+            graph_node node{&proto, {}, {}, make_attribute_table(proto)};
+            for(auto const& input_name : proto.input()) {
+                node.input_id_list.push_back(intern(input_name));
+            }
+            for(auto const& output_name : proto.output()) {
+                node.output_id_list.push_back(intern(output_name));
+            }
+            return node;
+        }
+
+        void link_node(int node_index) {
+            for(auto id : node_list_[node_index].input_id_list) {
+                add_consumer(id, node_index);
+            }
+            for(auto id : node_list_[node_index].output_id_list) {
+                producer_list_[id] = node_index;
+            }
+        }
+        void unlink_node(int node_index) {
+            for(auto id : node_list_[node_index].input_id_list) {
+                remove_consumer(id, node_index);
+            }
+            for(auto id : node_list_[node_index].output_id_list) {
+                if(producer_list_[id] == node_index) {
+                    producer_list_[id] = -1;
+                }
+            }
+        }
+
+        // consumer lists are kept in node order
+        void add_consumer(int tensor_id, int node_index) {
+            auto& consumer_list = consumer_list_[tensor_id];
+            consumer_list.insert(std::upper_bound(consumer_list.begin(),
+                                                  consumer_list.end(),
+                                                  node_index),
+                                 node_index);
+        }
+        void remove_consumer(int tensor_id, int node_index) {
+            auto& consumer_list = consumer_list_[tensor_id];
+            consumer_list.erase(std::find(consumer_list.begin(),
+                                          consumer_list.end(), node_index));
+        }
+
+        // Shapes with symbolic dimensions are ignored
+        int load_value_info_dims(onnx::ValueInfoProto const& value_info) {
+            auto id = intern(value_info.name());
+            if(!dims_list_[id].empty() ||
+               !value_info.type().has_tensor_type()) {
+                return id;
+            }
+            std::vector<int> dims;
+            for(auto const& dim :
+                value_info.type().tensor_type().shape().dim()) {
+                if(!dim.has_dim_value()) {
+                    return id;
+                }
+                dims.push_back(static_cast<int>(dim.dim_value()));
+            }
+            dims_list_[id] = dims;
+            return id;
+        }
+
+        onnx::GraphProto const* graph_;
+        onnx::GraphProto* mutable_graph_ = nullptr;
+        std::vector<graph_node> node_list_;
+        std::vector<std::string> name_list_;
+        std::unordered_map<std::string, int> id_table_;
+        std::vector<int> producer_list_;
+        std::vector<std::vector<int>> consumer_list_;
+        std::vector<bool> is_graph_output_list_;
+        std::vector<std::vector<int>> dims_list_;
+    };
+
+    // Converts tensor names to IDs. Names not in the graph are ignored
+    template <typename NameRange>
+    auto make_tensor_id_set(graph_ir const& ir, NameRange const& name_range) {
+        std::vector<bool> is_in_set(ir.tensor_num(), false);
+        for(auto const& name : name_range) {
+            auto id = ir.find_tensor_id(name);
+            if(id != -1) {
+                is_in_set[id] = true;
+            }
+        }
+        return is_in_set;
+    }
+
+    // Adds a parameter made by a pass to parameter_table and to the graph
+    // as an initializer holding its data, so that make_parameter_table
+    // finds it too. name is suffixed with a number when a tensor or a
+    // parameter already has it. Returns the ID of the parameter
+    inline auto
+    add_parameter(graph_ir& ir,
+                  std::unordered_map<std::string, array>& parameter_table,
+                  std::string const& name, array const& arr) {
+        if(arr.dtype() != dtype_t::float_) {
+            throw std::runtime_error("Not implemented: parameter of dtype " +
+                                     std::to_string(static_cast<int>(
+                                       arr.dtype())));
+        }
+        auto unique_name = name;
+        for(int i = 1; ir.find_tensor_id(unique_name) != -1 ||
+                       parameter_table.find(unique_name) !=
+                         parameter_table.end();
+            ++i) {
+            unique_name = name + "_" + std::to_string(i);
+        }
+
+        onnx::TensorProto initializer;
+        initializer.set_name(unique_name);
+        initializer.set_data_type(onnx::TensorProto_DataType_FLOAT);
+        for(auto d : arr.dims()) {
+            initializer.add_dims(d);
+        }
+        initializer.set_raw_data(static_cast<char const*>(arr.data()),
+                                 total_size(arr) * sizeof(float));
+        parameter_table.insert({unique_name, arr});
+        return ir.add_initializer(std::move(initializer));
+    }
+
+    // Returns the name given to the parameter
+    inline auto
+    add_parameter(onnx::GraphProto& graph,
+                  std::unordered_map<std::string, array>& parameter_table,
+                  std::string const& name, array const& arr) {
+        graph_ir ir(graph);
+        return ir.tensor_name(add_parameter(ir, parameter_table, name, arr));
+    }
+
+} // namespace instant
+
+#endif // INSTANT_GRAPH_HPP
@@ -0,0 +1,76 @@
+#ifndef INSTANT_HOST_KERNEL_HPP
+#define INSTANT_HOST_KERNEL_HPP
+
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include <mkldnn.hpp>
+
+namespace instant {
+
+    // Work MKL-DNN has no primitive for (e.g. broadcasting Add). It runs on
+    // the calling thread in place of its placeholder primitive in a net.
+    // Kernels take buffers by get_data_handle() when they run, so they see
+    // buffers assigned in the arena or bound after they are made
+    using host_kernel = std::function<void()>;
+
+    // Placeholder primitive to the host kernel running in its place
+    using host_kernel_table_t =
+      std::unordered_map<mkldnn_primitive_t, host_kernel>;
+
+    // Makes a primitive only marking the position of a host kernel in a
+    // net. It is never submitted to a stream
+    inline auto make_host_kernel_placeholder(mkldnn::engine const& engine) {
+        auto mem = mkldnn::memory({{{1},
+                                    mkldnn::memory::data_type::f32,
+                                    mkldnn::memory::format::x},
+                                   engine});
+        return mkldnn::primitive(mkldnn::view(mem, {1}, {0}));
+    }
+
+    // Runs nets [first, last). Primitives between host kernels are
+    // submitted to a stream together
+    inline void run_nets(std::vector<mkldnn::primitive> const& nets,
+                         int first, int last,
+                         host_kernel_table_t const& host_kernel_table) {
+        auto submit = [&nets](int first, int last) {
+            if(first == last) {
+                return;
+            }
+            if(first == 0 && last == static_cast<int>(nets.size())) {
+                mkldnn::stream(mkldnn::stream::kind::eager)
+                  .submit(nets)
+                  .wait();
+                return;
+            }
+            mkldnn::stream(mkldnn::stream::kind::eager)
+              .submit(std::vector<mkldnn::primitive>(nets.begin() + first,
+                                                     nets.begin() + last))
+              .wait();
+        };
+        if(host_kernel_table.empty()) {
+            submit(first, last);
+            return;
+        }
+        auto submitted = first;
+        for(int i = first; i < last; ++i) {
+            auto found = host_kernel_table.find(nets[i].get());
+            if(found == host_kernel_table.end()) {
+                continue;
+            }
+            submit(submitted, i);
+            found->second();
+            submitted = i + 1;
+        }
+        submit(submitted, last);
+    }
+
+    inline void run_nets(std::vector<mkldnn::primitive> const& nets,
+                         host_kernel_table_t const& host_kernel_table) {
+        run_nets(nets, 0, nets.size(), host_kernel_table);
+    }
+
+} // namespace instant
+
+#endif // INSTANT_HOST_KERNEL_HPP
@@ -1,36 +1,158 @@
 #ifndef INSTANT_INSTANT_HPP
 #define INSTANT_INSTANT_HPP
 
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <list>
+#include <map>
+
+#include <instant/isa.hpp>
 #include <instant/model.hpp>
+#include <instant/pass.hpp>
+#include <instant/profile.hpp>
+#include <instant/tuner.hpp>
 
 namespace instant {
 
-    class model {
+    // Immutable part of a model: the optimized graph and the (packed)
+    // parameters. It is shared by execution contexts of any thread. ir is
+    // the view of the graph of onnx_model made for passes, so nets are
+    // made without parsing the graph again
+    class compiled_model {
     public:
-        model(onnx::ModelProto const& onnx_model,
-              std::unordered_map<std::string, array> const& parameter_table,
-              std::vector<array> const& temp_array_list,
-              std::unordered_map<std::string, const mkldnn::memory> const&
-                parameter_memory_table,
-              std::unordered_map<std::string, array> const& input_table,
-              std::unordered_map<
-                std::string,
-                std::tuple<const mkldnn::memory, mkldnn::memory::format>> const&
-                input_memory_table,
-              std::unordered_map<std::string, array> const& output_table,
-              std::vector<mkldnn::primitive> const& nets,
-              std::unordered_map<
-                std::string,
-                std::tuple<const mkldnn::memory, mkldnn::memory::format>> const&
-                variable_memory_table,
-              std::vector<mkldnn::memory> const& temp_variable_memory_list)
-          : onnx_model_(onnx_model), parameter_table_(parameter_table),
+        compiled_model(
+          std::shared_ptr<const onnx::ModelProto> const& onnx_model,
+          graph_ir const& ir,
+          std::unordered_map<std::string, array> const& parameter_table,
+          std::vector<array> const& temp_array_list,
+          std::unordered_map<std::string, const mkldnn::memory> const&
+            parameter_memory_table,
+          std::vector<std::pair<std::string, mkldnn::memory>> const&
+            packed_parameter_memory_list,
+          std::vector<std::tuple<std::string, dtype_t, std::vector<int>,
+                                 mkldnn::memory::format>> const&
+            input_name_dtype_dims_format_list,
+          std::set<std::string> const& required_output_set,
+          mkldnn::engine const& engine,
+          std::shared_ptr<char const> const& mapped_file = nullptr)
+          : onnx_model_(onnx_model), ir_(ir),
+            parameter_table_(parameter_table),
             temp_array_list_(temp_array_list),
             parameter_memory_table_(parameter_memory_table),
-            input_table_(input_table), input_memory_table_(input_memory_table),
+            packed_parameter_memory_list_(packed_parameter_memory_list),
+            input_name_dtype_dims_format_list_(
+              input_name_dtype_dims_format_list),
+            required_output_set_(required_output_set), engine_(engine),
+            mapped_file_(mapped_file) {}
+
+        auto const& onnx_model() const { return *onnx_model_; }
+        auto const& graph() const { return onnx_model_->graph(); }
+        auto const& ir() const { return ir_; }
+        auto const& parameter_memory_table() const {
+            return parameter_memory_table_;
+        }
+        auto const& input_name_dtype_dims_format_list() const {
+            return input_name_dtype_dims_format_list_;
+        }
+        auto const& required_output_set() const {
+            return required_output_set_;
+        }
+        auto const& engine() const { return engine_; }
+
+        // Bytes of parameter memories referenced by nets
+        auto parameter_size() const {
+            std::set<void*> handle_set;
+            std::size_t size = 0;
+            for(auto const& p : parameter_memory_table_) {
+                if(handle_set.insert(p.second.get_data_handle()).second) {
+                    size += p.second.get_primitive_desc().get_size();
+                }
+            }
+            return size;
+        }
+
+    private:
+        std::shared_ptr<const onnx::ModelProto> onnx_model_;
+        graph_ir ir_;
+        std::unordered_map<std::string, array> parameter_table_;
+        std::vector<array> temp_array_list_;
+        std::unordered_map<std::string, const mkldnn::memory>
+          parameter_memory_table_;
+        std::vector<std::pair<std::string, mkldnn::memory>>
+          packed_parameter_memory_list_;
+        std::vector<std::tuple<std::string, dtype_t, std::vector<int>,
+                               mkldnn::memory::format>>
+          input_name_dtype_dims_format_list_;
+        std::set<std::string> required_output_set_;
+        mkldnn::engine engine_;
+        // parameter memories of a loaded compiled model file point here
+        std::shared_ptr<char const> mapped_file_;
+    };
+
+    // Mutable part of a model: input, output and intermediate buffers and
+    // nets bound to them. An execution context must not be used by more
+    // than one thread at the same time, but any number of contexts can be
+    // made from one compiled model
+    class execution_context {
+    public:
+        execution_context(
+          std::shared_ptr<const compiled_model> const& compiled,
+          std::unordered_map<std::string, array> const& input_table,
+          std::unordered_map<
+            std::string,
+            std::tuple<const mkldnn::memory, mkldnn::memory::format>> const&
+            input_memory_table,
+          std::unordered_map<std::string, array> const& output_table,
+          std::vector<mkldnn::primitive> const& nets,
+          std::unordered_map<
+            std::string,
+            std::tuple<const mkldnn::memory, mkldnn::memory::format>> const&
+            variable_memory_table,
+          std::vector<mkldnn::memory> const& temp_variable_memory_list,
+          std::vector<std::pair<std::string, mkldnn::memory>> const&
+            packed_parameter_memory_list,
+          std::shared_ptr<void> const& arena, std::size_t arena_size,
+          std::vector<std::pair<int, int>> const& node_net_range_list,
+          host_kernel_table_t const& host_kernel_table,
+          int inter_op_thread_num = 1)
+          : compiled_(compiled), input_table_(input_table),
+            input_memory_table_(input_memory_table),
             output_table_(output_table), nets_(nets),
             variable_memory_table_(variable_memory_table),
-            temp_variable_memory_list_(temp_variable_memory_list) {}
+            temp_variable_memory_list_(temp_variable_memory_list),
+            packed_parameter_memory_list_(packed_parameter_memory_list),
+            arena_(arena), arena_size_(arena_size),
+            node_net_range_list_(node_net_range_list),
+            host_kernel_table_(host_kernel_table) {
+            if(inter_op_thread_num > 1) {
+                node_dependency_list_ =
+                  make_node_dependency_list(compiled_->ir());
+                thread_budget_list_ = make_thread_budget_list(
+                  serialize_nodes(node_dependency_list_),
+                  get_max_intra_op_thread_num());
+                executor_ = std::make_shared<dag_executor>(inter_op_thread_num);
+            }
+            memory_list_ = temp_variable_memory_list_;
+            for(auto const& p : input_memory_table_) {
+                memory_list_.push_back(std::get<0>(p.second));
+            }
+            for(auto const& p : variable_memory_table_) {
+                memory_list_.push_back(std::get<0>(p.second));
+            }
+            // The memory written to an output array is the one having its
+            // buffer as handle
+            for(auto const& name_and_arr : output_table_) {
+                auto const* data = name_and_arr.second.data();
+                for(auto const& mem : memory_list_) {
+                    if(mem.get_data_handle() == data) {
+                        output_memory_table_.insert(
+                          {name_and_arr.first, mem});
+                        break;
+                    }
+                }
+            }
+        }
 
         auto& input(std::string const& input_name) {
             return find_value(input_table_, input_name);
@@ -39,40 +161,297 @@ namespace instant {
             return find_value(output_table_, input_name);
         }
 
-        auto const& run() const {
-            mkldnn::stream(mkldnn::stream::kind::eager).submit(nets_).wait();
+        // Bytes of the arena shared by intermediate variables
+        auto arena_size() const { return arena_size_; }
+
+        // Bytes owned by this context (arena, inputs, outputs and
+        // temporaries allocated outside the arena)
+        auto buffer_size() const {
+            auto size = arena_size_;
+            for(auto const& p : input_table_) {
+                size += total_size(p.second) *
+                        get_size_in_bytes(p.second.dtype());
+            }
+            for(auto const& p : output_table_) {
+                size += total_size(p.second) *
+                        get_size_in_bytes(p.second.dtype());
+            }
+            for(auto const& mem : temp_variable_memory_list_) {
+                if(!is_deferred_memory(mem)) {
+                    size += mem.get_primitive_desc().get_size();
+                }
+            }
+            return size;
+        }
+
+        auto const& compiled() const { return compiled_; }
+
+        // Makes nets read the input from data (size bytes owned by the
+        // caller) instead of input(name) without copy. The binding lasts
+        // until the input is bound again or reset_io_bindings() is called.
+        // Nets never write to inputs (only intermediate buffers are
+        // updated in place), so data is not modified
+        auto bind_input(std::string const& name, void const* data,
+                        std::size_t size) {
+            auto const& mem =
+              std::get<0>(find_value(input_memory_table_, name));
+            validate_io_binding(name, mem, data, size);
+            rebind_memory(mem, const_cast<void*>(data));
+        }
+
+        // Makes nets write the output to data instead of output(name).
+        // Arrays returned by run() are not updated while they are bound
+        auto bind_output(std::string const& name, void* data,
+                         std::size_t size) {
+            auto const& mem = find_value(output_memory_table_, name);
+            validate_io_binding(name, mem, data, size);
+            rebind_memory(mem, data);
+        }
+
+        // Makes nets use input(name) and output(name) again
+        auto reset_io_bindings() {
+            for(auto& name_and_arr : input_table_) {
+                rebind_memory(std::get<0>(find_value(input_memory_table_,
+                                                     name_and_arr.first)),
+                              name_and_arr.second.data());
+            }
+            for(auto& name_and_arr : output_table_) {
+                rebind_memory(
+                  find_value(output_memory_table_, name_and_arr.first),
+                  name_and_arr.second.data());
+            }
+        }
+
+        // Number of threads running independent nodes at the same time
+        auto inter_op_thread_num() const {
+            return executor_ ? executor_->worker_num() : 1;
+        }
+
+        auto const& run() {
+            if(executor_ && !is_profiling_enabled_) {
+                executor_->run(node_dependency_list_, [this](int node_index) {
+                    set_intra_op_thread_num(thread_budget_list_[node_index]);
+                    auto const& range = node_net_range_list_[node_index];
+                    run_nets(nets_, range.first, range.second,
+                             host_kernel_table_);
+                });
+                return output_table_;
+            }
+            if(!is_profiling_enabled_) {
+                run_nets(nets_, host_kernel_table_);
+                return output_table_;
+            }
+            for(std::size_t i = 0; i < nets_.size(); ++i) {
+                auto start = std::chrono::steady_clock::now();
+                run_nets(nets_, i, i + 1, host_kernel_table_);
+                auto end = std::chrono::steady_clock::now();
+                primitive_time_list_[i] +=
+                  std::chrono::duration<double, std::milli>(end - start)
+                    .count();
+            }
+            ++profiled_run_count_;
             return output_table_;
         }
 
+        auto reset_profile() {
+            primitive_time_list_.assign(nets_.size(), 0.);
+            profiled_run_count_ = 0;
+        }
+
+        // In profiling mode, run() submits primitives one by one and
+        // measures time of each. Nodes are run sequentially even if the
+        // context has inter-op threads
+        auto set_profiling_enabled(bool is_enabled) {
+            if(is_enabled && primitive_profile_list_.empty()) {
+                primitive_profile_list_ = make_primitive_profile_list(
+                  compiled_->ir(), nets_, node_net_range_list_,
+                  compiled_->parameter_memory_table(), variable_memory_table_);
+                reset_profile();
+            }
+            is_profiling_enabled_ = is_enabled;
+        }
+
+        // The number of reorders run() executes and the bytes they read and
+        // write (see propagate_layouts)
+        auto reorder_stats() const { return calc_reorder_stats(nets_); }
+
+        // Profiles of primitives (in execution order) averaged over runs in
+        // profiling mode
+        auto profile() const {
+            auto profile_list = primitive_profile_list_;
+            for(std::size_t i = 0; i < profile_list.size(); ++i) {
+                profile_list[i].time =
+                  profiled_run_count_ == 0
+                    ? 0.
+                    : primitive_time_list_[i] / profiled_run_count_;
+            }
+            return profile_list;
+        }
+
     private:
-        onnx::ModelProto onnx_model_;
-        std::unordered_map<std::string, array> parameter_table_;
-        std::vector<array> temp_array_list_;
-        std::unordered_map<std::string, const mkldnn::memory>
-          parameter_memory_table_;
+        // A bound buffer must have the size of the memory and be aligned
+        // for its elements
+        static void validate_io_binding(std::string const& name,
+                                        mkldnn::memory const& mem,
+                                        void const* data, std::size_t size) {
+            auto required_size = mem.get_primitive_desc().get_size();
+            if(size != required_size) {
+                throw std::runtime_error(
+                  "Invalid buffer size for " + name + ": " +
+                  std::to_string(size) + " (" + std::to_string(required_size) +
+                  " is required)");
+            }
+            if(!data || reinterpret_cast<std::uintptr_t>(data) %
+                            alignof(float) != 0) {
+                throw std::runtime_error("Misaligned buffer for " + name);
+            }
+        }
+
+        // Points mem to data together with the memories viewing its buffer
+        // (e.g. the output of Flatten or Reshape of an input), which keep
+        // their offsets in it. Inputs and outputs have their own buffers,
+        // so no other memory points into them
+        void rebind_memory(mkldnn::memory const& mem, void* data) {
+            auto begin =
+              reinterpret_cast<std::uintptr_t>(mem.get_data_handle());
+            auto end = begin + mem.get_primitive_desc().get_size();
+            std::vector<std::pair<mkldnn::memory, std::size_t>>
+              view_and_offset_list{{mem, 0}};
+            for(auto const& view : memory_list_) {
+                auto handle =
+                  reinterpret_cast<std::uintptr_t>(view.get_data_handle());
+                if(begin <= handle && handle < end) {
+                    view_and_offset_list.emplace_back(view, handle - begin);
+                }
+            }
+            for(auto& view_and_offset : view_and_offset_list) {
+                view_and_offset.first.set_data_handle(
+                  static_cast<char*>(data) + view_and_offset.second);
+            }
+        }
+
+        std::shared_ptr<const compiled_model> compiled_;
         std::unordered_map<std::string, array> input_table_;
         std::unordered_map<
           std::string, std::tuple<const mkldnn::memory, mkldnn::memory::format>>
           input_memory_table_;
         std::unordered_map<std::string, array> output_table_;
+        std::unordered_map<std::string, mkldnn::memory> output_memory_table_;
         std::vector<mkldnn::primitive> nets_;
         std::unordered_map<
           std::string, std::tuple<const mkldnn::memory, mkldnn::memory::format>>
           variable_memory_table_;
         std::vector<mkldnn::memory> temp_variable_memory_list_;
+        std::vector<mkldnn::memory> memory_list_; // all variable memories
+        std::vector<std::pair<std::string, mkldnn::memory>>
+          packed_parameter_memory_list_;
+        std::shared_ptr<void> arena_;
+        std::size_t arena_size_;
+        std::vector<std::pair<int, int>> node_net_range_list_;
+        host_kernel_table_t host_kernel_table_;
+
+        std::vector<std::vector<int>> node_dependency_list_;
+        std::vector<int> thread_budget_list_; // intra-op threads per node
+        std::shared_ptr<dag_executor> executor_;
+
+        bool is_profiling_enabled_ = false;
+        std::vector<primitive_profile> primitive_profile_list_;
+        std::vector<double> primitive_time_list_;
+        int profiled_run_count_ = 0;
     };
 
-    inline auto make_model(
-      onnx::ModelProto const& onnx_model,
-      std::vector<std::tuple<std::string, dtype_t, std::vector<int> const&,
+    // Runs propagate_layouts with the blocked format of the running CPU.
+    // Nothing is done when the CPU has no blocked format. Nets are made
+    // once to know the dims of variables, which are recorded in ir
+    inline auto propagate_layouts_for_cpu(
+      graph_ir& ir,
+      std::unordered_map<std::string, array> const& parameter_table,
+      std::vector<std::tuple<std::string, dtype_t, std::vector<int>,
                              mkldnn::memory::format>> const&
         input_name_dtype_dims_format_list,
-      std::vector<std::string> const& required_output_name_list,
+      std::set<std::string> const& required_output_set,
       mkldnn::engine const& engine = ::instant::get_context().engine()) {
-        auto parameter_table = make_parameter_table(onnx_model.graph());
+        auto blocked_format = get_blocked_format(get_cpu_isa_name());
+        if(blocked_format.second == 1) {
+            return;
+        }
         auto parameter_memory_table_and_temp_array_list =
-          make_parameter_memory_table(onnx_model.graph(), parameter_table,
-                                      engine);
+          make_parameter_memory_table(ir, parameter_table, engine);
+        auto const& parameter_memory_table =
+          std::get<0>(parameter_memory_table_and_temp_array_list);
+        std::vector<std::tuple<std::string, array, mkldnn::memory::format>>
+          input_list;
+        for(auto const& input : input_name_dtype_dims_format_list) {
+            input_list.push_back(std::make_tuple(
+              std::get<0>(input),
+              array(std::get<1>(input), std::get<2>(input)),
+              std::get<3>(input)));
+        }
+        auto input_memory_table =
+          make_variable_memory_table(input_list, engine);
+        auto temp_tuple = make_nets(ir, parameter_memory_table,
+                                    input_memory_table, required_output_set);
+        for(auto const& name_and_memory : std::get<1>(temp_tuple)) {
+            auto id = ir.find_tensor_id(name_and_memory.first);
+            if(id != -1) {
+                ir.set_dims(id,
+                            extract_dims(std::get<0>(name_and_memory.second)));
+            }
+        }
+
+        std::unordered_map<std::string, std::string> input_format_table;
+        for(auto const& input : input_name_dtype_dims_format_list) {
+            input_format_table[std::get<0>(input)] = "other";
+            for(auto const& name_and_format : get_tunable_format_table()) {
+                if(name_and_format.second == std::get<3>(input)) {
+                    input_format_table[std::get<0>(input)] =
+                      name_and_format.first;
+                }
+            }
+        }
+        auto const& format_table = get_tunable_format_table();
+        propagate_layouts(
+          ir, parameter_table, input_format_table, required_output_set,
+          blocked_format.first, blocked_format.second,
+          [&](graph_node const& node, std::string const& src_format,
+              std::string const& dst_format) {
+              return supports_conv_format(
+                parameter_memory_table, node, ir.dims(node.input_id_list[0]),
+                find_value(format_table, src_format),
+                find_value(format_table, dst_format), engine);
+          });
+    }
+
+    inline auto propagate_layouts_for_cpu(
+      onnx::GraphProto& graph,
+      std::unordered_map<std::string, array> const& parameter_table,
+      std::vector<std::tuple<std::string, dtype_t, std::vector<int>,
+                             mkldnn::memory::format>> const&
+        input_name_dtype_dims_format_list,
+      std::set<std::string> const& required_output_set,
+      mkldnn::engine const& engine = ::instant::get_context().engine()) {
+        graph_ir ir(graph);
+        propagate_layouts_for_cpu(ir, parameter_table,
+                                  input_name_dtype_dims_format_list,
+                                  required_output_set, engine);
+    }
+
+    // Makes a compiled model of the graph already optimized by passes. ir
+    // is the view of the graph of optimized_onnx_model. Nets are made to
+    // know the formats which primitives require and parameters are packed
+    // to them. The nets are returned as an execution context for the dims
+    // the model is compiled with, so the first context is not made twice
+    inline auto compile_optimized_model_and_context(
+      std::shared_ptr<const onnx::ModelProto> const& optimized_onnx_model,
+      graph_ir const& ir,
+      std::unordered_map<std::string, array> parameter_table,
+      std::vector<std::tuple<std::string, dtype_t, std::vector<int>,
+                             mkldnn::memory::format>> const&
+        input_name_dtype_dims_format_list,
+      std::set<std::string> const& required_output_set,
+      mkldnn::engine const& engine) {
+        auto parameter_memory_table_and_temp_array_list =
+          make_parameter_memory_table(ir, parameter_table, engine);
         auto& parameter_memory_table =
           std::get<0>(parameter_memory_table_and_temp_array_list);
         auto& temp_array_list =
@@ -83,9 +462,256 @@ namespace instant {
           input_list;
         for(auto const& input_name_dtype_dims_format :
             input_name_dtype_dims_format_list) {
+            auto const& name = std::get<0>(input_name_dtype_dims_format);
+            array arr(std::get<1>(input_name_dtype_dims_format),
+                      std::get<2>(input_name_dtype_dims_format));
+            input_table.insert({name, arr});
+            input_list.push_back(std::make_tuple(
+              name, arr, std::get<3>(input_name_dtype_dims_format)));
+        }
+        auto input_memory_table =
+          make_variable_memory_table(input_list, engine);
+        auto temp_tuple = make_nets(ir, parameter_memory_table,
+                                    input_memory_table, required_output_set);
+        auto const& parameter_nets = std::get<4>(temp_tuple);
+        auto const& packed_parameter_memory_list = std::get<5>(temp_tuple);
+        // the nets read the packed memories, so they stay valid
+        pack_parameters(ir, parameter_table, parameter_memory_table,
+                        parameter_nets, packed_parameter_memory_list);
+        auto compiled = std::make_shared<const compiled_model>(
+          optimized_onnx_model, ir, parameter_table, temp_array_list,
+          parameter_memory_table, packed_parameter_memory_list,
+          input_name_dtype_dims_format_list, required_output_set, engine);
+        execution_context context(
+          compiled, input_table, input_memory_table, std::get<3>(temp_tuple),
+          std::get<0>(temp_tuple), std::get<1>(temp_tuple),
+          std::get<2>(temp_tuple), packed_parameter_memory_list,
+          std::get<6>(temp_tuple), std::get<7>(temp_tuple),
+          std::get<8>(temp_tuple), std::get<9>(temp_tuple));
+        return std::make_pair(compiled, std::move(context));
+    }
+
+    inline auto compile_optimized_model(
+      std::shared_ptr<const onnx::ModelProto> const& optimized_onnx_model,
+      graph_ir const& ir,
+      std::unordered_map<std::string, array> parameter_table,
+      std::vector<std::tuple<std::string, dtype_t, std::vector<int>,
+                             mkldnn::memory::format>> const&
+        input_name_dtype_dims_format_list,
+      std::set<std::string> const& required_output_set,
+      mkldnn::engine const& engine) {
+        return compile_optimized_model_and_context(
+                 optimized_onnx_model, ir, std::move(parameter_table),
+                 input_name_dtype_dims_format_list, required_output_set,
+                 engine)
+          .first;
+    }
+
+    inline auto compile_optimized_model(
+      onnx::ModelProto const& optimized_onnx_model,
+      std::unordered_map<std::string, array> parameter_table,
+      std::vector<std::tuple<std::string, dtype_t, std::vector<int>,
+                             mkldnn::memory::format>> const&
+        input_name_dtype_dims_format_list,
+      std::set<std::string> const& required_output_set,
+      mkldnn::engine const& engine) {
+        auto onnx_model =
+          std::make_shared<const onnx::ModelProto>(optimized_onnx_model);
+        return compile_optimized_model(
+          onnx_model, graph_ir(onnx_model->graph()),
+          std::move(parameter_table), input_name_dtype_dims_format_list,
+          required_output_set, engine);
+    }
+
+    // Steps of optimize_graph that differ between builders
+    struct graph_optimization_options {
+        // Conv, FC, pooling and Relu are quantized with these ranges when
+        // set (see quantize)
+        range_table_t const* range_table = nullptr;
+        // Conv formats are measured (see tune_conv) instead of propagated
+        // when set. Measured layers are added to the cache
+        conv_tuning_cache_t* conv_tuning_cache = nullptr;
+    };
+
+    // Runs the passes of make_*_compiled_model in order
+    inline auto optimize_graph(
+      graph_ir& ir,
+      std::unordered_map<std::string, array>& parameter_table,
+      std::vector<std::tuple<std::string, dtype_t, std::vector<int>,
+                             mkldnn::memory::format>> const&
+        input_name_dtype_dims_format_list,
+      std::set<std::string> const& required_output_set,
+      mkldnn::engine const& engine,
+      graph_optimization_options const& options) {
+        eliminate_dead_nodes(ir, parameter_table, required_output_set);
+        eliminate_identity_nodes(ir, required_output_set);
+        fuse_residual_add(ir, parameter_table, required_output_set);
+        fuse_post_eltwise(ir, required_output_set);
+        if(options.range_table) {
+            quantize(ir, parameter_table, *options.range_table,
+                     required_output_set);
+        }
+        // after quantize so that int8 Relu is not chained
+        fuse_eltwise_chain(ir, parameter_table, required_output_set);
+        if(options.conv_tuning_cache) {
+            tune_conv(ir, parameter_table, input_name_dtype_dims_format_list,
+                      required_output_set, *options.conv_tuning_cache,
+                      engine);
+        } else {
+            propagate_layouts_for_cpu(ir, parameter_table,
+                                      input_name_dtype_dims_format_list,
+                                      required_output_set, engine);
+        }
+        plan_in_place_concat(ir, parameter_table, required_output_set);
+    }
+
+    // Optimizes a copy of onnx_model by optimize_graph and compiles it. The
+    // graph is converted to graph_ir once, and the passes and nets share
+    // it. Returns the compiled model and its first execution context (see
+    // compile_optimized_model_and_context)
+    inline auto make_compiled_model_and_context(
+      onnx::ModelProto const& onnx_model,
+      std::unordered_map<std::string, array> parameter_table,
+      std::vector<std::tuple<std::string, dtype_t, std::vector<int>,
+                             mkldnn::memory::format>> const&
+        input_name_dtype_dims_format_list,
+      std::vector<std::string> const& required_output_name_list,
+      mkldnn::engine const& engine,
+      graph_optimization_options const& options) {
+        std::set<std::string> required_output_set(
+          required_output_name_list.begin(), required_output_name_list.end());
+        auto optimized_onnx_model =
+          std::make_shared<onnx::ModelProto>(onnx_model);
+        graph_ir ir(*optimized_onnx_model->mutable_graph());
+        optimize_graph(ir, parameter_table, input_name_dtype_dims_format_list,
+                       required_output_set, engine, options);
+        return compile_optimized_model_and_context(
+          optimized_onnx_model, ir, std::move(parameter_table),
+          input_name_dtype_dims_format_list, required_output_set, engine);
+    }
+
+    // parameter_table is typically made by make_parameter_table or
+    // load_onnx_with_mapped_parameter_table. Nodes and parameters no
+    // required output depends on are removed (see eliminate_dead_nodes)
+    inline auto make_compiled_model(
+      onnx::ModelProto const& onnx_model,
+      std::unordered_map<std::string, array> parameter_table,
+      std::vector<std::tuple<std::string, dtype_t, std::vector<int>,
+                             mkldnn::memory::format>> const&
+        input_name_dtype_dims_format_list,
+      std::vector<std::string> const& required_output_name_list,
+      mkldnn::engine const& engine = ::instant::get_context().engine()) {
+        return make_compiled_model_and_context(
+                 onnx_model, std::move(parameter_table),
+                 input_name_dtype_dims_format_list, required_output_name_list,
+                 engine, graph_optimization_options())
+          .first;
+    }
+
+    // Conv, FC, pooling and Relu run in int8 with scales computed from
+    // range_table (see quantize and instant_calibrate). Inputs and
+    // required outputs are f32
+    inline auto make_int8_compiled_model(
+      onnx::ModelProto const& onnx_model,
+      std::unordered_map<std::string, array> parameter_table,
+      range_table_t const& range_table,
+      std::vector<std::tuple<std::string, dtype_t, std::vector<int>,
+                             mkldnn::memory::format>> const&
+        input_name_dtype_dims_format_list,
+      std::vector<std::string> const& required_output_name_list,
+      mkldnn::engine const& engine = ::instant::get_context().engine()) {
+        graph_optimization_options options;
+        options.range_table = &range_table;
+        return make_compiled_model_and_context(
+                 onnx_model, std::move(parameter_table),
+                 input_name_dtype_dims_format_list, required_output_name_list,
+                 engine, options)
+          .first;
+    }
+
+    // Conv algorithms and formats are chosen by measuring them (see
+    // tune_conv). Winners are kept in the file tuning_cache_filename, so
+    // later builds of the same layers on the same ISA skip measuring.
+    // Returns the first execution context too (see
+    // make_compiled_model_and_context)
+    inline auto make_tuned_compiled_model_and_context(
+      onnx::ModelProto const& onnx_model,
+      std::unordered_map<std::string, array> parameter_table,
+      std::vector<std::tuple<std::string, dtype_t, std::vector<int>,
+                             mkldnn::memory::format>> const&
+        input_name_dtype_dims_format_list,
+      std::vector<std::string> const& required_output_name_list,
+      std::string const& tuning_cache_filename,
+      mkldnn::engine const& engine = ::instant::get_context().engine()) {
+        conv_tuning_cache_t cache;
+        if(std::ifstream(tuning_cache_filename)) {
+            cache = load_conv_tuning_cache(tuning_cache_filename);
+        }
+        auto cached_layer_num = cache.size();
+        graph_optimization_options options;
+        options.conv_tuning_cache = &cache;
+        auto compiled_and_context = make_compiled_model_and_context(
+          onnx_model, std::move(parameter_table),
+          input_name_dtype_dims_format_list, required_output_name_list,
+          engine, options);
+        if(cache.size() != cached_layer_num) {
+            save_conv_tuning_cache(tuning_cache_filename, cache);
+        }
+        return compiled_and_context;
+    }
+
+    inline auto make_tuned_compiled_model(
+      onnx::ModelProto const& onnx_model,
+      std::unordered_map<std::string, array> parameter_table,
+      std::vector<std::tuple<std::string, dtype_t, std::vector<int>,
+                             mkldnn::memory::format>> const&
+        input_name_dtype_dims_format_list,
+      std::vector<std::string> const& required_output_name_list,
+      std::string const& tuning_cache_filename,
+      mkldnn::engine const& engine = ::instant::get_context().engine()) {
+        return make_tuned_compiled_model_and_context(
+                 onnx_model, std::move(parameter_table),
+                 input_name_dtype_dims_format_list, required_output_name_list,
+                 tuning_cache_filename, engine)
+          .first;
+    }
+
+    // input_dims_list is the dims of each input in the order of
+    // compiled->input_name_dtype_dims_format_list(). Only the batch size
+    // (the first dimension) may differ from the dims the model is compiled
+    // with.
+    // With inter_op_thread_num > 1, independent nodes (e.g. branches of
+    // Inception-like graphs) run concurrently on that many threads and the
+    // intra-op threads are divided among them
+    inline auto make_execution_context(
+      std::shared_ptr<const compiled_model> const& compiled,
+      std::vector<std::vector<int>> const& input_dims_list,
+      int inter_op_thread_num = 1) {
+        auto const& engine = compiled->engine();
+        auto const& input_name_dtype_dims_format_list =
+          compiled->input_name_dtype_dims_format_list();
+        if(input_dims_list.size() != input_name_dtype_dims_format_list.size()) {
+            throw std::runtime_error("invalid input num: " +
+                                     std::to_string(input_dims_list.size()));
+        }
+        std::unordered_map<std::string, array> input_table;
+        std::vector<std::tuple<std::string, array, mkldnn::memory::format>>
+          input_list;
+        for(int i = 0; i < static_cast<int>(input_dims_list.size()); ++i) {
+            auto const& input_name_dtype_dims_format =
+              input_name_dtype_dims_format_list[i];
             auto name = std::get<0>(input_name_dtype_dims_format);
             auto dtype = std::get<1>(input_name_dtype_dims_format);
-            auto dims = std::get<2>(input_name_dtype_dims_format);
+            auto const& compiled_dims =
+              std::get<2>(input_name_dtype_dims_format);
+            auto dims = input_dims_list[i];
+            if(dims.size() != compiled_dims.size() ||
+               !std::equal(dims.begin() + 1, dims.end(),
+                           compiled_dims.begin() + 1)) {
+                throw std::runtime_error(
+                  "invalid input dims (only batch size can be changed): " +
+                  name);
+            }
             auto format = std::get<3>(input_name_dtype_dims_format);
             auto arr = array(dtype, dims);
             input_table.insert({name, arr});
@@ -94,17 +720,285 @@ namespace instant {
         auto input_memory_table =
           make_variable_memory_table(input_list, engine);
         auto temp_tuple = make_nets(
-          onnx_model.graph(), parameter_memory_table, input_memory_table,
-          std::set<std::string>(required_output_name_list.begin(),
-                                required_output_name_list.end()));
+          compiled->ir(), compiled->parameter_memory_table(),
+          input_memory_table, compiled->required_output_set(),
+          make_default_primitive_factory_table(), get_context(),
+          inter_op_thread_num > 1);
         auto const& nets = std::get<0>(temp_tuple);
         auto const& variable_memory_table = std::get<1>(temp_tuple);
         auto const& temp_variable_memory_list = std::get<2>(temp_tuple);
         auto const& output_table = std::get<3>(temp_tuple);
-        return model(onnx_model, parameter_table, temp_array_list,
-                     parameter_memory_table, input_table, input_memory_table,
-                     output_table, nets, variable_memory_table,
-                     temp_variable_memory_list);
+        auto const& parameter_nets = std::get<4>(temp_tuple);
+        auto const& packed_parameter_memory_list = std::get<5>(temp_tuple);
+        auto const& arena = std::get<6>(temp_tuple);
+        auto arena_size = std::get<7>(temp_tuple);
+        auto const& node_net_range_list = std::get<8>(temp_tuple);
+        auto const& host_kernel_table = std::get<9>(temp_tuple);
+
+        // Parameters are already packed. Only a parameter shared by
+        // primitives requiring different formats is reordered again here
+        mkldnn::stream(mkldnn::stream::kind::eager)
+          .submit(parameter_nets)
+          .wait();
+        return execution_context(compiled, input_table, input_memory_table,
+                                 output_table, nets, variable_memory_table,
+                                 temp_variable_memory_list,
+                                 packed_parameter_memory_list, arena,
+                                 arena_size, node_net_range_list,
+                                 host_kernel_table, inter_op_thread_num);
+    }
+
+    // Returns the input dims the model is compiled with
+    inline auto
+    get_input_dims_list(std::shared_ptr<const compiled_model> const& compiled) {
+        std::vector<std::vector<int>> input_dims_list;
+        for(auto const& input_name_dtype_dims_format :
+            compiled->input_name_dtype_dims_format_list()) {
+            input_dims_list.push_back(
+              std::get<2>(input_name_dtype_dims_format));
+        }
+        return input_dims_list;
+    }
+
+    inline auto make_execution_context(
+      std::shared_ptr<const compiled_model> const& compiled,
+      int inter_op_thread_num = 1) {
+        return make_execution_context(compiled, get_input_dims_list(compiled),
+                                      inter_op_thread_num);
+    }
+
+    // Execution contexts keyed by input dims. The least recently used one is
+    // discarded when the number of contexts exceeds the capacity
+    class execution_context_cache {
+    public:
+        execution_context_cache(
+          std::shared_ptr<const compiled_model> const& compiled,
+          std::size_t capacity)
+          : compiled_(compiled), capacity_(capacity) {}
+
+        auto const& compiled() const { return compiled_; }
+        auto size() const { return context_list_.size(); }
+        auto capacity() const { return capacity_; }
+        auto set_capacity(std::size_t capacity) {
+            capacity_ = capacity;
+            shrink();
+        }
+
+        auto
+        contains(std::vector<std::vector<int>> const& input_dims_list) const {
+            return context_iter_table_.find(input_dims_list) !=
+                   context_iter_table_.end();
+        }
+
+        // Returns the context for input_dims_list. It is made if not cached
+        auto& get(std::vector<std::vector<int>> const& input_dims_list) {
+            auto found = context_iter_table_.find(input_dims_list);
+            if(found != context_iter_table_.end()) {
+                context_list_.splice(context_list_.begin(), context_list_,
+                                     found->second);
+                return found->second->second;
+            }
+            context_list_.emplace_front(
+              input_dims_list,
+              make_execution_context(compiled_, input_dims_list));
+            context_iter_table_.insert(
+              {input_dims_list, context_list_.begin()});
+            shrink();
+            return context_list_.front().second;
+        }
+
+        auto erase(std::vector<std::vector<int>> const& input_dims_list) {
+            auto found = context_iter_table_.find(input_dims_list);
+            if(found != context_iter_table_.end()) {
+                context_list_.erase(found->second);
+                context_iter_table_.erase(found);
+            }
+        }
+
+        // Adds a context made elsewhere as the most recently used one. A
+        // context cached for the same input dims is replaced
+        auto insert(std::vector<std::vector<int>> const& input_dims_list,
+                    execution_context const& context) {
+            erase(input_dims_list);
+            context_list_.emplace_front(input_dims_list, context);
+            context_iter_table_.insert(
+              {input_dims_list, context_list_.begin()});
+            shrink();
+        }
+
+    private:
+        void shrink() {
+            // the most recently used one is kept even if capacity is 0
+            while(context_list_.size() > std::max<std::size_t>(capacity_, 1)) {
+                context_iter_table_.erase(context_list_.back().first);
+                context_list_.pop_back();
+            }
+        }
+
+        std::shared_ptr<const compiled_model> compiled_;
+        std::size_t capacity_;
+        std::list<std::pair<std::vector<std::vector<int>>, execution_context>>
+          context_list_; // the front is the most recently used
+        std::map<std::vector<std::vector<int>>,
+                 decltype(context_list_)::iterator>
+          context_iter_table_;
+    };
+
+    class model {
+    public:
+        explicit model(std::shared_ptr<const compiled_model> const& compiled,
+                       std::size_t context_cache_capacity = 8)
+          : model(::instant::make_execution_context(compiled),
+                  context_cache_capacity) {}
+        // context is the one made together with its compiled model (see
+        // make_compiled_model_and_context)
+        explicit model(execution_context context,
+                       std::size_t context_cache_capacity = 8)
+          : context_(std::move(context)),
+            context_cache_(context_.compiled(), context_cache_capacity) {
+            // run(input_table) with the compiled dims reuses context_. The
+            // cached copy shares its buffers
+            cache_own_context();
+        }
+
+        auto& input(std::string const& input_name) {
+            return context_.input(input_name);
+        }
+        auto const& output(std::string const& input_name) const {
+            return context_.output(input_name);
+        }
+
+        // Bytes of the arena shared by intermediate variables
+        auto arena_size() const { return context_.arena_size(); }
+
+        // (see execution_context::reorder_stats)
+        auto reorder_stats() const { return context_.reorder_stats(); }
+
+        auto const& compiled() const { return context_.compiled(); }
+
+        // Zero-copy I/O (see execution_context::bind_input). Bindings
+        // affect run() without input_table
+        auto bind_input(std::string const& name, void const* data,
+                        std::size_t size) {
+            uncache_own_context();
+            context_.bind_input(name, data, size);
+        }
+        auto bind_output(std::string const& name, void* data,
+                         std::size_t size) {
+            uncache_own_context();
+            context_.bind_output(name, data, size);
+        }
+        auto reset_io_bindings() {
+            context_.reset_io_bindings();
+            cache_own_context();
+        }
+
+        // Makes another context sharing parameters with this model. It can
+        // run on another thread concurrently
+        auto make_execution_context() const {
+            return ::instant::make_execution_context(context_.compiled());
+        }
+
+        auto const& run() { return context_.run(); }
+
+        // Runs with inputs whose batch size may differ from the one the
+        // model is made with. Nets are made and cached for each input dims.
+        // Returned outputs are valid until the cached context is discarded
+        auto const&
+        run(std::unordered_map<std::string, array> const& input_table) {
+            std::vector<std::vector<int>> input_dims_list;
+            for(auto const& input_name_dtype_dims_format :
+                context_.compiled()->input_name_dtype_dims_format_list()) {
+                input_dims_list.push_back(
+                  find_value(input_table,
+                             std::get<0>(input_name_dtype_dims_format))
+                    .dims());
+            }
+            auto& context = context_cache_.get(input_dims_list);
+            for(auto const& name_and_arr : input_table) {
+                auto const& arr = name_and_arr.second;
+                std::copy(fbegin(arr), fend(arr),
+                          fbegin(context.input(name_and_arr.first)));
+            }
+            return context.run();
+        }
+
+        auto set_profiling_enabled(bool is_enabled) {
+            context_.set_profiling_enabled(is_enabled);
+        }
+        auto reset_profile() { context_.reset_profile(); }
+        auto profile() const { return context_.profile(); }
+
+        auto& context_cache() { return context_cache_; }
+        auto const& context_cache() const { return context_cache_; }
+
+    private:
+        void cache_own_context() {
+            context_cache_.insert(get_input_dims_list(context_.compiled()),
+                                  context_);
+        }
+        // Bound buffers must not be used by run(input_table)
+        void uncache_own_context() {
+            context_cache_.erase(get_input_dims_list(context_.compiled()));
+        }
+
+        execution_context context_;
+        execution_context_cache context_cache_;
+    };
+
+    // parameter_table is typically made by make_parameter_table or
+    // load_onnx_with_mapped_parameter_table
+    inline auto make_model(
+      onnx::ModelProto const& onnx_model,
+      std::unordered_map<std::string, array> parameter_table,
+      std::vector<std::tuple<std::string, dtype_t, std::vector<int>,
+                             mkldnn::memory::format>> const&
+        input_name_dtype_dims_format_list,
+      std::vector<std::string> const& required_output_name_list,
+      mkldnn::engine const& engine = ::instant::get_context().engine()) {
+        return model(make_compiled_model_and_context(
+                       onnx_model, std::move(parameter_table),
+                       input_name_dtype_dims_format_list,
+                       required_output_name_list, engine,
+                       graph_optimization_options())
+                       .second);
+    }
+
+    // Opt-in tuning mode of make_model (see make_tuned_compiled_model)
+    inline auto make_tuned_model(
+      onnx::ModelProto const& onnx_model,
+      std::unordered_map<std::string, array> parameter_table,
+      std::vector<std::tuple<std::string, dtype_t, std::vector<int>,
+                             mkldnn::memory::format>> const&
+        input_name_dtype_dims_format_list,
+      std::vector<std::string> const& required_output_name_list,
+      std::string const& tuning_cache_filename,
+      mkldnn::engine const& engine = ::instant::get_context().engine()) {
+        return model(make_tuned_compiled_model_and_context(
+                       onnx_model, std::move(parameter_table),
+                       input_name_dtype_dims_format_list,
+                       required_output_name_list, tuning_cache_filename,
+                       engine)
+                       .second);
+    }
+
+    inline auto make_model(
+      onnx::ModelProto const& onnx_model,
+      std::vector<std::tuple<std::string, dtype_t, std::vector<int>,
+                             mkldnn::memory::format>> const&
+        input_name_dtype_dims_format_list,
+      std::vector<std::string> const& required_output_name_list,
+      mkldnn::engine const& engine = ::instant::get_context().engine()) {
+        // parameters of nodes not required are not loaded at all
+        auto pruned_onnx_model = onnx_model;
+        eliminate_dead_nodes(*pruned_onnx_model.mutable_graph(),
+                             std::set<std::string>(
+                               required_output_name_list.begin(),
+                               required_output_name_list.end()));
+        return make_model(pruned_onnx_model,
+                          make_parameter_table(pruned_onnx_model.graph()),
+                          input_name_dtype_dims_format_list,
+                          required_output_name_list, engine);
     }
 
 } // namespace instant
@@ -0,0 +1,31 @@
+#ifndef INSTANT_ISA_HPP
+#define INSTANT_ISA_HPP
+
+#include <string>
+
+namespace instant {
+
+    // The widest SIMD instruction set the running CPU supports. Results
+    // measured or packed for one ISA are not reused on another
+    inline std::string get_cpu_isa_name() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx512f")) {
+            return "avx512";
+        }
+        if(__builtin_cpu_supports("avx2")) {
+            return "avx2";
+        }
+        if(__builtin_cpu_supports("avx")) {
+            return "avx";
+        }
+        if(__builtin_cpu_supports("sse4.2")) {
+            return "sse42";
+        }
+#endif
+        return "generic";
+    }
+
+} // namespace instant
+
+#endif // INSTANT_ISA_HPP
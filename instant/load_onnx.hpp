@@ -2,9 +2,11 @@
 #define INSTANT_LOAD_ONNX_HPP
 
 #include <algorithm>
+#include <cstdint>
 #include <exception>
 #include <fstream>
 #include <functional>
+#include <limits>
 #include <numeric>
 #include <string>
 #include <tuple>
@@ -12,8 +14,14 @@
 #include <utility>
 #include <vector>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <google/protobuf/io/coded_stream.h>
 #include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <google/protobuf/wire_format_lite.h>
 
 #include <instant/array.hpp>
 #include <instant/dtype.hpp>
@@ -26,85 +34,6 @@ namespace instant {
         onnx_load_error(std::string const& message) : runtime_error(message) {}
     };
 
-    /*
-    inline auto load_nodes(onnx::GraphProto const& graph) {
-        std::vector<onnx::NodeProto> nodes;
-        std::copy(graph.node().begin(), graph.node().end(),
-    std::back_inserter(nodes)); return nodes;
-    }
-
-    inline auto
-    serialize_nodes(std::map<std::string, array> const& initializers,
-                    std::vector<onnx::NodeProto> const& nodes) {
-        std::vector<std::string> availables;
-        std::transform(initializers.begin(), initializers.end(),
-                       std::back_inserter(availables),
-                       [](auto const& e) { return e.first; });
-        std::vector<std::string> all_inputs, all_outputs;
-        for(auto const& node : nodes) {
-            all_inputs.insert(all_inputs.end(), node.input().begin(),
-                              node.input().end());
-            all_outputs.insert(all_outputs.end(), node.output().begin(),
-                               node.output().end());
-        }
-        std::sort(all_inputs.begin(), all_inputs.end());
-        std::sort(all_outputs.begin(), all_outputs.end());
-        std::vector<std::string> model_inputs;
-        std::set_difference(all_inputs.begin(), all_inputs.end(),
-                            all_outputs.begin(), all_outputs.end(),
-                            std::back_inserter(model_inputs));
-        availables.insert(availables.end(), model_inputs.begin(),
-                          model_inputs.end());
-        std::sort(availables.begin(), availables.end());
-
-        std::vector<onnx::NodeProto const*> left_nodes;
-        std::transform(nodes.begin(), nodes.end(),
-                       std::back_inserter(left_nodes),
-                       [](auto const& node) { return std::addressof(node); });
-
-        std::vector<std::vector<onnx::NodeProto const*>> node_partial_order;
-        while(!left_nodes.empty()) {
-            std::vector<onnx::NodeProto const*> consumable_node_set;
-            std::copy_if(
-              left_nodes.begin(), left_nodes.end(),
-              std::back_inserter(consumable_node_set), [&availables](auto* np) {
-                  std::vector<std::string> unavailable_inputs;
-                  std::vector<std::string> inputs(np->input().begin(),
-                                                  np->input().end());
-                  std::sort(inputs.begin(), inputs.end());
-                  std::sort(availables.begin(), availables.end());
-                  std::set_difference(inputs.begin(), inputs.end(),
-                                      availables.begin(), availables.end(),
-                                      std::back_inserter(unavailable_inputs));
-                  return unavailable_inputs.empty();
-              });
-            for(auto* np : consumable_node_set) {
-                // std::cout << np << " " <<
-                // np->input(0) << "\n";
-                availables.insert(availables.end(), np->output().begin(),
-                                  np->output().end());
-            }
-            // std::cout <<"---\n";
-
-            if(consumable_node_set.empty()) {
-                throw onnx_load_error("Invalid node definition");
-            }
-            node_partial_order.push_back(consumable_node_set);
-            auto end_iter = std::remove_if(
-              left_nodes.begin(), left_nodes.end(),
-              [&consumable_node_set](auto* left_node_ptr) {
-                  return std::any_of(
-                    consumable_node_set.begin(), consumable_node_set.end(),
-                    [left_node_ptr](auto const* consumable_node) {
-                        return left_node_ptr == consumable_node;
-                    });
-              });
-            left_nodes.erase(end_iter, left_nodes.end());
-        }
-        return node_partial_order;
-    }
-    */
-
     inline auto load_onnx(std::string const& filename) {
         namespace gpio = ::google::protobuf::io;
 
@@ -121,6 +50,188 @@ namespace instant {
         return onnx_model;
     }
 
+    // Maps the whole file read only. The mapping is released when the last
+    // pointer sharing its ownership is destroyed
+    inline auto map_file(std::string const& filename) {
+        auto fd = ::open(filename.c_str(), O_RDONLY);
+        if(fd == -1) {
+            throw onnx_load_error("File open error: " + filename);
+        }
+        struct stat file_stat;
+        if(::fstat(fd, &file_stat) == -1 || file_stat.st_size == 0) {
+            ::close(fd);
+            throw onnx_load_error("Invalid file: " + filename);
+        }
+        std::size_t size = file_stat.st_size;
+        auto* addr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if(addr == MAP_FAILED) {
+            throw onnx_load_error("mmap error: " + filename);
+        }
+        std::shared_ptr<char const> data(
+          static_cast<char const*>(addr),
+          [size](char const* p) { ::munmap(const_cast<char*>(p), size); });
+        return std::make_tuple(data, size);
+    }
+
+    // Calls f(field_number, field_data, field_size, payload_data,
+    // payload_size) for each field of serialized message. payload is valid
+    // only for length delimited fields
+    template <typename F>
+    auto for_each_serialized_field(char const* data, std::size_t size, F f) {
+        namespace gpio = ::google::protobuf::io;
+        using wfl = ::google::protobuf::internal::WireFormatLite;
+
+        if(std::numeric_limits<int>::max() < size) {
+            throw onnx_load_error("Too large message");
+        }
+        gpio::CodedInputStream cis(
+          reinterpret_cast<::google::protobuf::uint8 const*>(data),
+          static_cast<int>(size));
+        cis.SetTotalBytesLimit(std::numeric_limits<int>::max(),
+                               std::numeric_limits<int>::max());
+        while(true) {
+            auto field_begin = cis.CurrentPosition();
+            auto tag = cis.ReadTag();
+            if(tag == 0) {
+                break;
+            }
+            char const* payload_data = nullptr;
+            ::google::protobuf::uint32 payload_size = 0;
+            if(wfl::GetTagWireType(tag) == wfl::WIRETYPE_LENGTH_DELIMITED) {
+                if(!cis.ReadVarint32(&payload_size)) {
+                    throw onnx_load_error("ONNX parse error");
+                }
+                payload_data = data + cis.CurrentPosition();
+                if(!cis.Skip(payload_size)) {
+                    throw onnx_load_error("ONNX parse error");
+                }
+            } else if(!wfl::SkipField(&cis, tag)) {
+                throw onnx_load_error("ONNX parse error");
+            }
+            f(wfl::GetTagFieldNumber(tag), data + field_begin,
+              cis.CurrentPosition() - field_begin, payload_data, payload_size);
+        }
+    }
+
+    inline auto merge_serialized_field(google::protobuf::MessageLite& message,
+                                       char const* field_data,
+                                       std::size_t field_size) {
+        namespace gpio = ::google::protobuf::io;
+        gpio::CodedInputStream cis(
+          reinterpret_cast<::google::protobuf::uint8 const*>(field_data),
+          static_cast<int>(field_size));
+        cis.SetTotalBytesLimit(std::numeric_limits<int>::max(),
+                               std::numeric_limits<int>::max());
+        if(!message.MergeFromCodedStream(&cis)) {
+            throw onnx_load_error("ONNX parse error");
+        }
+    }
+
+    // Loads ONNX model without copying initializers' raw_data.
+    // Returned model's initializers have only metadata (name, dims and
+    // data_type) and returned parameter table's arrays point into the read
+    // only mapping of the file. MKL-DNN reorders user memory of any
+    // address, so raw_data aligned for float is mapped as it is. Only
+    // misaligned raw_data and float_data are copied (64 byte aligned)
+    inline auto load_onnx_with_mapped_parameter_table(
+      std::string const& filename) {
+        constexpr auto model_graph_field_number = 7;
+        constexpr auto graph_initializer_field_number = 5;
+        constexpr auto tensor_raw_data_field_number = 9;
+        constexpr std::size_t alignment = 64;
+
+        std::shared_ptr<char const> file_data;
+        std::size_t file_size;
+        std::tie(file_data, file_size) = map_file(filename);
+
+        onnx::ModelProto onnx_model;
+        std::unordered_map<std::string, instant::array> parameter_table;
+        auto add_parameter = [&parameter_table, &file_data](
+                               onnx::TensorProto const& tensor,
+                               char const* raw_data, std::size_t raw_size) {
+            assert(tensor.has_data_type());
+            dtype_t d = tensor_proto_data_type_to_dtype_t(tensor.data_type());
+            if(d != instant::dtype_t::float_) {
+                throw onnx_load_error("Not implemented");
+            }
+            std::vector<int> dims(tensor.dims().begin(), tensor.dims().end());
+            std::size_t total_size = calc_total_size(dims);
+
+            std::shared_ptr<void> data;
+            if(raw_data && total_size * sizeof(float) == raw_size &&
+               reinterpret_cast<std::uintptr_t>(raw_data) % alignof(float) ==
+                 0) {
+                // share ownership of the mapping
+                data = std::shared_ptr<void>(
+                  file_data, const_cast<char*>(raw_data));
+            } else {
+                data =
+                  allocate_aligned_data(total_size * sizeof(float), alignment);
+                auto* p = data.get();
+                if(raw_data) {
+                    if(total_size * sizeof(float) != raw_size) {
+                        throw onnx_load_error("Invalid raw_data size: " +
+                                              tensor.name());
+                    }
+                    std::copy(raw_data, raw_data + raw_size,
+                              static_cast<char*>(p));
+                } else {
+                    if(tensor.float_data_size() != total_size) {
+                        throw onnx_load_error("Invalid float_data size: " +
+                                              tensor.name());
+                    }
+                    std::copy(tensor.float_data().begin(),
+                              tensor.float_data().end(),
+                              static_cast<float*>(p));
+                }
+            }
+            parameter_table.insert(
+              {tensor.name(), instant::array(d, dims, std::move(data))});
+        };
+
+        for_each_serialized_field(
+          file_data.get(), file_size,
+          [&](int field_number, char const* field_data,
+              std::size_t field_size, char const* graph_data,
+              std::size_t graph_size) {
+              if(field_number != model_graph_field_number) {
+                  merge_serialized_field(onnx_model, field_data, field_size);
+                  return;
+              }
+              auto& graph = *onnx_model.mutable_graph();
+              for_each_serialized_field(
+                graph_data, graph_size,
+                [&](int field_number, char const* field_data,
+                    std::size_t field_size, char const* tensor_data,
+                    std::size_t tensor_size) {
+                    if(field_number != graph_initializer_field_number) {
+                        merge_serialized_field(graph, field_data, field_size);
+                        return;
+                    }
+                    auto& tensor = *graph.add_initializer();
+                    char const* raw_data = nullptr;
+                    std::size_t raw_size = 0;
+                    for_each_serialized_field(
+                      tensor_data, tensor_size,
+                      [&](int field_number, char const* field_data,
+                          std::size_t field_size, char const* payload_data,
+                          std::size_t payload_size) {
+                          if(field_number == tensor_raw_data_field_number) {
+                              raw_data = payload_data;
+                              raw_size = payload_size;
+                          } else {
+                              merge_serialized_field(tensor, field_data,
+                                                     field_size);
+                          }
+                      });
+                    add_parameter(tensor, raw_data, raw_size);
+                    tensor.clear_float_data();
+                });
+          });
+        return std::make_tuple(onnx_model, parameter_table);
+    }
+
     // TODO avoid copy
     /*
     inline auto make_parameter_table(onnx::GraphProto const& graph) {
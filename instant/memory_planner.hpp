@@ -0,0 +1,86 @@
+#ifndef INSTANT_MEMORY_PLANNER_HPP
+#define INSTANT_MEMORY_PLANNER_HPP
+
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+#include <tuple>
+#include <vector>
+
+namespace instant {
+
+    inline auto round_up(std::size_t size, std::size_t alignment) {
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    // Assigns an offset in one arena to each buffer of size_list.
+    // is_conflicting(i, j) tells whether buffers i and j can be used at the
+    // same time. Such buffers never share storage.
+    // Larger buffers are placed first, each at the lowest offset which does
+    // not conflict with already placed buffers.
+    // Returns the offset list (in the order of size_list) and arena size
+    template <typename IsConflicting>
+    inline auto plan_arena(std::vector<std::size_t> const& size_list,
+                           IsConflicting is_conflicting,
+                           std::size_t alignment = 64) {
+        std::vector<int> order(size_list.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(),
+                         [&size_list](int a, int b) {
+                             return size_list[a] > size_list[b];
+                         });
+
+        std::vector<std::size_t> offset_list(size_list.size(), 0);
+        std::vector<int> placed_list;
+        std::size_t arena_size = 0;
+        for(auto i : order) {
+            auto size = round_up(size_list[i], alignment);
+
+            std::vector<int> conflict_list;
+            std::copy_if(placed_list.begin(), placed_list.end(),
+                         std::back_inserter(conflict_list),
+                         [&is_conflicting, i](int j) {
+                             return is_conflicting(i, j);
+                         });
+            std::sort(conflict_list.begin(), conflict_list.end(),
+                      [&offset_list](int a, int b) {
+                          return offset_list[a] < offset_list[b];
+                      });
+
+            std::size_t offset = 0;
+            for(auto j : conflict_list) {
+                if(offset + size <= offset_list[j]) {
+                    break; // fits in the gap
+                }
+                offset = std::max(offset, offset_list[j] +
+                                            round_up(size_list[j], alignment));
+            }
+            offset_list[i] = offset;
+            placed_list.push_back(i);
+            arena_size = std::max(arena_size, offset + size);
+        }
+        return std::make_tuple(offset_list, arena_size);
+    }
+
+    // buffer_list is the list of (size in bytes, first node index, last
+    // node index). Buffers whose lifetimes overlap never share storage
+    inline auto plan_arena(
+      std::vector<std::tuple<std::size_t, int, int>> const& buffer_list,
+      std::size_t alignment = 64) {
+        std::vector<std::size_t> size_list;
+        std::transform(buffer_list.begin(), buffer_list.end(),
+                       std::back_inserter(size_list),
+                       [](auto const& b) { return std::get<0>(b); });
+        return plan_arena(size_list,
+                          [&buffer_list](int i, int j) {
+                              return std::get<1>(buffer_list[j]) <=
+                                       std::get<2>(buffer_list[i]) &&
+                                     std::get<1>(buffer_list[i]) <=
+                                       std::get<2>(buffer_list[j]);
+                          },
+                          alignment);
+    }
+
+} // namespace instant
+
+#endif // INSTANT_MEMORY_PLANNER_HPP
@@ -9,12 +9,15 @@
 
 #include <instant/array.hpp>
 #include <instant/context.hpp>
+#include <instant/graph.hpp>
+#include <instant/memory_planner.hpp>
 #include <instant/operator.hpp>
+#include <instant/scheduler.hpp>
 
 namespace instant {
 
     inline auto make_parameter_memory_pair(
-      onnx::NodeProto const& node, int param_index,
+      graph_node const& node, int param_index,
       mkldnn::memory::format format,
       std::unordered_map<std::string, instant::array> const& parameter_table,
       mkldnn::engine const& engine) {
@@ -28,17 +31,37 @@ namespace instant {
     }
 
     inline auto make_parameter_memory_table(
-      onnx::GraphProto const& graph,
+      graph_ir const& ir,
       std::unordered_map<std::string, instant::array> const& parameter_table,
       mkldnn::engine const& engine) {
         std::unordered_map<std::string, const mkldnn::memory> memory_table;
         std::vector<array> temp_array_list;
-        for(auto const& node : graph.node()) {
+        for(auto const& node : ir.node_list()) {
             if(node.op_type() == "Conv") {
                 constexpr auto weight_index = 1;
-                memory_table.insert(make_parameter_memory_pair(
-                  node, weight_index, mkldnn::memory::format::oihw,
-                  parameter_table, engine));
+                auto group = load_group(node.attribute_table);
+                if(group == 1) {
+                    memory_table.insert(make_parameter_memory_pair(
+                      node, weight_index, mkldnn::memory::format::oihw,
+                      parameter_table, engine));
+                } else {
+                    // oihw weight is viewed as goihw without copy
+                    auto const& name = node.input(weight_index);
+                    auto const& arr = find_value(parameter_table, name);
+                    auto const& dims = arr.dims();
+                    if(dims.size() != 4 || dims[0] % group != 0) {
+                        throw std::runtime_error(
+                          "Invalid group of Conv: " + node.output(0));
+                    }
+                    mkldnn::memory::dims tz{group, dims[0] / group, dims[1],
+                                            dims[2], dims[3]};
+                    memory_table.insert(
+                      {name, mkldnn::memory({{{tz},
+                                              mkldnn::memory::data_type::f32,
+                                              mkldnn::memory::format::goihw},
+                                             engine},
+                                            const_cast<void*>(arr.data()))});
+                }
 
                 if(node.input_size() != 2) {
                     constexpr auto bias_index = 2;
@@ -100,6 +123,79 @@ namespace instant {
                 memory_table.insert(make_parameter_memory_pair(
                   node, var_index, mkldnn::memory::format::x, parameter_table,
                   engine));
+            } else if(node.op_type() == "EltwiseChain") {
+                // scales and shifts of "AxisAffine" (see fuse_eltwise_chain)
+                for(int i = 1; i < node.input_size(); ++i) {
+                    memory_table.insert(make_parameter_memory_pair(
+                      node, i, mkldnn::memory::format::x, parameter_table,
+                      engine));
+                }
+            } else if(node.op_type() == "Add" || node.op_type() == "Sum") {
+                // constant operands are held in plain formats. Scalars are
+                // viewed as 1-D and 3-D ones (e.g. bias of CHW) as 4-D with
+                // batch size 1, which broadcast the same
+                for(auto const& name : node.proto->input()) {
+                    auto found = parameter_table.find(name);
+                    if(found == parameter_table.end() ||
+                       memory_table.find(name) != memory_table.end()) {
+                        continue;
+                    }
+                    auto const& arr = found->second;
+                    mkldnn::memory::dims tz(arr.dims().begin(),
+                                            arr.dims().end());
+                    if(tz.empty() || tz.size() == 3) {
+                        tz.insert(tz.begin(), 1);
+                    }
+                    memory_table.insert(
+                      {name, mkldnn::memory({{{tz},
+                                              mkldnn::memory::data_type::f32,
+                                              get_plain_format(tz.size())},
+                                             engine},
+                                            const_cast<void*>(arr.data()))});
+                }
+            } else if(node.op_type() == "Gemm" ||
+                      node.op_type() == "MatMul") {
+                // 2-D B is viewed as the (N, K) weight of inner product
+                // without copy (see is_inner_product_weight). The other
+                // operands are held in plain formats. C of Gemm drops its
+                // leading 1s so that C of (1, N) is taken as the bias
+                auto const& attribute_table = node.attribute_table;
+                auto is_b_transposed =
+                  attribute_table.find("transB") != attribute_table.end() &&
+                  load_attribute_int(attribute_table, "transB") == 1;
+                for(int i = 0; i < node.input_size(); ++i) {
+                    auto const& name = node.input(i);
+                    auto found = parameter_table.find(name);
+                    if(found == parameter_table.end() ||
+                       memory_table.find(name) != memory_table.end()) {
+                        continue;
+                    }
+                    auto const& arr = found->second;
+                    mkldnn::memory::dims tz(arr.dims().begin(),
+                                            arr.dims().end());
+                    auto format = mkldnn::memory::format::io;
+                    if(i == 1 && tz.size() == 2) {
+                        if(is_b_transposed) {
+                            format = mkldnn::memory::format::oi;
+                        } else {
+                            std::swap(tz[0], tz[1]);
+                        }
+                    } else {
+                        while(i == 2 && tz.size() > 1 && tz[0] == 1) {
+                            tz.erase(tz.begin());
+                        }
+                        if(tz.empty()) {
+                            tz.push_back(1);
+                        }
+                        format = get_plain_format(tz.size());
+                    }
+                    memory_table.insert(
+                      {name,
+                       mkldnn::memory(
+                         {{{tz}, mkldnn::memory::data_type::f32, format},
+                          engine},
+                         const_cast<void*>(arr.data()))});
+                }
             } else {
                 // TODO
                 /*
@@ -109,7 +205,15 @@ namespace instant {
             }
         }
         return std::make_tuple(memory_table, temp_array_list);
-    } // namespace instant
+    }
+
+    inline auto make_parameter_memory_table(
+      onnx::GraphProto const& graph,
+      std::unordered_map<std::string, instant::array> const& parameter_table,
+      mkldnn::engine const& engine) {
+        return make_parameter_memory_table(graph_ir(graph), parameter_table,
+                                           engine);
+    }
 
     inline auto make_variable_memory_table(
       std::vector<std::tuple<std::string, instant::array,
@@ -142,9 +246,21 @@ namespace instant {
                                                                // and origin
                                                                // format] list
           std::vector<mkldnn::memory>, // temporary variable memory list
-          std::vector<std::pair<std::string, array>>> // reqired output
+          std::vector<std::pair<std::string, array>>, // reqired output
                                                       // name and array
                                                       // list
+          std::vector<mkldnn::primitive>, // parameter net (executed once)
+          std::vector<std::pair<std::string,
+                                mkldnn::memory>>, // packed parameter name
+                                                  // and memory list
+          std::vector<std::pair<mkldnn::memory,
+                                mkldnn::memory>>, // variable memory alias
+                                                  // list (alias memory and
+                                                  // aliased memory)
+          std::vector<std::pair<mkldnn::primitive,
+                                host_kernel>>> // host kernel list
+                                               // (placeholder in net and
+                                               // kernel)
         (std::unordered_map<std::string,
                             const mkldnn::memory> const&, // parameter memory
                                                           // table
@@ -154,34 +270,55 @@ namespace instant {
                       mkldnn::memory::format>> const&, // variable memory
                                                        // table
          std::set<std::string> const&, // required output name set
-         onnx::NodeProto const&, mkldnn::engine const&)>;
+         graph_node const&, mkldnn::engine const&)>;
 
     inline auto make_default_primitive_factory_table() {
         std::unordered_map<std::string, primitive_factory>
           primitive_factory_table;
-        // primitive_factory_table.insert({"Abs", make_abs_primitive});
+        primitive_factory_table.insert({"Abs", make_abs_primitive});
+        primitive_factory_table.insert({"Add", make_add_primitive});
         primitive_factory_table.insert(
           {"AveragePool", make_average_pool_primitive});
         primitive_factory_table.insert(
           {"BatchNormalization", make_batch_norm_primitive});
+        primitive_factory_table.insert({"Clip", make_clip_primitive});
+        primitive_factory_table.insert({"Concat", make_concat_primitive});
         primitive_factory_table.insert({"Conv", make_conv_primitive});
         primitive_factory_table.insert({"Dropout", make_dropout_primitive});
+        primitive_factory_table.insert(
+          {"EltwiseChain", make_eltwise_chain_primitive});
         primitive_factory_table.insert({"Elu", make_elu_primitive});
+        primitive_factory_table.insert({"Exp", make_exp_primitive});
         primitive_factory_table.insert({"FC", make_fc_primitive});
+        primitive_factory_table.insert({"Flatten", make_flatten_primitive});
+        primitive_factory_table.insert({"Gemm", make_gemm_primitive});
+        primitive_factory_table.insert(
+          {"HardSigmoid", make_hard_sigmoid_primitive});
+        primitive_factory_table.insert({"Identity", make_nop_primitive});
         primitive_factory_table.insert(
           {"LeakyRelu", make_leaky_relu_primitive});
+        primitive_factory_table.insert({"Log", make_log_primitive});
+        primitive_factory_table.insert({"MatMul", make_matmul_primitive});
         primitive_factory_table.insert({"MaxPool", make_max_pool_primitive});
+        primitive_factory_table.insert({"Neg", make_neg_primitive});
+        primitive_factory_table.insert(
+          {"Reciprocal", make_reciprocal_primitive});
         primitive_factory_table.insert({"Relu", make_relu_primitive});
         primitive_factory_table.insert({"Reshape", make_reshape_primitive});
+        primitive_factory_table.insert({"Sigmoid", make_sigmoid_primitive});
         primitive_factory_table.insert({"Softmax", make_softmax_primitive});
-        // primitive_factory_table.insert({"Sqrt", make_sqrt_primitive});
+        primitive_factory_table.insert({"Sqrt", make_sqrt_primitive});
+        primitive_factory_table.insert({"Sum", make_add_primitive});
         primitive_factory_table.insert({"Tanh", make_tanh_primitive});
         // TODO other primitives
         return primitive_factory_table;
     }
 
+    // When allows_concurrent_nodes is true, intermediate buffers are
+    // planned so that nets of nodes independent of each other can run at
+    // the same time
     inline auto make_nets(
-      onnx::GraphProto const& graph,
+      graph_ir const& ir,
       std::unordered_map<std::string, const mkldnn::memory> const&
         parameter_memory_table,
       std::unordered_map<
@@ -191,12 +328,44 @@ namespace instant {
       std::unordered_map<std::string, primitive_factory>
         primitive_factory_table =
           instant::make_default_primitive_factory_table(),
-      instant::context const& context = instant::get_context()) {
+      instant::context const& context = instant::get_context(),
+      bool allows_concurrent_nodes = false) {
         auto variable_memory_table = input_memory_table;
         std::unordered_map<std::string, instant::array> output_table;
         std::vector<mkldnn::primitive> nets;
         std::vector<mkldnn::memory> temp_variable_memory_list;
-        for(auto const& node : graph.node()) {
+        std::vector<mkldnn::primitive> parameter_nets;
+        std::vector<std::pair<std::string, mkldnn::memory>>
+          packed_parameter_memory_list;
+        host_kernel_table_t host_kernel_table;
+
+        // Deferred memories are grouped into buffers. Each buffer has its
+        // size and lifetime (first and last node index using it)
+        std::vector<std::tuple<std::size_t, int, int>> buffer_list;
+        std::vector<std::vector<mkldnn::memory>> buffer_memory_list;
+        std::vector<std::vector<int>> buffer_user_list; // node indices
+        std::unordered_map<mkldnn_primitive_t, int> buffer_index_table;
+        std::vector<int> variable_buffer_index_list(ir.tensor_num(), -1);
+        auto register_buffer = [&](mkldnn::memory const& mem, int node_index) {
+            auto found = buffer_index_table.find(mem.get());
+            if(found != buffer_index_table.end()) {
+                return found->second;
+            }
+            int buffer_index = buffer_list.size();
+            buffer_list.emplace_back(mem.get_primitive_desc().get_size(),
+                                     node_index, node_index);
+            buffer_memory_list.push_back({mem});
+            buffer_user_list.push_back({node_index});
+            buffer_index_table.insert({mem.get(), buffer_index});
+            return buffer_index;
+        };
+
+        // [first, last) of nets constructed for each node
+        std::vector<std::pair<int, int>> node_net_range_list;
+
+        for(int node_index = 0; node_index < ir.node_num(); ++node_index) {
+            auto const& node = ir.node(node_index);
+            node_net_range_list.emplace_back(nets.size(), nets.size());
             try {
                 auto primitive_factory_pair_iter =
                   primitive_factory_table.find(node.op_type());
@@ -214,6 +383,52 @@ namespace instant {
                   std::get<1>(temp_tuple);
                 auto& temp_vars = std::get<2>(temp_tuple);
                 auto& output_name_and_arr_list = std::get<3>(temp_tuple);
+                auto& parameter_net = std::get<4>(temp_tuple);
+                auto& packed_parameter_memories = std::get<5>(temp_tuple);
+                auto& variable_memory_alias_list = std::get<6>(temp_tuple);
+                auto& host_kernel_list = std::get<7>(temp_tuple);
+
+                for(auto input_id : node.input_id_list) {
+                    auto buffer_index = variable_buffer_index_list[input_id];
+                    if(buffer_index != -1) {
+                        auto& last = std::get<2>(buffer_list[buffer_index]);
+                        last = std::max(last, node_index);
+                        buffer_user_list[buffer_index].push_back(node_index);
+                    }
+                }
+                for(auto const& alias : variable_memory_alias_list) {
+                    if(!is_deferred_memory(alias.first) ||
+                       !is_deferred_memory(alias.second)) {
+                        continue;
+                    }
+                    // an alias may be written by a node after the one
+                    // making the buffer (e.g. a slice of a Concat output)
+                    auto buffer_index =
+                      register_buffer(alias.second, node_index);
+                    auto& last = std::get<2>(buffer_list[buffer_index]);
+                    last = std::max(last, node_index);
+                    buffer_user_list[buffer_index].push_back(node_index);
+                    buffer_memory_list[buffer_index].push_back(alias.first);
+                    buffer_index_table.insert(
+                      {alias.first.get(), buffer_index});
+                }
+                for(auto const& output_name_and_memory_and_origin_format :
+                    output_name_and_memory_and_origin_format_list) {
+                    auto const& output_name =
+                      output_name_and_memory_and_origin_format.first;
+                    auto const& mem = std::get<0>(
+                      output_name_and_memory_and_origin_format.second);
+                    auto output_id = ir.find_tensor_id(output_name);
+                    if(output_id != -1 && is_deferred_memory(mem)) {
+                        variable_buffer_index_list[output_id] =
+                          register_buffer(mem, node_index);
+                    }
+                }
+                for(auto const& mem : temp_vars) {
+                    if(is_deferred_memory(mem)) {
+                        register_buffer(mem, node_index);
+                    }
+                }
 
                 nets.insert(nets.end(), std::make_move_iterator(net.begin()),
                             std::make_move_iterator(net.end()));
@@ -229,14 +444,127 @@ namespace instant {
                 output_table.insert(
                   std::make_move_iterator(output_name_and_arr_list.begin()),
                   std::make_move_iterator(output_name_and_arr_list.end()));
+                parameter_nets.insert(
+                  parameter_nets.end(),
+                  std::make_move_iterator(parameter_net.begin()),
+                  std::make_move_iterator(parameter_net.end()));
+                packed_parameter_memory_list.insert(
+                  packed_parameter_memory_list.end(),
+                  std::make_move_iterator(packed_parameter_memories.begin()),
+                  std::make_move_iterator(packed_parameter_memories.end()));
+                for(auto& placeholder_and_kernel : host_kernel_list) {
+                    host_kernel_table.emplace(
+                      placeholder_and_kernel.first.get(),
+                      std::move(placeholder_and_kernel.second));
+                }
             } catch(mkldnn::error const& e) {
                 std::cout << "MKLDNN Error: " << e.message << std::endl;
             } catch(std::exception const& e) {
                 std::cout << "Error: " << e.what() << std::endl;
             }
+            node_net_range_list.back().second = nets.size();
+        }
+
+        // Buffers whose lifetimes do not overlap share storage in one arena
+        std::tuple<std::vector<std::size_t>, std::size_t>
+          offset_list_and_arena_size;
+        if(allows_concurrent_nodes) {
+            // Buffer j can reuse storage of buffer i only when all users of
+            // i finish before any user of j starts. Users of j include all
+            // its producers, which are more than one for Concat outputs
+            // written in slices
+            auto ancestor_table =
+              make_ancestor_table(make_node_dependency_list(ir));
+            auto happens_before = [&](int i, int j) {
+                return std::all_of(
+                  buffer_user_list[j].begin(), buffer_user_list[j].end(),
+                  [&](int j_user) {
+                      return std::all_of(
+                        buffer_user_list[i].begin(), buffer_user_list[i].end(),
+                        [&](int user) {
+                            return ancestor_table[j_user][user];
+                        });
+                  });
+            };
+            std::vector<std::size_t> size_list;
+            for(auto const& buffer : buffer_list) {
+                size_list.push_back(std::get<0>(buffer));
+            }
+            offset_list_and_arena_size =
+              plan_arena(size_list, [&](int i, int j) {
+                  return !happens_before(i, j) && !happens_before(j, i);
+              });
+        } else {
+            offset_list_and_arena_size = plan_arena(buffer_list);
+        }
+        auto const& offset_list = std::get<0>(offset_list_and_arena_size);
+        auto arena_size = std::get<1>(offset_list_and_arena_size);
+        auto arena = allocate_aligned_data(arena_size, 64);
+        for(int i = 0; i < static_cast<int>(buffer_list.size()); ++i) {
+            for(auto& mem : buffer_memory_list[i]) {
+                mem.set_data_handle(static_cast<char*>(arena.get()) +
+                                    offset_list[i]);
+            }
         }
+
         return std::make_tuple(nets, variable_memory_table,
-                               temp_variable_memory_list, output_table);
+                               temp_variable_memory_list, output_table,
+                               parameter_nets, packed_parameter_memory_list,
+                               arena, arena_size, node_net_range_list,
+                               host_kernel_table);
+    }
+
+    inline auto make_nets(
+      onnx::GraphProto const& graph,
+      std::unordered_map<std::string, const mkldnn::memory> const&
+        parameter_memory_table,
+      std::unordered_map<
+        std::string, std::tuple<const mkldnn::memory, mkldnn::memory::format>>&
+        input_memory_table,
+      std::set<std::string> const& required_output_set,
+      std::unordered_map<std::string, primitive_factory>
+        primitive_factory_table =
+          instant::make_default_primitive_factory_table(),
+      instant::context const& context = instant::get_context(),
+      bool allows_concurrent_nodes = false) {
+        return make_nets(graph_ir(graph), parameter_memory_table,
+                         input_memory_table, required_output_set,
+                         primitive_factory_table, context,
+                         allows_concurrent_nodes);
+    }
+
+    // Execute parameter nets once and replace reordered parameters with
+    // packed ones. Original parameter arrays which are no longer referenced
+    // are released
+    inline auto pack_parameters(
+      graph_ir const& ir,
+      std::unordered_map<std::string, instant::array>& parameter_table,
+      std::unordered_map<std::string, const mkldnn::memory>&
+        parameter_memory_table,
+      std::vector<mkldnn::primitive> const& parameter_nets,
+      std::vector<std::pair<std::string, mkldnn::memory>> const&
+        packed_parameter_memory_list) {
+        mkldnn::stream(mkldnn::stream::kind::eager)
+          .submit(parameter_nets)
+          .wait();
+
+        std::vector<int> consumer_count_list(ir.tensor_num());
+        for(int i = 0; i < ir.tensor_num(); ++i) {
+            consumer_count_list[i] = ir.consumer_list(i).size();
+        }
+        for(auto const& name_and_memory : packed_parameter_memory_list) {
+            --consumer_count_list[ir.tensor_id(name_and_memory.first)];
+        }
+        for(auto const& name_and_memory : packed_parameter_memory_list) {
+            auto const& name = name_and_memory.first;
+            if(consumer_count_list[ir.tensor_id(name)] != 0 ||
+               parameter_table.find(name) == parameter_table.end()) {
+                continue; // still used or already released
+            }
+            parameter_memory_table.erase(name);
+            parameter_memory_table.insert(name_and_memory);
+            parameter_table.erase(name);
+        }
     }
 
     inline auto run_model(
@@ -256,7 +584,11 @@ namespace instant {
                     required_output_set, primitive_factory_table, context);
         auto const& nets = std::get<0>(temp_tuple);
         auto const& output_table = std::get<3>(temp_tuple);
-        mkldnn::stream(mkldnn::stream::kind::eager).submit(nets).wait();
+        auto const& parameter_nets = std::get<4>(temp_tuple);
+        mkldnn::stream(mkldnn::stream::kind::eager)
+          .submit(parameter_nets)
+          .wait();
+        run_nets(nets, std::get<9>(temp_tuple));
         return output_table;
     }
 
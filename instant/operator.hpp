@@ -1,11 +1,14 @@
 #ifndef INSTANT_OPERATOR_HPP
 #define INSTANT_OPERATOR_HPP
 
+#include <instant/operator/add.hpp>
 #include <instant/operator/batch_norm.hpp>
+#include <instant/operator/concat.hpp>
 #include <instant/operator/conv.hpp>
 #include <instant/operator/dropout.hpp>
 #include <instant/operator/eltwise.hpp>
 #include <instant/operator/fc.hpp>
+#include <instant/operator/gemm.hpp>
 #include <instant/operator/pool.hpp>
 #include <instant/operator/reshape.hpp>
 #include <instant/operator/softmax.hpp>
@@ -0,0 +1,278 @@
+#ifndef INSTANT_OPERATOR_ADD_HPP
+#define INSTANT_OPERATOR_ADD_HPP
+
+#include <algorithm>
+#include <numeric>
+
+#include <instant/eltwise_kernel.hpp>
+#include <instant/operator/common.hpp>
+
+namespace instant {
+
+    // Dims of the result of inputs broadcast by numpy rules
+    inline auto
+    calc_broadcast_dims(std::vector<std::vector<int>> const& dims_list) {
+        std::vector<int> output_dims;
+        for(auto const& dims : dims_list) {
+            if(dims.size() > output_dims.size()) {
+                output_dims.insert(output_dims.begin(),
+                                   dims.size() - output_dims.size(), 1);
+            }
+            auto offset = output_dims.size() - dims.size();
+            for(std::size_t i = 0; i < dims.size(); ++i) {
+                auto& d = output_dims[offset + i];
+                if(d == 1) {
+                    d = dims[i];
+                } else if(dims[i] != 1 && dims[i] != d) {
+                    throw std::runtime_error("Dims can not be broadcast");
+                }
+            }
+        }
+        return output_dims;
+    }
+
+    // Strides in elements of a dense input for each dim of output_dims. A
+    // stride is 0 where the input is broadcast
+    inline auto calc_broadcast_strides(std::vector<int> const& input_dims,
+                                       std::vector<int> const& output_dims) {
+        std::vector<int> strides(output_dims.size(), 0);
+        auto offset = output_dims.size() - input_dims.size();
+        int stride = 1;
+        for(int i = input_dims.size() - 1; i >= 0; --i) {
+            if(input_dims[i] != 1) {
+                strides[offset + i] = stride;
+                stride *= input_dims[i];
+            }
+        }
+        return strides;
+    }
+
+    // c = a + b where a and b are broadcast to dims (see
+    // calc_broadcast_strides). c is dense and may be a when a is not
+    // broadcast. Dims are merged as long as the inputs stay contiguous, so
+    // the inner loop runs kernel over the longest span of unit or zero
+    // stride
+    inline void add_broadcast(float const* a, std::vector<int> const& a_strides,
+                              float const* b, std::vector<int> const& b_strides,
+                              float* c, std::vector<int> const& dims,
+                              add_kernel kernel = get_add_kernel()) {
+        // merged dims, innermost first
+        std::vector<int> merged_dims, merged_a_strides, merged_b_strides;
+        for(int i = dims.size() - 1; i >= 0; --i) {
+            if(dims[i] == 1) {
+                continue;
+            }
+            if(!merged_dims.empty() &&
+               a_strides[i] == merged_a_strides.back() * merged_dims.back() &&
+               b_strides[i] == merged_b_strides.back() * merged_dims.back()) {
+                merged_dims.back() *= dims[i];
+                continue;
+            }
+            merged_dims.push_back(dims[i]);
+            merged_a_strides.push_back(a_strides[i]);
+            merged_b_strides.push_back(b_strides[i]);
+        }
+        if(merged_dims.empty()) {
+            c[0] = a[0] + b[0];
+            return;
+        }
+
+        auto inner_size = merged_dims[0];
+        auto inner_a_stride = merged_a_strides[0];
+        auto inner_b_stride = merged_b_strides[0];
+        auto outer_size =
+          std::accumulate(merged_dims.begin() + 1, merged_dims.end(), 1,
+                          std::multiplies<int>());
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+        for(int o = 0; o < outer_size; ++o) {
+            auto a_offset = 0;
+            auto b_offset = 0;
+            for(std::size_t i = 1, rest = o; i < merged_dims.size(); ++i) {
+                auto index = rest % merged_dims[i];
+                rest /= merged_dims[i];
+                a_offset += index * merged_a_strides[i];
+                b_offset += index * merged_b_strides[i];
+            }
+            // the inner stride of an input is 1 unless it is broadcast
+            auto* pc = c + static_cast<std::size_t>(o) * inner_size;
+            kernel(a + a_offset, inner_a_stride != 0, b + b_offset,
+                   inner_b_stride != 0, pc, inner_size);
+        }
+    }
+
+    // Appends the primitives computing output = sum of inputs to net.
+    // input_dims_list has the dims inputs are broadcast as. Inputs of the
+    // output dims are summed by MKL-DNN in their formats. Otherwise they
+    // are reordered to plain formats if needed and added by add_broadcast,
+    // which runs as a host kernel. output_memory_manager is called with the
+    // output dims and primitive desc and the generator of the primitive
+    // writing the output
+    template <typename OutputMemoryManager>
+    auto make_sum_net(
+      std::vector<mkldnn::memory> const& input_memory_list,
+      std::vector<std::vector<int>> const& input_dims_list,
+      std::vector<mkldnn::primitive>& net,
+      std::vector<mkldnn::memory>& temp_variable_memory_list,
+      std::vector<std::pair<mkldnn::primitive, host_kernel>>& host_kernel_list,
+      mkldnn::engine const& engine,
+      OutputMemoryManager output_memory_manager) {
+        auto output_dims = calc_broadcast_dims(input_dims_list);
+        if(std::all_of(input_memory_list.begin(), input_memory_list.end(),
+                       [&output_dims](auto const& input_memory) {
+                           return extract_dims(input_memory) == output_dims;
+                       })) {
+            std::vector<mkldnn::memory::primitive_desc> input_pd_list;
+            std::vector<mkldnn::primitive::at> input_list;
+            for(auto const& input_memory : input_memory_list) {
+                input_pd_list.push_back(input_memory.get_primitive_desc());
+                input_list.push_back(input_memory);
+            }
+            auto sum_pd = mkldnn::sum::primitive_desc(
+              std::vector<float>(input_memory_list.size(), 1.f),
+              input_pd_list);
+            output_memory_manager(
+              output_dims, sum_pd.dst_primitive_desc(),
+              [input_list, sum_pd](auto& op_output_memory) mutable {
+                  return mkldnn::sum(sum_pd, input_list, op_output_memory);
+              });
+            return;
+        }
+
+        std::vector<mkldnn::memory> plain_input_memory_list;
+        std::vector<std::vector<int>> input_strides_list;
+        for(std::size_t i = 0; i < input_memory_list.size(); ++i) {
+            plain_input_memory_list.push_back(
+              make_plain_memory(input_memory_list[i], net,
+                                temp_variable_memory_list, engine));
+            input_strides_list.push_back(
+              calc_broadcast_strides(input_dims_list[i], output_dims));
+        }
+        auto output_pd = mkldnn::memory::primitive_desc(
+          {{output_dims},
+           mkldnn::memory::data_type::f32,
+           get_plain_format(output_dims.size())},
+          engine);
+        output_memory_manager(
+          output_dims, output_pd,
+          [&host_kernel_list, &engine, plain_input_memory_list,
+           input_strides_list, output_dims](auto& op_output_memory) {
+              auto placeholder = make_host_kernel_placeholder(engine);
+              auto output_strides =
+                calc_broadcast_strides(output_dims, output_dims);
+              mkldnn::memory output_memory = op_output_memory;
+              host_kernel_list.emplace_back(placeholder, [=]() {
+                  auto* output =
+                    static_cast<float*>(output_memory.get_data_handle());
+                  add_broadcast(static_cast<float const*>(
+                                  plain_input_memory_list[0].get_data_handle()),
+                                input_strides_list[0],
+                                static_cast<float const*>(
+                                  plain_input_memory_list[1].get_data_handle()),
+                                input_strides_list[1], output, output_dims);
+                  for(std::size_t i = 2; i < plain_input_memory_list.size();
+                      ++i) {
+                      add_broadcast(output, output_strides,
+                                    static_cast<float const*>(
+                                      plain_input_memory_list[i]
+                                        .get_data_handle()),
+                                    input_strides_list[i], output,
+                                    output_dims);
+                  }
+              });
+              return placeholder;
+          });
+    }
+
+    // Add and Sum with numpy-style broadcasting. Inputs may be parameters.
+    // Add of opset < 7 with "broadcast" and "axis" is also supported
+    inline auto make_add_primitive(
+      std::unordered_map<std::string, const mkldnn::memory> const&
+        parameter_memory_table,
+      std::unordered_map<std::string, std::tuple<const mkldnn::memory,
+                                                 mkldnn::memory::format>> const&
+        variable_memory_table,
+      std::set<std::string> const& required_output_set,
+      graph_node const& node, mkldnn::engine const& engine) {
+        auto const& attribute_table = node.attribute_table;
+
+        std::vector<mkldnn::memory> input_memory_list;
+        std::vector<std::vector<int>> input_dims_list;
+        std::unique_ptr<mkldnn::memory::format> input_origin_format_p;
+        for(auto const& input_name : node.proto->input()) {
+            auto found = variable_memory_table.find(input_name);
+            if(found != variable_memory_table.end()) {
+                input_memory_list.push_back(std::get<0>(found->second));
+                if(!input_origin_format_p) {
+                    input_origin_format_p =
+                      std::make_unique<mkldnn::memory::format>(
+                        std::get<1>(found->second));
+                }
+            } else {
+                input_memory_list.push_back(
+                  find_value(parameter_memory_table, input_name));
+            }
+            input_dims_list.push_back(extract_dims(input_memory_list.back()));
+        }
+        if(input_memory_list.size() == 1) {
+            throw std::runtime_error("Not implemented: " + node.op_type() +
+                                     " of one input");
+        }
+        if(attribute_table.find("broadcast") != attribute_table.end() &&
+           attribute_table.find("axis") != attribute_table.end() &&
+           load_attribute_int(attribute_table, "broadcast") == 1) {
+            // B is aligned to the axis of A, not to the last dim
+            auto axis = load_attribute_int(attribute_table, "axis");
+            auto& b_dims = input_dims_list.at(1);
+            auto ndims = static_cast<int>(input_dims_list[0].size());
+            if(axis < 0) {
+                axis += ndims;
+            }
+            b_dims.resize(ndims - axis, 1);
+        }
+        auto input_origin_format = input_origin_format_p
+                                     ? *input_origin_format_p
+                                     : mkldnn::memory::format::nchw;
+
+        auto const& output_name = node.output(0);
+
+        std::vector<mkldnn::primitive> net;
+        std::vector<std::pair<
+          std::string, std::tuple<mkldnn::memory, mkldnn::memory::format>>>
+          variable_memory_list;
+        std::vector<mkldnn::memory>
+          temp_variable_memory_list; // for temporary memory's life
+        std::vector<std::pair<std::string, array>> output_name_and_arr_list;
+        std::vector<std::pair<mkldnn::primitive, host_kernel>>
+          host_kernel_list;
+
+        make_sum_net(
+          input_memory_list, input_dims_list, net, temp_variable_memory_list,
+          host_kernel_list, engine,
+          [&](std::vector<int> const& output_dims,
+              mkldnn::memory::primitive_desc const& output_pd,
+              auto op_primitive_generator) {
+              // required output arrays not of 4-D are plain
+              manage_output_memory(
+                required_output_set, output_name, dtype_t::float_,
+                output_dims,
+                output_dims.size() == 4
+                  ? input_origin_format
+                  : get_plain_format(output_dims.size()),
+                output_pd,
+                variable_memory_list, temp_variable_memory_list,
+                output_name_and_arr_list, net, engine, op_primitive_generator);
+          });
+
+        return std::make_tuple(
+          net, variable_memory_list, temp_variable_memory_list,
+          output_name_and_arr_list, std::vector<mkldnn::primitive>(),
+          std::vector<std::pair<std::string, mkldnn::memory>>(),
+          std::vector<std::pair<mkldnn::memory, mkldnn::memory>>(),
+          host_kernel_list);
+    }
+
+} // namespace instant
+
+#endif // INSTANT_OPERATOR_ADD_HPP
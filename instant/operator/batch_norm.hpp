@@ -13,9 +13,9 @@ namespace instant {
                                                  mkldnn::memory::format>> const&
         variable_memory_table,
       std::set<std::string> const& required_output_set,
-      onnx::NodeProto const& node, mkldnn::engine const& engine) {
+      graph_node const& node, mkldnn::engine const& engine) {
 
-        auto attribute_table = instant::make_attribute_table(node);
+        auto const& attribute_table = node.attribute_table;
 
         auto epsilon = load_attribute_float(attribute_table, "epsilon");
         auto is_test =
@@ -105,13 +105,12 @@ namespace instant {
             throw std::runtime_error("var primitive is invalid");
         }
 
-        auto bn_weights_memory = weights_memory;
-        if(mkldnn::memory::primitive_desc(bn_pd.weights_primitive_desc()) !=
-           weights_memory.get_primitive_desc()) {
-            bn_weights_memory = mkldnn::memory(bn_pd.weights_primitive_desc());
-            temp_variable_memory_list.push_back(bn_weights_memory);
-            net.push_back(mkldnn::reorder(weights_memory, bn_weights_memory));
-        }
+        std::vector<mkldnn::primitive> parameter_net;
+        std::vector<std::pair<std::string, mkldnn::memory>>
+          packed_parameter_memory_list;
+        auto bn_weights_memory = manage_parameter_memory(
+          node.input(1), weights_memory, bn_pd.weights_primitive_desc(),
+          parameter_net, packed_parameter_memory_list);
 
         std::vector<std::pair<
           std::string, std::tuple<mkldnn::memory, mkldnn::memory::format>>>
@@ -132,9 +131,12 @@ namespace instant {
                 op_output_memory);
           });
 
-        return std::make_tuple(net, variable_memory_list,
-                               temp_variable_memory_list,
-                               output_name_and_arr_list);
+        return std::make_tuple(
+          net, variable_memory_list, temp_variable_memory_list,
+          output_name_and_arr_list, parameter_net,
+          packed_parameter_memory_list,
+          std::vector<std::pair<mkldnn::memory, mkldnn::memory>>(),
+          std::vector<std::pair<mkldnn::primitive, host_kernel>>());
     }
 
 } // namespace instant
@@ -1,12 +1,15 @@
 #ifndef INSTANT_OPERATOR_COMMON_HPP
 #define INSTANT_OPERATOR_COMMON_HPP
 
+#include <numeric>
 #include <unordered_map>
 
 #include <mkldnn.hpp>
 
 #include <instant/array.hpp>
 #include <instant/context.hpp>
+#include <instant/graph.hpp>
+#include <instant/host_kernel.hpp>
 #include <instant/load_onnx.hpp>
 
 namespace instant {
@@ -79,6 +82,175 @@ namespace instant {
         return attr.f();
     }
 
+    // Makes post-ops from the attributes set by fuse_residual_add and
+    // fuse_post_eltwise. The sum of the residual comes before eltwise ops
+    inline auto make_post_eltwise_attr(
+      std::unordered_map<
+        std::string, std::reference_wrapper<const onnx::AttributeProto>> const&
+        attribute_table) {
+        static const std::unordered_map<std::string, mkldnn::algorithm>
+          eltwise_algorithm_table{
+            {"Relu", mkldnn::algorithm::eltwise_relu},
+            {"LeakyRelu", mkldnn::algorithm::eltwise_relu},
+            {"Elu", mkldnn::algorithm::eltwise_elu}};
+        mkldnn::post_ops ops;
+        if(attribute_table.find("post_sum") != attribute_table.end()) {
+            ops.append_sum(1.f);
+        }
+        if(attribute_table.find("post_eltwise_op_types") !=
+           attribute_table.end()) {
+            onnx::AttributeProto const& op_types_attr =
+              find_value(attribute_table, "post_eltwise_op_types");
+            onnx::AttributeProto const& alphas_attr =
+              find_value(attribute_table, "post_eltwise_alphas");
+            for(int i = 0; i < op_types_attr.strings_size(); ++i) {
+                ops.append_eltwise(
+                  1.f,
+                  find_value(eltwise_algorithm_table, op_types_attr.strings(i)),
+                  alphas_attr.floats(i), 0.f);
+            }
+        }
+        mkldnn::primitive_attr attr;
+        attr.set_post_ops(ops);
+        return attr;
+    }
+
+    // Activation formats the conv tuner chooses from
+    inline auto const& get_tunable_format_table() {
+        static const std::unordered_map<std::string, mkldnn::memory::format>
+          format_table{{"any", mkldnn::memory::format::any},
+                       {"nchw", mkldnn::memory::format::nchw},
+                       {"nhwc", mkldnn::memory::format::nhwc},
+                       {"nChw8c", mkldnn::memory::format::nChw8c},
+                       {"nChw16c", mkldnn::memory::format::nChw16c}};
+        return format_table;
+    }
+
+    // Loads the attributes set by tune_conv: the algorithm and the source
+    // and destination formats of Conv. They are direct and any when the
+    // node is not tuned
+    inline auto load_tuned_conv_attributes(
+      std::unordered_map<
+        std::string, std::reference_wrapper<const onnx::AttributeProto>> const&
+        attribute_table) {
+        if(attribute_table.find("tuned_conv_algorithm") ==
+           attribute_table.end()) {
+            return std::make_tuple(mkldnn::algorithm::convolution_direct,
+                                   mkldnn::memory::format::any,
+                                   mkldnn::memory::format::any);
+        }
+        onnx::AttributeProto const& algorithm_attr =
+          find_value(attribute_table, "tuned_conv_algorithm");
+        onnx::AttributeProto const& src_format_attr =
+          find_value(attribute_table, "tuned_src_format");
+        onnx::AttributeProto const& dst_format_attr =
+          find_value(attribute_table, "tuned_dst_format");
+        return std::make_tuple(
+          algorithm_attr.s() == "winograd"
+            ? mkldnn::algorithm::convolution_winograd
+            : mkldnn::algorithm::convolution_direct,
+          find_value(get_tunable_format_table(), src_format_attr.s()),
+          find_value(get_tunable_format_table(), dst_format_attr.s()));
+    }
+
+    // Loads the attributes set by fuse_residual_add: whether the Conv adds
+    // its residual input (input 3) and whether it may accumulate into the
+    // buffer of the residual
+    inline auto load_post_sum_attributes(
+      std::unordered_map<
+        std::string, std::reference_wrapper<const onnx::AttributeProto>> const&
+        attribute_table) {
+        auto load_flag = [&attribute_table](std::string const& name) {
+            return attribute_table.find(name) != attribute_table.end() &&
+                   load_attribute_int(attribute_table, name) == 1;
+        };
+        return std::make_pair(load_flag("post_sum"),
+                              load_flag("post_sum_in_place"));
+    }
+
+    // Loads the attributes set by plan_in_place_concat: the name of the
+    // Concat output the node writes into, the channel offset of the slice
+    // of the node and the channel nums of all slices. The name is empty
+    // when the node is not planned
+    inline auto load_concat_slice_attributes(
+      std::unordered_map<
+        std::string, std::reference_wrapper<const onnx::AttributeProto>> const&
+        attribute_table) {
+        if(attribute_table.find("concat_output") == attribute_table.end()) {
+            return std::make_tuple(std::string(), 0, std::vector<int>());
+        }
+        onnx::AttributeProto const& output_attr =
+          find_value(attribute_table, "concat_output");
+        return std::make_tuple(
+          output_attr.s(),
+          static_cast<int>(
+            load_attribute_int(attribute_table, "concat_channel_offset")),
+          load_attribute_ints(attribute_table, "concat_channel_nums"));
+    }
+
+    inline auto extract_data_type(mkldnn::memory const& m) {
+        return static_cast<mkldnn::memory::data_type>(
+          m.get_primitive_desc().desc().data.data_type);
+    }
+
+    inline auto extract_format(mkldnn::memory const& m) {
+        return static_cast<mkldnn::memory::format>(
+          m.get_primitive_desc().desc().data.format);
+    }
+
+    // Loads the attributes set by the quantize pass: whether the node runs
+    // in int8, the input scale, the weight scale of each output channel,
+    // the output scale and the output data type
+    inline auto load_quantization_attributes(
+      std::unordered_map<
+        std::string, std::reference_wrapper<const onnx::AttributeProto>> const&
+        attribute_table) {
+        if(attribute_table.find("quantized_input_scale") ==
+           attribute_table.end()) {
+            return std::make_tuple(false, 1.f, std::vector<float>(), 1.f,
+                                   mkldnn::memory::data_type::f32);
+        }
+        onnx::AttributeProto const& weight_scales_attr =
+          find_value(attribute_table, "quantized_weight_scales");
+        onnx::AttributeProto const& output_data_type_attr =
+          find_value(attribute_table, "quantized_output_data_type");
+        return std::make_tuple(
+          true, load_attribute_float(attribute_table, "quantized_input_scale"),
+          std::vector<float>(weight_scales_attr.floats().begin(),
+                             weight_scales_attr.floats().end()),
+          load_attribute_float(attribute_table, "quantized_output_scale"),
+          output_data_type_attr.s() == "u8" ? mkldnn::memory::data_type::u8
+                                            : mkldnn::memory::data_type::f32);
+    }
+
+    // Makes the primitive convert int32 accumulators of int8 inputs and
+    // weights to the output scale (1 for f32 output)
+    inline auto set_quantized_output_scales(
+      mkldnn::primitive_attr& attr, float input_scale,
+      std::vector<float> const& weight_scales, float output_scale) {
+        std::vector<float> scales;
+        for(auto weight_scale : weight_scales) {
+            scales.push_back(output_scale / (input_scale * weight_scale));
+        }
+        attr.set_output_scales(1 << 1, scales); // per output channel
+        attr.set_int_output_round_mode(mkldnn::round_mode::round_nearest);
+    }
+
+    // Reorders input to output multiplying scales. A scale is applied to
+    // each index of the dimensions in mask (all elements when mask is 0)
+    inline auto make_scaled_reorder(mkldnn::memory const& input,
+                                    mkldnn::memory const& output,
+                                    std::vector<float> const& scales,
+                                    int mask = 0) {
+        mkldnn::primitive_attr attr;
+        attr.set_output_scales(mask, scales);
+        attr.set_int_output_round_mode(mkldnn::round_mode::round_nearest);
+        return mkldnn::reorder(
+          mkldnn::reorder::primitive_desc(input.get_primitive_desc(),
+                                          output.get_primitive_desc(), attr),
+          input, output);
+    }
+
     inline auto load_2d_data_processing_attributes(
       std::unordered_map<
         std::string, std::reference_wrapper<const onnx::AttributeProto>> const&
@@ -110,6 +282,156 @@ namespace instant {
         return std::make_tuple(strides, kernel_shape, padding_l, padding_r);
     }
 
+    // "group" of Conv. 1 when it is omitted
+    inline auto load_group(
+      std::unordered_map<
+        std::string, std::reference_wrapper<const onnx::AttributeProto>> const&
+        attribute_table) {
+        if(attribute_table.find("group") == attribute_table.end()) {
+            return 1;
+        }
+        return static_cast<int>(load_attribute_int(attribute_table, "group"));
+    }
+
+    // Output channel num of Conv weight dims, which are goihw when grouped
+    inline auto
+    calc_output_channel_num(mkldnn::memory::dims const& weight_dims) {
+        return weight_dims.size() == 5 ? weight_dims[0] * weight_dims[1]
+                                       : weight_dims[0];
+    }
+
+    // Makes memory without buffer. The buffer is assigned in the arena
+    // planned by make_nets after all primitives are constructed
+    inline auto
+    make_deferred_memory(mkldnn::memory::primitive_desc const& pd) {
+        return mkldnn::memory(pd, nullptr);
+    }
+
+    inline auto is_deferred_memory(mkldnn::memory const& m) {
+        return m.get_data_handle() == nullptr;
+    }
+
+    // Memory of an operand which may be either a variable or a parameter
+    inline auto find_variable_or_parameter_memory(
+      std::unordered_map<std::string, const mkldnn::memory> const&
+        parameter_memory_table,
+      std::unordered_map<std::string, std::tuple<const mkldnn::memory,
+                                                 mkldnn::memory::format>> const&
+        variable_memory_table,
+      std::string const& name) {
+        auto found = variable_memory_table.find(name);
+        if(found != variable_memory_table.end()) {
+            return std::get<0>(found->second);
+        }
+        return find_value(parameter_memory_table, name);
+    }
+
+    // Format of dense row-major memory of the dims
+    inline auto get_plain_format(int ndims) {
+        switch(ndims) {
+        case 1:
+            return mkldnn::memory::format::x;
+        case 2:
+            return mkldnn::memory::format::nc;
+        case 3:
+            return mkldnn::memory::format::tnc;
+        case 4:
+            return mkldnn::memory::format::nchw;
+        default:
+            throw std::runtime_error("Not implemented dims size: " +
+                                     std::to_string(ndims));
+        }
+    }
+
+    // Reorders memory to the plain format of its dims unless it is plain.
+    // Host kernels read plain memories only
+    inline auto
+    make_plain_memory(mkldnn::memory const& memory,
+                      std::vector<mkldnn::primitive>& net,
+                      std::vector<mkldnn::memory>& temp_variable_memory_list,
+                      mkldnn::engine const& engine) {
+        auto dims = extract_dims(memory);
+        auto plain_pd = mkldnn::memory::primitive_desc(
+          {{dims}, extract_data_type(memory), get_plain_format(dims.size())},
+          engine);
+        if(memory.get_primitive_desc() == plain_pd) {
+            return memory;
+        }
+        auto plain_memory = make_deferred_memory(plain_pd);
+        temp_variable_memory_list.push_back(plain_memory);
+        net.push_back(mkldnn::reorder(memory, plain_memory));
+        return plain_memory;
+    }
+
+    // Channels per block of a blocked activation format, or 0
+    inline auto get_channel_block_size(mkldnn::memory::format format) {
+        return format == mkldnn::memory::format::nChw8c
+                 ? 8
+                 : format == mkldnn::memory::format::nChw16c ? 16 : 0;
+    }
+
+    // The Concat output is made in the format the first producer prefers.
+    // A blocked format is kept only when every slice is made of whole
+    // blocks
+    inline auto
+    choose_concat_output_format(mkldnn::memory::format preferred_format,
+                                std::vector<int> const& channel_num_list) {
+        if(preferred_format == mkldnn::memory::format::nchw ||
+           preferred_format == mkldnn::memory::format::nhwc) {
+            return preferred_format;
+        }
+        auto block_size = get_channel_block_size(preferred_format);
+        if(block_size == 0) {
+            return mkldnn::memory::format::nchw;
+        }
+        for(auto channel_num : channel_num_list) {
+            if(channel_num % block_size != 0) {
+                return mkldnn::memory::format::nchw;
+            }
+        }
+        return preferred_format;
+    }
+
+    // Makes the view of the channels [channel_offset, channel_offset +
+    // channel_num) of the Concat output a producer writes into (see
+    // plan_in_place_concat). The first producer makes the deferred memory
+    // of the whole output, which is returned as the second memory; the
+    // others take it from variable_memory_table. The view shares the
+    // buffer of the whole output, so it is returned as its alias
+    inline auto make_concat_slice_memory(
+      std::unordered_map<std::string, std::tuple<const mkldnn::memory,
+                                                 mkldnn::memory::format>> const&
+        variable_memory_table,
+      std::string const& concat_output_name, int channel_offset,
+      std::vector<int> const& channel_num_list,
+      mkldnn::memory::dims const& slice_dims,
+      mkldnn::memory::format preferred_format, mkldnn::engine const& engine) {
+        std::unique_ptr<mkldnn::memory> new_whole_memory_p;
+        auto found = variable_memory_table.find(concat_output_name);
+        if(found == variable_memory_table.end()) {
+            auto whole_dims = slice_dims;
+            whole_dims[1] = std::accumulate(channel_num_list.begin(),
+                                            channel_num_list.end(), 0);
+            new_whole_memory_p =
+              std::make_unique<mkldnn::memory>(make_deferred_memory(
+                {{{whole_dims},
+                  mkldnn::memory::data_type::f32,
+                  choose_concat_output_format(preferred_format,
+                                              channel_num_list)},
+                 engine}));
+        }
+        auto const& whole_memory = new_whole_memory_p
+                                     ? *new_whole_memory_p
+                                     : std::get<0>(found->second);
+        auto view_pd = mkldnn::view::primitive_desc(
+          whole_memory.get_primitive_desc(), slice_dims,
+          {0, channel_offset, 0, 0});
+        auto slice_memory =
+          make_deferred_memory(view_pd.dst_primitive_desc());
+        return std::make_tuple(slice_memory, whole_memory,
+                               new_whole_memory_p != nullptr);
+    }
+
     template <typename OpPrimitiveGenerator>
     auto manage_output_memory(
       std::set<std::string> const& required_output_set,
@@ -138,11 +460,12 @@ namespace instant {
                              output_arr_p->data()));
         }
 
-        auto op_output_memory =
-          output_memory_p ? *output_memory_p : mkldnn::memory(output_pd);
+        auto op_output_memory = output_memory_p
+                                  ? *output_memory_p
+                                  : make_deferred_memory(output_pd);
         if(output_memory_p && mkldnn::memory::primitive_desc(output_pd) !=
                                 output_memory_p->get_primitive_desc()) {
-            op_output_memory = mkldnn::memory(output_pd);
+            op_output_memory = make_deferred_memory(output_pd);
             temp_variable_memory_list.push_back(*output_memory_p);
         }
 
@@ -161,6 +484,36 @@ namespace instant {
         }
     }
 
+    // Parameters are reordered once by parameter_net (executed at model
+    // construction), not by the net executed on every run. Non-empty scales
+    // quantize an f32 parameter (see make_scaled_reorder). A parameter
+    // already quantized by pack_parameters is only reordered, since nets
+    // made again (e.g. for another batch size) see the packed memory
+    inline auto manage_parameter_memory(
+      std::string const& parameter_name,
+      mkldnn::memory const& parameter_memory,
+      mkldnn::memory::primitive_desc const& op_parameter_pd,
+      std::vector<mkldnn::primitive>& parameter_net,
+      std::vector<std::pair<std::string, mkldnn::memory>>&
+        packed_parameter_memory_list,
+      std::vector<float> const& scales = {}, int scale_mask = 0) {
+        if(op_parameter_pd == parameter_memory.get_primitive_desc()) {
+            return parameter_memory;
+        }
+        auto op_parameter_memory = mkldnn::memory(op_parameter_pd);
+        auto is_quantizing = !scales.empty() &&
+                             extract_data_type(parameter_memory) ==
+                               mkldnn::memory::data_type::f32;
+        parameter_net.push_back(
+          !is_quantizing
+            ? mkldnn::reorder(parameter_memory, op_parameter_memory)
+            : make_scaled_reorder(parameter_memory, op_parameter_memory,
+                                  scales, scale_mask));
+        packed_parameter_memory_list.emplace_back(parameter_name,
+                                                  op_parameter_memory);
+        return op_parameter_memory;
+    }
+
     inline auto array_to_memory(array const& arr, mkldnn::memory::format format,
                                 mkldnn::engine const& engine) {
         return mkldnn::memory({{{arr.dims()},
@@ -0,0 +1,98 @@
+#ifndef INSTANT_OPERATOR_CONCAT_HPP
+#define INSTANT_OPERATOR_CONCAT_HPP
+
+#include <instant/operator/common.hpp>
+
+namespace instant {
+
+    inline auto make_concat_primitive(
+      std::unordered_map<std::string, const mkldnn::memory> const&
+      /*parameter_memory_table*/,
+      std::unordered_map<std::string, std::tuple<const mkldnn::memory,
+                                                 mkldnn::memory::format>> const&
+        variable_memory_table,
+      std::set<std::string> const& required_output_set,
+      graph_node const& node, mkldnn::engine const& engine) {
+        auto const& attribute_table = node.attribute_table;
+
+        auto input_origin_format =
+          std::get<1>(find_value(variable_memory_table, node.input(0)));
+
+        auto const& output_name = node.output(0);
+
+        std::vector<mkldnn::primitive> net;
+        std::vector<std::pair<
+          std::string, std::tuple<mkldnn::memory, mkldnn::memory::format>>>
+          variable_memory_list;
+        std::vector<mkldnn::memory>
+          temp_variable_memory_list; // for temporary memory's life
+        std::vector<std::pair<std::string, array>> output_name_and_arr_list;
+
+        // Producers have written their outputs into slices of the output
+        // (see plan_in_place_concat), so nothing is moved. Only a required
+        // output is copied to its own array
+        if(attribute_table.find("concat_in_place") != attribute_table.end()) {
+            auto const& output_memory =
+              std::get<0>(find_value(variable_memory_table, output_name));
+            if(required_output_set.find(output_name) !=
+               required_output_set.end()) {
+                array output_arr(dtype_t::float_, extract_dims(output_memory));
+                auto output_arr_memory =
+                  array_to_memory(output_arr, input_origin_format, engine);
+                net.push_back(
+                  mkldnn::reorder(output_memory, output_arr_memory));
+                temp_variable_memory_list.push_back(output_arr_memory);
+                output_name_and_arr_list.emplace_back(output_name,
+                                                      std::move(output_arr));
+            }
+            return std::make_tuple(
+              net, variable_memory_list, temp_variable_memory_list,
+              output_name_and_arr_list, std::vector<mkldnn::primitive>(),
+              std::vector<std::pair<std::string, mkldnn::memory>>(),
+              std::vector<std::pair<mkldnn::memory, mkldnn::memory>>(),
+              std::vector<std::pair<mkldnn::primitive, host_kernel>>());
+        }
+
+        std::vector<mkldnn::memory::primitive_desc> input_pd_list;
+        std::vector<mkldnn::primitive::at> input_list;
+        std::vector<int> output_dims;
+        int axis = attribute_table.find("axis") == attribute_table.end()
+                     ? 1
+                     : load_attribute_int(attribute_table, "axis");
+        for(auto const& input_name : node.proto->input()) {
+            auto const& input_memory =
+              std::get<0>(find_value(variable_memory_table, input_name));
+            auto input_dims = extract_dims(input_memory);
+            if(output_dims.empty()) {
+                output_dims = input_dims;
+                if(axis < 0) {
+                    axis += input_dims.size();
+                }
+            } else {
+                output_dims.at(axis) += input_dims.at(axis);
+            }
+            input_pd_list.push_back(input_memory.get_primitive_desc());
+            input_list.push_back(input_memory);
+        }
+        auto concat_pd = mkldnn::concat::primitive_desc(axis, input_pd_list);
+
+        manage_output_memory(
+          required_output_set, output_name, dtype_t::float_, output_dims,
+          input_origin_format, concat_pd.dst_primitive_desc(),
+          variable_memory_list, temp_variable_memory_list,
+          output_name_and_arr_list, net, engine,
+          [&input_list, &concat_pd](auto& op_output_memory) {
+              return mkldnn::concat(concat_pd, input_list, op_output_memory);
+          });
+
+        return std::make_tuple(
+          net, variable_memory_list, temp_variable_memory_list,
+          output_name_and_arr_list, std::vector<mkldnn::primitive>(),
+          std::vector<std::pair<std::string, mkldnn::memory>>(),
+          std::vector<std::pair<mkldnn::memory, mkldnn::memory>>(),
+          std::vector<std::pair<mkldnn::primitive, host_kernel>>());
+    }
+
+} // namespace instant
+
+#endif // INSTANT_OPERATOR_CONCAT_HPP
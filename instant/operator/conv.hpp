@@ -12,9 +12,9 @@ namespace instant {
                                                  mkldnn::memory::format>> const&
         variable_memory_table,
       std::set<std::string> const& required_output_set,
-      onnx::NodeProto const& node, mkldnn::engine const& engine) {
+      graph_node const& node, mkldnn::engine const& engine) {
 
-        auto attribute_table = instant::make_attribute_table(node);
+        auto const& attribute_table = node.attribute_table;
 
         auto attributes = load_2d_data_processing_attributes(attribute_table);
         auto const& strides = std::get<0>(attributes);
@@ -31,41 +31,160 @@ namespace instant {
 
         auto input_dims = extract_dims(input_memory);
         auto weight_dims = extract_dims(weight_memory);
-        auto output_dims =
-          make_conv_output_dims(input_dims, weight_dims[0], kernel_shape,
-                                strides, padding_l, padding_r);
+        // weight is goihw for grouped (and depthwise) conv
+        auto output_dims = make_conv_output_dims(
+          input_dims, calc_output_channel_num(weight_dims), kernel_shape,
+          strides, padding_l, padding_r);
 
         auto const& output_name = node.output(0);
 
-        auto conv_input_md =
-          mkldnn::memory::desc({input_dims}, mkldnn::memory::data_type::f32,
-                               mkldnn::memory::format::any);
-        auto conv_weight_md =
-          mkldnn::memory::desc({weight_dims}, mkldnn::memory::data_type::f32,
-                               mkldnn::memory::format::any);
-        auto conv_output_md =
-          mkldnn::memory::desc({output_dims}, mkldnn::memory::data_type::f32,
-                               mkldnn::memory::format::any);
-
-        std::unique_ptr<mkldnn::convolution_forward::desc> conv_desc_p;
-        if(node.input_size() == 2) {
-            conv_desc_p = std::make_unique<mkldnn::convolution_forward::desc>(
-              mkldnn::prop_kind::forward_inference,
-              mkldnn::algorithm::convolution_direct, conv_input_md,
-              conv_weight_md, conv_output_md, strides, padding_l, padding_r,
-              mkldnn::padding_kind::zero);
-        } else {
-            auto const& bias_memory =
-              find_value(parameter_memory_table, node.input(2));
-            conv_desc_p = std::make_unique<mkldnn::convolution_forward::desc>(
-              mkldnn::prop_kind::forward_inference,
-              mkldnn::algorithm::convolution_direct, conv_input_md,
-              conv_weight_md, bias_memory.get_primitive_desc().desc(),
-              conv_output_md, strides, padding_l, padding_r,
-              mkldnn::padding_kind::zero);
+        // int8 conv takes u8 input, s8 weight and s32 bias
+        auto quantization = load_quantization_attributes(attribute_table);
+        auto is_quantized = std::get<0>(quantization);
+        auto input_scale = std::get<1>(quantization);
+        auto const& weight_scales = std::get<2>(quantization);
+        auto output_scale = std::get<3>(quantization);
+        auto output_data_type = std::get<4>(quantization);
+
+        auto tuned = load_tuned_conv_attributes(attribute_table);
+        auto conv_algorithm = std::get<0>(tuned);
+        auto conv_src_format = std::get<1>(tuned);
+        auto conv_dst_format = std::get<2>(tuned);
+
+        auto make_conv_pd = [&](mkldnn::memory::format src_format,
+                                mkldnn::memory::desc const& conv_output_md) {
+            auto conv_input_md = mkldnn::memory::desc(
+              {input_dims},
+              is_quantized ? mkldnn::memory::data_type::u8
+                           : mkldnn::memory::data_type::f32,
+              src_format);
+            auto conv_weight_md = mkldnn::memory::desc(
+              {weight_dims},
+              is_quantized ? mkldnn::memory::data_type::s8
+                           : mkldnn::memory::data_type::f32,
+              mkldnn::memory::format::any);
+
+            std::unique_ptr<mkldnn::convolution_forward::desc> conv_desc_p;
+            if(node.input_size() == 2) {
+                conv_desc_p =
+                  std::make_unique<mkldnn::convolution_forward::desc>(
+                    mkldnn::prop_kind::forward_inference, conv_algorithm,
+                    conv_input_md, conv_weight_md, conv_output_md, strides,
+                    padding_l, padding_r, mkldnn::padding_kind::zero);
+            } else {
+                auto const& bias_memory =
+                  find_value(parameter_memory_table, node.input(2));
+                auto conv_bias_md =
+                  is_quantized
+                    ? mkldnn::memory::desc({extract_dims(bias_memory)},
+                                           mkldnn::memory::data_type::s32,
+                                           mkldnn::memory::format::any)
+                    : bias_memory.get_primitive_desc().desc();
+                conv_desc_p =
+                  std::make_unique<mkldnn::convolution_forward::desc>(
+                    mkldnn::prop_kind::forward_inference, conv_algorithm,
+                    conv_input_md, conv_weight_md, conv_bias_md,
+                    conv_output_md, strides, padding_l, padding_r,
+                    mkldnn::padding_kind::zero);
+            }
+            auto conv_attr = make_post_eltwise_attr(attribute_table);
+            if(is_quantized) {
+                set_quantized_output_scales(conv_attr, input_scale,
+                                            weight_scales, output_scale);
+            }
+            return mkldnn::convolution_forward::primitive_desc(
+              *conv_desc_p, conv_attr, engine);
+        };
+        auto make_output_md = [&](mkldnn::memory::format format) {
+            return mkldnn::memory::desc({output_dims}, output_data_type,
+                                        format);
+        };
+        // Formats chosen by tune_conv or propagate_layouts fall back to any
+        // when no implementation supports them
+        auto conv_pd = [&]() {
+            try {
+                return make_conv_pd(conv_src_format,
+                                    make_output_md(conv_dst_format));
+            } catch(mkldnn::error const&) {
+                if(conv_src_format == mkldnn::memory::format::any &&
+                   conv_dst_format == mkldnn::memory::format::any) {
+                    throw;
+                }
+                conv_src_format = mkldnn::memory::format::any;
+                return make_conv_pd(
+                  conv_src_format,
+                  make_output_md(mkldnn::memory::format::any));
+            }
+        }();
+
+        // Conv fused with the following Add by fuse_residual_add sums the
+        // residual (input 3) into its output. The Conv accumulates into the
+        // buffer of the residual when it is planned so and an
+        // implementation writes the format of the residual. Otherwise the
+        // residual is copied to the output before the Conv runs
+        auto post_sum = load_post_sum_attributes(attribute_table);
+        std::unique_ptr<mkldnn::memory> residual_memory_p;
+        auto is_residual_in_place = false;
+        if(post_sum.first) {
+            residual_memory_p = std::make_unique<mkldnn::memory>(std::get<0>(
+              find_value(variable_memory_table, node.input(3))));
+            if(extract_dims(*residual_memory_p) != output_dims) {
+                throw std::runtime_error(
+                  "Residual dims differ from Conv output dims: " +
+                  node.input(3));
+            }
+            if(post_sum.second && is_deferred_memory(*residual_memory_p) &&
+               required_output_set.find(output_name) ==
+                 required_output_set.end()) {
+                try {
+                    conv_pd = make_conv_pd(
+                      conv_src_format,
+                      residual_memory_p->get_primitive_desc().desc());
+                    is_residual_in_place = true;
+                } catch(mkldnn::error const&) {
+                    // the residual is copied to the output
+                }
+            }
+        }
+
+        std::vector<std::pair<
+          std::string, std::tuple<mkldnn::memory, mkldnn::memory::format>>>
+          variable_memory_list;
+        std::vector<std::pair<mkldnn::memory, mkldnn::memory>>
+          variable_memory_alias_list;
+
+        // Conv planned by plan_in_place_concat writes its output directly
+        // into its slice of the Concat output. When no implementation
+        // writes into the slice, the output is reordered into it
+        auto concat_slice = load_concat_slice_attributes(attribute_table);
+        auto const& concat_output_name = std::get<0>(concat_slice);
+        std::unique_ptr<mkldnn::memory> slice_memory_p;
+        if(!concat_output_name.empty()) {
+            auto slice_and_whole = make_concat_slice_memory(
+              variable_memory_table, concat_output_name,
+              std::get<1>(concat_slice), std::get<2>(concat_slice),
+              output_dims,
+              static_cast<mkldnn::memory::format>(
+                conv_pd.dst_primitive_desc().desc().data.format),
+              engine);
+            slice_memory_p =
+              std::make_unique<mkldnn::memory>(std::get<0>(slice_and_whole));
+            auto const& whole_memory = std::get<1>(slice_and_whole);
+            if(std::get<2>(slice_and_whole)) {
+                variable_memory_list.emplace_back(
+                  concat_output_name,
+                  std::make_tuple(whole_memory, input_origin_format));
+            }
+            variable_memory_alias_list.emplace_back(*slice_memory_p,
+                                                    whole_memory);
+            try {
+                conv_pd = make_conv_pd(
+                  conv_src_format,
+                  slice_memory_p->get_primitive_desc().desc());
+            } catch(mkldnn::error const&) {
+                // the output is reordered into the slice
+            }
         }
-        auto conv_pd =
-          mkldnn::convolution_forward::primitive_desc(*conv_desc_p, engine);
 
         std::vector<mkldnn::primitive> net;
         std::vector<mkldnn::memory>
@@ -74,48 +193,149 @@ namespace instant {
         auto conv_input_memory = input_memory;
         if(mkldnn::memory::primitive_desc(conv_pd.src_primitive_desc()) !=
            input_memory.get_primitive_desc()) {
-            conv_input_memory = mkldnn::memory(conv_pd.src_primitive_desc());
+            conv_input_memory =
+              make_deferred_memory(conv_pd.src_primitive_desc());
             temp_variable_memory_list.push_back(conv_input_memory);
-            net.push_back(mkldnn::reorder(input_memory, conv_input_memory));
+            if(is_quantized && extract_data_type(input_memory) ==
+                                 mkldnn::memory::data_type::f32) {
+                net.push_back(make_scaled_reorder(
+                  input_memory, conv_input_memory, {input_scale}));
+            } else {
+                net.push_back(
+                  mkldnn::reorder(input_memory, conv_input_memory));
+            }
         }
 
-        auto conv_weight_memory = weight_memory;
-        if(mkldnn::memory::primitive_desc(conv_pd.weights_primitive_desc()) !=
-           weight_memory.get_primitive_desc()) {
-            conv_weight_memory =
-              mkldnn::memory(conv_pd.weights_primitive_desc());
-            temp_variable_memory_list.push_back(conv_weight_memory);
-            net.push_back(mkldnn::reorder(weight_memory, conv_weight_memory));
+        std::vector<mkldnn::primitive> parameter_net;
+        std::vector<std::pair<std::string, mkldnn::memory>>
+          packed_parameter_memory_list;
+        auto conv_weight_memory = manage_parameter_memory(
+          node.input(1), weight_memory, conv_pd.weights_primitive_desc(),
+          parameter_net, packed_parameter_memory_list, weight_scales, 1);
+        std::unique_ptr<mkldnn::memory> conv_bias_memory_p;
+        if(node.input_size() != 2) {
+            std::vector<float> bias_scales;
+            for(auto weight_scale : weight_scales) {
+                bias_scales.push_back(input_scale * weight_scale);
+            }
+            conv_bias_memory_p =
+              std::make_unique<mkldnn::memory>(manage_parameter_memory(
+                node.input(2),
+                find_value(parameter_memory_table, node.input(2)),
+                conv_pd.bias_primitive_desc(), parameter_net,
+                packed_parameter_memory_list, bias_scales, 1));
         }
 
-        std::vector<std::pair<
-          std::string, std::tuple<mkldnn::memory, mkldnn::memory::format>>>
-          variable_memory_list;
         std::vector<std::pair<std::string, array>> output_name_and_arr_list;
 
-        manage_output_memory(
-          required_output_set, output_name, dtype_t::float_, output_dims,
-          input_origin_format, conv_pd.dst_primitive_desc(),
-          variable_memory_list, temp_variable_memory_list,
-          output_name_and_arr_list, net, engine,
-          [&conv_input_memory, &conv_weight_memory, &node, &conv_pd,
-           &parameter_memory_table](auto& op_output_memory) {
-              if(node.input_size() == 2) {
-                  return mkldnn::convolution_forward(conv_pd, conv_input_memory,
-                                                     conv_weight_memory,
-                                                     op_output_memory);
-              } else {
-                  auto const& conv_bias_memory =
-                    find_value(parameter_memory_table, node.input(2));
-                  return mkldnn::convolution_forward(
-                    conv_pd, conv_input_memory, conv_weight_memory,
-                    conv_bias_memory, op_output_memory);
-              }
-          });
-
-        return std::make_tuple(net, variable_memory_list,
-                               temp_variable_memory_list,
-                               output_name_and_arr_list);
+        auto make_conv = [&conv_input_memory, &conv_weight_memory,
+                          &conv_bias_memory_p,
+                          &conv_pd](mkldnn::memory const& op_output_memory) {
+            if(!conv_bias_memory_p) {
+                return mkldnn::convolution_forward(conv_pd, conv_input_memory,
+                                                   conv_weight_memory,
+                                                   op_output_memory);
+            } else {
+                return mkldnn::convolution_forward(
+                  conv_pd, conv_input_memory, conv_weight_memory,
+                  *conv_bias_memory_p, op_output_memory);
+            }
+        };
+        if(is_residual_in_place) {
+            net.push_back(make_conv(*residual_memory_p));
+            variable_memory_list.emplace_back(
+              output_name,
+              std::make_tuple(*residual_memory_p, input_origin_format));
+        } else if(slice_memory_p) {
+            if(mkldnn::memory::primitive_desc(conv_pd.dst_primitive_desc()) ==
+               slice_memory_p->get_primitive_desc()) {
+                net.push_back(make_conv(*slice_memory_p));
+            } else {
+                auto op_output_memory =
+                  make_deferred_memory(conv_pd.dst_primitive_desc());
+                temp_variable_memory_list.push_back(op_output_memory);
+                net.push_back(make_conv(op_output_memory));
+                net.push_back(
+                  mkldnn::reorder(op_output_memory, *slice_memory_p));
+            }
+            variable_memory_list.emplace_back(
+              output_name,
+              std::make_tuple(*slice_memory_p, input_origin_format));
+        } else {
+            manage_output_memory(
+              required_output_set, output_name, dtype_t::float_, output_dims,
+              input_origin_format, conv_pd.dst_primitive_desc(),
+              variable_memory_list, temp_variable_memory_list,
+              output_name_and_arr_list, net, engine,
+              [&](mkldnn::memory const& op_output_memory) {
+                  if(residual_memory_p) {
+                      net.push_back(
+                        mkldnn::reorder(*residual_memory_p, op_output_memory));
+                  }
+                  return make_conv(op_output_memory);
+              });
+        }
+
+        return std::make_tuple(
+          net, variable_memory_list, temp_variable_memory_list,
+          output_name_and_arr_list, parameter_net,
+          packed_parameter_memory_list, variable_memory_alias_list,
+          std::vector<std::pair<mkldnn::primitive, host_kernel>>());
+    }
+
+    // Whether an f32 direct implementation of the Conv node takes
+    // src_format and dst_format. make_conv_primitive falls back to any
+    // when none does
+    inline auto supports_conv_format(
+      std::unordered_map<std::string, const mkldnn::memory> const&
+        parameter_memory_table,
+      graph_node const& node, mkldnn::memory::dims const& input_dims,
+      mkldnn::memory::format src_format, mkldnn::memory::format dst_format,
+      mkldnn::engine const& engine) {
+        auto const& attribute_table = node.attribute_table;
+        auto attributes = load_2d_data_processing_attributes(attribute_table);
+        auto const& strides = std::get<0>(attributes);
+        auto const& kernel_shape = std::get<1>(attributes);
+        auto const& padding_l = std::get<2>(attributes);
+        auto const& padding_r = std::get<3>(attributes);
+        auto weight_dims =
+          extract_dims(find_value(parameter_memory_table, node.input(1)));
+        auto output_dims = make_conv_output_dims(
+          input_dims, calc_output_channel_num(weight_dims), kernel_shape,
+          strides, padding_l, padding_r);
+
+        auto f32 = mkldnn::memory::data_type::f32;
+        auto input_md = mkldnn::memory::desc({input_dims}, f32, src_format);
+        auto weight_md = mkldnn::memory::desc({weight_dims}, f32,
+                                              mkldnn::memory::format::any);
+        auto output_md = mkldnn::memory::desc({output_dims}, f32, dst_format);
+        try {
+            std::unique_ptr<mkldnn::convolution_forward::desc> conv_desc_p;
+            if(node.input_size() == 2) {
+                conv_desc_p =
+                  std::make_unique<mkldnn::convolution_forward::desc>(
+                    mkldnn::prop_kind::forward_inference,
+                    mkldnn::algorithm::convolution_direct, input_md,
+                    weight_md, output_md, strides, padding_l, padding_r,
+                    mkldnn::padding_kind::zero);
+            } else {
+                conv_desc_p =
+                  std::make_unique<mkldnn::convolution_forward::desc>(
+                    mkldnn::prop_kind::forward_inference,
+                    mkldnn::algorithm::convolution_direct, input_md,
+                    weight_md,
+                    find_value(parameter_memory_table, node.input(2))
+                      .get_primitive_desc()
+                      .desc(),
+                    output_md, strides, padding_l, padding_r,
+                    mkldnn::padding_kind::zero);
+            }
+            mkldnn::convolution_forward::primitive_desc(
+              *conv_desc_p, make_post_eltwise_attr(attribute_table), engine);
+        } catch(mkldnn::error const&) {
+            return false;
+        }
+        return true;
     }
 
 } // namespace instant
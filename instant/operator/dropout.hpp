@@ -13,7 +13,7 @@ namespace instant {
                                                  mkldnn::memory::format>> const&
         variable_memory_table,
       std::set<std::string> const& required_output_set,
-      onnx::NodeProto const& node, mkldnn::engine const& engine) {
+      graph_node const& node, mkldnn::engine const& engine) {
         return make_nop_primitive(parameter_memory_table, variable_memory_table,
                                   required_output_set, node, engine);
     }
@@ -1,8 +1,15 @@
 #ifndef INSTANT_OPERATOR_ELTWISE_HPP
 #define INSTANT_OPERATOR_ELTWISE_HPP
 
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <numeric>
+
 #include <mkldnn.hpp>
 
+#include <instant/eltwise_kernel.hpp>
 #include <instant/operator/common.hpp>
 
 namespace instant {
@@ -16,7 +23,7 @@ namespace instant {
                                                  mkldnn::memory::format>> const&
         variable_memory_table,
       std::set<std::string> const& required_output_set,
-      onnx::NodeProto const& node, mkldnn::engine const& engine) {
+      graph_node const& node, mkldnn::engine const& engine) {
         auto const& input_memory_and_origin_format =
           find_value(variable_memory_table, node.input(0));
         auto const& input_memory = std::get<0>(input_memory_and_origin_format);
@@ -47,9 +54,211 @@ namespace instant {
                                              op_output_memory);
           });
 
-        return std::make_tuple(net, variable_memory_list,
-                               temp_variable_memory_list,
-                               output_name_and_arr_list);
+        return std::make_tuple(
+          net, variable_memory_list, temp_variable_memory_list,
+          output_name_and_arr_list, std::vector<mkldnn::primitive>(),
+          std::vector<std::pair<std::string, mkldnn::memory>>(),
+          std::vector<std::pair<mkldnn::memory, mkldnn::memory>>(),
+          std::vector<std::pair<mkldnn::primitive, host_kernel>>());
+    }
+
+    // Sets channels padding the last block of a blocked activation to
+    // zero, as MKL-DNN primitives reading it expect
+    inline void zero_channel_padding(float* data, std::vector<int> const& dims,
+                                     int block_size) {
+        auto block_num = (dims[1] + block_size - 1) / block_size;
+        std::size_t spatial_size = dims[2] * dims[3];
+        auto lane_first = dims[1] % block_size;
+        for(int n = 0; n < dims[0]; ++n) {
+            auto last_block_index = n * block_num + block_num - 1;
+            auto* last_block =
+              data + last_block_index * spatial_size * block_size;
+            for(std::size_t i = 0; i < spatial_size; ++i) {
+                std::fill(last_block + i * block_size + lane_first,
+                          last_block + (i + 1) * block_size, 0.f);
+            }
+        }
+    }
+
+    // y = the segments applied to x in order by the eltwise chain kernel of
+    // the running CPU (see get_eltwise_chain_kernel). y is in the format of
+    // input_memory, so blocked x is never reordered. net and
+    // temp_variable_memory_list may have the reorder making input_memory
+    inline auto make_host_eltwise_primitive(
+      std::vector<eltwise_segment> const& segment_list,
+      mkldnn::memory const& input_memory,
+      mkldnn::memory::format input_origin_format,
+      std::vector<mkldnn::primitive> net,
+      std::vector<mkldnn::memory> temp_variable_memory_list,
+      std::set<std::string> const& required_output_set,
+      graph_node const& node, mkldnn::engine const& engine) {
+        auto input_output_dims = extract_dims(input_memory);
+        if(extract_data_type(input_memory) !=
+           mkldnn::memory::data_type::f32) {
+            throw std::runtime_error(node.op_type() +
+                                     " takes f32 input: " + node.input(0));
+        }
+
+        auto const& output_name = node.output(0);
+
+        std::vector<std::pair<
+          std::string, std::tuple<mkldnn::memory, mkldnn::memory::format>>>
+          variable_memory_list;
+        std::vector<std::pair<std::string, array>> output_name_and_arr_list;
+        std::vector<std::pair<mkldnn::primitive, host_kernel>>
+          host_kernel_list;
+
+        auto input_pd = input_memory.get_primitive_desc();
+        manage_output_memory(
+          required_output_set, output_name, dtype_t::float_, input_output_dims,
+          input_origin_format, input_pd, variable_memory_list,
+          temp_variable_memory_list, output_name_and_arr_list, net, engine,
+          [&](auto& op_output_memory) {
+              auto placeholder = make_host_kernel_placeholder(engine);
+              mkldnn::memory x_memory = input_memory;
+              mkldnn::memory y_memory = op_output_memory;
+              auto size = input_pd.get_size() / sizeof(float);
+              auto block_size =
+                get_channel_block_size(extract_format(input_memory));
+              auto is_padded =
+                block_size != 0 && input_output_dims[1] % block_size != 0;
+              auto kernel = get_eltwise_chain_kernel();
+              host_kernel_list.emplace_back(placeholder, [=]() {
+                  auto const* x =
+                    static_cast<float const*>(x_memory.get_data_handle());
+                  auto* y = static_cast<float*>(y_memory.get_data_handle());
+                  // segments after the first one run in place on y
+                  for(auto const& segment : segment_list) {
+                      run_eltwise_kernel(kernel, segment, x, y, size);
+                      x = y;
+                  }
+                  if(is_padded) {
+                      zero_channel_padding(y, input_output_dims, block_size);
+                  }
+              });
+              return placeholder;
+          });
+
+        return std::make_tuple(
+          net, variable_memory_list, temp_variable_memory_list,
+          output_name_and_arr_list, std::vector<mkldnn::primitive>(),
+          std::vector<std::pair<std::string, mkldnn::memory>>(),
+          std::vector<std::pair<mkldnn::memory, mkldnn::memory>>(),
+          host_kernel_list);
+    }
+
+    // y = op_list[n-1](...op_list[0](x)) for operators MKL-DNN has no
+    // primitive for and for fused chains without lane_affine
+    inline auto make_host_eltwise_primitive(
+      std::vector<eltwise_op> const& op_list,
+      std::unordered_map<std::string, const mkldnn::memory> const&
+      /*parameter_memory_table*/,
+      std::unordered_map<std::string, std::tuple<const mkldnn::memory,
+                                                 mkldnn::memory::format>> const&
+        variable_memory_table,
+      std::set<std::string> const& required_output_set,
+      graph_node const& node, mkldnn::engine const& engine) {
+        auto const& input_memory_and_origin_format =
+          find_value(variable_memory_table, node.input(0));
+        auto const& input_memory = std::get<0>(input_memory_and_origin_format);
+        return make_host_eltwise_primitive(
+          {{{op_list},
+            input_memory.get_primitive_desc().get_size() / sizeof(float),
+            16,
+            nullptr}},
+          input_memory, std::get<1>(input_memory_and_origin_format), {}, {},
+          required_output_set, node, engine);
+    }
+
+    // Segment applying op_list to x of dims in memory of size elements.
+    // Its lane_affine operations vary along axis (-1 for none) and
+    // constant_list has their scales and shifts of dims[axis] elements
+    // (empty for the other operations). x is plain, or blocked in channels
+    // of block_size when it is not 0 (then axis is 1). Constants repeated
+    // in lists of a period of 16 elements span each channel (block) of x.
+    // Few elements of a plain axis make the whole x a span instead, with
+    // the constants repeated over their period
+    inline auto make_eltwise_segment(
+      std::vector<eltwise_op> const& op_list, int axis,
+      std::vector<std::pair<std::vector<float>, std::vector<float>>> const&
+        constant_list,
+      std::vector<int> const& dims, int block_size, std::size_t size) {
+        constexpr std::size_t min_period = 16;
+        constexpr std::size_t max_period = 64 * 1024;
+        eltwise_segment segment{
+          {}, size, min_period, std::make_shared<std::vector<float>>()};
+        if(axis == -1) {
+            segment.op_list_list.push_back(op_list);
+            return segment;
+        }
+
+        // index of the constant for the k-th element of a span of group g,
+        // or -1 for a padding channel
+        std::function<int(std::size_t, std::size_t)> index_of;
+        std::size_t group_num = 1;
+        if(block_size != 0) {
+            auto channel_num = dims[1];
+            group_num = (channel_num + block_size - 1) / block_size;
+            segment.span_size =
+              static_cast<std::size_t>(dims[2]) * dims[3] * block_size;
+            index_of = [channel_num, block_size](std::size_t g,
+                                                 std::size_t k) {
+                int c = g * block_size + k % block_size;
+                return c < channel_num ? c : -1;
+            };
+        } else {
+            std::size_t dim = dims[axis];
+            auto inner_size = std::accumulate(
+              dims.begin() + axis + 1, dims.end(), std::size_t(1),
+              std::multiplies<std::size_t>());
+            auto period = dim * inner_size;
+            while(period % min_period != 0) {
+                period += dim * inner_size;
+            }
+            if(inner_size < min_period && period <= max_period) {
+                segment.period = period;
+                index_of = [dim, inner_size](std::size_t, std::size_t k) {
+                    return static_cast<int>(k / inner_size % dim);
+                };
+            } else {
+                group_num = dim;
+                segment.span_size = inner_size;
+                index_of = [](std::size_t g, std::size_t) {
+                    return static_cast<int>(g);
+                };
+            }
+        }
+
+        // lists of lane_affine operations of each group in order
+        auto lane_op_num =
+          std::count_if(op_list.begin(), op_list.end(), [](auto const& op) {
+              return op.kind == eltwise_kind::lane_affine;
+          });
+        auto period = segment.period;
+        auto& list_data = *segment.list_data;
+        list_data.resize(group_num * lane_op_num * 2 * period);
+        for(std::size_t g = 0; g < group_num; ++g) {
+            auto group_op_list = op_list;
+            auto* list = list_data.data() + g * lane_op_num * 2 * period;
+            for(std::size_t j = 0; j < op_list.size(); ++j) {
+                if(op_list[j].kind != eltwise_kind::lane_affine) {
+                    continue;
+                }
+                auto const& constants = constant_list[j];
+                for(std::size_t k = 0; k < period; ++k) {
+                    auto index = index_of(g, k);
+                    list[k] = index == -1 ? 1.f : constants.first[index];
+                    list[period + k] =
+                      index == -1 ? 0.f : constants.second[index];
+                }
+                group_op_list[j].scale_list = list;
+                group_op_list[j].shift_list = list + period;
+                group_op_list[j].period = period;
+                list += 2 * period;
+            }
+            segment.op_list_list.push_back(group_op_list);
+        }
+        return segment;
     }
 
     inline auto make_relu_primitive(
@@ -59,7 +268,7 @@ namespace instant {
                                                  mkldnn::memory::format>> const&
         variable_memory_table,
       std::set<std::string> const& required_output_set,
-      onnx::NodeProto const& node, mkldnn::engine const& engine) {
+      graph_node const& node, mkldnn::engine const& engine) {
         float alpha = 0.;
         float beta = 0.;
         return make_eltwise_primitive<mkldnn::algorithm::eltwise_relu>(
@@ -74,15 +283,14 @@ namespace instant {
                                                  mkldnn::memory::format>> const&
         variable_memory_table,
       std::set<std::string> const& required_output_set,
-      onnx::NodeProto const& node, mkldnn::engine const& engine) {
+      graph_node const& node, mkldnn::engine const& engine) {
         float alpha = 0.;
         float beta = 0.;
-        return make_eltwise_primitive<mkldnn::algorithm::eltwise_relu>(
+        return make_eltwise_primitive<mkldnn::algorithm::eltwise_tanh>(
           alpha, beta, parameter_memory_table, variable_memory_table,
           required_output_set, node, engine);
     }
 
-    /*
     inline auto make_abs_primitive(
       std::unordered_map<std::string, const mkldnn::memory> const&
         parameter_memory_table,
@@ -90,16 +298,128 @@ namespace instant {
                                                  mkldnn::memory::format>> const&
         variable_memory_table,
       std::set<std::string> const& required_output_set,
-      onnx::NodeProto const& node, mkldnn::engine const& engine) {
-        float alpha = 0.;
-        float beta = 0.;
-        return make_eltwise_primitive<mkldnn::algorithm::eltwise_abs>(
-          alpha, beta, parameter_memory_table, variable_memory_table,
-          required_output_set, node, engine);
+      graph_node const& node, mkldnn::engine const& engine) {
+        return make_host_eltwise_primitive(
+          {{eltwise_kind::abs, 0.f, 0.f}},
+          parameter_memory_table, variable_memory_table, required_output_set,
+          node, engine);
+    }
+
+    inline auto make_clip_primitive(
+      std::unordered_map<std::string, const mkldnn::memory> const&
+        parameter_memory_table,
+      std::unordered_map<std::string, std::tuple<const mkldnn::memory,
+                                                 mkldnn::memory::format>> const&
+        variable_memory_table,
+      std::set<std::string> const& required_output_set,
+      graph_node const& node, mkldnn::engine const& engine) {
+        auto const& attribute_table = node.attribute_table;
+        auto load_bound = [&attribute_table](std::string const& name,
+                                             float default_value) {
+            return attribute_table.find(name) == attribute_table.end()
+                     ? default_value
+                     : load_attribute_float(attribute_table, name);
+        };
+        return make_host_eltwise_primitive(
+          {{eltwise_kind::clip,
+            load_bound("min", std::numeric_limits<float>::lowest()),
+            load_bound("max", std::numeric_limits<float>::max())}},
+          parameter_memory_table, variable_memory_table, required_output_set,
+          node, engine);
+    }
+
+    inline auto make_exp_primitive(
+      std::unordered_map<std::string, const mkldnn::memory> const&
+        parameter_memory_table,
+      std::unordered_map<std::string, std::tuple<const mkldnn::memory,
+                                                 mkldnn::memory::format>> const&
+        variable_memory_table,
+      std::set<std::string> const& required_output_set,
+      graph_node const& node, mkldnn::engine const& engine) {
+        return make_host_eltwise_primitive(
+          {{eltwise_kind::exp, 0.f, 0.f}},
+          parameter_memory_table, variable_memory_table, required_output_set,
+          node, engine);
+    }
+
+    inline auto make_hard_sigmoid_primitive(
+      std::unordered_map<std::string, const mkldnn::memory> const&
+        parameter_memory_table,
+      std::unordered_map<std::string, std::tuple<const mkldnn::memory,
+                                                 mkldnn::memory::format>> const&
+        variable_memory_table,
+      std::set<std::string> const& required_output_set,
+      graph_node const& node, mkldnn::engine const& engine) {
+        auto const& attribute_table = node.attribute_table;
+        auto load_coefficient = [&attribute_table](std::string const& name,
+                                                   float default_value) {
+            return attribute_table.find(name) == attribute_table.end()
+                     ? default_value
+                     : load_attribute_float(attribute_table, name);
+        };
+        return make_host_eltwise_primitive(
+          {{eltwise_kind::hard_sigmoid, load_coefficient("alpha", 0.2f),
+            load_coefficient("beta", 0.5f)}},
+          parameter_memory_table, variable_memory_table, required_output_set,
+          node, engine);
+    }
+
+    inline auto make_log_primitive(
+      std::unordered_map<std::string, const mkldnn::memory> const&
+        parameter_memory_table,
+      std::unordered_map<std::string, std::tuple<const mkldnn::memory,
+                                                 mkldnn::memory::format>> const&
+        variable_memory_table,
+      std::set<std::string> const& required_output_set,
+      graph_node const& node, mkldnn::engine const& engine) {
+        return make_host_eltwise_primitive(
+          {{eltwise_kind::log, 0.f, 0.f}},
+          parameter_memory_table, variable_memory_table, required_output_set,
+          node, engine);
+    }
+
+    inline auto make_neg_primitive(
+      std::unordered_map<std::string, const mkldnn::memory> const&
+        parameter_memory_table,
+      std::unordered_map<std::string, std::tuple<const mkldnn::memory,
+                                                 mkldnn::memory::format>> const&
+        variable_memory_table,
+      std::set<std::string> const& required_output_set,
+      graph_node const& node, mkldnn::engine const& engine) {
+        return make_host_eltwise_primitive(
+          {{eltwise_kind::neg, 0.f, 0.f}},
+          parameter_memory_table, variable_memory_table, required_output_set,
+          node, engine);
+    }
+
+    inline auto make_reciprocal_primitive(
+      std::unordered_map<std::string, const mkldnn::memory> const&
+        parameter_memory_table,
+      std::unordered_map<std::string, std::tuple<const mkldnn::memory,
+                                                 mkldnn::memory::format>> const&
+        variable_memory_table,
+      std::set<std::string> const& required_output_set,
+      graph_node const& node, mkldnn::engine const& engine) {
+        return make_host_eltwise_primitive(
+          {{eltwise_kind::reciprocal, 0.f, 0.f}},
+          parameter_memory_table, variable_memory_table, required_output_set,
+          node, engine);
+    }
+
+    inline auto make_sigmoid_primitive(
+      std::unordered_map<std::string, const mkldnn::memory> const&
+        parameter_memory_table,
+      std::unordered_map<std::string, std::tuple<const mkldnn::memory,
+                                                 mkldnn::memory::format>> const&
+        variable_memory_table,
+      std::set<std::string> const& required_output_set,
+      graph_node const& node, mkldnn::engine const& engine) {
+        return make_host_eltwise_primitive(
+          {{eltwise_kind::sigmoid, 0.f, 0.f}},
+          parameter_memory_table, variable_memory_table, required_output_set,
+          node, engine);
     }
-    */
 
-    /*
     inline auto make_sqrt_primitive(
       std::unordered_map<std::string, const mkldnn::memory> const&
         parameter_memory_table,
@@ -107,14 +427,12 @@ namespace instant {
                                                  mkldnn::memory::format>> const&
         variable_memory_table,
       std::set<std::string> const& required_output_set,
-      onnx::NodeProto const& node, mkldnn::engine const& engine) {
-        float alpha = 0.;
-        float beta = 0.;
-        return make_eltwise_primitive<mkldnn::algorithm::eltwise_sqrt>(
-          alpha, beta, parameter_memory_table, variable_memory_table,
-          required_output_set, node, engine);
+      graph_node const& node, mkldnn::engine const& engine) {
+        return make_host_eltwise_primitive(
+          {{eltwise_kind::sqrt, 0.f, 0.f}},
+          parameter_memory_table, variable_memory_table, required_output_set,
+          node, engine);
     }
-    */
 
     inline auto make_leaky_relu_primitive(
       std::unordered_map<std::string, const mkldnn::memory> const&
@@ -123,8 +441,8 @@ namespace instant {
                                                  mkldnn::memory::format>> const&
         variable_memory_table,
       std::set<std::string> const& required_output_set,
-      onnx::NodeProto const& node, mkldnn::engine const& engine) {
-        auto attribute_table = make_attribute_table(node);
+      graph_node const& node, mkldnn::engine const& engine) {
+        auto const& attribute_table = node.attribute_table;
         float alpha = load_attribute_float(attribute_table,
                                            "alpha"); // Coefficient of leakage
         float beta = 0.;
@@ -142,8 +460,8 @@ namespace instant {
                                                  mkldnn::memory::format>> const&
         variable_memory_table,
       std::set<std::string> const& required_output_set,
-      onnx::NodeProto const& node, mkldnn::engine const& engine) {
-        auto attribute_table = make_attribute_table(node);
+      graph_node const& node, mkldnn::engine const& engine) {
+        auto const& attribute_table = node.attribute_table;
         float alpha = load_attribute_float(
           attribute_table,
           "alpha"); // Coefficient of ELU //TODO check default is 1.0
@@ -153,6 +471,129 @@ namespace instant {
           required_output_set, node, engine);
     }
 
+    // Operators fused by fuse_eltwise_chain run in one pass over memory.
+    // "AxisAffine" takes its scales and shifts from parameter inputs, and
+    // operators of it varying along other axes than the previous one start
+    // another pass. Blocked x is reordered to the plain format unless they
+    // vary along channels
+    inline auto make_eltwise_chain_primitive(
+      std::unordered_map<std::string, const mkldnn::memory> const&
+        parameter_memory_table,
+      std::unordered_map<std::string, std::tuple<const mkldnn::memory,
+                                                 mkldnn::memory::format>> const&
+        variable_memory_table,
+      std::set<std::string> const& required_output_set,
+      graph_node const& node, mkldnn::engine const& engine) {
+        static const std::unordered_map<std::string, eltwise_kind> kind_table{
+          {"Abs", eltwise_kind::abs},
+          {"Affine", eltwise_kind::affine},
+          {"AxisAffine", eltwise_kind::lane_affine},
+          {"Clip", eltwise_kind::clip},
+          {"Elu", eltwise_kind::elu},
+          {"Exp", eltwise_kind::exp},
+          {"HardSigmoid", eltwise_kind::hard_sigmoid},
+          {"LeakyRelu", eltwise_kind::leaky_relu},
+          {"Log", eltwise_kind::log},
+          {"Neg", eltwise_kind::neg},
+          {"Reciprocal", eltwise_kind::reciprocal},
+          {"Relu", eltwise_kind::relu},
+          {"Sigmoid", eltwise_kind::sigmoid},
+          {"Sqrt", eltwise_kind::sqrt},
+          {"Tanh", eltwise_kind::tanh}};
+        auto const& attribute_table = node.attribute_table;
+        onnx::AttributeProto const& op_types_attr =
+          find_value(attribute_table, "eltwise_op_types");
+        onnx::AttributeProto const& alphas_attr =
+          find_value(attribute_table, "eltwise_alphas");
+        onnx::AttributeProto const& betas_attr =
+          find_value(attribute_table, "eltwise_betas");
+        std::vector<eltwise_op> op_list;
+        for(int i = 0; i < op_types_attr.strings_size(); ++i) {
+            op_list.push_back({find_value(kind_table, op_types_attr.strings(i)),
+                               alphas_attr.floats(i), betas_attr.floats(i)});
+        }
+        auto is_lane_affine = [](eltwise_op const& op) {
+            return op.kind == eltwise_kind::lane_affine;
+        };
+        if(std::none_of(op_list.begin(), op_list.end(), is_lane_affine)) {
+            return make_host_eltwise_primitive(
+              op_list, parameter_memory_table, variable_memory_table,
+              required_output_set, node, engine);
+        }
+
+        auto const& input_memory_and_origin_format =
+          find_value(variable_memory_table, node.input(0));
+        auto const& input_memory = std::get<0>(input_memory_and_origin_format);
+        auto dims = extract_dims(input_memory);
+        int ndims = dims.size();
+
+        // axes counted from the last one are of numpy broadcasting
+        onnx::AttributeProto const& axes_attr =
+          find_value(attribute_table, "eltwise_axes");
+        std::vector<int> axis_list(op_list.size(), -1);
+        std::vector<std::pair<std::vector<float>, std::vector<float>>>
+          constant_list(op_list.size());
+        auto is_blocked = get_channel_block_size(extract_format(
+                            input_memory)) != 0;
+        for(std::size_t i = 0, input_index = 1; i < op_list.size(); ++i) {
+            if(!is_lane_affine(op_list[i])) {
+                continue;
+            }
+            auto axis = static_cast<int>(axes_attr.ints(i));
+            axis_list[i] = axis < 0 ? ndims + axis : axis;
+            for(auto* constants :
+                {&constant_list[i].first, &constant_list[i].second}) {
+                auto const& memory = find_value(parameter_memory_table,
+                                                node.input(input_index++));
+                auto const* data =
+                  static_cast<float const*>(memory.get_data_handle());
+                constants->assign(data,
+                                 data + calc_total_size(extract_dims(memory)));
+            }
+            if(axis_list[i] < 0 || axis_list[i] >= ndims ||
+               constant_list[i].first.size() != dims[axis_list[i]] ||
+               constant_list[i].second.size() != dims[axis_list[i]]) {
+                throw std::runtime_error(
+                  "Constants do not match the axis of x: " + node.name());
+            }
+            is_blocked = is_blocked && axis_list[i] == 1;
+        }
+
+        std::vector<mkldnn::primitive> net;
+        std::vector<mkldnn::memory>
+          temp_variable_memory_list; // for temporary memory's life
+        auto x_memory =
+          is_blocked ? input_memory
+                     : make_plain_memory(input_memory, net,
+                                         temp_variable_memory_list, engine);
+        auto block_size =
+          is_blocked ? get_channel_block_size(extract_format(x_memory)) : 0;
+        auto size = x_memory.get_primitive_desc().get_size() / sizeof(float);
+
+        std::vector<eltwise_segment> segment_list;
+        std::size_t first = 0;
+        int axis = -1;
+        for(std::size_t i = 0; i <= op_list.size(); ++i) {
+            if(i < op_list.size() &&
+               (axis_list[i] == -1 || axis == -1 || axis_list[i] == axis)) {
+                axis = std::max(axis, axis_list[i]);
+                continue;
+            }
+            segment_list.push_back(make_eltwise_segment(
+              std::vector<eltwise_op>(op_list.begin() + first,
+                                      op_list.begin() + i),
+              axis,
+              std::vector<std::pair<std::vector<float>, std::vector<float>>>(
+                constant_list.begin() + first, constant_list.begin() + i),
+              dims, block_size, size));
+            first = i;
+            axis = i < op_list.size() ? axis_list[i] : -1;
+        }
+        return make_host_eltwise_primitive(
+          segment_list, x_memory, std::get<1>(input_memory_and_origin_format),
+          net, temp_variable_memory_list, required_output_set, node, engine);
+    }
+
 } // namespace instant
 
 #endif // INSTANT_OPERATOR_ELTWISE_HPP
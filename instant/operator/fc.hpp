@@ -12,9 +12,9 @@ namespace instant {
                                                  mkldnn::memory::format>> const&
         variable_memory_table,
       std::set<std::string> const& required_output_set,
-      onnx::NodeProto const& node, mkldnn::engine const& engine) {
+      graph_node const& node, mkldnn::engine const& engine) {
 
-        auto attribute_table = instant::make_attribute_table(node);
+        auto const& attribute_table = node.attribute_table;
 
         auto axis = load_attribute_int(attribute_table, "axis");
         assert(axis == 1);
@@ -36,21 +36,42 @@ namespace instant {
 
         auto const& output_name = node.output(0);
 
-        auto fc_input_md =
-          mkldnn::memory::desc({input_dims}, mkldnn::memory::data_type::f32,
-                               mkldnn::memory::format::any);
-        auto fc_weight_md =
-          mkldnn::memory::desc({weight_dims}, mkldnn::memory::data_type::f32,
-                               mkldnn::memory::format::any);
-        auto fc_output_md =
-          mkldnn::memory::desc({output_dims}, mkldnn::memory::data_type::f32,
-                               mkldnn::memory::format::any);
+        // int8 inner product takes u8 input, s8 weight and s32 bias
+        auto quantization = load_quantization_attributes(attribute_table);
+        auto is_quantized = std::get<0>(quantization);
+        auto input_scale = std::get<1>(quantization);
+        auto const& weight_scales = std::get<2>(quantization);
+        auto output_scale = std::get<3>(quantization);
+        auto output_data_type = std::get<4>(quantization);
+
+        auto fc_input_md = mkldnn::memory::desc(
+          {input_dims},
+          is_quantized ? mkldnn::memory::data_type::u8
+                       : mkldnn::memory::data_type::f32,
+          mkldnn::memory::format::any);
+        auto fc_weight_md = mkldnn::memory::desc(
+          {weight_dims},
+          is_quantized ? mkldnn::memory::data_type::s8
+                       : mkldnn::memory::data_type::f32,
+          mkldnn::memory::format::any);
+        auto fc_bias_md = is_quantized
+                            ? mkldnn::memory::desc(
+                                {bias_dims}, mkldnn::memory::data_type::s32,
+                                mkldnn::memory::format::any)
+                            : bias_memory.get_primitive_desc().desc();
+        auto fc_output_md = mkldnn::memory::desc(
+          {output_dims}, output_data_type, mkldnn::memory::format::any);
 
         mkldnn::inner_product_forward::desc fc_desc(
           mkldnn::prop_kind::forward_inference, fc_input_md, fc_weight_md,
-          bias_memory.get_primitive_desc().desc(), fc_output_md);
-        auto fc_pd =
-          mkldnn::inner_product_forward::primitive_desc(fc_desc, engine);
+          fc_bias_md, fc_output_md);
+        auto fc_attr = make_post_eltwise_attr(attribute_table);
+        if(is_quantized) {
+            set_quantized_output_scales(fc_attr, input_scale, weight_scales,
+                                        output_scale);
+        }
+        auto fc_pd = mkldnn::inner_product_forward::primitive_desc(
+          fc_desc, fc_attr, engine);
 
         std::vector<mkldnn::primitive> net;
         std::vector<mkldnn::memory>
@@ -59,18 +80,31 @@ namespace instant {
         auto fc_input_memory = input_memory;
         if(mkldnn::memory::primitive_desc(fc_pd.src_primitive_desc()) !=
            input_memory.get_primitive_desc()) {
-            fc_input_memory = mkldnn::memory(fc_pd.src_primitive_desc());
+            fc_input_memory =
+              make_deferred_memory(fc_pd.src_primitive_desc());
             temp_variable_memory_list.push_back(fc_input_memory);
-            net.push_back(mkldnn::reorder(input_memory, fc_input_memory));
+            if(is_quantized && extract_data_type(input_memory) ==
+                                 mkldnn::memory::data_type::f32) {
+                net.push_back(make_scaled_reorder(input_memory, fc_input_memory,
+                                                  {input_scale}));
+            } else {
+                net.push_back(mkldnn::reorder(input_memory, fc_input_memory));
+            }
         }
 
-        auto fc_weight_memory = weight_memory;
-        if(mkldnn::memory::primitive_desc(fc_pd.weights_primitive_desc()) !=
-           weight_memory.get_primitive_desc()) {
-            fc_weight_memory = mkldnn::memory(fc_pd.weights_primitive_desc());
-            temp_variable_memory_list.push_back(fc_weight_memory);
-            net.push_back(mkldnn::reorder(weight_memory, fc_weight_memory));
+        std::vector<mkldnn::primitive> parameter_net;
+        std::vector<std::pair<std::string, mkldnn::memory>>
+          packed_parameter_memory_list;
+        auto fc_weight_memory = manage_parameter_memory(
+          node.input(1), weight_memory, fc_pd.weights_primitive_desc(),
+          parameter_net, packed_parameter_memory_list, weight_scales, 1);
+        std::vector<float> bias_scales;
+        for(auto weight_scale : weight_scales) {
+            bias_scales.push_back(input_scale * weight_scale);
         }
+        auto fc_bias_memory = manage_parameter_memory(
+          node.input(2), bias_memory, fc_pd.bias_primitive_desc(),
+          parameter_net, packed_parameter_memory_list, bias_scales, 1);
 
         std::vector<std::pair<
           std::string, std::tuple<mkldnn::memory, mkldnn::memory::format>>>
@@ -82,15 +116,18 @@ namespace instant {
           input_origin_format, fc_pd.dst_primitive_desc(), variable_memory_list,
           temp_variable_memory_list, output_name_and_arr_list, net, engine,
           [&fc_pd, &fc_input_memory, &fc_weight_memory,
-           &bias_memory](auto& op_output_memory) {
+           &fc_bias_memory](auto& op_output_memory) {
               return mkldnn::inner_product_forward(
-                fc_pd, fc_input_memory, fc_weight_memory, bias_memory,
+                fc_pd, fc_input_memory, fc_weight_memory, fc_bias_memory,
                 op_output_memory);
           });
 
-        return std::make_tuple(net, variable_memory_list,
-                               temp_variable_memory_list,
-                               output_name_and_arr_list);
+        return std::make_tuple(
+          net, variable_memory_list, temp_variable_memory_list,
+          output_name_and_arr_list, parameter_net,
+          packed_parameter_memory_list,
+          std::vector<std::pair<mkldnn::memory, mkldnn::memory>>(),
+          std::vector<std::pair<mkldnn::primitive, host_kernel>>());
     }
 
 } // namespace instant
@@ -0,0 +1,521 @@
+#ifndef INSTANT_OPERATOR_GEMM_HPP
+#define INSTANT_OPERATOR_GEMM_HPP
+
+#include <algorithm>
+#include <numeric>
+
+#include <instant/operator/add.hpp>
+#include <instant/operator/common.hpp>
+
+namespace instant {
+
+    // c = alpha * op(a) * op(b) + beta * c of row-major matrices, where
+    // op(a) is m x k, op(b) is k x n and op transposes when trans_* is set
+    inline void sgemm(bool trans_a, bool trans_b, int m, int n, int k,
+                      float alpha, float const* a, int lda, float const* b,
+                      int ldb, float beta, float* c, int ldc) {
+#ifdef MKLDNN_VERSION_MAJOR
+        // MKL-DNN takes column-major matrices, so it computes
+        // c^T = op(b)^T * op(a)^T
+        auto transa = trans_b ? 'T' : 'N';
+        auto transb = trans_a ? 'T' : 'N';
+        mkldnn::error::wrap_c_api(mkldnn_sgemm(&transa, &transb, &n, &m, &k,
+                                               &alpha, b, &ldb, a, &lda, &beta,
+                                               c, &ldc),
+                                  "could not run sgemm");
+#else
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+        for(int i = 0; i < m; ++i) {
+            auto* ci = c + static_cast<std::size_t>(i) * ldc;
+            if(beta == 0.f) {
+                std::fill(ci, ci + n, 0.f);
+            } else if(beta != 1.f) {
+                std::transform(ci, ci + n, ci,
+                               [beta](float v) { return beta * v; });
+            }
+            auto op_a = [&](int p) {
+                return trans_a ? a[static_cast<std::size_t>(p) * lda + i]
+                               : a[static_cast<std::size_t>(i) * lda + p];
+            };
+            if(!trans_b) {
+                for(int p = 0; p < k; ++p) {
+                    auto av = alpha * op_a(p);
+                    auto const* bp = b + static_cast<std::size_t>(p) * ldb;
+                    for(int j = 0; j < n; ++j) {
+                        ci[j] += av * bp[j];
+                    }
+                }
+            } else {
+                for(int j = 0; j < n; ++j) {
+                    auto const* bj = b + static_cast<std::size_t>(j) * ldb;
+                    auto sum = 0.f;
+                    for(int p = 0; p < k; ++p) {
+                        sum += op_a(p) * bj[p];
+                    }
+                    ci[j] += alpha * sum;
+                }
+            }
+        }
+#endif
+    }
+
+    // Constant B of Gemm and MatMul is held as the (N, K) weight of inner
+    // product (see make_parameter_memory_table): io when B is (K, N) and
+    // oi when it is transposed by transB. Its buffer is B as it is
+    inline auto is_inner_product_weight(mkldnn::memory const& m) {
+        auto format = extract_format(m);
+        return format == mkldnn::memory::format::io ||
+               format == mkldnn::memory::format::oi;
+    }
+
+    // output = input * weight^T + bias by the MKL-DNN inner product. input
+    // is (..., K) and weight is (N, K). The leading dims of input are
+    // folded into M and output (..., N) is a view of the (M, N) result.
+    // The weight and the bias are packed once by parameter_net into the
+    // formats the inner product prefers
+    inline auto make_gemm_inner_product(
+      std::unordered_map<std::string, const mkldnn::memory> const&
+        parameter_memory_table,
+      mkldnn::memory const& input_memory, std::string const& weight_name,
+      std::string const& bias_name, // empty for no bias
+      std::set<std::string> const& required_output_set,
+      std::string const& output_name, mkldnn::engine const& engine) {
+        auto const& weight_memory =
+          find_value(parameter_memory_table, weight_name);
+        auto weight_dims = extract_dims(weight_memory);
+        auto output_dims = extract_dims(input_memory);
+        auto k = output_dims.back();
+        output_dims.back() = weight_dims[0];
+        auto is_folded = output_dims.size() != 2;
+        mkldnn::memory::dims input_dims{
+          std::accumulate(output_dims.begin(), output_dims.end() - 1, 1,
+                          std::multiplies<int>()),
+          k};
+        mkldnn::memory::dims ip_output_dims{input_dims[0], weight_dims[0]};
+
+        std::vector<mkldnn::primitive> net;
+        std::vector<mkldnn::memory>
+          temp_variable_memory_list; // for temporary memory's life
+        std::vector<std::pair<mkldnn::memory, mkldnn::memory>>
+          variable_memory_alias_list;
+
+        // input of (M, K) viewing plain input
+        auto ip_input_src_memory = input_memory;
+        if(is_folded) {
+            auto plain_input_memory = make_plain_memory(
+              input_memory, net, temp_variable_memory_list, engine);
+            ip_input_src_memory = mkldnn::memory(
+              {{{input_dims},
+                mkldnn::memory::data_type::f32,
+                mkldnn::memory::format::nc},
+               engine},
+              plain_input_memory.get_data_handle());
+            temp_variable_memory_list.push_back(ip_input_src_memory);
+            variable_memory_alias_list.emplace_back(ip_input_src_memory,
+                                                    plain_input_memory);
+        }
+
+        // output viewed as (..., N) has to be plain
+        auto ip_input_md =
+          mkldnn::memory::desc({input_dims}, mkldnn::memory::data_type::f32,
+                               mkldnn::memory::format::any);
+        auto ip_weight_md =
+          mkldnn::memory::desc({weight_dims}, mkldnn::memory::data_type::f32,
+                               mkldnn::memory::format::any);
+        auto ip_output_md = mkldnn::memory::desc(
+          {ip_output_dims}, mkldnn::memory::data_type::f32,
+          is_folded ? mkldnn::memory::format::nc
+                    : mkldnn::memory::format::any);
+        auto ip_pd = [&]() {
+            if(bias_name.empty()) {
+                return mkldnn::inner_product_forward::primitive_desc(
+                  mkldnn::inner_product_forward::desc(
+                    mkldnn::prop_kind::forward_inference, ip_input_md,
+                    ip_weight_md, ip_output_md),
+                  engine);
+            }
+            return mkldnn::inner_product_forward::primitive_desc(
+              mkldnn::inner_product_forward::desc(
+                mkldnn::prop_kind::forward_inference, ip_input_md,
+                ip_weight_md,
+                find_value(parameter_memory_table, bias_name)
+                  .get_primitive_desc()
+                  .desc(),
+                ip_output_md),
+              engine);
+        }();
+
+        auto ip_input_memory = ip_input_src_memory;
+        if(mkldnn::memory::primitive_desc(ip_pd.src_primitive_desc()) !=
+           ip_input_src_memory.get_primitive_desc()) {
+            ip_input_memory = make_deferred_memory(ip_pd.src_primitive_desc());
+            temp_variable_memory_list.push_back(ip_input_memory);
+            net.push_back(
+              mkldnn::reorder(ip_input_src_memory, ip_input_memory));
+        }
+
+        std::vector<mkldnn::primitive> parameter_net;
+        std::vector<std::pair<std::string, mkldnn::memory>>
+          packed_parameter_memory_list;
+        auto ip_weight_memory = manage_parameter_memory(
+          weight_name, weight_memory, ip_pd.weights_primitive_desc(),
+          parameter_net, packed_parameter_memory_list);
+        std::unique_ptr<mkldnn::memory> ip_bias_memory_p;
+        if(!bias_name.empty()) {
+            ip_bias_memory_p =
+              std::make_unique<mkldnn::memory>(manage_parameter_memory(
+                bias_name, find_value(parameter_memory_table, bias_name),
+                ip_pd.bias_primitive_desc(), parameter_net,
+                packed_parameter_memory_list));
+        }
+
+        std::vector<std::pair<
+          std::string, std::tuple<mkldnn::memory, mkldnn::memory::format>>>
+          variable_memory_list;
+        std::vector<std::pair<std::string, array>> output_name_and_arr_list;
+
+        auto output_format = get_plain_format(output_dims.size());
+        auto output_pd = is_folded
+                           ? mkldnn::memory::primitive_desc(
+                               {{output_dims},
+                                mkldnn::memory::data_type::f32,
+                                output_format},
+                               engine)
+                           : ip_pd.dst_primitive_desc();
+        manage_output_memory(
+          required_output_set, output_name, dtype_t::float_, output_dims,
+          output_format, output_pd, variable_memory_list,
+          temp_variable_memory_list, output_name_and_arr_list, net, engine,
+          [&](auto& op_output_memory) {
+              auto ip_output_memory = op_output_memory;
+              if(is_folded) {
+                  ip_output_memory =
+                    mkldnn::memory(ip_pd.dst_primitive_desc(),
+                                   op_output_memory.get_data_handle());
+                  temp_variable_memory_list.push_back(ip_output_memory);
+                  variable_memory_alias_list.emplace_back(ip_output_memory,
+                                                          op_output_memory);
+              }
+              if(!ip_bias_memory_p) {
+                  return mkldnn::inner_product_forward(
+                    ip_pd, ip_input_memory, ip_weight_memory,
+                    ip_output_memory);
+              }
+              return mkldnn::inner_product_forward(
+                ip_pd, ip_input_memory, ip_weight_memory, *ip_bias_memory_p,
+                ip_output_memory);
+          });
+
+        return std::make_tuple(
+          net, variable_memory_list, temp_variable_memory_list,
+          output_name_and_arr_list, parameter_net,
+          packed_parameter_memory_list, variable_memory_alias_list,
+          std::vector<std::pair<mkldnn::primitive, host_kernel>>());
+    }
+
+    // B of the host kernel as a plain matrix: its memory, whether it is
+    // transposed and its dims (K, N) as op(B). Constant B is taken as it
+    // is (see is_inner_product_weight)
+    inline auto make_plain_b(
+      mkldnn::memory const& b_memory, bool trans_b,
+      std::vector<mkldnn::primitive>& net,
+      std::vector<mkldnn::memory>& temp_variable_memory_list,
+      mkldnn::engine const& engine) {
+        auto b_dims = extract_dims(b_memory);
+        if(is_inner_product_weight(b_memory)) {
+            return std::make_tuple(
+              b_memory,
+              extract_format(b_memory) == mkldnn::memory::format::oi,
+              std::vector<int>{b_dims[1], b_dims[0]});
+        }
+        if(trans_b) {
+            std::swap(b_dims[0], b_dims[1]);
+        }
+        return std::make_tuple(
+          make_plain_memory(b_memory, net, temp_variable_memory_list, engine),
+          trans_b, b_dims);
+    }
+
+    // Y = alpha * op(A) * op(B) + beta * C where C is broadcast to Y.
+    // Constant B with A not transposed, alpha 1 and C of N elements (if
+    // any, with beta 1) runs the inner product with B packed once.
+    // Otherwise sgemm runs as a host kernel on plain A, B and C
+    inline auto make_gemm_primitive(
+      std::unordered_map<std::string, const mkldnn::memory> const&
+        parameter_memory_table,
+      std::unordered_map<std::string, std::tuple<const mkldnn::memory,
+                                                 mkldnn::memory::format>> const&
+        variable_memory_table,
+      std::set<std::string> const& required_output_set,
+      graph_node const& node, mkldnn::engine const& engine) {
+        auto const& attribute_table = node.attribute_table;
+        auto load_flag = [&attribute_table](std::string const& name) {
+            return attribute_table.find(name) != attribute_table.end() &&
+                   load_attribute_int(attribute_table, name) == 1;
+        };
+        auto load_float = [&attribute_table](std::string const& name) {
+            return attribute_table.find(name) == attribute_table.end()
+                     ? 1.f
+                     : load_attribute_float(attribute_table, name);
+        };
+        auto trans_a = load_flag("transA");
+        auto trans_b = load_flag("transB");
+        auto alpha = load_float("alpha");
+        auto beta = load_float("beta");
+
+        auto a_memory = find_variable_or_parameter_memory(
+          parameter_memory_table, variable_memory_table, node.input(0));
+        auto b_memory = find_variable_or_parameter_memory(
+          parameter_memory_table, variable_memory_table, node.input(1));
+        auto a_dims = extract_dims(a_memory);
+        if(a_dims.size() != 2) {
+            throw std::runtime_error("Gemm takes 2-D A: " + node.input(0));
+        }
+        auto has_c =
+          node.input_size() >= 3 && !node.input(2).empty() && beta != 0.f;
+        auto const& output_name = node.output(0);
+
+        // constant B may be already packed
+        auto is_b_constant = variable_memory_table.find(node.input(1)) ==
+                             variable_memory_table.end();
+        if(!trans_a && is_b_constant && alpha == 1.f &&
+           variable_memory_table.find(node.input(0)) !=
+             variable_memory_table.end()) {
+            auto found_c = has_c ? parameter_memory_table.find(node.input(2))
+                                 : parameter_memory_table.end();
+            if(!has_c ||
+               (beta == 1.f && found_c != parameter_memory_table.end() &&
+                extract_dims(found_c->second) ==
+                  std::vector<int>{extract_dims(b_memory)[0]})) {
+                return make_gemm_inner_product(
+                  parameter_memory_table, a_memory, node.input(1),
+                  has_c ? node.input(2) : std::string(), required_output_set,
+                  output_name, engine);
+            }
+        }
+
+        std::vector<mkldnn::primitive> net;
+        std::vector<mkldnn::memory>
+          temp_variable_memory_list; // for temporary memory's life
+        std::vector<std::pair<mkldnn::primitive, host_kernel>>
+          host_kernel_list;
+
+        auto plain_a_memory =
+          make_plain_memory(a_memory, net, temp_variable_memory_list, engine);
+        auto m = trans_a ? a_dims[1] : a_dims[0];
+        auto k = trans_a ? a_dims[0] : a_dims[1];
+        auto plain_b = make_plain_b(b_memory, trans_b, net,
+                                    temp_variable_memory_list, engine);
+        auto const& plain_b_memory = std::get<0>(plain_b);
+        auto is_b_transposed = std::get<1>(plain_b);
+        auto n = std::get<2>(plain_b)[1];
+        if(std::get<2>(plain_b)[0] != k) {
+            throw std::runtime_error("K of A and B differ: " + node.name());
+        }
+        std::vector<int> output_dims{m, n};
+
+        // C is broadcast with the strides of (M, N)
+        std::unique_ptr<mkldnn::memory> plain_c_memory_p;
+        std::vector<int> c_strides;
+        if(has_c) {
+            auto c_memory = find_variable_or_parameter_memory(
+              parameter_memory_table, variable_memory_table, node.input(2));
+            plain_c_memory_p = std::make_unique<mkldnn::memory>(
+              make_plain_memory(c_memory, net, temp_variable_memory_list,
+                                engine));
+            auto c_dims = extract_dims(c_memory);
+            if(calc_broadcast_dims({c_dims, output_dims}) != output_dims) {
+                throw std::runtime_error("C can not be broadcast to Y: " +
+                                         node.input(2));
+            }
+            c_strides = calc_broadcast_strides(c_dims, output_dims);
+        }
+
+        std::vector<std::pair<
+          std::string, std::tuple<mkldnn::memory, mkldnn::memory::format>>>
+          variable_memory_list;
+        std::vector<std::pair<std::string, array>> output_name_and_arr_list;
+        auto output_pd = mkldnn::memory::primitive_desc(
+          {{output_dims},
+           mkldnn::memory::data_type::f32,
+           mkldnn::memory::format::nc},
+          engine);
+        manage_output_memory(
+          required_output_set, output_name, dtype_t::float_, output_dims,
+          mkldnn::memory::format::nc, output_pd, variable_memory_list,
+          temp_variable_memory_list, output_name_and_arr_list, net, engine,
+          [&](auto& op_output_memory) {
+              auto placeholder = make_host_kernel_placeholder(engine);
+              mkldnn::memory output_memory = op_output_memory;
+              auto c_memory_p =
+                plain_c_memory_p
+                  ? std::make_shared<mkldnn::memory>(*plain_c_memory_p)
+                  : nullptr;
+              host_kernel_list.emplace_back(placeholder, [=]() {
+                  auto* y =
+                    static_cast<float*>(output_memory.get_data_handle());
+                  if(c_memory_p) {
+                      auto const* c = static_cast<float const*>(
+                        c_memory_p->get_data_handle());
+                      for(int i = 0; i < m; ++i) {
+                          for(int j = 0; j < n; ++j) {
+                              y[i * n + j] =
+                                beta * c[i * c_strides[0] + j * c_strides[1]];
+                          }
+                      }
+                  }
+                  sgemm(trans_a, is_b_transposed, m, n, k, alpha,
+                        static_cast<float const*>(
+                          plain_a_memory.get_data_handle()),
+                        trans_a ? m : k,
+                        static_cast<float const*>(
+                          plain_b_memory.get_data_handle()),
+                        is_b_transposed ? k : n, c_memory_p ? 1.f : 0.f, y,
+                        n);
+              });
+              return placeholder;
+          });
+
+        return std::make_tuple(
+          net, variable_memory_list, temp_variable_memory_list,
+          output_name_and_arr_list, std::vector<mkldnn::primitive>(),
+          std::vector<std::pair<std::string, mkldnn::memory>>(),
+          std::vector<std::pair<mkldnn::memory, mkldnn::memory>>(),
+          host_kernel_list);
+    }
+
+    // Matrix product of numpy. Matrices are the last 2 dims and the
+    // leading dims are batch dims broadcast to each other. 1-D A (B) is
+    // taken as a row (column) vector and its dim is removed from the
+    // output. Constant 2-D B runs the inner product with B packed once and
+    // the batch dims of A folded into M. Otherwise sgemm runs as a host
+    // kernel for each matrix
+    inline auto make_matmul_primitive(
+      std::unordered_map<std::string, const mkldnn::memory> const&
+        parameter_memory_table,
+      std::unordered_map<std::string, std::tuple<const mkldnn::memory,
+                                                 mkldnn::memory::format>> const&
+        variable_memory_table,
+      std::set<std::string> const& required_output_set,
+      graph_node const& node, mkldnn::engine const& engine) {
+        auto a_memory = find_variable_or_parameter_memory(
+          parameter_memory_table, variable_memory_table, node.input(0));
+        auto b_memory = find_variable_or_parameter_memory(
+          parameter_memory_table, variable_memory_table, node.input(1));
+        auto a_dims = extract_dims(a_memory);
+        auto const& output_name = node.output(0);
+
+        // constant B may be already packed
+        if(a_dims.size() >= 2 &&
+           variable_memory_table.find(node.input(1)) ==
+             variable_memory_table.end() &&
+           extract_dims(b_memory).size() == 2 &&
+           variable_memory_table.find(node.input(0)) !=
+             variable_memory_table.end()) {
+            return make_gemm_inner_product(
+              parameter_memory_table, a_memory, node.input(1), std::string(),
+              required_output_set, output_name, engine);
+        }
+
+        std::vector<mkldnn::primitive> net;
+        std::vector<mkldnn::memory>
+          temp_variable_memory_list; // for temporary memory's life
+        std::vector<std::pair<mkldnn::primitive, host_kernel>>
+          host_kernel_list;
+
+        auto plain_a_memory =
+          make_plain_memory(a_memory, net, temp_variable_memory_list, engine);
+        auto plain_b = make_plain_b(b_memory, false, net,
+                                    temp_variable_memory_list, engine);
+        auto const& plain_b_memory = std::get<0>(plain_b);
+        auto is_b_transposed = std::get<1>(plain_b);
+        auto b_dims = std::get<2>(plain_b);
+
+        // 1-D operands are made 2-D
+        auto is_a_vector = a_dims.size() == 1;
+        auto is_b_vector = b_dims.size() == 1;
+        if(is_a_vector) {
+            a_dims.insert(a_dims.begin(), 1);
+        }
+        if(is_b_vector) {
+            b_dims.push_back(1);
+        }
+        auto m = a_dims[a_dims.size() - 2];
+        auto k = a_dims.back();
+        auto n = b_dims.back();
+        if(b_dims[b_dims.size() - 2] != k) {
+            throw std::runtime_error("K of A and B differ: " + node.name());
+        }
+        std::vector<int> a_batch_dims(a_dims.begin(), a_dims.end() - 2);
+        std::vector<int> b_batch_dims(b_dims.begin(), b_dims.end() - 2);
+        auto batch_dims = calc_broadcast_dims({a_batch_dims, b_batch_dims});
+        auto a_batch_strides = calc_broadcast_strides(a_batch_dims, batch_dims);
+        auto b_batch_strides = calc_broadcast_strides(b_batch_dims, batch_dims);
+        auto batch_size = std::accumulate(batch_dims.begin(), batch_dims.end(),
+                                          1, std::multiplies<int>());
+
+        auto output_dims = batch_dims;
+        if(!is_a_vector) {
+            output_dims.push_back(m);
+        }
+        if(!is_b_vector) {
+            output_dims.push_back(n);
+        }
+        if(output_dims.empty()) {
+            output_dims.push_back(1); // dot product of vectors
+        }
+
+        std::vector<std::pair<
+          std::string, std::tuple<mkldnn::memory, mkldnn::memory::format>>>
+          variable_memory_list;
+        std::vector<std::pair<std::string, array>> output_name_and_arr_list;
+        auto output_format = get_plain_format(output_dims.size());
+        auto output_pd = mkldnn::memory::primitive_desc(
+          {{output_dims}, mkldnn::memory::data_type::f32, output_format},
+          engine);
+        manage_output_memory(
+          required_output_set, output_name, dtype_t::float_, output_dims,
+          output_format, output_pd, variable_memory_list,
+          temp_variable_memory_list, output_name_and_arr_list, net, engine,
+          [&](auto& op_output_memory) {
+              auto placeholder = make_host_kernel_placeholder(engine);
+              mkldnn::memory output_memory = op_output_memory;
+              host_kernel_list.emplace_back(placeholder, [=]() {
+                  auto const* a = static_cast<float const*>(
+                    plain_a_memory.get_data_handle());
+                  auto const* b = static_cast<float const*>(
+                    plain_b_memory.get_data_handle());
+                  auto* y =
+                    static_cast<float*>(output_memory.get_data_handle());
+                  for(int i = 0; i < batch_size; ++i) {
+                      // offsets in matrices
+                      std::size_t a_offset = 0, b_offset = 0;
+                      for(int d = batch_dims.size() - 1, rest = i; d >= 0;
+                          --d) {
+                          auto index = rest % batch_dims[d];
+                          rest /= batch_dims[d];
+                          a_offset += index * a_batch_strides[d];
+                          b_offset += index * b_batch_strides[d];
+                      }
+                      sgemm(false, is_b_transposed, m, n, k, 1.f,
+                            a + a_offset * m * k, k, b + b_offset * k * n,
+                            is_b_transposed ? k : n, 0.f,
+                            y + static_cast<std::size_t>(i) * m * n, n);
+                  }
+              });
+              return placeholder;
+          });
+
+        return std::make_tuple(
+          net, variable_memory_list, temp_variable_memory_list,
+          output_name_and_arr_list, std::vector<mkldnn::primitive>(),
+          std::vector<std::pair<std::string, mkldnn::memory>>(),
+          std::vector<std::pair<mkldnn::memory, mkldnn::memory>>(),
+          host_kernel_list);
+    }
+
+} // namespace instant
+
+#endif // INSTANT_OPERATOR_GEMM_HPP
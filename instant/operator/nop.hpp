@@ -5,6 +5,8 @@
 
 namespace instant {
 
+    // The output aliases the input, so no primitive is made. Only a
+    // required output is copied to its own array
     inline auto make_nop_primitive(
       std::unordered_map<std::string, const mkldnn::memory> const&
       /*parameter_memory_table*/,
@@ -12,7 +14,7 @@ namespace instant {
                                                  mkldnn::memory::format>> const&
         variable_memory_table,
       std::set<std::string> const& required_output_set,
-      onnx::NodeProto const& node, mkldnn::engine const& engine) {
+      graph_node const& node, mkldnn::engine const& engine) {
         auto const& input_memory_and_origin_format =
           find_value(variable_memory_table, node.input(0));
         auto const& input_memory = std::get<0>(input_memory_and_origin_format);
@@ -30,6 +32,19 @@ namespace instant {
 
         std::vector<mkldnn::primitive> net;
 
+        if(required_output_set.find(output_name) ==
+           required_output_set.end()) {
+            variable_memory_list.emplace_back(
+              output_name,
+              std::make_tuple(input_memory, input_origin_format));
+            return std::make_tuple(
+              net, variable_memory_list, temp_variable_memory_list,
+              output_name_and_arr_list, std::vector<mkldnn::primitive>(),
+              std::vector<std::pair<std::string, mkldnn::memory>>(),
+              std::vector<std::pair<mkldnn::memory, mkldnn::memory>>(),
+              std::vector<std::pair<mkldnn::primitive, host_kernel>>());
+        }
+
         manage_output_memory(
           required_output_set, output_name, dtype_t::float_, input_output_dims,
           input_origin_format, input_memory.get_primitive_desc(),
@@ -39,9 +54,12 @@ namespace instant {
               return mkldnn::reorder(input_memory, op_output_memory);
           });
 
-        return std::make_tuple(net, variable_memory_list,
-                               temp_variable_memory_list,
-                               output_name_and_arr_list);
+        return std::make_tuple(
+          net, variable_memory_list, temp_variable_memory_list,
+          output_name_and_arr_list, std::vector<mkldnn::primitive>(),
+          std::vector<std::pair<std::string, mkldnn::memory>>(),
+          std::vector<std::pair<mkldnn::memory, mkldnn::memory>>(),
+          std::vector<std::pair<mkldnn::primitive, host_kernel>>());
     }
 
 } // namespace instant
@@ -60,9 +60,9 @@ namespace instant {
                                                  mkldnn::memory::format>> const&
         variable_memory_table,
       std::set<std::string> const& required_output_set,
-      onnx::NodeProto const& node, mkldnn::engine const& engine) {
+      graph_node const& node, mkldnn::engine const& engine) {
 
-        auto attribute_table = instant::make_attribute_table(node);
+        auto const& attribute_table = node.attribute_table;
 
         auto attributes = load_2d_data_processing_attributes(attribute_table);
         auto const& strides = std::get<0>(attributes);
@@ -90,37 +90,53 @@ namespace instant {
           variable_memory_list;
         std::vector<std::pair<std::string, array>> output_name_and_arr_list;
 
-        auto pool_output_md =
-          mkldnn::memory::desc({output_dims}, mkldnn::memory::data_type::f32,
-                               mkldnn::memory::format::any);
+        // Quantized input (set by the quantize pass) is pooled in int8
+        // with the same scale. int8 pooling is supported only for inference
+        auto data_type = extract_data_type(input_memory);
+        auto is_quantized = data_type != mkldnn::memory::data_type::f32;
+        auto pool_output_md = mkldnn::memory::desc(
+          {output_dims}, data_type, mkldnn::memory::format::any);
 
         auto pool_desc = mkldnn::pooling_forward::desc(
-          mkldnn::prop_kind::forward, pooling_alg,
-          input_memory.get_primitive_desc().desc(), pool_output_md, strides,
-          kernel_shape, padding_l, padding_r, mkldnn::padding_kind::zero);
+          is_quantized ? mkldnn::prop_kind::forward_inference
+                       : mkldnn::prop_kind::forward,
+          pooling_alg, input_memory.get_primitive_desc().desc(),
+          pool_output_md, strides, kernel_shape, padding_l, padding_r,
+          mkldnn::padding_kind::zero);
         auto pool_pd =
           mkldnn::pooling_forward::primitive_desc(pool_desc, engine);
 
         std::vector<mkldnn::primitive> net;
 
-        auto pool_indices_memory =
-          mkldnn::memory(pool_pd.workspace_primitive_desc());
-        temp_variable_memory_list.push_back(pool_indices_memory);
+        std::unique_ptr<mkldnn::memory> pool_indices_memory_p;
+        if(!is_quantized) {
+            pool_indices_memory_p = std::make_unique<mkldnn::memory>(
+              make_deferred_memory(pool_pd.workspace_primitive_desc()));
+            temp_variable_memory_list.push_back(*pool_indices_memory_p);
+        }
 
         manage_output_memory(
           required_output_set, output_name, dtype_t::float_, output_dims,
           input_origin_format, pool_pd.dst_primitive_desc(),
           variable_memory_list, temp_variable_memory_list,
           output_name_and_arr_list, net, engine,
-          [&input_memory, &pool_indices_memory,
+          [&input_memory, &pool_indices_memory_p,
            &pool_pd](auto& op_output_memory) {
-              return mkldnn::pooling_forward(
-                pool_pd, input_memory, op_output_memory, pool_indices_memory);
+              if(!pool_indices_memory_p) {
+                  return mkldnn::pooling_forward(pool_pd, input_memory,
+                                                 op_output_memory);
+              }
+              return mkldnn::pooling_forward(pool_pd, input_memory,
+                                             op_output_memory,
+                                             *pool_indices_memory_p);
           });
 
-        return std::make_tuple(net, variable_memory_list,
-                               temp_variable_memory_list,
-                               output_name_and_arr_list);
+        return std::make_tuple(
+          net, variable_memory_list, temp_variable_memory_list,
+          output_name_and_arr_list, std::vector<mkldnn::primitive>(),
+          std::vector<std::pair<std::string, mkldnn::memory>>(),
+          std::vector<std::pair<mkldnn::memory, mkldnn::memory>>(),
+          std::vector<std::pair<mkldnn::primitive, host_kernel>>());
     }
 
     inline auto make_max_pool_primitive(
@@ -130,7 +146,7 @@ namespace instant {
                                                  mkldnn::memory::format>> const&
         variable_memory_table,
       std::set<std::string> const& required_output_set,
-      onnx::NodeProto const& node, mkldnn::engine const& engine) {
+      graph_node const& node, mkldnn::engine const& engine) {
         return make_pool_primitive<mkldnn::pooling_max>(
           parameter_memory_table, variable_memory_table, required_output_set,
           node, engine);
@@ -143,7 +159,7 @@ namespace instant {
                                                  mkldnn::memory::format>> const&
         variable_memory_table,
       std::set<std::string> const& required_output_set,
-      onnx::NodeProto const& node, mkldnn::engine const& engine) {
+      graph_node const& node, mkldnn::engine const& engine) {
         return make_pool_primitive<
           mkldnn::pooling_avg_include_padding>( // TODO check
           parameter_memory_table, variable_memory_table, required_output_set,
@@ -29,38 +29,47 @@ namespace instant {
         return new_shape;
     }
 
-    inline auto make_reshape_primitive(
-      std::unordered_map<std::string, const mkldnn::memory> const&
-      /*parameter_memory_table*/,
-      std::unordered_map<std::string, std::tuple<const mkldnn::memory,
-                                                 mkldnn::memory::format>> const&
-        variable_memory_table,
-      std::set<std::string> const& /*required_output_set*/,
-      onnx::NodeProto const& node, mkldnn::engine const& engine) {
-        auto attribute_table = instant::make_attribute_table(node);
-        auto shape = load_attribute_ints(attribute_table, "shape");
-
-        auto const& input_memory_and_origin_format =
-          find_value(variable_memory_table, node.input(0));
+    // The output of Reshape and Flatten shares the buffer of the input
+    // (reordered to nchw if needed). The input is aliased as it is when
+    // the dims do not change
+    inline auto make_reshaped_output(
+      std::tuple<const mkldnn::memory, mkldnn::memory::format> const&
+        input_memory_and_origin_format,
+      std::string const& output_name, mkldnn::memory::dims const& output_dims,
+      mkldnn::engine const& engine) {
         auto const& input_memory = std::get<0>(input_memory_and_origin_format);
         auto input_dims = extract_dims(input_memory);
-        shape[0] = input_dims[0];
-        auto output_dims = calc_reshaped_dims(input_dims, shape);
-
-        auto const& output_name = node.output(0);
 
         std::vector<mkldnn::memory>
           temp_variable_memory_list; // for temporary memory's life
 
         std::vector<mkldnn::primitive> net;
 
+        if(output_dims == input_dims) {
+            auto output_name_and_mem_and_origin_format = std::make_pair(
+              output_name,
+              std::make_tuple(input_memory,
+                              std::get<1>(input_memory_and_origin_format)));
+            return std::make_tuple(
+              net,
+              std::vector<decltype(output_name_and_mem_and_origin_format)>{
+                std::move(output_name_and_mem_and_origin_format)},
+              temp_variable_memory_list,
+              std::vector<std::pair<std::string, array>>(),
+              std::vector<mkldnn::primitive>(),
+              std::vector<std::pair<std::string, mkldnn::memory>>(),
+              std::vector<std::pair<mkldnn::memory, mkldnn::memory>>(),
+              std::vector<std::pair<mkldnn::primitive, host_kernel>>());
+        }
+
         auto op_input_memory = input_memory;
         if(input_memory.get_primitive_desc().desc().data.format !=
            mkldnn::memory::format::nchw) {
-            op_input_memory = mkldnn::memory({{{input_dims},
-                                               mkldnn::memory::data_type::f32,
-                                               mkldnn::memory::format::nchw},
-                                              engine});
+            op_input_memory =
+              make_deferred_memory({{{input_dims},
+                                     mkldnn::memory::data_type::f32,
+                                     mkldnn::memory::format::nchw},
+                                    engine});
             temp_variable_memory_list.push_back(op_input_memory);
             net.push_back(mkldnn::reorder(input_memory, op_input_memory));
         }
@@ -72,6 +81,9 @@ namespace instant {
                            mkldnn::memory::format::nc},
                           engine},
                          op_input_memory.get_data_handle());
+        // op_output_memory shares op_input_memory's buffer
+        std::vector<std::pair<mkldnn::memory, mkldnn::memory>>
+          variable_memory_alias_list{{op_output_memory, op_input_memory}};
 
         auto output_name_and_mem_and_origin_format = std::make_pair(
           output_name, std::make_tuple(std::move(op_output_memory),
@@ -81,7 +93,65 @@ namespace instant {
           std::vector<decltype(output_name_and_mem_and_origin_format)>{
             std::move(output_name_and_mem_and_origin_format)},
           temp_variable_memory_list,
-          std::vector<std::pair<std::string, array>>());
+          std::vector<std::pair<std::string, array>>(),
+          std::vector<mkldnn::primitive>(),
+          std::vector<std::pair<std::string, mkldnn::memory>>(),
+          variable_memory_alias_list,
+          std::vector<std::pair<mkldnn::primitive, host_kernel>>());
+    }
+
+    inline auto make_reshape_primitive(
+      std::unordered_map<std::string, const mkldnn::memory> const&
+      /*parameter_memory_table*/,
+      std::unordered_map<std::string, std::tuple<const mkldnn::memory,
+                                                 mkldnn::memory::format>> const&
+        variable_memory_table,
+      std::set<std::string> const& /*required_output_set*/,
+      graph_node const& node, mkldnn::engine const& engine) {
+        auto const& attribute_table = node.attribute_table;
+        auto shape = load_attribute_ints(attribute_table, "shape");
+
+        auto const& input_memory_and_origin_format =
+          find_value(variable_memory_table, node.input(0));
+        auto input_dims =
+          extract_dims(std::get<0>(input_memory_and_origin_format));
+        shape[0] = input_dims[0];
+        return make_reshaped_output(input_memory_and_origin_format,
+                                    node.output(0),
+                                    calc_reshaped_dims(input_dims, shape),
+                                    engine);
+    }
+
+    // Flattens dims before and after axis (1 by default) into 2D
+    inline auto make_flatten_primitive(
+      std::unordered_map<std::string, const mkldnn::memory> const&
+      /*parameter_memory_table*/,
+      std::unordered_map<std::string, std::tuple<const mkldnn::memory,
+                                                 mkldnn::memory::format>> const&
+        variable_memory_table,
+      std::set<std::string> const& /*required_output_set*/,
+      graph_node const& node, mkldnn::engine const& engine) {
+        auto const& attribute_table = node.attribute_table;
+        auto axis = attribute_table.find("axis") == attribute_table.end()
+                      ? 1
+                      : static_cast<int>(
+                          load_attribute_int(attribute_table, "axis"));
+
+        auto const& input_memory_and_origin_format =
+          find_value(variable_memory_table, node.input(0));
+        auto input_dims =
+          extract_dims(std::get<0>(input_memory_and_origin_format));
+        if(axis < 0 || axis > static_cast<int>(input_dims.size())) {
+            throw std::runtime_error("invalid axis of Flatten: " +
+                                     node.output(0));
+        }
+        mkldnn::memory::dims output_dims{
+          calc_total_size(mkldnn::memory::dims(input_dims.begin(),
+                                               input_dims.begin() + axis)),
+          calc_total_size(mkldnn::memory::dims(input_dims.begin() + axis,
+                                               input_dims.end()))};
+        return make_reshaped_output(input_memory_and_origin_format,
+                                    node.output(0), output_dims, engine);
     }
 
 } // namespace instant
@@ -0,0 +1,16 @@
+#ifndef INSTANT_PASS_HPP
+#define INSTANT_PASS_HPP
+
+#include <instant/pass/eliminate_dead_nodes.hpp>
+#include <instant/pass/eliminate_identity_nodes.hpp>
+#include <instant/pass/fold_batch_norm.hpp>
+#include <instant/pass/fuse_eltwise_chain.hpp>
+#include <instant/pass/fuse_post_eltwise.hpp>
+#include <instant/pass/fuse_residual_add.hpp>
+#include <instant/pass/plan_in_place_concat.hpp>
+#include <instant/pass/propagate_layouts.hpp>
+#include <instant/pass/quantize.hpp>
+
+namespace instant {} // namespace instant
+
+#endif // INSTANT_PASS_HPP
@@ -0,0 +1,90 @@
+#ifndef INSTANT_PASS_ELIMINATE_DEAD_NODES_HPP
+#define INSTANT_PASS_ELIMINATE_DEAD_NODES_HPP
+
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <instant/array.hpp>
+#include <instant/graph.hpp>
+#include <instant/onnx.pb.h>
+
+namespace instant {
+
+    // Removes nodes no required output depends on (e.g. the classifier
+    // after the feature layer taken from a classification model), together
+    // with initializers, inputs and outputs of the graph used only by them.
+    // Throws when the graph has no tensor of a required output name, since
+    // all nodes would be removed. Returns the number of removed nodes
+    inline auto
+    eliminate_dead_nodes(graph_ir& ir,
+                         std::set<std::string> const& required_output_set) {
+        for(auto const& name : required_output_set) {
+            if(ir.find_tensor_id(name) == -1) {
+                throw std::runtime_error("Required output not found: " +
+                                         name);
+            }
+        }
+        std::vector<bool> is_live_node_list(ir.node_num(), false);
+        auto is_live_tensor_list = make_tensor_id_set(ir, required_output_set);
+        // nodes are topologically sorted, so one backward sweep is enough
+        for(int i = ir.node_num() - 1; i >= 0; --i) {
+            auto const& node = ir.node(i);
+            for(auto output_id : node.output_id_list) {
+                if(is_live_tensor_list[output_id]) {
+                    is_live_node_list[i] = true;
+                }
+            }
+            if(!is_live_node_list[i]) {
+                continue;
+            }
+            for(auto input_id : node.input_id_list) {
+                is_live_tensor_list[input_id] = true;
+            }
+        }
+        std::vector<bool> is_dead_node_list;
+        for(auto is_live : is_live_node_list) {
+            is_dead_node_list.push_back(!is_live);
+        }
+        auto removed_node_num = ir.remove_nodes(is_dead_node_list);
+        ir.retain_graph_values(is_live_tensor_list);
+        return removed_node_num;
+    }
+
+    // Also releases parameters no remaining node uses, so they are never
+    // converted to memories or packed
+    inline auto eliminate_dead_nodes(
+      graph_ir& ir, std::unordered_map<std::string, array>& parameter_table,
+      std::set<std::string> const& required_output_set) {
+        auto removed_node_num = eliminate_dead_nodes(ir, required_output_set);
+        for(auto it = parameter_table.begin(); it != parameter_table.end();) {
+            auto id = ir.find_tensor_id(it->first);
+            if(id == -1 || ir.consumer_list(id).empty()) {
+                it = parameter_table.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        return removed_node_num;
+    }
+
+    inline auto
+    eliminate_dead_nodes(onnx::GraphProto& graph,
+                         std::set<std::string> const& required_output_set) {
+        graph_ir ir(graph);
+        return eliminate_dead_nodes(ir, required_output_set);
+    }
+
+    inline auto eliminate_dead_nodes(
+      onnx::GraphProto& graph,
+      std::unordered_map<std::string, array>& parameter_table,
+      std::set<std::string> const& required_output_set) {
+        graph_ir ir(graph);
+        return eliminate_dead_nodes(ir, parameter_table, required_output_set);
+    }
+
+} // namespace instant
+
+#endif // INSTANT_PASS_ELIMINATE_DEAD_NODES_HPP
@@ -0,0 +1,112 @@
+#ifndef INSTANT_PASS_ELIMINATE_IDENTITY_NODES_HPP
+#define INSTANT_PASS_ELIMINATE_IDENTITY_NODES_HPP
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <instant/graph.hpp>
+#include <instant/onnx.pb.h>
+
+namespace instant {
+
+    // Reshape and Flatten change nothing when their output dims are the
+    // ones of the input. Dims are known only when they are declared in the
+    // graph (see graph_ir::dims). Reshape takes the batch size from its
+    // input (see make_reshape_primitive)
+    inline auto is_noop_reshape(graph_ir const& ir, graph_node const& node) {
+        auto const& input_dims = ir.dims(node.input_id_list[0]);
+        if(input_dims.empty()) {
+            return false;
+        }
+        auto const& output_dims = ir.dims(node.output_id_list[0]);
+        if(!output_dims.empty()) {
+            return output_dims == input_dims;
+        }
+        if(node.op_type() == "Flatten") {
+            auto found = node.attribute_table.find("axis");
+            auto axis = found == node.attribute_table.end()
+                          ? 1
+                          : static_cast<int>(found->second.get().i());
+            return input_dims.size() == 2 && axis == 1;
+        }
+        auto found = node.attribute_table.find("shape");
+        if(found == node.attribute_table.end()) {
+            return false;
+        }
+        auto const& shape = found->second.get().ints();
+        if(shape.size() != static_cast<int>(input_dims.size()) ||
+           std::count(shape.begin(), shape.end(), -1) > 1) {
+            return false;
+        }
+        // one -1 is the input dim when all the others are
+        for(int i = 1; i < shape.size(); ++i) {
+            if(shape.Get(i) != input_dims[i] && shape.Get(i) != 0 &&
+               shape.Get(i) != -1) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Removes Dropout (inference), Identity and no-op Reshape and Flatten
+    // nodes. Their consumers take the input of the removed node instead, so
+    // neither a primitive nor a buffer is made for them. A node whose
+    // output is required or a graph output is kept; its factory copies
+    // the input to the output array. Returns the number of removed nodes
+    inline auto
+    eliminate_identity_nodes(graph_ir& ir,
+                             std::set<std::string> const& required_output_set) {
+        auto is_required_output_list =
+          make_tensor_id_set(ir, required_output_set);
+        std::vector<bool> is_removed_list(ir.node_num(), false);
+        for(int i = 0; i < ir.node_num(); ++i) {
+            auto const& node = ir.node(i);
+            auto const& op_type = node.op_type();
+            auto is_identity = false;
+            if(op_type == "Dropout") {
+                // the mask output can not be removed
+                is_identity =
+                  node.output_id_list.size() == 1 ||
+                  (ir.consumer_list(node.output_id_list[1]).empty() &&
+                   !ir.is_graph_output(node.output_id_list[1]) &&
+                   !is_required_output_list[node.output_id_list[1]]);
+            } else if(op_type == "Identity") {
+                is_identity = true;
+            } else if(op_type == "Reshape" || op_type == "Flatten") {
+                is_identity = is_noop_reshape(ir, node);
+            }
+            auto output_id = node.output_id_list[0];
+            is_removed_list[i] = is_identity &&
+                                 !is_required_output_list[output_id] &&
+                                 !ir.is_graph_output(output_id);
+        }
+
+        // consumers of removed nodes are rewired to their sources
+        std::vector<int> source_id_list(ir.tensor_num(), -1);
+        for(int i = 0; i < ir.node_num(); ++i) {
+            for(int j = 0; j < ir.node(i).input_size(); ++j) {
+                auto source_id = source_id_list[ir.node(i).input_id_list[j]];
+                if(source_id != -1) {
+                    ir.set_input(i, j, source_id);
+                }
+            }
+            if(is_removed_list[i]) {
+                source_id_list[ir.node(i).output_id_list[0]] =
+                  ir.node(i).input_id_list[0];
+            }
+        }
+        return ir.remove_nodes(is_removed_list);
+    }
+
+    inline auto
+    eliminate_identity_nodes(onnx::GraphProto& graph,
+                             std::set<std::string> const& required_output_set) {
+        graph_ir ir(graph);
+        return eliminate_identity_nodes(ir, required_output_set);
+    }
+
+} // namespace instant
+
+#endif // INSTANT_PASS_ELIMINATE_IDENTITY_NODES_HPP
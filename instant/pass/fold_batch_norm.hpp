@@ -0,0 +1,171 @@
+#ifndef INSTANT_PASS_FOLD_BATCH_NORM_HPP
+#define INSTANT_PASS_FOLD_BATCH_NORM_HPP
+
+#include <cmath>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+#include <instant/array.hpp>
+#include <instant/graph.hpp>
+#include <instant/onnx.pb.h>
+
+namespace instant {
+
+    // Folds BatchNormalization (inference, spatial) into the preceding Conv
+    //   w' = w * scale / sqrt(var + epsilon)
+    //   b' = (b - mean) * scale / sqrt(var + epsilon) + B
+    // The folded weight and bias are added to parameter_table and graph
+    // initializers with new names (see add_parameter; a bias is synthesized
+    // if the Conv has none) and the BatchNormalization node is dropped.
+    // Parameters no longer used by any node are released together with
+    // their initializers and graph inputs.
+    // The Conv output is folded only when the BatchNormalization node is its
+    // sole consumer and it is not a required output
+    inline auto
+    fold_batch_norm(onnx::GraphProto& graph,
+                    std::unordered_map<std::string, array>& parameter_table,
+                    std::set<std::string> const& required_output_set) {
+        std::unordered_map<std::string, int> consumer_count_table;
+        std::unordered_map<std::string, int> producer_index_table;
+        for(int i = 0; i < graph.node_size(); ++i) {
+            for(auto const& input_name : graph.node(i).input()) {
+                ++consumer_count_table[input_name];
+            }
+            for(auto const& output_name : graph.node(i).output()) {
+                producer_index_table[output_name] = i;
+            }
+        }
+        for(auto const& output : graph.output()) {
+            ++consumer_count_table[output.name()];
+        }
+        auto is_parameter = [&parameter_table](std::string const& name) {
+            return parameter_table.find(name) != parameter_table.end();
+        };
+
+        std::set<int> folded_index_set;
+        for(int i = 0; i < graph.node_size(); ++i) {
+            auto const& bn_node = graph.node(i);
+            if(bn_node.op_type() != "BatchNormalization" ||
+               bn_node.output_size() != 1) {
+                continue;
+            }
+            auto epsilon = 1e-5f;
+            auto is_foldable = true;
+            for(auto const& attr : bn_node.attribute()) {
+                if(attr.name() == "epsilon") {
+                    epsilon = attr.f();
+                } else if((attr.name() == "is_test" ||
+                           attr.name() == "spatial") &&
+                          attr.i() != 1) {
+                    is_foldable = false;
+                }
+            }
+            auto const& conv_output_name = bn_node.input(0);
+            auto producer = producer_index_table.find(conv_output_name);
+            if(!is_foldable || producer == producer_index_table.end() ||
+               consumer_count_table[conv_output_name] != 1 ||
+               required_output_set.find(conv_output_name) !=
+                 required_output_set.end()) {
+                continue;
+            }
+            auto& conv_node = *graph.mutable_node(producer->second);
+            if(conv_node.op_type() != "Conv") {
+                continue;
+            }
+            if(!std::all_of(conv_node.input().begin() + 1,
+                            conv_node.input().end(), is_parameter) ||
+               !std::all_of(bn_node.input().begin() + 1, bn_node.input().end(),
+                            is_parameter)) {
+                continue;
+            }
+
+            auto const& weight = parameter_table.at(conv_node.input(1));
+            auto const& scale = parameter_table.at(bn_node.input(1));
+            auto const& b = parameter_table.at(bn_node.input(2));
+            auto const& mean = parameter_table.at(bn_node.input(3));
+            auto const& var = parameter_table.at(bn_node.input(4));
+            auto output_channel_num = weight.dims()[0];
+            auto weight_size_per_channel =
+              total_size(weight) / output_channel_num;
+
+            array folded_weight(dtype_t::float_, weight.dims());
+            array folded_bias =
+              conv_node.input_size() == 3
+                ? array(dtype_t::float_, {output_channel_num})
+                : zeros(dtype_t::float_, {output_channel_num});
+            if(conv_node.input_size() == 3) {
+                auto const& bias = parameter_table.at(conv_node.input(2));
+                std::copy(fbegin(bias), fend(bias), fbegin(folded_bias));
+            }
+            for(int o = 0; o < output_channel_num; ++o) {
+                auto factor = fat(scale, o) / std::sqrt(fat(var, o) + epsilon);
+                auto first = fbegin(weight) + o * weight_size_per_channel;
+                std::transform(first, first + weight_size_per_channel,
+                               fbegin(folded_weight) +
+                                 o * weight_size_per_channel,
+                               [factor](float w) { return w * factor; });
+                fat(folded_bias, o) =
+                  (fat(folded_bias, o) - fat(mean, o)) * factor + fat(b, o);
+            }
+
+            auto const& output_name = bn_node.output(0);
+            auto folded_weight_name =
+              add_parameter(graph, parameter_table,
+                            output_name + "_folded_weight", folded_weight);
+            auto folded_bias_name = add_parameter(
+              graph, parameter_table, output_name + "_folded_bias",
+              folded_bias);
+            for(auto const& input_name : bn_node.input()) {
+                --consumer_count_table[input_name];
+            }
+            for(int j = 1; j < conv_node.input_size(); ++j) {
+                --consumer_count_table[conv_node.input(j)];
+            }
+            conv_node.set_input(1, folded_weight_name);
+            if(conv_node.input_size() == 3) {
+                conv_node.set_input(2, folded_bias_name);
+            } else {
+                conv_node.add_input(folded_bias_name);
+            }
+            conv_node.set_output(0, output_name);
+            folded_index_set.insert(i);
+        }
+
+        std::set<std::string> released_name_set;
+        for(auto const& name_and_count : consumer_count_table) {
+            if(name_and_count.second == 0 &&
+               is_parameter(name_and_count.first)) {
+                parameter_table.erase(name_and_count.first);
+                released_name_set.insert(name_and_count.first);
+            }
+        }
+        auto is_released = [&released_name_set](std::string const& name) {
+            return released_name_set.find(name) != released_name_set.end();
+        };
+        google::protobuf::RepeatedPtrField<onnx::TensorProto> initializer_list;
+        for(auto& initializer : *graph.mutable_initializer()) {
+            if(!is_released(initializer.name())) {
+                initializer_list.Add()->Swap(&initializer);
+            }
+        }
+        graph.mutable_initializer()->Swap(&initializer_list);
+        google::protobuf::RepeatedPtrField<onnx::ValueInfoProto> input_list;
+        for(auto& input : *graph.mutable_input()) {
+            if(!is_released(input.name())) {
+                input_list.Add()->Swap(&input);
+            }
+        }
+        graph.mutable_input()->Swap(&input_list);
+        google::protobuf::RepeatedPtrField<onnx::NodeProto> node_list;
+        for(int i = 0; i < graph.node_size(); ++i) {
+            if(folded_index_set.find(i) == folded_index_set.end()) {
+                node_list.Add()->Swap(graph.mutable_node(i));
+            }
+        }
+        graph.mutable_node()->Swap(&node_list);
+    }
+
+} // namespace instant
+
+#endif // INSTANT_PASS_FOLD_BATCH_NORM_HPP
@@ -0,0 +1,346 @@
+#ifndef INSTANT_PASS_FUSE_ELTWISE_CHAIN_HPP
+#define INSTANT_PASS_FUSE_ELTWISE_CHAIN_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <instant/array.hpp>
+#include <instant/graph.hpp>
+#include <instant/onnx.pb.h>
+
+namespace instant {
+
+    // Attributes taken as (alpha, beta) of each chainable operator (see
+    // eltwise_op) with their ONNX defaults
+    inline auto const& eltwise_chain_attribute_table() {
+        static const std::unordered_map<
+          std::string, std::vector<std::pair<std::string, float>>>
+          table{{"Abs", {}},
+                {"Clip",
+                 {{"min", std::numeric_limits<float>::lowest()},
+                  {"max", std::numeric_limits<float>::max()}}},
+                {"Elu", {{"alpha", 1.f}}},
+                {"Exp", {}},
+                {"HardSigmoid", {{"alpha", 0.2f}, {"beta", 0.5f}}},
+                {"LeakyRelu", {{"alpha", 0.01f}}},
+                {"Log", {}},
+                {"Neg", {}},
+                {"Reciprocal", {}},
+                {"Relu", {}},
+                {"Sigmoid", {}},
+                {"Sqrt", {}},
+                {"Tanh", {}}};
+        return table;
+    }
+
+    // y = scale * x + shift of Add and Mul of x and constant_id or of
+    // inference BatchNormalization as (scale, shift, axis). Scale and shift
+    // are of one element when axis is 0, or of the elements of the constant
+    // (channels) along axis, which counts from the last one when negative
+    inline auto make_affine_step(
+      graph_ir const& ir,
+      std::unordered_map<std::string, array> const& parameter_table,
+      graph_node const& node, int constant_id) {
+        if(node.op_type() == "BatchNormalization") {
+            auto epsilon = 1e-5f;
+            auto found = node.attribute_table.find("epsilon");
+            if(found != node.attribute_table.end()) {
+                epsilon = found->second.get().f();
+            }
+            auto const& scale = parameter_table.at(node.input(1));
+            auto const& b = parameter_table.at(node.input(2));
+            auto const& mean = parameter_table.at(node.input(3));
+            auto const& var = parameter_table.at(node.input(4));
+            auto channel_num = static_cast<int>(total_size(scale));
+            array folded_scale(dtype_t::float_, {channel_num});
+            array folded_shift(dtype_t::float_, {channel_num});
+            for(int c = 0; c < channel_num; ++c) {
+                fat(folded_scale, c) =
+                  fat(scale, c) / std::sqrt(fat(var, c) + epsilon);
+                fat(folded_shift, c) =
+                  fat(b, c) - fat(mean, c) * fat(folded_scale, c);
+            }
+            return std::make_tuple(folded_scale, folded_shift, 1);
+        }
+
+        auto const& constant =
+          parameter_table.at(ir.tensor_name(constant_id));
+        auto const& dims = constant.dims();
+        auto found = std::find_if(dims.begin(), dims.end(),
+                                  [](int d) { return d != 1; });
+        auto axis = found == dims.end()
+                      ? 0
+                      : static_cast<int>(found - dims.end());
+        auto size = static_cast<int>(total_size(constant));
+        array one_list(dtype_t::float_, {size});
+        std::fill(fbegin(one_list), fend(one_list), 1.f);
+        auto value_list = zeros(dtype_t::float_, {size});
+        std::copy(fbegin(constant), fend(constant), fbegin(value_list));
+        if(node.op_type() == "Mul") {
+            return std::make_tuple(value_list,
+                                   zeros(dtype_t::float_, {size}), axis);
+        }
+        return std::make_tuple(one_list, value_list, axis);
+    }
+
+    // Collapses each maximal chain of two or more element-wise nodes into
+    // an "EltwiseChain" node, which applies all of them in one pass over
+    // memory (see make_eltwise_chain_primitive). The first node of a chain
+    // becomes the fused node: it takes over the output of the last one and
+    // records the operators in "eltwise_op_types", "eltwise_alphas",
+    // "eltwise_betas" and "eltwise_axes" attributes. Add and Mul of x and
+    // a constant and inference BatchNormalization are chained as
+    // y = scale * x + shift: "Affine" of a scalar constant keeps scale and
+    // shift as its alpha and beta. "AxisAffine" of a constant varying along
+    // one axis of x (the channels of BatchNormalization) takes them as
+    // parameter inputs of the fused node (see add_parameter). Its axis
+    // counts from the last one when negative, as numpy broadcasting aligns
+    // the constant. Parameters no node uses any more are released. An
+    // intermediate is fused only when the next node is its sole consumer
+    // and it is not a required output. Run it after fuse_post_eltwise so
+    // that eltwise nodes after Conv and FC are fused into them as post-ops
+    // first. Chains run in f32, so nodes taking int8 input are not chained:
+    // run it after quantize to keep int8 Relu. Returns the number of
+    // removed nodes
+    inline auto
+    fuse_eltwise_chain(graph_ir& ir,
+                       std::unordered_map<std::string, array>& parameter_table,
+                       std::set<std::string> const& required_output_set) {
+        auto is_required_output_list =
+          make_tensor_id_set(ir, required_output_set);
+        auto is_parameter = [&](int id) {
+            return parameter_table.find(ir.tensor_name(id)) !=
+                   parameter_table.end();
+        };
+
+        // int8 tensors come from Conv or FC outputting u8 (see quantize)
+        // through pooling and Relu
+        std::vector<bool> is_int8_list(ir.tensor_num(), false);
+        for(auto const& node : ir.node_list()) {
+            auto const& op_type = node.op_type();
+            if(op_type == "Conv" || op_type == "FC") {
+                auto found = node.attribute_table.find(
+                  "quantized_output_data_type");
+                is_int8_list[node.output_id_list[0]] =
+                  found != node.attribute_table.end() &&
+                  found->second.get().s() == "u8";
+            } else if(op_type == "MaxPool" || op_type == "AveragePool" ||
+                      op_type == "Relu") {
+                is_int8_list[node.output_id_list[0]] =
+                  is_int8_list[node.input_id_list[0]];
+            }
+        }
+
+        // the constant operand of Add and Mul chained as an affine step, or
+        // -1. It is a scalar or varies along one axis, and broadcasting it
+        // keeps the dims of x when they are known
+        auto find_affine_constant = [&](graph_node const& node) {
+            if((node.op_type() != "Add" && node.op_type() != "Mul") ||
+               node.input_id_list.size() != 2 ||
+               node.attribute_table.find("broadcast") !=
+                 node.attribute_table.end()) {
+                return -1;
+            }
+            for(int k = 0; k < 2; ++k) {
+                auto x_id = node.input_id_list[k];
+                auto constant_id = node.input_id_list[1 - k];
+                if(is_parameter(x_id) || !is_parameter(constant_id)) {
+                    continue;
+                }
+                auto const& constant =
+                  parameter_table.at(ir.tensor_name(constant_id));
+                auto const& dims = constant.dims();
+                auto const& x_dims = ir.dims(x_id);
+                if(constant.dtype() != dtype_t::float_ ||
+                   std::count_if(dims.begin(), dims.end(),
+                                 [](int d) { return d != 1; }) > 1 ||
+                   (!x_dims.empty() &&
+                    (dims.size() > x_dims.size() ||
+                     !std::equal(dims.rbegin(), dims.rend(), x_dims.rbegin(),
+                                 [](int d, int x_d) {
+                                     return d == 1 || d == x_d;
+                                 })))) {
+                    continue;
+                }
+                return constant_id;
+            }
+            return -1;
+        };
+        auto is_affine_batch_norm = [&](graph_node const& node) {
+            if(node.op_type() != "BatchNormalization" ||
+               node.input_id_list.size() != 5 || node.output_size() != 1 ||
+               !std::all_of(node.input_id_list.begin() + 1,
+                            node.input_id_list.end(), is_parameter)) {
+                return false;
+            }
+            for(auto const& name : {"is_test", "spatial"}) {
+                auto found = node.attribute_table.find(name);
+                if(found != node.attribute_table.end() &&
+                   found->second.get().i() != 1) {
+                    return false;
+                }
+            }
+            return true;
+        };
+
+        // x of a node chainable as y = f(x), or -1
+        auto const& attribute_table = eltwise_chain_attribute_table();
+        auto find_chain_input = [&](int node_index) {
+            auto const& node = ir.node(node_index);
+            auto x_id = -1;
+            if(node.input_id_list.size() == 1 &&
+               attribute_table.find(node.op_type()) !=
+                 attribute_table.end()) {
+                x_id = node.input_id_list[0];
+            } else if(is_affine_batch_norm(node)) {
+                x_id = node.input_id_list[0];
+            } else {
+                auto constant_id = find_affine_constant(node);
+                if(constant_id != -1) {
+                    x_id = node.input_id_list[0] == constant_id
+                             ? node.input_id_list[1]
+                             : node.input_id_list[0];
+                }
+            }
+            return x_id != -1 && !is_int8_list[x_id] ? x_id : -1;
+        };
+
+        // node indices of each chain
+        std::vector<std::vector<int>> chain_list;
+        std::vector<bool> is_chained_list(ir.node_num(), false);
+        for(int i = 0; i < ir.node_num(); ++i) {
+            if(is_chained_list[i] || find_chain_input(i) == -1) {
+                continue;
+            }
+            std::vector<int> chain{i};
+            auto output_id = ir.node(i).output_id_list[0];
+            while(true) {
+                auto const& consumer_list = ir.consumer_list(output_id);
+                if(consumer_list.size() != 1 || ir.is_graph_output(output_id) ||
+                   is_required_output_list[output_id] ||
+                   find_chain_input(consumer_list[0]) != output_id) {
+                    break;
+                }
+                chain.push_back(consumer_list[0]);
+                output_id = ir.node(consumer_list[0]).output_id_list[0];
+            }
+            if(chain.size() < 2) {
+                continue;
+            }
+            for(auto index : chain) {
+                is_chained_list[index] = true;
+            }
+            chain_list.push_back(chain);
+        }
+
+        std::vector<bool> is_fused_list(ir.node_num(), false);
+        std::vector<int> constant_id_list; // of chained nodes
+        for(auto const& chain : chain_list) {
+            onnx::NodeProto fused_node;
+            fused_node.set_name(ir.node(chain.front()).proto->name());
+            fused_node.set_op_type("EltwiseChain");
+            fused_node.add_input(
+              ir.tensor_name(find_chain_input(chain.front())));
+            fused_node.add_output(
+              ir.tensor_name(ir.node(chain.back()).output_id_list[0]));
+            auto* op_types_attr = fused_node.add_attribute();
+            op_types_attr->set_name("eltwise_op_types");
+            op_types_attr->set_type(
+              onnx::AttributeProto_AttributeType_STRINGS);
+            auto* alphas_attr = fused_node.add_attribute();
+            alphas_attr->set_name("eltwise_alphas");
+            alphas_attr->set_type(onnx::AttributeProto_AttributeType_FLOATS);
+            auto* betas_attr = fused_node.add_attribute();
+            betas_attr->set_name("eltwise_betas");
+            betas_attr->set_type(onnx::AttributeProto_AttributeType_FLOATS);
+            auto* axes_attr = fused_node.add_attribute();
+            axes_attr->set_name("eltwise_axes");
+            axes_attr->set_type(onnx::AttributeProto_AttributeType_INTS);
+            for(auto index : chain) {
+                auto const& node = ir.node(index);
+                if(attribute_table.find(node.op_type()) ==
+                   attribute_table.end()) {
+                    // affine step
+                    auto scale_and_shift_and_axis = make_affine_step(
+                      ir, parameter_table, node, find_affine_constant(node));
+                    auto const& scale = std::get<0>(scale_and_shift_and_axis);
+                    auto const& shift = std::get<1>(scale_and_shift_and_axis);
+                    auto axis = std::get<2>(scale_and_shift_and_axis);
+                    if(axis == 0) {
+                        op_types_attr->add_strings("Affine");
+                        alphas_attr->add_floats(fat(scale, 0));
+                        betas_attr->add_floats(fat(shift, 0));
+                    } else {
+                        op_types_attr->add_strings("AxisAffine");
+                        alphas_attr->add_floats(0.f);
+                        betas_attr->add_floats(0.f);
+                        for(auto const& name_and_arr :
+                            {std::make_pair("_scale", &scale),
+                             std::make_pair("_shift", &shift)}) {
+                            fused_node.add_input(ir.tensor_name(add_parameter(
+                              ir, parameter_table,
+                              node.output(0) + name_and_arr.first,
+                              *name_and_arr.second)));
+                        }
+                    }
+                    axes_attr->add_ints(axis);
+                    continue;
+                }
+                std::vector<float> coefficient_list{0.f, 0.f};
+                auto const& name_and_default_list =
+                  attribute_table.at(node.op_type());
+                for(std::size_t k = 0; k < name_and_default_list.size();
+                    ++k) {
+                    auto found = node.attribute_table.find(
+                      name_and_default_list[k].first);
+                    coefficient_list[k] =
+                      found == node.attribute_table.end()
+                        ? name_and_default_list[k].second
+                        : found->second.get().f();
+                }
+                op_types_attr->add_strings(node.op_type());
+                alphas_attr->add_floats(coefficient_list[0]);
+                betas_attr->add_floats(coefficient_list[1]);
+                axes_attr->add_ints(0);
+            }
+            for(auto index : chain) {
+                auto const& input_id_list = ir.node(index).input_id_list;
+                std::copy_if(input_id_list.begin(), input_id_list.end(),
+                             std::back_inserter(constant_id_list),
+                             is_parameter);
+            }
+            ir.replace_node(chain.front(), std::move(fused_node));
+            for(std::size_t k = 1; k < chain.size(); ++k) {
+                is_fused_list[chain[k]] = true;
+            }
+        }
+        auto removed_node_num = ir.remove_nodes(is_fused_list);
+
+        std::vector<bool> is_retained_list(ir.tensor_num(), true);
+        for(auto id : constant_id_list) {
+            if(ir.consumer_list(id).empty()) {
+                parameter_table.erase(ir.tensor_name(id));
+                is_retained_list[id] = false;
+            }
+        }
+        ir.retain_graph_values(is_retained_list);
+        return removed_node_num;
+    }
+
+    inline auto
+    fuse_eltwise_chain(onnx::GraphProto& graph,
+                       std::unordered_map<std::string, array>& parameter_table,
+                       std::set<std::string> const& required_output_set) {
+        graph_ir ir(graph);
+        return fuse_eltwise_chain(ir, parameter_table, required_output_set);
+    }
+
+} // namespace instant
+
+#endif // INSTANT_PASS_FUSE_ELTWISE_CHAIN_HPP
@@ -0,0 +1,83 @@
+#ifndef INSTANT_PASS_FUSE_POST_ELTWISE_HPP
+#define INSTANT_PASS_FUSE_POST_ELTWISE_HPP
+
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <instant/graph.hpp>
+#include <instant/onnx.pb.h>
+
+namespace instant {
+
+    // Default alpha of each fusible eltwise operator (ONNX default)
+    inline auto const& post_eltwise_default_alpha_table() {
+        static const std::unordered_map<std::string, float> table{
+          {"Relu", 0.f}, {"LeakyRelu", 0.01f}, {"Elu", 1.f}};
+        return table;
+    }
+
+    // Fuses eltwise nodes (Relu, LeakyRelu and Elu) into the preceding Conv
+    // or FC node. The fused node takes over the output of the eltwise node
+    // and records the eltwise operators in "post_eltwise_op_types" and
+    // "post_eltwise_alphas" attributes, which are converted to MKL-DNN
+    // post-ops by the factory. The intermediate is fused only when the
+    // eltwise node is its sole consumer and it is not a required output
+    inline auto
+    fuse_post_eltwise(graph_ir& ir,
+                      std::set<std::string> const& required_output_set) {
+        auto is_required_output_list =
+          make_tensor_id_set(ir, required_output_set);
+        auto const& default_alpha_table = post_eltwise_default_alpha_table();
+        std::vector<bool> is_fused_list(ir.node_num(), false);
+        for(int i = 0; i < ir.node_num(); ++i) {
+            if(ir.node(i).op_type() != "Conv" && ir.node(i).op_type() != "FC") {
+                continue;
+            }
+            auto output_id = ir.node(i).output_id_list[0];
+            while(true) {
+                auto const& consumer_list = ir.consumer_list(output_id);
+                if(consumer_list.size() != 1 || ir.is_graph_output(output_id) ||
+                   is_required_output_list[output_id]) {
+                    break;
+                }
+                auto consumer_index = consumer_list[0];
+                auto const& consumer = ir.node(consumer_index);
+                auto found = default_alpha_table.find(consumer.op_type());
+                if(found == default_alpha_table.end()) {
+                    break;
+                }
+                auto alpha = found->second;
+                auto found_alpha = consumer.attribute_table.find("alpha");
+                if(found_alpha != consumer.attribute_table.end()) {
+                    alpha = found_alpha->second.get().f();
+                }
+
+                ir.mutable_attribute(i, "post_eltwise_op_types",
+                                     onnx::AttributeProto_AttributeType_STRINGS)
+                  .add_strings(consumer.op_type());
+                ir.mutable_attribute(i, "post_eltwise_alphas",
+                                     onnx::AttributeProto_AttributeType_FLOATS)
+                  .add_floats(alpha);
+
+                output_id = consumer.output_id_list[0];
+                is_fused_list[consumer_index] = true;
+            }
+            if(output_id != ir.node(i).output_id_list[0]) {
+                ir.set_output(i, 0, output_id);
+            }
+        }
+        ir.remove_nodes(is_fused_list);
+    }
+
+    inline auto
+    fuse_post_eltwise(onnx::GraphProto& graph,
+                      std::set<std::string> const& required_output_set) {
+        graph_ir ir(graph);
+        fuse_post_eltwise(ir, required_output_set);
+    }
+
+} // namespace instant
+
+#endif // INSTANT_PASS_FUSE_POST_ELTWISE_HPP
@@ -0,0 +1,176 @@
+#ifndef INSTANT_PASS_FUSE_RESIDUAL_ADD_HPP
+#define INSTANT_PASS_FUSE_RESIDUAL_ADD_HPP
+
+#include <functional>
+#include <set>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <instant/array.hpp>
+#include <instant/graph.hpp>
+#include <instant/onnx.pb.h>
+
+namespace instant {
+
+    // Fuses Add (or Sum of two inputs) of a Conv output X and a residual R
+    // into the Conv as a sum post-op (the skip connection of ResNet). The
+    // Conv takes R as input 3 (a zero bias of a unique name is added as an
+    // initializer if it has none), takes over the output of the Add and
+    // records "post_sum". Run it before fuse_post_eltwise so the Relu
+    // after the Add is fused as well.
+    // X is fused only when the Add is its sole consumer and it is not a
+    // required output. R must be computed before the Conv and have the
+    // dims of X when both are known. "post_sum_in_place" is also recorded
+    // when the Conv may accumulate into the buffer of R, that is when R is
+    // an intermediate whose other consumers all run before the Conv.
+    // Quantized Conv nodes are not fused. Returns the number of fused Add
+    // nodes
+    inline auto
+    fuse_residual_add(graph_ir& ir,
+                      std::unordered_map<std::string, array>& parameter_table,
+                      std::set<std::string> const& required_output_set) {
+        auto is_required_output_list =
+          make_tensor_id_set(ir, required_output_set);
+        auto is_parameter = [&](int id) {
+            return parameter_table.find(ir.tensor_name(id)) !=
+                   parameter_table.end();
+        };
+
+        // whether node ancestor_index is an ancestor of node node_index
+        auto is_ancestor = [&ir](int ancestor_index, int node_index) {
+            std::vector<bool> is_visited_list(ir.node_num(), false);
+            std::function<bool(int)> search = [&](int i) {
+                if(i == ancestor_index) {
+                    return true;
+                }
+                if(i < ancestor_index || is_visited_list[i]) {
+                    return false;
+                }
+                is_visited_list[i] = true;
+                for(auto input_id : ir.node(i).input_id_list) {
+                    auto producer = ir.producer(input_id);
+                    if(producer != -1 && search(producer)) {
+                        return true;
+                    }
+                }
+                return false;
+            };
+            return search(node_index);
+        };
+
+        // the Conv producing the operand able to take the Add, or -1
+        auto find_fusible_conv = [&](int x_id) {
+            auto producer = ir.producer(x_id);
+            if(producer == -1 || ir.consumer_list(x_id).size() != 1 ||
+               ir.is_graph_output(x_id) || is_required_output_list[x_id]) {
+                return -1;
+            }
+            auto const& conv = ir.node(producer);
+            if(conv.op_type() != "Conv" || conv.input_id_list.size() > 3 ||
+               !is_parameter(conv.input_id_list[1]) ||
+               conv.attribute_table.find("post_sum") !=
+                 conv.attribute_table.end() ||
+               conv.attribute_table.find("quantized_input_scale") !=
+                 conv.attribute_table.end()) {
+                return -1;
+            }
+            return producer;
+        };
+
+        // (Add index, Conv index, residual ID, in place)
+        std::vector<std::tuple<int, int, int, bool>> fusion_list;
+        for(int i = 0; i < ir.node_num(); ++i) {
+            auto const& node = ir.node(i);
+            if((node.op_type() != "Add" && node.op_type() != "Sum") ||
+               node.input_id_list.size() != 2 ||
+               node.attribute_table.find("broadcast") !=
+                 node.attribute_table.end()) {
+                continue;
+            }
+            for(int k = 0; k < 2; ++k) {
+                auto x_id = node.input_id_list[k];
+                auto r_id = node.input_id_list[1 - k];
+                auto conv_index = find_fusible_conv(x_id);
+                if(conv_index == -1 || r_id == x_id || is_parameter(r_id) ||
+                   ir.producer(r_id) >= conv_index) {
+                    continue;
+                }
+                auto const& x_dims = ir.dims(x_id);
+                auto const& r_dims = ir.dims(r_id);
+                if(!x_dims.empty() && !r_dims.empty() && x_dims != r_dims) {
+                    continue;
+                }
+
+                auto r_producer = ir.producer(r_id);
+                auto is_in_place =
+                  r_producer != -1 && !ir.is_graph_output(r_id) &&
+                  !is_required_output_list[r_id] &&
+                  !is_required_output_list[node.output_id_list[0]];
+                if(is_in_place) {
+                    // outputs of these may alias their inputs
+                    static const std::set<std::string> aliasing_op_type_set{
+                      "Dropout", "Flatten", "Identity", "Reshape"};
+                    is_in_place = aliasing_op_type_set.find(
+                                    ir.node(r_producer).op_type()) ==
+                                  aliasing_op_type_set.end();
+                }
+                for(auto consumer : ir.consumer_list(r_id)) {
+                    if(!is_in_place) {
+                        break;
+                    }
+                    is_in_place = consumer == i ||
+                                  (consumer != conv_index &&
+                                   is_ancestor(consumer, conv_index));
+                }
+                fusion_list.emplace_back(i, conv_index, r_id, is_in_place);
+                break;
+            }
+        }
+
+        // nodes are rewired after all fusions are found
+        std::vector<bool> is_fused_list(ir.node_num(), false);
+        for(auto const& fusion : fusion_list) {
+            auto add_index = std::get<0>(fusion);
+            auto conv_index = std::get<1>(fusion);
+            auto const& conv = ir.node(conv_index);
+            if(conv.input_size() == 2) {
+                auto output_channel_num =
+                  parameter_table.at(conv.input(1)).dims()[0];
+                auto bias_id = add_parameter(
+                  ir, parameter_table, conv.output(0) + "_bias",
+                  zeros(dtype_t::float_, {output_channel_num}));
+                ir.add_input(conv_index, bias_id);
+            }
+            ir.add_input(conv_index, std::get<2>(fusion));
+            for(auto const& name_and_value :
+                {std::make_pair("post_sum", true),
+                 std::make_pair("post_sum_in_place", std::get<3>(fusion))}) {
+                if(!name_and_value.second) {
+                    continue;
+                }
+                ir.mutable_attribute(conv_index, name_and_value.first,
+                                     onnx::AttributeProto_AttributeType_INT)
+                  .set_i(1);
+            }
+            ir.set_output(conv_index, 0,
+                          ir.node(add_index).output_id_list[0]);
+            is_fused_list[add_index] = true;
+        }
+        ir.remove_nodes(is_fused_list);
+        return static_cast<int>(fusion_list.size());
+    }
+
+    inline auto
+    fuse_residual_add(onnx::GraphProto& graph,
+                      std::unordered_map<std::string, array>& parameter_table,
+                      std::set<std::string> const& required_output_set) {
+        graph_ir ir(graph);
+        return fuse_residual_add(ir, parameter_table, required_output_set);
+    }
+
+} // namespace instant
+
+#endif // INSTANT_PASS_FUSE_RESIDUAL_ADD_HPP
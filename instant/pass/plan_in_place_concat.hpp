@@ -0,0 +1,118 @@
+#ifndef INSTANT_PASS_PLAN_IN_PLACE_CONCAT_HPP
+#define INSTANT_PASS_PLAN_IN_PLACE_CONCAT_HPP
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <instant/array.hpp>
+#include <instant/graph.hpp>
+#include <instant/onnx.pb.h>
+
+namespace instant {
+
+    // Lets the Conv nodes making the inputs of a Concat write their outputs
+    // directly into their channel slices of the Concat output, so the
+    // Concat itself moves no data (see make_concat_slice_memory). A Concat
+    // is planned when it joins channels (axis 1) of distinct f32 outputs of
+    // Conv nodes with parameter weights, each used only by the Concat and
+    // not required. Other Concat nodes run the MKL-DNN concat primitive.
+    // Returns the number of planned Concat nodes
+    inline auto plan_in_place_concat(
+      graph_ir& ir,
+      std::unordered_map<std::string, array> const& parameter_table,
+      std::set<std::string> const& required_output_set) {
+        auto is_required_output_list =
+          make_tensor_id_set(ir, required_output_set);
+
+        // output channel num of the producer able to write into a slice
+        auto calc_slice_channel_num = [&](int tensor_id) {
+            auto producer = ir.producer(tensor_id);
+            if(producer == -1 || ir.consumer_list(tensor_id).size() != 1 ||
+               ir.is_graph_output(tensor_id) ||
+               is_required_output_list[tensor_id]) {
+                return 0;
+            }
+            auto const& node = ir.node(producer);
+            if(node.op_type() != "Conv" ||
+               node.attribute_table.find("post_sum") !=
+                 node.attribute_table.end()) {
+                return 0;
+            }
+            auto found = parameter_table.find(node.proto->input(1));
+            if(found == parameter_table.end()) {
+                return 0;
+            }
+            auto data_type = node.attribute_table.find(
+              "quantized_output_data_type");
+            if(data_type != node.attribute_table.end() &&
+               data_type->second.get().s() != "f32") {
+                return 0;
+            }
+            return found->second.dims()[0];
+        };
+
+        int planned_concat_num = 0;
+        for(int i = 0; i < ir.node_num(); ++i) {
+            auto const& node = ir.node(i);
+            if(node.op_type() != "Concat") {
+                continue;
+            }
+            auto found = node.attribute_table.find("axis");
+            auto axis = found == node.attribute_table.end()
+                          ? 1
+                          : static_cast<int>(found->second.get().i());
+            if(axis != 1 && axis != -3) {
+                continue;
+            }
+            // an input taken twice has one consumer listed twice, so it is
+            // rejected as well
+            std::vector<int> channel_num_list;
+            for(auto input_id : node.input_id_list) {
+                channel_num_list.push_back(calc_slice_channel_num(input_id));
+            }
+            if(std::find(channel_num_list.begin(), channel_num_list.end(),
+                         0) != channel_num_list.end()) {
+                continue;
+            }
+
+            auto channel_offset = 0;
+            for(int j = 0; j < static_cast<int>(node.input_id_list.size());
+                ++j) {
+                auto producer = ir.producer(node.input_id_list[j]);
+                ir.mutable_attribute(producer, "concat_output",
+                                     onnx::AttributeProto_AttributeType_STRING)
+                  .set_s(node.output(0));
+                ir.mutable_attribute(producer, "concat_channel_offset",
+                                     onnx::AttributeProto_AttributeType_INT)
+                  .set_i(channel_offset);
+                auto& channel_nums_attr = ir.mutable_attribute(
+                  producer, "concat_channel_nums",
+                  onnx::AttributeProto_AttributeType_INTS);
+                channel_nums_attr.clear_ints();
+                for(auto channel_num : channel_num_list) {
+                    channel_nums_attr.add_ints(channel_num);
+                }
+                channel_offset += channel_num_list[j];
+            }
+            ir.mutable_attribute(i, "concat_in_place",
+                                 onnx::AttributeProto_AttributeType_INT)
+              .set_i(1);
+            ++planned_concat_num;
+        }
+        return planned_concat_num;
+    }
+
+    inline auto plan_in_place_concat(
+      onnx::GraphProto& graph,
+      std::unordered_map<std::string, array> const& parameter_table,
+      std::set<std::string> const& required_output_set) {
+        graph_ir ir(graph);
+        return plan_in_place_concat(ir, parameter_table, required_output_set);
+    }
+
+} // namespace instant
+
+#endif // INSTANT_PASS_PLAN_IN_PLACE_CONCAT_HPP
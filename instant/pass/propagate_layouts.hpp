@@ -0,0 +1,230 @@
+#ifndef INSTANT_PASS_PROPAGATE_LAYOUTS_HPP
+#define INSTANT_PASS_PROPAGATE_LAYOUTS_HPP
+
+#include <functional>
+#include <numeric>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <instant/array.hpp>
+#include <instant/graph.hpp>
+#include <instant/onnx.pb.h>
+
+namespace instant {
+
+    // Blocked activation format JIT convolutions of the ISA (see
+    // get_cpu_isa_name) run on. Channels are blocked by block_size
+    inline auto get_blocked_format(std::string const& isa_name) {
+        if(isa_name == "avx512") {
+            return std::make_pair(std::string("nChw16c"), 16);
+        }
+        if(isa_name == "avx2" || isa_name == "avx" || isa_name == "sse42") {
+            return std::make_pair(std::string("nChw8c"), 8);
+        }
+        return std::make_pair(std::string("nchw"), 1);
+    }
+
+    // Operators whose output is in the format of their input
+    inline auto const& get_format_preserving_op_type_set() {
+        static const std::set<std::string> op_type_set{
+          "Abs",        "AveragePool",  "BatchNormalization",
+          "Clip",       "Dropout",      "EltwiseChain",
+          "Elu",        "Exp",          "HardSigmoid",
+          "Identity",   "LeakyRelu",    "Log",
+          "MaxPool",    "Neg",          "Reciprocal",
+          "Relu",       "Sigmoid",      "Softmax",
+          "Sqrt",       "Tanh"};
+        return op_type_set;
+    }
+
+    // Takes a Conv node and its (source, destination) format names. Returns
+    // whether an implementation supports them
+    using conv_format_checker = std::function<bool(
+      graph_node const&, std::string const&, std::string const&)>;
+
+    // Assigns one format to each group of tensors connected by format
+    // preserving operators, so that reorders happen only between groups.
+    // Each group takes nchw or the blocked format, whichever needs fewer
+    // bytes reordered:
+    //  - a model input not in the format of its group is reordered once
+    //  - Reshape, Flatten and required outputs take nchw
+    //  - Conv input and output whose channels are multiples of the block
+    //    size count as blocked since a Conv running in plain formats costs
+    //    about as much as a reorder. They do not count when
+    //    is_conv_format_supported rejects the blocked format, since the
+    //    Conv falls back to any then
+    // Each reorder weighs the bytes of its f32 tensor (ir.dims). A tensor
+    // of unknown dims weighs as one element. Ties are broken in favour of
+    // the blocked format. The formats are set to Conv nodes as "tuned_*"
+    // attributes (see load_tuned_conv_attributes). Conv nodes already
+    // tuned or quantized are left as they are. input_format_table has the
+    // format name of each model input.
+    // Returns the bytes the assignment is estimated to reorder
+    inline auto propagate_layouts(
+      graph_ir& ir,
+      std::unordered_map<std::string, array> const& parameter_table,
+      std::unordered_map<std::string, std::string> const& input_format_table,
+      std::set<std::string> const& required_output_set,
+      std::string const& blocked_format, int block_size,
+      conv_format_checker const& is_conv_format_supported =
+        conv_format_checker()) {
+
+        // groups are found by union-find over tensor IDs
+        std::vector<int> parent_list(ir.tensor_num());
+        std::iota(parent_list.begin(), parent_list.end(), 0);
+        std::function<int(int)> find_group = [&](int id) {
+            return parent_list[id] == id
+                     ? id
+                     : parent_list[id] = find_group(parent_list[id]);
+        };
+        auto const& preserving_op_type_set =
+          get_format_preserving_op_type_set();
+        for(auto const& node : ir.node_list()) {
+            if(preserving_op_type_set.find(node.op_type()) !=
+               preserving_op_type_set.end()) {
+                parent_list[find_group(node.output_id_list[0])] =
+                  find_group(node.input_id_list[0]);
+            } else if(node.attribute_table.find("post_sum") !=
+                      node.attribute_table.end()) {
+                // Conv summing its residual (see fuse_residual_add)
+                parent_list[find_group(node.output_id_list[0])] =
+                  find_group(node.input_id_list[3]);
+            }
+        }
+
+        auto is_assignable_conv = [&](graph_node const& node) {
+            return node.op_type() == "Conv" &&
+                   parameter_table.find(node.proto->input(1)) !=
+                     parameter_table.end() &&
+                   node.attribute_table.find("tuned_conv_algorithm") ==
+                     node.attribute_table.end() &&
+                   node.attribute_table.find("quantized_input_scale") ==
+                     node.attribute_table.end();
+        };
+        auto group_attribute = [](graph_node const& node) {
+            auto found = node.attribute_table.find("group");
+            return found == node.attribute_table.end()
+                     ? 1
+                     : static_cast<int>(found->second.get().i());
+        };
+        auto is_supported = [&](graph_node const& node,
+                                std::string const& src_format,
+                                std::string const& dst_format) {
+            return !is_conv_format_supported ||
+                   is_conv_format_supported(node, src_format, dst_format);
+        };
+        // (input, output) channel nums are multiples of the block size and
+        // the blocked format is supported there
+        auto is_blockable = [&](graph_node const& node) {
+            auto const& weight_dims =
+              parameter_table.at(node.proto->input(1)).dims();
+            return std::make_pair(
+              weight_dims[1] * group_attribute(node) % block_size == 0 &&
+                is_supported(node, blocked_format, "any"),
+              weight_dims[0] % block_size == 0 &&
+                is_supported(node, "any", blocked_format));
+        };
+        auto tensor_bytes = [&ir](int id) {
+            auto const& dims = ir.dims(id);
+            return std::accumulate(dims.begin(), dims.end(), std::size_t(1),
+                                   std::multiplies<std::size_t>()) *
+                   sizeof(float);
+        };
+
+        // costs of nchw and the blocked format of each group
+        std::vector<std::size_t> nchw_cost_list(ir.tensor_num(), 0);
+        std::vector<std::size_t> blocked_cost_list(ir.tensor_num(), 0);
+        for(auto const& name_and_format : input_format_table) {
+            auto id = ir.find_tensor_id(name_and_format.first);
+            if(id == -1) {
+                continue;
+            }
+            if(name_and_format.second != "nchw") {
+                nchw_cost_list[find_group(id)] += tensor_bytes(id);
+            }
+            if(name_and_format.second != blocked_format) {
+                blocked_cost_list[find_group(id)] += tensor_bytes(id);
+            }
+        }
+        for(auto const& node : ir.node_list()) {
+            if(node.op_type() == "Reshape" || node.op_type() == "Flatten") {
+                auto id = node.input_id_list[0];
+                blocked_cost_list[find_group(id)] += tensor_bytes(id);
+            } else if(is_assignable_conv(node)) {
+                auto blockable = is_blockable(node);
+                if(blockable.first) {
+                    auto id = node.input_id_list[0];
+                    nchw_cost_list[find_group(id)] += tensor_bytes(id);
+                }
+                if(blockable.second) {
+                    auto id = node.output_id_list[0];
+                    nchw_cost_list[find_group(id)] += tensor_bytes(id);
+                }
+            }
+        }
+        for(auto const& name : required_output_set) {
+            auto id = ir.find_tensor_id(name);
+            if(id != -1) {
+                blocked_cost_list[find_group(id)] += tensor_bytes(id);
+            }
+        }
+
+        auto is_blocked_group = [&](int id) {
+            auto group = find_group(id);
+            return blocked_cost_list[group] <= nchw_cost_list[group];
+        };
+        std::size_t estimated_reorder_bytes = 0;
+        for(int id = 0; id < ir.tensor_num(); ++id) {
+            if(find_group(id) == id) {
+                estimated_reorder_bytes += is_blocked_group(id)
+                                             ? blocked_cost_list[id]
+                                             : nchw_cost_list[id];
+            }
+        }
+
+        for(int i = 0; i < ir.node_num(); ++i) {
+            auto const& node = ir.node(i);
+            if(!is_assignable_conv(node)) {
+                continue;
+            }
+            // the blocked format is set only when channels fit the blocks
+            auto blockable = is_blockable(node);
+            auto src_format =
+              is_blocked_group(node.input_id_list[0])
+                ? (blockable.first ? blocked_format : std::string("any"))
+                : std::string("nchw");
+            auto dst_format =
+              is_blocked_group(node.output_id_list[0])
+                ? (blockable.second ? blocked_format : std::string("any"))
+                : std::string("nchw");
+            for(auto const& name_and_value :
+                {std::make_pair("tuned_conv_algorithm", std::string("direct")),
+                 std::make_pair("tuned_src_format", src_format),
+                 std::make_pair("tuned_dst_format", dst_format)}) {
+                ir.mutable_attribute(i, name_and_value.first,
+                                     onnx::AttributeProto_AttributeType_STRING)
+                  .set_s(name_and_value.second);
+            }
+        }
+        return estimated_reorder_bytes;
+    }
+
+    inline auto propagate_layouts(
+      onnx::GraphProto& graph,
+      std::unordered_map<std::string, array> const& parameter_table,
+      std::unordered_map<std::string, std::string> const& input_format_table,
+      std::set<std::string> const& required_output_set,
+      std::string const& blocked_format, int block_size,
+      conv_format_checker const& is_conv_format_supported =
+        conv_format_checker()) {
+        graph_ir ir(graph);
+        return propagate_layouts(ir, parameter_table, input_format_table,
+                                 required_output_set, blocked_format,
+                                 block_size, is_conv_format_supported);
+    }
+
+} // namespace instant
+
+#endif // INSTANT_PASS_PROPAGATE_LAYOUTS_HPP
@@ -0,0 +1,218 @@
+#ifndef INSTANT_PASS_QUANTIZE_HPP
+#define INSTANT_PASS_QUANTIZE_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <instant/array.hpp>
+#include <instant/graph.hpp>
+#include <instant/onnx.pb.h>
+
+namespace instant {
+
+    // (min, max) of values of each tensor observed in calibration
+    using range_table_t =
+      std::unordered_map<std::string, std::pair<float, float>>;
+
+    // The range table file has one tensor per line: "name min max"
+    inline auto load_range_table(std::string const& filename) {
+        std::ifstream ifs(filename);
+        if(!ifs) {
+            throw std::runtime_error("File open error: " + filename);
+        }
+        range_table_t range_table;
+        std::string name;
+        float min, max;
+        while(ifs >> name >> min >> max) {
+            range_table[name] = std::make_pair(min, max);
+        }
+        return range_table;
+    }
+
+    inline auto save_range_table(std::string const& filename,
+                                 range_table_t const& range_table) {
+        std::ofstream ofs(filename);
+        if(!ofs) {
+            throw std::runtime_error("File open error: " + filename);
+        }
+        std::map<std::string, std::pair<float, float>> sorted_range_table(
+          range_table.begin(), range_table.end());
+        ofs << std::setprecision(9);
+        for(auto const& p : sorted_range_table) {
+            ofs << p.first << " " << p.second.first << " " << p.second.second
+                << "\n";
+        }
+    }
+
+    // Scale which maps values in range to u8 (non-negative range) or s8
+    inline auto calc_quantization_scale(std::pair<float, float> const& range) {
+        auto abs_max = std::max(std::abs(range.first), std::abs(range.second));
+        if(abs_max == 0.f) {
+            return 1.f;
+        }
+        return (range.first >= 0.f ? 255.f : 127.f) / abs_max;
+    }
+
+    // Scale which maps each output channel of weight to s8
+    inline auto calc_weight_scales(array const& weight) {
+        auto output_channel_num = weight.dims()[0];
+        auto size_per_channel = total_size(weight) / output_channel_num;
+        std::vector<float> scales;
+        for(int oc = 0; oc < output_channel_num; ++oc) {
+            auto first = fbegin(weight) + oc * size_per_channel;
+            float abs_max = 0.f;
+            std::for_each(first, first + size_per_channel, [&abs_max](float w) {
+                abs_max = std::max(abs_max, std::abs(w));
+            });
+            scales.push_back(abs_max == 0.f ? 1.f : 127.f / abs_max);
+        }
+        return scales;
+    }
+
+    // Makes Conv, FC, MaxPool, AveragePool and Relu run in int8 where the
+    // ranges of their input and output are in range_table.
+    // Conv and FC take u8 input, so they are quantized only when their
+    // input is non-negative. f32 input is quantized by a reorder in front
+    // of them. They output u8 when all consumers run in int8 and f32
+    // (dequantized by output scales) otherwise. Pooling and Relu run in
+    // int8 only between int8 nodes, so int8 tensors never reach f32 nodes
+    // or required outputs.
+    // Scales are recorded in "quantized_*" attributes of Conv and FC,
+    // which are read by their factories
+    inline auto quantize(
+      graph_ir& ir,
+      std::unordered_map<std::string, array> const& parameter_table,
+      range_table_t const& range_table,
+      std::set<std::string> const& required_output_set) {
+        auto has_range = [&](int id) {
+            return range_table.find(ir.tensor_name(id)) != range_table.end();
+        };
+        auto range = [&](int id) {
+            return range_table.at(ir.tensor_name(id));
+        };
+        auto is_conv_or_fc = [&ir](int node_index) {
+            auto const& op_type = ir.node(node_index).op_type();
+            return op_type == "Conv" || op_type == "FC";
+        };
+        auto is_required_output_list =
+          make_tensor_id_set(ir, required_output_set);
+
+        std::vector<bool> is_quantized_list(ir.node_num(), false);
+        for(int i = 0; i < ir.node_num(); ++i) {
+            auto const& node = ir.node(i);
+            auto input_id = node.input_id_list[0];
+            if(!has_range(input_id) || !has_range(node.output_id_list[0])) {
+                continue;
+            }
+            if(is_conv_or_fc(i)) {
+                // residual sum (see fuse_residual_add) stays in f32
+                auto found_group = node.attribute_table.find("group");
+                is_quantized_list[i] =
+                  range(input_id).first >= 0.f &&
+                  node.attribute_table.find("post_sum") ==
+                    node.attribute_table.end() &&
+                  parameter_table.find(node.proto->input(1)) !=
+                    parameter_table.end() &&
+                  (found_group == node.attribute_table.end() ||
+                   found_group->second.get().i() == 1);
+            } else if(node.op_type() == "MaxPool" ||
+                      node.op_type() == "AveragePool" ||
+                      node.op_type() == "Relu") {
+                is_quantized_list[i] = true;
+            }
+        }
+
+        // A tensor is held in u8 when its producer and all its consumers
+        // run in int8
+        auto is_int8_tensor = [&](int id) {
+            auto producer = ir.producer(id);
+            if(producer == -1 || !is_quantized_list[producer] ||
+               is_required_output_list[id] || ir.is_graph_output(id)) {
+                return false;
+            }
+            if(is_conv_or_fc(producer) && range(id).first < 0.f) {
+                return false; // would be s8
+            }
+            auto const& consumer_list = ir.consumer_list(id);
+            return !consumer_list.empty() &&
+                   std::all_of(consumer_list.begin(), consumer_list.end(),
+                               [&is_quantized_list](int c) {
+                                   return is_quantized_list[c];
+                               });
+        };
+        bool is_changed = true;
+        while(is_changed) {
+            is_changed = false;
+            for(int i = 0; i < ir.node_num(); ++i) {
+                if(!is_quantized_list[i] || is_conv_or_fc(i)) {
+                    continue;
+                }
+                if(!is_int8_tensor(ir.node(i).input_id_list[0]) ||
+                   !is_int8_tensor(ir.node(i).output_id_list[0])) {
+                    is_quantized_list[i] = false;
+                    is_changed = true;
+                }
+            }
+        }
+
+        // Pooling and Relu keep the scale of their input, so the scale of
+        // an int8 tensor is the one of the Conv or FC output it comes from
+        auto calc_tensor_scale = [&](int id) {
+            if(is_int8_tensor(id)) {
+                while(!is_conv_or_fc(ir.producer(id))) {
+                    id = ir.node(ir.producer(id)).input_id_list[0];
+                }
+            }
+            return calc_quantization_scale(range(id));
+        };
+        for(int i = 0; i < ir.node_num(); ++i) {
+            if(!is_quantized_list[i] || !is_conv_or_fc(i)) {
+                continue;
+            }
+            auto input_id = ir.node(i).input_id_list[0];
+            auto output_id = ir.node(i).output_id_list[0];
+            auto is_int8_output = is_int8_tensor(output_id);
+
+            ir.mutable_attribute(i, "quantized_input_scale",
+                                 onnx::AttributeProto_AttributeType_FLOAT)
+              .set_f(calc_tensor_scale(input_id));
+
+            auto& weight_scales_attr = ir.mutable_attribute(
+              i, "quantized_weight_scales",
+              onnx::AttributeProto_AttributeType_FLOATS);
+            weight_scales_attr.clear_floats();
+            for(auto scale :
+                calc_weight_scales(parameter_table.at(ir.node(i).input(1)))) {
+                weight_scales_attr.add_floats(scale);
+            }
+
+            ir.mutable_attribute(i, "quantized_output_scale",
+                                 onnx::AttributeProto_AttributeType_FLOAT)
+              .set_f(is_int8_output ? calc_tensor_scale(output_id) : 1.f);
+
+            ir.mutable_attribute(i, "quantized_output_data_type",
+                                 onnx::AttributeProto_AttributeType_STRING)
+              .set_s(is_int8_output ? "u8" : "f32");
+        }
+    }
+
+    inline auto quantize(
+      onnx::GraphProto& graph,
+      std::unordered_map<std::string, array> const& parameter_table,
+      range_table_t const& range_table,
+      std::set<std::string> const& required_output_set) {
+        graph_ir ir(graph);
+        quantize(ir, parameter_table, range_table, required_output_set);
+    }
+
+} // namespace instant
+
+#endif // INSTANT_PASS_QUANTIZE_HPP
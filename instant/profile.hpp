@@ -0,0 +1,180 @@
+#ifndef INSTANT_PROFILE_HPP
+#define INSTANT_PROFILE_HPP
+
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <mkldnn.hpp>
+
+#include <instant/graph.hpp>
+#include <instant/load_onnx.hpp>
+#include <instant/operator/common.hpp>
+
+namespace instant {
+
+    struct primitive_profile {
+        std::string node_name; // name of the node or its first output
+        std::string op_type;
+        std::string kind; // "compute" or "reorder"
+        double time;      // average milliseconds per run
+        double flops;     // of the node (only for its compute primitive)
+
+        auto gflops_per_second() const {
+            return time == 0. ? 0. : flops / (time * 1.e6);
+        }
+    };
+
+    inline auto get_primitive_kind_name(mkldnn::primitive const& p) {
+        mkldnn_primitive_kind_t kind;
+        mkldnn::error::wrap_c_api(
+          mkldnn_primitive_desc_query(p.get_primitive_desc(),
+                                      mkldnn_query_primitive_kind, 0, &kind),
+          "could not get primitive kind");
+        return std::string(kind == mkldnn_reorder ? "reorder" : "compute");
+    }
+
+    // Bytes a reorder reads and writes
+    inline auto calc_reorder_byte_size(mkldnn::primitive const& reorder) {
+        auto pd = reorder.get_primitive_desc();
+        return mkldnn_memory_primitive_desc_get_size(
+                 mkldnn_primitive_desc_query_pd(pd, mkldnn_query_input_pd, 0)) +
+               mkldnn_memory_primitive_desc_get_size(
+                 mkldnn_primitive_desc_query_pd(pd, mkldnn_query_output_pd, 0));
+    }
+
+    // The number of reorders in nets and the bytes they read and write
+    inline auto
+    calc_reorder_stats(std::vector<mkldnn::primitive> const& nets) {
+        int reorder_num = 0;
+        std::size_t byte_size = 0;
+        for(auto const& p : nets) {
+            if(get_primitive_kind_name(p) == "reorder") {
+                ++reorder_num;
+                byte_size += calc_reorder_byte_size(p);
+            }
+        }
+        return std::make_pair(reorder_num, byte_size);
+    }
+
+    // Counts multiply and add as 2 FLOPs. Operators without dedicated
+    // formula are counted as one FLOP per output element
+    inline auto calc_node_flops(
+      graph_node const& node,
+      std::unordered_map<std::string, const mkldnn::memory> const&
+        parameter_memory_table,
+      std::unordered_map<
+        std::string,
+        std::tuple<const mkldnn::memory, mkldnn::memory::format>> const&
+        variable_memory_table) {
+        auto found = variable_memory_table.find(node.output(0));
+        if(found == variable_memory_table.end()) {
+            return 0.;
+        }
+        double output_size =
+          calc_total_size(extract_dims(std::get<0>(found->second)));
+        auto const& attribute_table = node.attribute_table;
+        double flops = output_size;
+        if(node.op_type() == "Conv" || node.op_type() == "FC") {
+            auto weight_dims =
+              extract_dims(find_value(parameter_memory_table, node.input(1)));
+            // input channel num per group times kernel size for Conv
+            double weight_size_per_output =
+              calc_total_size(weight_dims) /
+              calc_output_channel_num(weight_dims);
+            flops = 2. * output_size * weight_size_per_output;
+        } else if(node.op_type() == "Gemm" || node.op_type() == "MatMul") {
+            auto a_dims = extract_dims(find_variable_or_parameter_memory(
+              parameter_memory_table, variable_memory_table, node.input(0)));
+            auto is_a_transposed =
+              node.op_type() == "Gemm" &&
+              attribute_table.find("transA") != attribute_table.end() &&
+              load_attribute_int(attribute_table, "transA") == 1;
+            flops = 2. * output_size *
+                    (is_a_transposed ? a_dims.front() : a_dims.back());
+        } else if(node.op_type() == "MaxPool" ||
+                  node.op_type() == "AveragePool") {
+            auto kernel_shape =
+              load_attribute_ints(attribute_table, "kernel_shape");
+            flops = output_size * calc_total_size(kernel_shape);
+        } else if(node.op_type() == "BatchNormalization") {
+            flops = 2. * output_size;
+        } else if(node.op_type() == "EltwiseChain") {
+            onnx::AttributeProto const& op_types_attr =
+              find_value(attribute_table, "eltwise_op_types");
+            flops = output_size * op_types_attr.strings_size();
+        } else if(node.op_type() == "Reshape" || node.op_type() == "Dropout") {
+            flops = 0.;
+        }
+        auto found_post_eltwise = attribute_table.find("post_eltwise_op_types");
+        if(found_post_eltwise != attribute_table.end()) {
+            onnx::AttributeProto const& op_types_attr =
+              found_post_eltwise->second;
+            flops += output_size * op_types_attr.strings_size();
+        }
+        return flops;
+    }
+
+    // Makes profiles (with zero time) of primitives made by make_nets
+    inline auto make_primitive_profile_list(
+      graph_ir const& ir, std::vector<mkldnn::primitive> const& nets,
+      std::vector<std::pair<int, int>> const& node_net_range_list,
+      std::unordered_map<std::string, const mkldnn::memory> const&
+        parameter_memory_table,
+      std::unordered_map<
+        std::string,
+        std::tuple<const mkldnn::memory, mkldnn::memory::format>> const&
+        variable_memory_table) {
+        std::vector<primitive_profile> profile_list(nets.size());
+        for(int i = 0; i < ir.node_num(); ++i) {
+            auto const& node = ir.node(i);
+            auto node_name = node.name().empty() ? node.output(0) : node.name();
+            auto flops = calc_node_flops(node, parameter_memory_table,
+                                         variable_memory_table);
+            for(int j = node_net_range_list[i].first;
+                j < node_net_range_list[i].second; ++j) {
+                auto kind = get_primitive_kind_name(nets[j]);
+                profile_list[j] = primitive_profile{
+                  node_name, node.op_type(), kind, 0., 0.};
+                if(kind == "compute") {
+                    profile_list[j].flops = flops;
+                    flops = 0.; // the first compute primitive takes all
+                }
+            }
+        }
+        return profile_list;
+    }
+
+    // Prints profiles in descending order of time
+    inline auto print_profile(std::ostream& os,
+                              std::vector<primitive_profile> profile_list) {
+        std::stable_sort(profile_list.begin(), profile_list.end(),
+                         [](auto const& a, auto const& b) {
+                             return a.time > b.time;
+                         });
+        double total_time = 0.;
+        for(auto const& p : profile_list) {
+            total_time += p.time;
+        }
+        os << std::left << std::setw(24) << "node" << std::setw(20) << "op"
+           << std::setw(10) << "kind" << std::right << std::setw(12)
+           << "time[ms]" << std::setw(8) << "%" << std::setw(12) << "GFLOP"
+           << std::setw(12) << "GFLOP/s" << "\n";
+        for(auto const& p : profile_list) {
+            os << std::left << std::setw(24) << p.node_name << std::setw(20)
+               << p.op_type << std::setw(10) << p.kind << std::right
+               << std::setw(12) << p.time << std::setw(8)
+               << (total_time == 0. ? 0. : 100. * p.time / total_time)
+               << std::setw(12) << p.flops * 1.e-9 << std::setw(12)
+               << p.gflops_per_second() << "\n";
+        }
+        os << std::left << std::setw(54) << "total" << std::right
+           << std::setw(12) << total_time << std::endl;
+    }
+
+} // namespace instant
+
+#endif // INSTANT_PROFILE_HPP
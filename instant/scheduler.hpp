@@ -0,0 +1,335 @@
+#ifndef INSTANT_SCHEDULER_HPP
+#define INSTANT_SCHEDULER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <instant/graph.hpp>
+#include <instant/load_onnx.hpp>
+
+namespace instant {
+
+    // The i-th element is the sorted list of indices of nodes producing
+    // inputs of the i-th node. Nodes must be topologically sorted
+    inline auto make_node_dependency_list(graph_ir const& ir) {
+        std::vector<std::vector<int>> dependency_list(ir.node_num());
+        for(int i = 0; i < ir.node_num(); ++i) {
+            auto& dependency = dependency_list[i];
+            for(auto input_id : ir.node(i).input_id_list) {
+                auto producer = ir.producer(input_id);
+                if(producer == -1) {
+                    continue; // model input or parameter
+                }
+                if(producer >= i) {
+                    throw onnx_load_error("Invalid node definition: " +
+                                          ir.node(i).op_type() + " " +
+                                          ir.node(i).proto->output(0));
+                }
+                dependency.push_back(producer);
+            }
+            std::sort(dependency.begin(), dependency.end());
+            dependency.erase(std::unique(dependency.begin(), dependency.end()),
+                             dependency.end());
+        }
+        return dependency_list;
+    }
+
+    inline auto make_node_dependency_list(onnx::GraphProto const& graph) {
+        return make_node_dependency_list(graph_ir(graph));
+    }
+
+    // Groups nodes into levels. Nodes of a level depend only on nodes of
+    // former levels, so they can run at the same time
+    inline auto
+    serialize_nodes(std::vector<std::vector<int>> const& dependency_list) {
+        std::vector<int> level_list(dependency_list.size(), 0);
+        std::vector<std::vector<int>> node_partial_order;
+        for(int i = 0; i < static_cast<int>(dependency_list.size()); ++i) {
+            for(auto d : dependency_list[i]) {
+                level_list[i] = std::max(level_list[i], level_list[d] + 1);
+            }
+            if(level_list[i] == static_cast<int>(node_partial_order.size())) {
+                node_partial_order.emplace_back();
+            }
+            node_partial_order[level_list[i]].push_back(i);
+        }
+        return node_partial_order;
+    }
+
+    // ancestor_table[i][j] is true when the j-th node has to finish before
+    // the i-th node starts
+    inline auto
+    make_ancestor_table(std::vector<std::vector<int>> const& dependency_list) {
+        auto node_num = dependency_list.size();
+        std::vector<std::vector<bool>> ancestor_table(
+          node_num, std::vector<bool>(node_num, false));
+        for(std::size_t i = 0; i < node_num; ++i) {
+            for(auto d : dependency_list[i]) {
+                ancestor_table[i][d] = true;
+                for(std::size_t j = 0; j < node_num; ++j) {
+                    if(ancestor_table[d][j]) {
+                        ancestor_table[i][j] = true;
+                    }
+                }
+            }
+        }
+        return ancestor_table;
+    }
+
+    // Divides thread_num threads equally among nodes of the same level
+    inline auto make_thread_budget_list(
+      std::vector<std::vector<int>> const& node_partial_order,
+      int thread_num) {
+        std::size_t node_num = 0;
+        for(auto const& level : node_partial_order) {
+            node_num += level.size();
+        }
+        std::vector<int> thread_budget_list(node_num, 1);
+        for(auto const& level : node_partial_order) {
+            for(auto i : level) {
+                thread_budget_list[i] =
+                  std::max(1, thread_num / static_cast<int>(level.size()));
+            }
+        }
+        return thread_budget_list;
+    }
+
+    inline auto get_max_intra_op_thread_num() {
+#ifdef _OPENMP
+        return omp_get_max_threads();
+#else
+        return 1;
+#endif
+    }
+
+    // Sets the number of threads primitives submitted from the calling
+    // thread use
+    inline auto set_intra_op_thread_num(int thread_num) {
+#ifdef _OPENMP
+        omp_set_num_threads(thread_num);
+#else
+        static_cast<void>(thread_num);
+#endif
+    }
+
+    // Runs nodes of a DAG on worker threads as soon as their dependencies
+    // finish. A worker pushes nodes made ready by itself to its own queue
+    // and takes the latest one, and steals the oldest one from another
+    // worker when its queue is empty
+    class dag_executor {
+    public:
+        explicit dag_executor(int worker_num) : queue_list_(worker_num) {
+            for(int i = 0; i < worker_num; ++i) {
+                worker_list_.emplace_back([this, i]() { work(i); });
+            }
+        }
+
+        dag_executor(dag_executor const&) = delete;
+        dag_executor& operator=(dag_executor const&) = delete;
+
+        ~dag_executor() {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                is_stopped_ = true;
+            }
+            job_started_.notify_all();
+            for(auto& worker : worker_list_) {
+                worker.join();
+            }
+        }
+
+        auto worker_num() const { return worker_list_.size(); }
+
+        // Calls task(i) for each node i after task(d) returns for all d in
+        // dependency_list[i]. The first exception thrown by task is
+        // rethrown after all nodes are processed (nodes depending on the
+        // failed one are skipped)
+        void run(std::vector<std::vector<int>> const& dependency_list,
+                 std::function<void(int)> const& task) {
+            std::lock_guard<std::mutex> run_lock(run_mutex_);
+            if(dependency_list.empty()) {
+                return;
+            }
+            std::vector<int> ready_list;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                task_ = &task;
+                exception_ = nullptr;
+                successor_list_.assign(dependency_list.size(), {});
+                remaining_dependency_num_list_ =
+                  std::make_unique<std::atomic<int>[]>(dependency_list.size());
+                for(int i = 0; i < static_cast<int>(dependency_list.size());
+                    ++i) {
+                    for(auto d : dependency_list[i]) {
+                        successor_list_[d].push_back(i);
+                    }
+                    remaining_dependency_num_list_[i] =
+                      dependency_list[i].size();
+                    if(dependency_list[i].empty()) {
+                        ready_list.push_back(i);
+                    }
+                }
+                remaining_node_num_ = dependency_list.size();
+                ++generation_;
+            }
+            for(std::size_t i = 0; i < ready_list.size(); ++i) {
+                push(i % queue_list_.size(), ready_list[i]);
+            }
+            job_started_.notify_all();
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            job_finished_.wait(lock, [this]() {
+                return remaining_node_num_ == 0 && active_worker_num_ == 0;
+            });
+            if(exception_) {
+                std::rethrow_exception(exception_);
+            }
+        }
+
+    private:
+        struct task_queue {
+            std::mutex mutex;
+            std::deque<int> deque;
+        };
+
+        void push(int worker_index, int node_index) {
+            {
+                // counted first so that the count never falls below the
+                // number of queued tasks
+                std::lock_guard<std::mutex> lock(mutex_);
+                ++queued_task_num_;
+            }
+            {
+                auto& queue = queue_list_[worker_index];
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                queue.deque.push_back(node_index);
+            }
+            task_pushed_.notify_one();
+        }
+
+        bool pop_or_steal(int worker_index, int& node_index) {
+            auto queue_num = static_cast<int>(queue_list_.size());
+            for(int k = 0; k < queue_num; ++k) {
+                auto& queue = queue_list_[(worker_index + k) % queue_num];
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                if(queue.deque.empty()) {
+                    continue;
+                }
+                if(k == 0) {
+                    node_index = queue.deque.back();
+                    queue.deque.pop_back();
+                } else {
+                    node_index = queue.deque.front();
+                    queue.deque.pop_front();
+                }
+                return true;
+            }
+            return false;
+        }
+
+        void work(int worker_index) {
+            std::size_t generation = 0;
+            while(true) {
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    job_started_.wait(lock, [this, generation]() {
+                        return is_stopped_ || generation_ != generation;
+                    });
+                    if(is_stopped_) {
+                        return;
+                    }
+                    generation = generation_;
+                    ++active_worker_num_;
+                }
+                process(worker_index);
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    --active_worker_num_;
+                }
+                job_finished_.notify_all();
+            }
+        }
+
+        void process(int worker_index) {
+            while(true) {
+                int node_index;
+                if(!pop_or_steal(worker_index, node_index)) {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    task_pushed_.wait(lock, [this]() {
+                        return queued_task_num_ != 0 ||
+                               remaining_node_num_ == 0;
+                    });
+                    if(remaining_node_num_ == 0) {
+                        return;
+                    }
+                    continue;
+                }
+                bool is_failed;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    --queued_task_num_;
+                    is_failed = static_cast<bool>(exception_);
+                }
+                if(!is_failed) {
+                    try {
+                        (*task_)(node_index);
+                    } catch(...) {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        if(!exception_) {
+                            exception_ = std::current_exception();
+                        }
+                    }
+                }
+                for(auto s : successor_list_[node_index]) {
+                    if(--remaining_dependency_num_list_[s] == 0) {
+                        push(worker_index, s);
+                    }
+                }
+                bool is_finished;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    is_finished = --remaining_node_num_ == 0;
+                }
+                if(is_finished) {
+                    task_pushed_.notify_all();
+                }
+            }
+        }
+
+        std::vector<task_queue> queue_list_;
+
+        std::mutex run_mutex_; // serializes run()
+        std::mutex mutex_;
+        std::condition_variable job_started_;
+        std::condition_variable task_pushed_;
+        std::condition_variable job_finished_;
+        bool is_stopped_ = false;
+        std::size_t generation_ = 0;
+        int active_worker_num_ = 0;
+        std::size_t queued_task_num_ = 0;
+        std::size_t remaining_node_num_ = 0;
+        std::function<void(int)> const* task_ = nullptr;
+        std::exception_ptr exception_;
+        std::vector<std::vector<int>> successor_list_;
+        std::unique_ptr<std::atomic<int>[]> remaining_dependency_num_list_;
+
+        std::vector<std::thread> worker_list_; // constructed last
+    };
+
+} // namespace instant
+
+#endif // INSTANT_SCHEDULER_HPP
@@ -0,0 +1,369 @@
+#ifndef INSTANT_TUNER_HPP
+#define INSTANT_TUNER_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <set>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include <mkldnn.hpp>
+
+#include <instant/isa.hpp>
+#include <instant/model.hpp>
+
+namespace instant {
+
+    // Key is the shape of a Conv layer and the ISA. Value is the winner:
+    // (algorithm, source format, destination format)
+    using conv_tuning_cache_t = std::unordered_map<
+      std::string, std::tuple<std::string, std::string, std::string>>;
+
+    // The cache file has one layer per line: "key algorithm src dst"
+    inline auto load_conv_tuning_cache(std::string const& filename) {
+        std::ifstream ifs(filename);
+        if(!ifs) {
+            throw std::runtime_error("File open error: " + filename);
+        }
+        conv_tuning_cache_t cache;
+        std::string key, algorithm, src_format, dst_format;
+        while(ifs >> key >> algorithm >> src_format >> dst_format) {
+            cache[key] = std::make_tuple(algorithm, src_format, dst_format);
+        }
+        return cache;
+    }
+
+    inline auto save_conv_tuning_cache(std::string const& filename,
+                                       conv_tuning_cache_t const& cache) {
+        std::ofstream ofs(filename);
+        if(!ofs) {
+            throw std::runtime_error("File open error: " + filename);
+        }
+        std::map<std::string, std::tuple<std::string, std::string, std::string>>
+          sorted_cache(cache.begin(), cache.end());
+        for(auto const& p : sorted_cache) {
+            ofs << p.first << " " << std::get<0>(p.second) << " "
+                << std::get<1>(p.second) << " " << std::get<2>(p.second)
+                << "\n";
+        }
+    }
+
+    inline auto format_to_string(mkldnn::memory::format format) {
+        for(auto const& name_and_format : get_tunable_format_table()) {
+            if(name_and_format.second == format) {
+                return name_and_format.first;
+            }
+        }
+        return std::to_string(static_cast<int>(format));
+    }
+
+    inline auto dims_to_string(std::vector<int> const& dims) {
+        std::string str;
+        for(auto d : dims) {
+            str += (str.empty() ? "" : "x") + std::to_string(d);
+        }
+        return str;
+    }
+
+    // The winner depends on the formats of the neighbors too, since they
+    // decide the reorders around Conv
+    inline auto
+    make_conv_tuning_key(std::string const& isa_name,
+                         graph_node const& node,
+                         mkldnn::memory const& input_memory,
+                         mkldnn::memory const& weight_memory,
+                         mkldnn::memory const& output_memory) {
+        auto const& attribute_table = node.attribute_table;
+        auto attributes = load_2d_data_processing_attributes(attribute_table);
+        std::string post_eltwise;
+        if(attribute_table.find("post_eltwise_op_types") !=
+           attribute_table.end()) {
+            onnx::AttributeProto const& op_types_attr =
+              find_value(attribute_table, "post_eltwise_op_types");
+            for(auto const& op_type : op_types_attr.strings()) {
+                post_eltwise += "+" + op_type;
+            }
+        }
+        return isa_name + ";" + dims_to_string(extract_dims(input_memory)) +
+               ";" + format_to_string(extract_format(input_memory)) + ";" +
+               dims_to_string(extract_dims(weight_memory)) + ";" +
+               dims_to_string(std::get<0>(attributes)) + ";" +
+               dims_to_string(std::get<2>(attributes)) + ";" +
+               dims_to_string(std::get<3>(attributes)) + ";" +
+               (node.input_size() == 2 ? "nobias" : "bias") + post_eltwise +
+               ";" + format_to_string(extract_format(output_memory));
+    }
+
+    // Runs net iteration_num times after a warm up and returns the
+    // shortest time in seconds
+    inline auto measure_net_time(std::vector<mkldnn::primitive> const& net,
+                                 int iteration_num) {
+        mkldnn::stream(mkldnn::stream::kind::eager).submit(net).wait();
+        auto best_time = std::numeric_limits<double>::max();
+        for(int i = 0; i < iteration_num; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            mkldnn::stream(mkldnn::stream::kind::eager).submit(net).wait();
+            auto end = std::chrono::steady_clock::now();
+            best_time = std::min(
+              best_time, std::chrono::duration<double>(end - start).count());
+        }
+        return best_time;
+    }
+
+    inline auto make_zero_memory(mkldnn::memory::primitive_desc const& pd) {
+        auto mem = mkldnn::memory(pd);
+        std::memset(mem.get_data_handle(), 0, pd.get_size());
+        return mem;
+    }
+
+    // Measures every combination of algorithm and source/destination format
+    // MKL-DNN supports for the Conv node. The time includes the reorder
+    // from the format of input_memory and the reorder to the format of
+    // output_memory (the ones the neighbors use without tuning)
+    inline auto tune_conv_node(
+      graph_node const& node,
+      std::unordered_map<std::string, const mkldnn::memory> const&
+        parameter_memory_table,
+      mkldnn::memory const& input_memory, mkldnn::memory const& output_memory,
+      mkldnn::engine const& engine, int iteration_num) {
+        auto const& attribute_table = node.attribute_table;
+        auto attributes = load_2d_data_processing_attributes(attribute_table);
+        auto const& strides = std::get<0>(attributes);
+        auto const& padding_l = std::get<2>(attributes);
+        auto const& padding_r = std::get<3>(attributes);
+        auto conv_attr = make_post_eltwise_attr(attribute_table);
+        auto weight_dims =
+          extract_dims(find_value(parameter_memory_table, node.input(1)));
+        auto has_bias = node.input_size() != 2;
+
+        auto input_pd = input_memory.get_primitive_desc();
+        auto output_pd = output_memory.get_primitive_desc();
+        auto input = make_zero_memory(input_pd);
+        auto output = make_zero_memory(output_pd);
+
+        std::tuple<std::string, std::string, std::string> winner(
+          "direct", "any", "any");
+        auto best_time = std::numeric_limits<double>::max();
+        std::set<std::tuple<int, int, int>> tried_set;
+        for(auto const& algorithm_name : {"direct", "winograd"}) {
+            auto algorithm = std::string(algorithm_name) == "winograd"
+                               ? mkldnn::algorithm::convolution_winograd
+                               : mkldnn::algorithm::convolution_direct;
+            for(auto const& src : get_tunable_format_table()) {
+                for(auto const& dst : get_tunable_format_table()) {
+                    auto src_md = mkldnn::memory::desc(
+                      {extract_dims(input_memory)},
+                      mkldnn::memory::data_type::f32, src.second);
+                    auto weight_md = mkldnn::memory::desc(
+                      {weight_dims}, mkldnn::memory::data_type::f32,
+                      mkldnn::memory::format::any);
+                    auto dst_md = mkldnn::memory::desc(
+                      {extract_dims(output_memory)},
+                      mkldnn::memory::data_type::f32, dst.second);
+                    std::unique_ptr<mkldnn::convolution_forward::primitive_desc>
+                      conv_pd_p;
+                    try {
+                        auto conv_desc =
+                          has_bias
+                            ? mkldnn::convolution_forward::desc(
+                                mkldnn::prop_kind::forward_inference,
+                                algorithm, src_md, weight_md,
+                                find_value(parameter_memory_table,
+                                           node.input(2))
+                                  .get_primitive_desc()
+                                  .desc(),
+                                dst_md, strides, padding_l, padding_r,
+                                mkldnn::padding_kind::zero)
+                            : mkldnn::convolution_forward::desc(
+                                mkldnn::prop_kind::forward_inference,
+                                algorithm, src_md, weight_md, dst_md, strides,
+                                padding_l, padding_r,
+                                mkldnn::padding_kind::zero);
+                        conv_pd_p = std::make_unique<
+                          mkldnn::convolution_forward::primitive_desc>(
+                          conv_desc, conv_attr, engine);
+                    } catch(mkldnn::error const&) {
+                        continue; // not supported on this CPU
+                    }
+                    auto const& conv_pd = *conv_pd_p;
+
+                    auto conv_input =
+                      conv_pd.src_primitive_desc() == input_pd
+                        ? input
+                        : make_zero_memory(conv_pd.src_primitive_desc());
+                    auto conv_output =
+                      conv_pd.dst_primitive_desc() == output_pd
+                        ? output
+                        : make_zero_memory(conv_pd.dst_primitive_desc());
+                    // "any" may resolve to a format tried already
+                    if(!tried_set
+                          .insert(std::make_tuple(
+                            static_cast<int>(algorithm),
+                            static_cast<int>(extract_format(conv_input)),
+                            static_cast<int>(extract_format(conv_output))))
+                          .second) {
+                        continue;
+                    }
+
+                    std::vector<mkldnn::primitive> net;
+                    if(conv_input != input) {
+                        net.push_back(mkldnn::reorder(input, conv_input));
+                    }
+                    auto weight =
+                      make_zero_memory(conv_pd.weights_primitive_desc());
+                    if(has_bias) {
+                        auto bias =
+                          make_zero_memory(conv_pd.bias_primitive_desc());
+                        net.push_back(mkldnn::convolution_forward(
+                          conv_pd, conv_input, weight, bias, conv_output));
+                    } else {
+                        net.push_back(mkldnn::convolution_forward(
+                          conv_pd, conv_input, weight, conv_output));
+                    }
+                    if(conv_output != output) {
+                        net.push_back(mkldnn::reorder(conv_output, output));
+                    }
+
+                    auto time = measure_net_time(net, iteration_num);
+                    if(time < best_time) {
+                        best_time = time;
+                        winner = std::make_tuple(algorithm_name, src.first,
+                                                 dst.first);
+                    }
+                }
+            }
+        }
+        return winner;
+    }
+
+    // Chooses the algorithm and the source/destination formats of each f32
+    // Conv by measuring them, and records them in "tuned_*" attributes
+    // read by make_conv_primitive. Layers found in cache are not measured
+    // and new winners are added to cache
+    inline auto tune_conv(
+      graph_ir& ir,
+      std::unordered_map<std::string, array> const& parameter_table,
+      std::vector<std::tuple<std::string, dtype_t, std::vector<int>,
+                             mkldnn::memory::format>> const&
+        input_name_dtype_dims_format_list,
+      std::set<std::string> const& required_output_set,
+      conv_tuning_cache_t& cache, mkldnn::engine const& engine,
+      int iteration_num = 10) {
+        auto parameter_memory_table_and_temp_array_list =
+          make_parameter_memory_table(ir, parameter_table, engine);
+        auto const& parameter_memory_table =
+          std::get<0>(parameter_memory_table_and_temp_array_list);
+        std::vector<std::tuple<std::string, array, mkldnn::memory::format>>
+          input_list;
+        for(auto const& input_name_dtype_dims_format :
+            input_name_dtype_dims_format_list) {
+            input_list.push_back(std::make_tuple(
+              std::get<0>(input_name_dtype_dims_format),
+              array(std::get<1>(input_name_dtype_dims_format),
+                    std::get<2>(input_name_dtype_dims_format)),
+              std::get<3>(input_name_dtype_dims_format)));
+        }
+        auto isa_name = get_cpu_isa_name();
+        std::unordered_map<graph_node const*, int> node_index_table;
+        for(int i = 0; i < ir.node_num(); ++i) {
+            node_index_table.insert({&ir.node(i), i});
+        }
+
+        // Each Conv is tuned while the nets are made once. Former Convs are
+        // tuned already when a latter one is made, so the input format it
+        // sees is the one it gets in the final nets
+        auto primitive_factory_table = make_default_primitive_factory_table();
+        auto conv_factory = find_value(primitive_factory_table, "Conv");
+        primitive_factory_table["Conv"] =
+          [&](std::unordered_map<std::string, const mkldnn::memory> const&
+                parameter_memory_table,
+              std::unordered_map<
+                std::string,
+                std::tuple<const mkldnn::memory, mkldnn::memory::format>> const&
+                variable_memory_table,
+              std::set<std::string> const& required_output_set,
+              graph_node const& node, mkldnn::engine const& engine) {
+              auto quantization =
+                load_quantization_attributes(node.attribute_table);
+              if(std::get<0>(quantization)) {
+                  // only f32 Conv is tuned
+                  return conv_factory(parameter_memory_table,
+                                      variable_memory_table,
+                                      required_output_set, node, engine);
+              }
+              // Only the primitive descriptors of the untuned Conv are used
+              // to know its output format (the one its neighbors see)
+              auto untuned =
+                conv_factory(parameter_memory_table, variable_memory_table,
+                             required_output_set, node, engine);
+              auto const& input_memory = std::get<0>(
+                find_value(variable_memory_table, node.input(0)));
+              auto const& output_name_and_memory_list = std::get<1>(untuned);
+              auto const& output_memory = std::get<0>(
+                std::find_if(output_name_and_memory_list.begin(),
+                             output_name_and_memory_list.end(),
+                             [&node](auto const& name_and_memory) {
+                                 return name_and_memory.first ==
+                                        node.output(0);
+                             })
+                  ->second);
+
+              auto key = make_conv_tuning_key(
+                isa_name, node, input_memory,
+                find_value(parameter_memory_table, node.input(1)),
+                output_memory);
+              auto found = cache.find(key);
+              if(found == cache.end()) {
+                  found = cache
+                            .insert({key, tune_conv_node(
+                                            node, parameter_memory_table,
+                                            input_memory, output_memory,
+                                            engine, iteration_num)})
+                            .first;
+              }
+
+              auto const& winner = found->second;
+              std::vector<std::pair<std::string, std::string>>
+                attribute_list{{"tuned_conv_algorithm", std::get<0>(winner)},
+                               {"tuned_src_format", std::get<1>(winner)},
+                               {"tuned_dst_format", std::get<2>(winner)}};
+              auto node_index = node_index_table.at(&node);
+              for(auto const& name_and_value : attribute_list) {
+                  ir.mutable_attribute(
+                    node_index, name_and_value.first,
+                    onnx::AttributeProto_AttributeType_STRING)
+                    .set_s(name_and_value.second);
+              }
+              return conv_factory(parameter_memory_table,
+                                  variable_memory_table, required_output_set,
+                                  node, engine);
+          };
+        auto input_memory_table =
+          make_variable_memory_table(input_list, engine);
+        make_nets(ir, parameter_memory_table, input_memory_table,
+                  required_output_set, primitive_factory_table);
+    }
+
+    inline auto tune_conv(
+      onnx::GraphProto& graph,
+      std::unordered_map<std::string, array> const& parameter_table,
+      std::vector<std::tuple<std::string, dtype_t, std::vector<int>,
+                             mkldnn::memory::format>> const&
+        input_name_dtype_dims_format_list,
+      std::set<std::string> const& required_output_set,
+      conv_tuning_cache_t& cache, mkldnn::engine const& engine,
+      int iteration_num = 10) {
+        graph_ir ir(graph);
+        tune_conv(ir, parameter_table, input_name_dtype_dims_format_list,
+                  required_output_set, cache, engine, iteration_num);
+    }
+
+} // namespace instant
+
+#endif // INSTANT_TUNER_HPP
@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+
+#include "common.hpp"
+#include "onnx_builder.hpp"
+
+#include <instant/batching_server.hpp>
+
+namespace instant {
+    namespace {
+
+        TEST(BatchingServerTest, run_batched_requests) {
+            onnx::ModelProto onnx_model;
+            auto& graph = *onnx_model.mutable_graph();
+            add_initializer(graph, "w", make_test_array({8, 3, 3, 3}, 1));
+            add_initializer(graph, "b", make_test_array({8}, 2));
+            add_node(graph, "Conv", {"x", "w", "b"}, {"h"},
+                     {make_ints_attribute("strides", {1, 1}),
+                      make_ints_attribute("kernel_shape", {3, 3}),
+                      make_ints_attribute("pads", {1, 1, 1, 1})});
+            add_node(graph, "Relu", {"h"}, {"y"});
+            std::vector<int> input_dims{1, 3, 8, 8};
+            auto compiled = make_compiled_model(
+              onnx_model, make_parameter_table(graph),
+              {std::make_tuple("x", dtype_t::float_, input_dims,
+                               mkldnn::memory::format::nchw)},
+              {"y"});
+
+            constexpr int request_num = 10;
+            constexpr std::size_t max_batch_size = 4;
+            std::vector<array> input_list;
+            std::vector<std::vector<float>> true_output_list;
+            auto context = make_execution_context(compiled);
+            for(int i = 0; i < request_num; ++i) {
+                input_list.push_back(make_test_array(input_dims, i));
+                std::copy(fbegin(input_list.back()), fend(input_list.back()),
+                          fbegin(context.input("x")));
+                auto const& output = find_value(context.run(), "y");
+                true_output_list.emplace_back(fbegin(output), fend(output));
+            }
+
+            batching_server server(compiled, max_batch_size,
+                                   std::chrono::milliseconds(10));
+            std::vector<std::future<batching_server::output_table_t>>
+              future_list;
+            for(int i = 0; i < request_num; ++i) {
+                future_list.push_back(server.submit({{"x", input_list[i]}}));
+            }
+            for(int i = 0; i < request_num; ++i) {
+                auto output_table = future_list[i].get();
+                auto const& output = find_value(output_table, "y");
+                ASSERT_EQ(output.dims()[0], 1);
+                assert_near_list(fbegin(output), fend(output),
+                                 true_output_list[i].begin(),
+                                 true_output_list[i].end(), 10.e-4);
+            }
+
+            auto batch_size_histogram = server.batch_size_histogram();
+            ASSERT_EQ(batch_size_histogram.size(), max_batch_size + 1);
+            int processed_num = 0;
+            for(std::size_t i = 0; i < batch_size_histogram.size(); ++i) {
+                processed_num += i * batch_size_histogram[i];
+            }
+            ASSERT_EQ(processed_num, request_num);
+            auto queue_depth_histogram = server.queue_depth_histogram();
+            ASSERT_EQ(std::accumulate(queue_depth_histogram.begin(),
+                                      queue_depth_histogram.end(), 0),
+                      request_num);
+
+            auto invalid_input = make_test_array({2, 3, 8, 8});
+            ASSERT_THROW(server.submit({{"x", invalid_input}}),
+                         std::runtime_error);
+        }
+
+    } // namespace
+} // namespace instant
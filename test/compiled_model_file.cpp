@@ -0,0 +1,201 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "common.hpp"
+#include "onnx_builder.hpp"
+
+#include <instant/compiled_model_file.hpp>
+
+namespace instant {
+    namespace {
+
+        auto make_conv_bn_fc_model() {
+            onnx::ModelProto onnx_model;
+            auto& graph = *onnx_model.mutable_graph();
+            add_initializer(graph, "w", make_test_array({8, 3, 3, 3}, 1));
+            add_initializer(graph, "b", make_test_array({8}, 2));
+            add_initializer(graph, "scale", make_test_array({8}, 3));
+            add_initializer(graph, "bn_b", make_test_array({8}, 4));
+            add_initializer(graph, "mean", make_test_array({8}, 5));
+            add_initializer(graph, "var", uniforms(dtype_t::float_, {8}, 1.));
+            add_initializer(graph, "fc_w", make_test_array({10, 8 * 8 * 8}, 6));
+            add_initializer(graph, "fc_b", make_test_array({10}, 7));
+            add_node(graph, "Conv", {"x", "w", "b"}, {"h"},
+                     {make_ints_attribute("strides", {1, 1}),
+                      make_ints_attribute("kernel_shape", {3, 3}),
+                      make_ints_attribute("pads", {1, 1, 1, 1})});
+            add_node(graph, "BatchNormalization",
+                     {"h", "scale", "bn_b", "mean", "var"}, {"bn"},
+                     {make_float_attribute("epsilon", 1e-5f),
+                      make_int_attribute("is_test", 1),
+                      make_int_attribute("spatial", 1)});
+            add_node(graph, "Relu", {"bn"}, {"r"});
+            add_node(graph, "Reshape", {"r"}, {"flatten"},
+                     {make_ints_attribute("shape", {1, -1})});
+            add_node(graph, "FC", {"flatten", "fc_w", "fc_b"}, {"y"},
+                     {make_int_attribute("axis", 1),
+                      make_int_attribute("axis_w", 1)});
+            return onnx_model;
+        }
+
+        auto make_input_list() {
+            return std::vector<std::tuple<std::string, dtype_t,
+                                          std::vector<int>,
+                                          mkldnn::memory::format>>{
+              std::make_tuple("x", dtype_t::float_,
+                              std::vector<int>{1, 3, 8, 8},
+                              mkldnn::memory::format::nchw)};
+        }
+
+        auto run(std::shared_ptr<const compiled_model> const& compiled,
+                 array const& input) {
+            auto context = make_execution_context(compiled);
+            std::copy(fbegin(input), fend(input), fbegin(context.input("x")));
+            return find_value(context.run(), "y");
+        }
+
+        TEST(CompiledModelFileTest, save_and_load_compiled_model) {
+            auto onnx_model = make_conv_bn_fc_model();
+            auto compiled = make_compiled_model(
+              onnx_model, make_parameter_table(onnx_model.graph()),
+              make_input_list(), {"y"});
+            auto filename = "compiled_model_test.bin";
+            save_compiled_model(filename, *compiled);
+            auto loaded = load_compiled_model(filename);
+            std::remove(filename); // the mapping is still valid
+
+            ASSERT_TRUE(loaded->input_name_dtype_dims_format_list() ==
+                        compiled->input_name_dtype_dims_format_list());
+            ASSERT_EQ(loaded->required_output_set(),
+                      compiled->required_output_set());
+            ASSERT_EQ(loaded->parameter_size(), compiled->parameter_size());
+            for(auto const& name_and_memory :
+                loaded->parameter_memory_table()) {
+                auto address = reinterpret_cast<std::uintptr_t>(
+                  name_and_memory.second.get_data_handle());
+                ASSERT_EQ(address % compiled_model_file_alignment, 0);
+            }
+
+            auto input = make_test_array({1, 3, 8, 8});
+            auto output = run(compiled, input);
+            auto loaded_output = run(loaded, input);
+            assert_eq_list(fbegin(loaded_output), fend(loaded_output),
+                           fbegin(output), fend(output));
+        }
+
+        TEST(CompiledModelFileTest, environment_identifies_mkldnn_build) {
+            auto fingerprint = get_mkldnn_fingerprint();
+            ASSERT_FALSE(fingerprint.empty());
+            ASSERT_EQ(get_mkldnn_fingerprint(), fingerprint);
+            ASSERT_NE(get_compiled_model_file_environment().find(fingerprint),
+                      std::string::npos);
+        }
+
+        TEST(CompiledModelFileTest, rebuild_on_environment_mismatch) {
+            auto onnx_model = make_conv_bn_fc_model();
+            auto onnx_filename = "compiled_model_test.onnx";
+            {
+                std::ofstream ofs(onnx_filename, std::ios::binary);
+                onnx_model.SerializeToOstream(&ofs);
+            }
+            auto filename = "compiled_model_test.bin";
+            std::remove(filename);
+            auto compiled = load_or_make_compiled_model(
+              filename, onnx_filename, make_input_list(), {"y"});
+            ASSERT_NO_THROW(load_compiled_model(filename));
+
+            // pretends the file is made on another CPU
+            std::string content;
+            {
+                std::ifstream ifs(filename, std::ios::binary);
+                content.assign(std::istreambuf_iterator<char>(ifs),
+                               std::istreambuf_iterator<char>());
+            }
+            auto environment = get_compiled_model_file_environment();
+            auto pos = content.find(environment);
+            ASSERT_NE(pos, std::string::npos);
+            content[pos] = '?';
+            {
+                std::ofstream ofs(filename, std::ios::binary);
+                ofs << content;
+            }
+            ASSERT_THROW(load_compiled_model(filename),
+                         compiled_model_file_error);
+
+            auto rebuilt = load_or_make_compiled_model(
+              filename, onnx_filename, make_input_list(), {"y"});
+            ASSERT_NO_THROW(load_compiled_model(filename)); // overwritten
+            std::remove(filename);
+            std::remove(onnx_filename);
+
+            auto input = make_test_array({1, 3, 8, 8});
+            auto output = run(compiled, input);
+            auto rebuilt_output = run(rebuilt, input);
+            assert_eq_list(fbegin(rebuilt_output), fend(rebuilt_output),
+                           fbegin(output), fend(output));
+        }
+
+        TEST(CompiledModelFileTest, rebuild_on_corrupt_enum) {
+            auto onnx_model = make_conv_bn_fc_model();
+            auto onnx_filename = "compiled_model_test.onnx";
+            {
+                std::ofstream ofs(onnx_filename, std::ios::binary);
+                onnx_model.SerializeToOstream(&ofs);
+            }
+            auto filename = "compiled_model_test.bin";
+            std::remove(filename);
+            load_or_make_compiled_model(filename, onnx_filename,
+                                        make_input_list(), {"y"});
+            std::string content;
+            {
+                std::ifstream ifs(filename, std::ios::binary);
+                content.assign(std::istreambuf_iterator<char>(ifs),
+                               std::istreambuf_iterator<char>());
+            }
+
+            // the input "x" is saved as name, dtype, dims and format
+            std::string input_entry;
+            auto append = [&input_entry](auto value) {
+                input_entry.append(reinterpret_cast<char const*>(&value),
+                                   sizeof(value));
+            };
+            append(std::uint64_t(1));
+            input_entry += "x";
+            append(static_cast<std::int32_t>(dtype_t::float_));
+            append(std::uint32_t(4));
+            for(std::int32_t d : {1, 3, 8, 8}) {
+                append(d);
+            }
+            auto pos = content.find(input_entry);
+            ASSERT_NE(pos, std::string::npos);
+            auto dtype_pos = pos + sizeof(std::uint64_t) + 1;
+            auto format_pos = pos + input_entry.size();
+
+            for(auto corrupt_pos : {dtype_pos, format_pos}) {
+                auto corrupt_content = content;
+                std::int32_t invalid_value = 0x7fffffff;
+                std::memcpy(&corrupt_content[corrupt_pos], &invalid_value,
+                            sizeof(invalid_value));
+                {
+                    std::ofstream ofs(filename, std::ios::binary);
+                    ofs << corrupt_content;
+                }
+                ASSERT_THROW(load_compiled_model(filename),
+                             compiled_model_file_error);
+                auto rebuilt = load_or_make_compiled_model(
+                  filename, onnx_filename, make_input_list(), {"y"});
+                ASSERT_NO_THROW(load_compiled_model(filename)); // overwritten
+                auto output = run(rebuilt, make_test_array({1, 3, 8, 8}));
+                ASSERT_EQ(output.dims(), (std::vector<int>{1, 10}));
+            }
+            std::remove(filename);
+            std::remove(onnx_filename);
+        }
+
+    } // namespace
+} // namespace instant
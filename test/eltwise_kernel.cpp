@@ -0,0 +1,278 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <instant/eltwise_kernel.hpp>
+
+namespace instant {
+    namespace {
+
+        // ISAs the running CPU can run the kernels of
+        auto make_runnable_isa_name_list() {
+            std::vector<std::string> isa_name_list{"generic"};
+            auto cpu_isa_name = get_cpu_isa_name();
+            if(cpu_isa_name == "avx2" || cpu_isa_name == "avx512") {
+                isa_name_list.push_back("avx2");
+            }
+            if(cpu_isa_name == "avx512") {
+                isa_name_list.push_back("avx512");
+            }
+            return isa_name_list;
+        }
+
+        // Values in (-range, range) of n elements, never zero and positive
+        // for operations defined on them
+        auto make_eltwise_input(eltwise_kind kind, std::size_t n,
+                                float range) {
+            std::vector<float> x(n);
+            for(std::size_t i = 0; i < n; ++i) {
+                x[i] = range * ((i * 7919 % 2000 + 0.5f) / 1000.f - 1.f);
+                if(kind == eltwise_kind::log || kind == eltwise_kind::sqrt) {
+                    x[i] = std::abs(x[i]) + 1e-3f;
+                }
+            }
+            return x;
+        }
+
+        TEST(EltwiseKernelTest, kernels_match_reference) {
+            std::vector<eltwise_op> op_list{
+              {eltwise_kind::abs, 0.f, 0.f},
+              {eltwise_kind::clip, -1.f, 2.f},
+              {eltwise_kind::elu, 0.5f, 0.f},
+              {eltwise_kind::exp, 0.f, 0.f},
+              {eltwise_kind::hard_sigmoid, 0.2f, 0.5f},
+              {eltwise_kind::leaky_relu, 0.1f, 0.f},
+              {eltwise_kind::log, 0.f, 0.f},
+              {eltwise_kind::neg, 0.f, 0.f},
+              {eltwise_kind::reciprocal, 0.f, 0.f},
+              {eltwise_kind::relu, 0.f, 0.f},
+              {eltwise_kind::sigmoid, 0.f, 0.f},
+              {eltwise_kind::sqrt, 0.f, 0.f},
+              {eltwise_kind::tanh, 0.f, 0.f}};
+            // sizes not of whole vectors leave remainders
+            for(auto const& isa_name : make_runnable_isa_name_list()) {
+                auto kernel = get_eltwise_kernel(isa_name);
+                for(auto const& op : op_list) {
+                    for(auto n : {std::size_t(1), std::size_t(37),
+                                  std::size_t(40000)}) {
+                        // 88.7 reaches both ends of exp in float
+                        for(auto range : {1.f, 50.f, 88.7f}) {
+                            auto x = make_eltwise_input(op.kind, n, range);
+                            std::vector<float> y(n);
+                            run_eltwise_kernel(kernel, op, x.data(), y.data(),
+                                               n);
+                            for(std::size_t i = 0; i < n; ++i) {
+                                auto r = apply_eltwise_op_reference(op, x[i]);
+                                ASSERT_NEAR(y[i], r,
+                                            1e-6f *
+                                              std::max(1.f, std::abs(r)))
+                                  << isa_name << " "
+                                  << static_cast<int>(op.kind) << " of "
+                                  << x[i];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        TEST(EltwiseKernelTest, special_values) {
+            auto inf = std::numeric_limits<float>::infinity();
+            std::vector<float> x{0.f, -1.f, inf, 100.f, -100.f};
+            for(auto const& isa_name : make_runnable_isa_name_list()) {
+                auto kernel = get_eltwise_kernel(isa_name);
+                std::vector<float> y(x.size());
+                kernel({eltwise_kind::log, 0.f, 0.f}, x.data(), y.data(),
+                       x.size());
+                ASSERT_EQ(y[0], -inf);
+                ASSERT_TRUE(std::isnan(y[1]));
+                ASSERT_EQ(y[2], inf);
+                kernel({eltwise_kind::exp, 0.f, 0.f}, x.data(), y.data(),
+                       x.size());
+                ASSERT_EQ(y[0], 1.f);
+                ASSERT_EQ(y[3], inf);
+                ASSERT_NEAR(y[4], 0.f, 1e-30f);
+                kernel({eltwise_kind::sigmoid, 0.f, 0.f}, x.data(), y.data(),
+                       x.size());
+                ASSERT_EQ(y[3], 1.f);
+                ASSERT_NEAR(y[4], 0.f, 1e-30f);
+                kernel({eltwise_kind::tanh, 0.f, 0.f}, x.data(), y.data(),
+                       x.size());
+                ASSERT_EQ(y[2], 1.f);
+                ASSERT_EQ(y[4], -1.f);
+                kernel({eltwise_kind::sqrt, 0.f, 0.f}, x.data(), y.data(),
+                       x.size());
+                ASSERT_EQ(y[0], 0.f);
+                ASSERT_TRUE(std::isnan(y[1]));
+                ASSERT_EQ(y[2], inf);
+                ASSERT_EQ(y[3], 10.f);
+            }
+        }
+
+        TEST(EltwiseKernelTest, exp_covers_float_range) {
+            auto inf = std::numeric_limits<float>::infinity();
+            std::vector<float> x{88.7f,   88.72f, -87.3f, -87.33f,
+                                 -87.34f, -100.f, -inf,   89.f};
+            for(auto const& isa_name : make_runnable_isa_name_list()) {
+                auto kernel = get_eltwise_kernel(isa_name);
+                std::vector<float> y(x.size());
+                kernel({eltwise_kind::exp, 0.f, 0.f}, x.data(), y.data(),
+                       x.size());
+                for(std::size_t i = 0; i < x.size(); ++i) {
+                    auto r = std::exp(x[i]);
+                    if(r == inf) {
+                        ASSERT_EQ(y[i], inf) << isa_name << " " << x[i];
+                    } else if(r < std::numeric_limits<float>::min()) {
+                        // flushed below the normal range
+                        ASSERT_EQ(y[i], 0.f) << isa_name << " " << x[i];
+                    } else {
+                        ASSERT_NEAR(y[i], r, 1e-6f * r)
+                          << isa_name << " " << x[i];
+                    }
+                }
+            }
+        }
+
+        TEST(EltwiseKernelTest, chain_kernels_match_reference) {
+            // Add->Relu->Clip and Mul->Add->Sigmoid like tails
+            std::vector<std::vector<eltwise_op>> op_list_list{
+              {{eltwise_kind::relu, 0.f, 0.f},
+               {eltwise_kind::clip, 0.f, 6.f}},
+              {{eltwise_kind::neg, 0.f, 0.f},
+               {eltwise_kind::exp, 0.f, 0.f},
+               {eltwise_kind::log, 0.f, 0.f},
+               {eltwise_kind::sigmoid, 0.f, 0.f}},
+              {{eltwise_kind::abs, 0.f, 0.f},
+               {eltwise_kind::sqrt, 0.f, 0.f},
+               {eltwise_kind::tanh, 0.f, 0.f},
+               {eltwise_kind::hard_sigmoid, 0.2f, 0.5f}}};
+            for(auto const& isa_name : make_runnable_isa_name_list()) {
+                auto kernel = get_eltwise_chain_kernel(isa_name);
+                for(auto const& op_list : op_list_list) {
+                    for(auto n : {std::size_t(1), std::size_t(37),
+                                  std::size_t(40000)}) {
+                        auto x = make_eltwise_input(eltwise_kind::relu, n,
+                                                    10.f);
+                        std::vector<float> y(n);
+                        run_eltwise_kernel(kernel, op_list, x.data(),
+                                           y.data(), n);
+                        std::vector<float> r(n);
+                        run_eltwise_chain_reference(op_list, x.data(),
+                                                    r.data(), n);
+                        for(std::size_t i = 0; i < n; ++i) {
+                            ASSERT_NEAR(y[i], r[i],
+                                        1e-5f * std::max(1.f, std::abs(r[i])))
+                              << isa_name << " of " << x[i];
+                        }
+                    }
+                }
+            }
+        }
+
+        TEST(EltwiseKernelTest, lane_affine_kernels_match_reference) {
+            // Mul->Add->Sigmoid like chain with constants over a period
+            constexpr std::size_t period = 48;
+            std::vector<float> scale_list(period), shift_list(period);
+            for(std::size_t k = 0; k < period; ++k) {
+                scale_list[k] = 1.f + 0.01f * k;
+                shift_list[k] = 0.1f * k - 2.f;
+            }
+            std::vector<eltwise_op> op_list{
+              {eltwise_kind::affine, 2.f, 1.f},
+              {eltwise_kind::lane_affine, 0.f, 0.f, scale_list.data(),
+               shift_list.data(), period},
+              {eltwise_kind::sigmoid, 0.f, 0.f}};
+            auto isa_name_list = make_runnable_isa_name_list();
+            isa_name_list.push_back("reference");
+            for(auto const& isa_name : isa_name_list) {
+                auto kernel = get_eltwise_chain_kernel(isa_name);
+                for(auto n : {std::size_t(1), std::size_t(37),
+                              std::size_t(40000)}) {
+                    auto x = make_eltwise_input(eltwise_kind::relu, n, 10.f);
+                    std::vector<float> y(n);
+                    kernel(op_list, x.data(), y.data(), n);
+                    for(std::size_t i = 0; i < n; ++i) {
+                        auto r = 1.f / (1.f + std::exp(-(
+                                                scale_list[i % period] *
+                                                  (2.f * x[i] + 1.f) +
+                                                shift_list[i % period])));
+                        ASSERT_NEAR(y[i], r, 1e-5f) << isa_name << " at " << i;
+                    }
+                }
+            }
+        }
+
+        TEST(EltwiseKernelTest, run_segment) {
+            // spans of 100 elements alternate between two lists
+            std::vector<float> list_data(4 * 16);
+            std::fill(list_data.begin(), list_data.begin() + 16, 2.f);
+            std::fill(list_data.begin() + 32, list_data.begin() + 48, 3.f);
+            eltwise_segment segment{{}, 100, 16, nullptr};
+            for(int g = 0; g < 2; ++g) {
+                auto const* list = list_data.data() + g * 32;
+                segment.op_list_list.push_back(
+                  {{eltwise_kind::lane_affine, 0.f, 0.f, list, list + 16, 16},
+                   {eltwise_kind::relu, 0.f, 0.f}});
+            }
+            auto x = make_eltwise_input(eltwise_kind::relu, 400, 1.f);
+            std::vector<float> y(x.size());
+            run_eltwise_kernel(get_eltwise_chain_kernel(), segment, x.data(),
+                               y.data(), x.size());
+            for(std::size_t i = 0; i < x.size(); ++i) {
+                ASSERT_EQ(y[i], std::max((i / 100 % 2 + 2.f) * x[i], 0.f))
+                  << i;
+            }
+        }
+
+        TEST(EltwiseKernelTest, run_in_place) {
+            auto x = make_eltwise_input(eltwise_kind::relu, 100, 1.f);
+            auto y = x;
+            run_eltwise_kernel(get_eltwise_kernel(),
+                               {eltwise_kind::relu, 0.f, 0.f}, y.data(),
+                               y.data(), y.size());
+            for(std::size_t i = 0; i < x.size(); ++i) {
+                ASSERT_EQ(y[i], std::max(x[i], 0.f));
+            }
+        }
+
+        TEST(EltwiseKernelTest, add_kernels_match_reference) {
+            auto isa_name_list = make_runnable_isa_name_list();
+            isa_name_list.push_back("reference");
+            for(auto const& isa_name : isa_name_list) {
+                auto kernel = get_add_kernel(isa_name);
+                for(auto n : {std::size_t(1), std::size_t(37),
+                              std::size_t(40000)}) {
+                    auto a = make_eltwise_input(eltwise_kind::abs, n, 50.f);
+                    auto b = make_eltwise_input(eltwise_kind::abs, n, 1.f);
+                    std::reverse(b.begin(), b.end());
+                    // a scalar operand is broadcast
+                    for(auto a_step : {0, 1}) {
+                        for(auto b_step : {0, 1}) {
+                            std::vector<float> c(n);
+                            kernel(a.data(), a_step, b.data(), b_step,
+                                   c.data(), n);
+                            for(std::size_t i = 0; i < n; ++i) {
+                                ASSERT_EQ(c[i],
+                                          a[i * a_step] + b[i * b_step])
+                                  << isa_name << " " << a_step << " "
+                                  << b_step << " at " << i;
+                            }
+                        }
+                    }
+
+                    // in place
+                    auto c = a;
+                    kernel(c.data(), 1, b.data(), 0, c.data(), n);
+                    for(std::size_t i = 0; i < n; ++i) {
+                        ASSERT_EQ(c[i], a[i] + b[0]) << isa_name;
+                    }
+                }
+            }
+        }
+
+    } // namespace
+} // namespace instant
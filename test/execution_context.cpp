@@ -0,0 +1,334 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <fstream>
+#include <thread>
+
+#include <unistd.h>
+
+#include "common.hpp"
+#include "onnx_builder.hpp"
+
+#include <instant/instant.hpp>
+
+namespace instant {
+    namespace {
+
+        class ExecutionContextTest : public ::testing::Test {
+        protected:
+            ExecutionContextTest() = default;
+            virtual void SetUp() {
+                auto& graph = *onnx_model_.mutable_graph();
+                add_initializer(graph, "w", make_test_array({16, 3, 3, 3}, 1));
+                add_initializer(graph, "b", make_test_array({16}, 2));
+                add_node(graph, "Conv", {"x", "w", "b"}, {"h"},
+                         {make_ints_attribute("strides", {1, 1}),
+                          make_ints_attribute("kernel_shape", {3, 3}),
+                          make_ints_attribute("pads", {1, 1, 1, 1})});
+                add_node(graph, "Relu", {"h"}, {"y"});
+            }
+
+            onnx::ModelProto onnx_model_;
+            std::vector<int> input_dims_{1, 3, 16, 16};
+        };
+
+        TEST_F(ExecutionContextTest, run_contexts_concurrently) {
+            constexpr int thread_num = 8;
+            constexpr int iteration_num = 20;
+            auto compiled = make_compiled_model(
+              onnx_model_, make_parameter_table(onnx_model_.graph()),
+              {std::make_tuple("x", dtype_t::float_, input_dims_,
+                               mkldnn::memory::format::nchw)},
+              {"y"});
+
+            // expected outputs are computed sequentially
+            std::vector<execution_context> context_list;
+            std::vector<array> input_list;
+            std::vector<std::vector<float>> true_output_list;
+            for(int t = 0; t < thread_num; ++t) {
+                context_list.push_back(make_execution_context(compiled));
+                input_list.push_back(make_test_array(input_dims_, t));
+                auto& context = context_list.back();
+                std::copy(fbegin(input_list.back()), fend(input_list.back()),
+                          fbegin(context.input("x")));
+                auto const& output = find_value(context.run(), "y");
+                true_output_list.emplace_back(fbegin(output), fend(output));
+            }
+
+            std::vector<int> mismatch_count_list(thread_num, 0);
+            std::vector<std::thread> thread_list;
+            for(int t = 0; t < thread_num; ++t) {
+                thread_list.emplace_back([&, t]() {
+                    auto& context = context_list[t];
+                    for(int i = 0; i < iteration_num; ++i) {
+                        std::copy(fbegin(input_list[t]), fend(input_list[t]),
+                                  fbegin(context.input("x")));
+                        auto const& output = find_value(context.run(), "y");
+                        if(!std::equal(fbegin(output), fend(output),
+                                       true_output_list[t].begin())) {
+                            ++mismatch_count_list[t];
+                        }
+                    }
+                });
+            }
+            for(auto& th : thread_list) {
+                th.join();
+            }
+            for(int t = 0; t < thread_num; ++t) {
+                ASSERT_EQ(mismatch_count_list[t], 0) << "thread " << t;
+            }
+        }
+
+        // Resident set size of the process in bytes. 0 when it is unknown
+        auto get_resident_size() {
+            std::ifstream ifs("/proc/self/statm");
+            std::size_t total_page_num = 0, resident_page_num = 0;
+            if(!(ifs >> total_page_num >> resident_page_num)) {
+                return std::size_t(0);
+            }
+            return resident_page_num *
+                   static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        }
+
+        // Memory actually taken by contexts sharing one compiled model is
+        // compared with the one taken by copies of the model (the former
+        // workaround of one model per thread)
+        TEST(ExecutionContextMemoryTest, contexts_share_parameters) {
+            constexpr int copy_num = 4;
+            // the weight dominates the buffers of a context
+            std::vector<int> weight_dims{256, 256, 3, 3};
+            std::size_t weight_size = calc_total_size(weight_dims) *
+                                      sizeof(float);
+            onnx::ModelProto onnx_model;
+            auto& graph = *onnx_model.mutable_graph();
+            add_initializer(graph, "w", make_test_array(weight_dims, 1));
+            add_node(graph, "Conv", {"x", "w"}, {"y"},
+                     {make_ints_attribute("kernel_shape", {3, 3}),
+                      make_ints_attribute("pads", {1, 1, 1, 1})});
+            std::vector<std::tuple<std::string, dtype_t, std::vector<int>,
+                                   mkldnn::memory::format>>
+              input_list{std::make_tuple("x", dtype_t::float_,
+                                         std::vector<int>{1, 256, 8, 8},
+                                         mkldnn::memory::format::nchw)};
+
+            auto base_size = get_resident_size();
+            if(base_size == 0) {
+                return; // not measurable on this platform
+            }
+            auto compiled = make_compiled_model(
+              onnx_model, make_parameter_table(graph), input_list, {"y"});
+            std::vector<execution_context> context_list;
+            for(int i = 0; i < copy_num; ++i) {
+                context_list.push_back(make_execution_context(compiled));
+            }
+            auto shared_size = get_resident_size() - base_size;
+
+            std::vector<model> model_list;
+            model_list.reserve(copy_num);
+            for(int i = 0; i < copy_num; ++i) {
+                model_list.push_back(make_model(
+                  onnx_model, make_parameter_table(graph), input_list, {"y"}));
+            }
+            auto copied_size =
+              get_resident_size() - base_size - shared_size;
+
+            // every copy holds the packed weight at least
+            ASSERT_GT(copied_size, (copy_num - 1) * weight_size);
+            ASSERT_LT(shared_size, copied_size / 2);
+        }
+
+        TEST_F(ExecutionContextTest, model_makes_context_sharing_parameters) {
+            auto model = make_model(
+              onnx_model_,
+              {std::make_tuple("x", dtype_t::float_, input_dims_,
+                               mkldnn::memory::format::nchw)},
+              {"y"});
+            auto context = model.make_execution_context();
+            auto input = make_test_array(input_dims_);
+            std::copy(fbegin(input), fend(input), fbegin(model.input("x")));
+            std::copy(fbegin(input), fend(input), fbegin(context.input("x")));
+            auto const& model_output = find_value(model.run(), "y");
+            auto const& context_output = find_value(context.run(), "y");
+            assert_eq_list(fbegin(context_output), fend(context_output),
+                           fbegin(model_output), fend(model_output));
+        }
+
+        TEST_F(ExecutionContextTest, run_with_various_batch_sizes) {
+            auto model = make_model(
+              onnx_model_,
+              {std::make_tuple("x", dtype_t::float_, input_dims_,
+                               mkldnn::memory::format::nchw)},
+              {"y"});
+            auto sample_size = calc_total_size(input_dims_);
+            for(auto batch_size : {1, 4, 2, 4}) {
+                auto input_dims = input_dims_;
+                input_dims[0] = batch_size;
+                auto input = make_test_array(input_dims, batch_size);
+                auto const& output =
+                  find_value(model.run({{"x", input}}), "y");
+                ASSERT_EQ(output.dims()[0], batch_size);
+                auto output_sample_size = total_size(output) / batch_size;
+                std::vector<float> batch_output(fbegin(output), fend(output));
+
+                // compare with the result of each sample
+                for(int b = 0; b < batch_size; ++b) {
+                    std::copy(fbegin(input) + b * sample_size,
+                              fbegin(input) + (b + 1) * sample_size,
+                              fbegin(model.input("x")));
+                    auto const& sample_output = find_value(model.run(), "y");
+                    assert_near_list(
+                      batch_output.begin() + b * output_sample_size,
+                      batch_output.begin() + (b + 1) * output_sample_size,
+                      fbegin(sample_output), fend(sample_output), 10.e-4);
+                }
+            }
+            ASSERT_EQ(model.context_cache().size(), 3);
+        }
+
+        TEST_F(ExecutionContextTest, context_cache_has_model_context) {
+            auto model = make_model(
+              onnx_model_,
+              {std::make_tuple("x", dtype_t::float_, input_dims_,
+                               mkldnn::memory::format::nchw)},
+              {"y"});
+            std::vector<std::vector<int>> input_dims_list{input_dims_};
+            ASSERT_EQ(model.context_cache().size(), 1);
+            ASSERT_TRUE(model.context_cache().contains(input_dims_list));
+
+            // run with the compiled dims shares the buffers of the model
+            auto input = make_test_array(input_dims_, 1);
+            auto const& output = find_value(model.run({{"x", input}}), "y");
+            ASSERT_EQ(model.context_cache().size(), 1);
+            ASSERT_EQ(output.data(), model.output("y").data());
+            assert_eq_list(fbegin(input), fend(input),
+                           fbegin(model.input("x")), fend(model.input("x")));
+
+            // bound buffers are not used by run with input_table
+            std::vector<float> bound_input(calc_total_size(input_dims_));
+            model.bind_input("x", bound_input.data(),
+                             bound_input.size() * sizeof(float));
+            ASSERT_FALSE(model.context_cache().contains(input_dims_list));
+            model.reset_io_bindings();
+            ASSERT_TRUE(model.context_cache().contains(input_dims_list));
+        }
+
+        TEST_F(ExecutionContextTest, context_cache_discards_lru_context) {
+            auto compiled = make_compiled_model(
+              onnx_model_, make_parameter_table(onnx_model_.graph()),
+              {std::make_tuple("x", dtype_t::float_, input_dims_,
+                               mkldnn::memory::format::nchw)},
+              {"y"});
+            execution_context_cache cache(compiled, 2);
+            auto make_input_dims_list = [this](int batch_size) {
+                auto input_dims = input_dims_;
+                input_dims[0] = batch_size;
+                return std::vector<std::vector<int>>{input_dims};
+            };
+            for(auto batch_size : {1, 2, 1, 3}) {
+                cache.get(make_input_dims_list(batch_size));
+            }
+            ASSERT_EQ(cache.size(), 2);
+            ASSERT_TRUE(cache.contains(make_input_dims_list(1)));
+            ASSERT_FALSE(cache.contains(make_input_dims_list(2)));
+            ASSERT_TRUE(cache.contains(make_input_dims_list(3)));
+
+            cache.set_capacity(1);
+            ASSERT_EQ(cache.size(), 1);
+            ASSERT_TRUE(cache.contains(make_input_dims_list(3)));
+
+            auto invalid_dims_list = make_input_dims_list(1);
+            invalid_dims_list[0][2] = 8; // not batch dimension
+            ASSERT_THROW(cache.get(invalid_dims_list), std::runtime_error);
+        }
+
+        TEST_F(ExecutionContextTest, bind_caller_owned_buffers) {
+            auto compiled = make_compiled_model(
+              onnx_model_, make_parameter_table(onnx_model_.graph()),
+              {std::make_tuple("x", dtype_t::float_, input_dims_,
+                               mkldnn::memory::format::nchw)},
+              {"y"});
+            auto context = make_execution_context(compiled);
+            auto input = make_test_array(input_dims_);
+            std::copy(fbegin(input), fend(input), fbegin(context.input("x")));
+            auto const& output_arr = find_value(context.run(), "y");
+            std::vector<float> true_output(fbegin(output_arr),
+                                           fend(output_arr));
+
+            std::vector<float> input_buffer(fbegin(input), fend(input));
+            std::vector<float> output_buffer(true_output.size(), 0.f);
+            context.bind_input("x", input_buffer.data(),
+                               input_buffer.size() * sizeof(float));
+            context.bind_output("y", output_buffer.data(),
+                                output_buffer.size() * sizeof(float));
+            std::fill(fbegin(context.input("x")), fend(context.input("x")),
+                      0.f); // not read while bound
+            context.run();
+            assert_near_list(output_buffer, true_output, 10.e-4);
+
+            // a new frame is read without copy
+            std::vector<float> zero_input_buffer(input_buffer.size(), 0.f);
+            context.bind_input("x", zero_input_buffer.data(),
+                               zero_input_buffer.size() * sizeof(float));
+            context.run();
+            auto zero_output = output_buffer;
+
+            context.reset_io_bindings();
+            std::fill(fbegin(context.input("x")), fend(context.input("x")),
+                      0.f);
+            auto const& reset_output = find_value(context.run(), "y");
+            assert_near_list(fbegin(reset_output), fend(reset_output),
+                             zero_output.begin(), zero_output.end(), 10.e-4);
+            std::copy(fbegin(input), fend(input), fbegin(context.input("x")));
+            context.run();
+            assert_near_list(fbegin(reset_output), fend(reset_output),
+                             true_output.begin(), true_output.end(), 10.e-4);
+
+            ASSERT_THROW(context.bind_input("x", input_buffer.data(),
+                                            input_buffer.size()),
+                         std::runtime_error); // size in elements
+            ASSERT_THROW(
+              context.bind_output(
+                "y", reinterpret_cast<char*>(output_buffer.data()) + 1,
+                output_buffer.size() * sizeof(float)),
+              std::runtime_error);
+            ASSERT_THROW(context.bind_input("h", input_buffer.data(),
+                                            input_buffer.size() * 4),
+                         std::runtime_error); // not an input
+        }
+
+        TEST(ExecutionContextAliasTest, bind_input_read_through_flatten) {
+            onnx::ModelProto onnx_model;
+            auto& graph = *onnx_model.mutable_graph();
+            add_node(graph, "Flatten", {"x"}, {"h"});
+            add_node(graph, "Relu", {"h"}, {"y"});
+            std::vector<int> input_dims{2, 3, 4, 4};
+            auto compiled = make_compiled_model(
+              onnx_model, make_parameter_table(onnx_model.graph()),
+              {std::make_tuple("x", dtype_t::float_, input_dims,
+                               mkldnn::memory::format::nchw)},
+              {"y"});
+            auto context = make_execution_context(compiled);
+            auto input = make_test_array(input_dims);
+            std::copy(fbegin(input), fend(input), fbegin(context.input("x")));
+            auto const& output_arr = find_value(context.run(), "y");
+            std::vector<float> true_output(fbegin(output_arr),
+                                           fend(output_arr));
+
+            // the output of Flatten views the bound buffer, not input("x")
+            std::vector<float> input_buffer(fbegin(input), fend(input));
+            std::fill(fbegin(context.input("x")), fend(context.input("x")),
+                      0.f);
+            context.bind_input("x", input_buffer.data(),
+                               input_buffer.size() * sizeof(float));
+            context.run();
+            assert_near_list(fbegin(output_arr), fend(output_arr),
+                             true_output.begin(), true_output.end(), 10.e-4);
+
+            context.reset_io_bindings();
+            context.run();
+            ASSERT_TRUE(std::all_of(fbegin(output_arr), fend(output_arr),
+                                    [](float y) { return y == 0.f; }));
+        }
+
+    } // namespace
+} // namespace instant
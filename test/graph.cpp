@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+
+#include "common.hpp"
+#include "onnx_builder.hpp"
+
+#include <instant/graph.hpp>
+
+namespace instant {
+    namespace {
+
+        // x -> Conv -> h -> Relu -> y0
+        //           -> h -> Relu -> y1
+        auto make_branch_conv_graph() {
+            onnx::GraphProto graph;
+            add_initializer(graph, "w", make_test_array({8, 3, 3, 3}, 1));
+            add_node(graph, "Conv", {"x", "w"}, {"h"},
+                     {make_int_attribute("group", 1),
+                      make_ints_attribute("kernel_shape", {3, 3})});
+            add_node(graph, "Relu", {"h"}, {"y0"});
+            add_node(graph, "Relu", {"h"}, {"y1"});
+            auto* input = graph.add_input();
+            input->set_name("x");
+            auto* shape =
+              input->mutable_type()->mutable_tensor_type()->mutable_shape();
+            for(auto d : {1, 3, 16, 16}) {
+                shape->add_dim()->set_dim_value(d);
+            }
+            graph.add_output()->set_name("y1");
+            return graph;
+        }
+
+        TEST(GraphTest, graph_ir) {
+            auto graph = make_branch_conv_graph();
+            graph_ir ir(graph);
+            ASSERT_EQ(ir.node_num(), 3);
+            ASSERT_EQ(ir.tensor_num(), 5); // x, w, h, y0 and y1
+
+            auto x = ir.tensor_id("x");
+            auto h = ir.tensor_id("h");
+            auto y1 = ir.tensor_id("y1");
+            ASSERT_EQ(ir.tensor_name(h), "h");
+            ASSERT_EQ(ir.find_tensor_id("z"), -1);
+            ASSERT_THROW(ir.tensor_id("z"), std::runtime_error);
+
+            assert_eq_list(ir.node(0).input_id_list,
+                           std::vector<int>{x, ir.tensor_id("w")});
+            assert_eq_list(ir.node(0).output_id_list, std::vector<int>{h});
+            ASSERT_EQ(ir.producer(x), -1);
+            ASSERT_EQ(ir.producer(h), 0);
+            assert_eq_list(ir.consumer_list(h), std::vector<int>{1, 2});
+            ASSERT_TRUE(ir.consumer_list(y1).empty());
+            ASSERT_TRUE(ir.is_graph_output(y1));
+            ASSERT_FALSE(ir.is_graph_output(ir.tensor_id("y0")));
+
+            // attributes are parsed once
+            auto const& attribute_table = ir.node(0).attribute_table;
+            ASSERT_EQ(attribute_table.size(), 2);
+            ASSERT_EQ(attribute_table.at("group").get().i(), 1);
+
+            assert_eq_list(ir.dims(x), std::vector<int>{1, 3, 16, 16});
+            assert_eq_list(ir.dims(ir.tensor_id("w")),
+                           std::vector<int>{8, 3, 3, 3});
+            ASSERT_TRUE(ir.dims(h).empty());
+            ir.set_dims(h, {1, 8, 14, 14});
+            assert_eq_list(ir.dims(h), std::vector<int>{1, 8, 14, 14});
+        }
+
+        TEST(GraphTest, mutate_graph_ir) {
+            auto graph = make_branch_conv_graph();
+            ASSERT_THROW(
+              graph_ir(static_cast<onnx::GraphProto const&>(graph))
+                .mutable_graph(),
+              std::runtime_error);
+
+            graph_ir ir(graph);
+            auto x = ir.tensor_id("x");
+            auto h = ir.tensor_id("h");
+            auto const* relu_proto = ir.node(2).proto;
+            auto const* group_attr =
+              &ir.node(0).attribute_table.at("group").get();
+
+            auto& attr = ir.mutable_attribute(
+              1, "alpha", onnx::AttributeProto_AttributeType_FLOAT);
+            attr.set_f(0.5f);
+            ASSERT_EQ(&ir.mutable_attribute(
+                        1, "alpha", onnx::AttributeProto_AttributeType_FLOAT),
+                      &attr);
+            ASSERT_EQ(graph.node(1).attribute_size(), 1);
+            ASSERT_EQ(ir.node(1).attribute_table.at("alpha").get().f(), 0.5f);
+
+            ir.set_input(2, 0, x);
+            ASSERT_EQ(graph.node(2).input(0), "x");
+            assert_eq_list(ir.consumer_list(x), std::vector<int>{0, 2});
+            assert_eq_list(ir.consumer_list(h), std::vector<int>{1});
+
+            // nodes and attributes are not parsed again
+            ASSERT_EQ(ir.remove_nodes({false, true, false}), 1);
+            ASSERT_EQ(graph.node_size(), 2);
+            ASSERT_EQ(ir.node_num(), 2);
+            ASSERT_EQ(ir.node(1).proto, relu_proto);
+            ASSERT_EQ(&graph.node(1), relu_proto);
+            ASSERT_EQ(&ir.node(0).attribute_table.at("group").get(),
+                      group_attr);
+            ASSERT_TRUE(ir.consumer_list(h).empty());
+            ASSERT_EQ(ir.producer(ir.tensor_id("y0")), -1);
+            ASSERT_EQ(ir.producer(ir.tensor_id("y1")), 1);
+            assert_eq_list(ir.consumer_list(x), std::vector<int>{0, 1});
+        }
+
+        TEST(GraphTest, make_tensor_id_set) {
+            auto graph = make_branch_conv_graph();
+            graph_ir ir(graph);
+            auto is_in_set =
+              make_tensor_id_set(ir, std::set<std::string>{"h", "z"});
+            ASSERT_EQ(is_in_set.size(), ir.tensor_num());
+            for(int i = 0; i < ir.tensor_num(); ++i) {
+                ASSERT_EQ(is_in_set[i], ir.tensor_name(i) == "h");
+            }
+        }
+
+    } // namespace
+} // namespace instant
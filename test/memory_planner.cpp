@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+
+#include "common.hpp"
+#include "onnx_builder.hpp"
+
+#include <instant/instant.hpp>
+#include <instant/memory_planner.hpp>
+
+namespace instant {
+    namespace {
+
+        TEST(MemoryPlannerTest, plan_arena) {
+            // (size, first, last)
+            std::vector<std::tuple<std::size_t, int, int>> buffer_list{
+              std::make_tuple(100, 0, 1), std::make_tuple(200, 1, 2),
+              std::make_tuple(100, 2, 3), std::make_tuple(50, 3, 3)};
+            auto offset_list_and_arena_size = plan_arena(buffer_list, 64);
+            auto const& offset_list = std::get<0>(offset_list_and_arena_size);
+            auto arena_size = std::get<1>(offset_list_and_arena_size);
+            ASSERT_EQ(offset_list.size(), buffer_list.size());
+            for(auto offset : offset_list) {
+                ASSERT_EQ(offset % 64, 0);
+            }
+            for(int i = 0; i < static_cast<int>(buffer_list.size()); ++i) {
+                for(int j = i + 1; j < static_cast<int>(buffer_list.size());
+                    ++j) {
+                    auto const& a = buffer_list[i];
+                    auto const& b = buffer_list[j];
+                    if(std::get<2>(a) < std::get<1>(b) ||
+                       std::get<2>(b) < std::get<1>(a)) {
+                        continue; // lifetimes do not overlap
+                    }
+                    ASSERT_TRUE(offset_list[i] + std::get<0>(a) <=
+                                  offset_list[j] ||
+                                offset_list[j] + std::get<0>(b) <=
+                                  offset_list[i]);
+                }
+            }
+            // 200 (256) and 100 (128) are live at the same time at most
+            ASSERT_EQ(arena_size, 256 + 128);
+        }
+
+        TEST(MemoryPlannerTest, relu_chain_reuses_buffer) {
+            onnx::ModelProto onnx_model;
+            auto& graph = *onnx_model.mutable_graph();
+            add_node(graph, "Relu", {"x"}, {"a"});
+            add_node(graph, "Relu", {"a"}, {"b"});
+            add_node(graph, "Relu", {"b"}, {"c"});
+            add_node(graph, "Relu", {"c"}, {"y"});
+
+            auto input = make_test_array({1, 8, 4, 4});
+            auto model =
+              make_model(onnx_model,
+                         {std::make_tuple("x", dtype_t::float_, input.dims(),
+                                          mkldnn::memory::format::nchw)},
+                         {"y"});
+            std::copy(fbegin(input), fend(input), fbegin(model.input("x")));
+
+            // "a" and "c" are never alive at the same time
+            auto buffer_size = round_up(total_size(input) * sizeof(float), 64);
+            ASSERT_EQ(model.arena_size(), 2 * buffer_size);
+
+            auto const& output = find_value(model.run(), "y");
+            std::vector<float> true_output(fbegin(input), fend(input));
+            for(auto& e : true_output) {
+                e = std::max(e, 0.f);
+            }
+            assert_near_list(fbegin(output), fend(output), true_output.begin(),
+                             true_output.end(), 10.e-4);
+        }
+
+    } // namespace
+} // namespace instant
@@ -0,0 +1,580 @@
+#include <gtest/gtest.h>
+
+#include "common.hpp"
+#include "onnx_builder.hpp"
+
+#include <instant/instant.hpp>
+
+namespace instant {
+    namespace {
+
+        class ModelTest : public ::testing::Test {
+        protected:
+            ModelTest() = default;
+            virtual void SetUp() { onnx_model_ = make_conv_model(); }
+
+            onnx::ModelProto make_conv_model() const {
+                onnx::ModelProto onnx_model;
+                auto& graph = *onnx_model.mutable_graph();
+                add_initializer(graph, "w", weight_);
+                add_initializer(graph, "b", bias_);
+                std::vector<onnx::AttributeProto> attribute_list{
+                  make_ints_attribute("strides", {1, 1}),
+                  make_ints_attribute("kernel_shape", {3, 3}),
+                  make_ints_attribute("pads", {1, 1, 1, 1})};
+                if(group_ != 1) {
+                    attribute_list.push_back(
+                      make_int_attribute("group", group_));
+                }
+                add_node(graph, "Conv", {"x", "w", "b"}, {"y"},
+                         attribute_list);
+                return onnx_model;
+            }
+
+            // naive convolution (stride 1, padding 1)
+            auto calc_true_output() const {
+                auto index = [](array const& a, int i0, int i1, int i2,
+                                int i3) {
+                    auto const& d = a.dims();
+                    return ((i0 * d[1] + i1) * d[2] + i2) * d[3] + i3;
+                };
+                auto n = input_.dims()[0];
+                auto ic = weight_.dims()[1]; // per group
+                auto h = input_.dims()[2];
+                auto w = input_.dims()[3];
+                auto oc = weight_.dims()[0];
+                auto k = weight_.dims()[2];
+                auto oc_per_group = oc / group_;
+                auto output = zeros(dtype_t::float_, {n, oc, h, w});
+                for(int b = 0; b < n; ++b) {
+                    for(int o = 0; o < oc; ++o) {
+                        for(int y = 0; y < h; ++y) {
+                            for(int x = 0; x < w; ++x) {
+                                float sum = fat(bias_, o);
+                                auto i0 = o / oc_per_group * ic;
+                                for(int i = 0; i < ic; ++i) {
+                                    for(int ky = 0; ky < k; ++ky) {
+                                        for(int kx = 0; kx < k; ++kx) {
+                                            auto iy = y + ky - 1;
+                                            auto ix = x + kx - 1;
+                                            if(iy < 0 || h <= iy || ix < 0 ||
+                                               w <= ix) {
+                                                continue;
+                                            }
+                                            sum +=
+                                              fat(input_,
+                                                  index(input_, b, i0 + i, iy,
+                                                        ix)) *
+                                              fat(weight_,
+                                                  index(weight_, o, i, ky, kx));
+                                        }
+                                    }
+                                }
+                                fat(output, index(output, b, o, y, x)) = sum;
+                            }
+                        }
+                    }
+                }
+                return output;
+            }
+
+            onnx::ModelProto onnx_model_;
+            array input_ = make_test_array({2, 3, 8, 8}, 0);
+            array weight_ = make_test_array({16, 3, 3, 3}, 1);
+            array bias_ = make_test_array({16}, 2);
+            int group_ = 1;
+            mkldnn::engine engine_{get_context().engine()};
+        };
+
+        TEST_F(ModelTest, steady_net_has_no_parameter_reorder) {
+            auto const& graph = onnx_model_.graph();
+            auto parameter_table = make_parameter_table(graph);
+            auto parameter_memory_table = std::get<0>(
+              make_parameter_memory_table(graph, parameter_table, engine_));
+            std::vector<
+              std::tuple<std::string, instant::array, mkldnn::memory::format>>
+              input_list{
+                std::make_tuple("x", input_, mkldnn::memory::format::nchw)};
+            auto input_memory_table =
+              make_variable_memory_table(input_list, engine_);
+            auto temp_tuple = make_nets(graph, parameter_memory_table,
+                                        input_memory_table, {"y"});
+            auto const& nets = std::get<0>(temp_tuple);
+            auto const& parameter_nets = std::get<4>(temp_tuple);
+            auto const& packed_parameter_memory_list = std::get<5>(temp_tuple);
+            // parameters are reordered only by the parameter net
+            for(auto const& p : nets) {
+                if(get_primitive_kind_name(p) != "reorder") {
+                    continue;
+                }
+                const_mkldnn_primitive_t reorder_input;
+                mkldnn::error::wrap_c_api(
+                  mkldnn_primitive_get_input_at(p.get(), 0, &reorder_input),
+                  "could not get reorder input");
+                for(auto const& name_and_memory : parameter_memory_table) {
+                    ASSERT_NE(reorder_input, name_and_memory.second.get())
+                      << name_and_memory.first;
+                }
+            }
+            ASSERT_EQ(parameter_nets.size(),
+                      packed_parameter_memory_list.size());
+            for(auto const& p : packed_parameter_memory_list) {
+                ASSERT_EQ(p.first, "w");
+            }
+        }
+
+        TEST_F(ModelTest, run_model_with_packed_parameters) {
+            auto model = make_model(
+              onnx_model_,
+              {std::make_tuple("x", dtype_t::float_, input_.dims(),
+                               mkldnn::memory::format::nchw)},
+              {"y"});
+            std::copy(fbegin(input_), fend(input_),
+                      fbegin(model.input("x")));
+            auto true_output = calc_true_output();
+            for(int i = 0; i < 2; ++i) { // packed weights are reused
+                auto const& output = find_value(model.run(), "y");
+                assert_near_list(fbegin(output), fend(output),
+                                 fbegin(true_output), fend(true_output),
+                                 10.e-4);
+            }
+        }
+
+        TEST_F(ModelTest, run_depthwise_conv) {
+            // depth multiplier 1 and 2
+            for(auto output_channel_num : {3, 6}) {
+                group_ = 3;
+                weight_ = make_test_array({output_channel_num, 1, 3, 3}, 1);
+                bias_ = make_test_array({output_channel_num}, 2);
+                auto model = make_model(
+                  make_conv_model(),
+                  {std::make_tuple("x", dtype_t::float_, input_.dims(),
+                                   mkldnn::memory::format::nchw)},
+                  {"y"});
+                std::copy(fbegin(input_), fend(input_),
+                          fbegin(model.input("x")));
+                auto const& output = find_value(model.run(), "y");
+                auto true_output = calc_true_output();
+                assert_near_list(fbegin(output), fend(output),
+                                 fbegin(true_output), fend(true_output),
+                                 10.e-4);
+            }
+        }
+
+        TEST_F(ModelTest, run_grouped_conv) {
+            // 2 input and 2 output channels per group
+            group_ = 2;
+            input_ = make_test_array({2, 4, 8, 8}, 0);
+            weight_ = make_test_array({4, 2, 3, 3}, 1);
+            bias_ = make_test_array({4}, 2);
+            auto onnx_model = make_conv_model();
+
+            // the oihw weight is viewed as goihw
+            auto parameter_table = make_parameter_table(onnx_model.graph());
+            auto parameter_memory_table =
+              std::get<0>(make_parameter_memory_table(
+                onnx_model.graph(), parameter_table, engine_));
+            auto const& weight_memory =
+              find_value(parameter_memory_table, "w");
+            ASSERT_EQ(extract_dims(weight_memory),
+                      (std::vector<int>{2, 2, 2, 3, 3}));
+            ASSERT_EQ(calc_output_channel_num(extract_dims(weight_memory)),
+                      4);
+
+            auto model = make_model(
+              onnx_model,
+              {std::make_tuple("x", dtype_t::float_, input_.dims(),
+                               mkldnn::memory::format::nchw)},
+              {"y"});
+            std::copy(fbegin(input_), fend(input_), fbegin(model.input("x")));
+            auto const& output = find_value(model.run(), "y");
+            ASSERT_EQ(output.dims(), (std::vector<int>{2, 4, 8, 8}));
+            auto true_output = calc_true_output();
+            assert_near_list(fbegin(output), fend(output),
+                             fbegin(true_output), fend(true_output), 10.e-4);
+        }
+
+        TEST_F(ModelTest, run_broadcast_add) {
+            // h = x + c, y = h + x + s and z = x + x (same dims)
+            onnx::ModelProto onnx_model;
+            auto& graph = *onnx_model.mutable_graph();
+            add_initializer(graph, "c", make_test_array({8, 1, 1}, 1));
+            add_initializer(graph, "s", make_test_array({4}, 2));
+            add_node(graph, "Add", {"x", "c"}, {"h"});
+            add_node(graph, "Sum", {"h", "x", "s"}, {"y"});
+            add_node(graph, "Add", {"x", "x"}, {"z"});
+            auto input = make_test_array({2, 8, 4, 4});
+            auto model = make_model(
+              onnx_model,
+              {std::make_tuple("x", dtype_t::float_, input.dims(),
+                               mkldnn::memory::format::nchw)},
+              {"y", "z"});
+            std::copy(fbegin(input), fend(input), fbegin(model.input("x")));
+            auto const& output_table = model.run();
+
+            auto c = make_test_array({8, 1, 1}, 1);
+            auto s = make_test_array({4}, 2);
+            auto true_y = array(dtype_t::float_, input.dims());
+            auto true_z = array(dtype_t::float_, input.dims());
+            for(int i = 0; i < total_size(input); ++i) {
+                auto channel = i / 16 % 8;
+                auto w = i % 4;
+                fat(true_y, i) =
+                  2.f * fat(input, i) + fat(c, channel) + fat(s, w);
+                fat(true_z, i) = 2.f * fat(input, i);
+            }
+            auto const& y = find_value(output_table, "y");
+            auto const& z = find_value(output_table, "z");
+            assert_near_list(fbegin(y), fend(y), fbegin(true_y), fend(true_y),
+                             10.e-4);
+            assert_near_list(fbegin(z), fend(z), fbegin(true_z), fend(true_z),
+                             10.e-4);
+        }
+
+        TEST_F(ModelTest, broadcast_dims) {
+            assert_eq_list(calc_broadcast_dims({{2, 8, 4, 4}, {8, 1, 1}}),
+                           std::vector<int>{2, 8, 4, 4});
+            assert_eq_list(calc_broadcast_dims({{1, 4}, {3, 1}}),
+                           std::vector<int>{3, 4});
+            ASSERT_THROW(calc_broadcast_dims({{2, 3}, {4}}),
+                         std::runtime_error);
+            assert_eq_list(calc_broadcast_strides({8, 1, 1}, {2, 8, 4, 4}),
+                           std::vector<int>{0, 1, 0, 0});
+        }
+
+        // c(i, j) = sum_p a(i, p) * b(p, j) with the strides of each dim
+        void calc_true_matmul(float const* a, int a_row_stride,
+                              int a_col_stride, float const* b,
+                              int b_row_stride, int b_col_stride, float* c,
+                              int m, int n, int k) {
+            for(int i = 0; i < m; ++i) {
+                for(int j = 0; j < n; ++j) {
+                    auto sum = 0.f;
+                    for(int p = 0; p < k; ++p) {
+                        sum += a[i * a_row_stride + p * a_col_stride] *
+                               b[p * b_row_stride + j * b_col_stride];
+                    }
+                    c[i * n + j] = sum;
+                }
+            }
+        }
+
+        TEST_F(ModelTest, run_gemm) {
+            // y = x * w^T + b runs the inner product and
+            // z = 0.5 * t^T * w^T + 2 * c runs sgemm
+            onnx::ModelProto onnx_model;
+            auto& graph = *onnx_model.mutable_graph();
+            add_initializer(graph, "w", make_test_array({4, 5}, 1));
+            add_initializer(graph, "b", make_test_array({4}, 2));
+            add_initializer(graph, "c", make_test_array({1, 4}, 3));
+            add_node(graph, "Gemm", {"x", "w", "b"}, {"y"},
+                     {make_int_attribute("transB", 1)});
+            add_node(graph, "Gemm", {"t", "w", "c"}, {"z"},
+                     {make_int_attribute("transA", 1),
+                      make_int_attribute("transB", 1),
+                      make_float_attribute("alpha", 0.5f),
+                      make_float_attribute("beta", 2.f)});
+            auto x = make_test_array({3, 5});
+            auto t = make_test_array({5, 3}, 4);
+            auto model = make_model(
+              onnx_model,
+              {std::make_tuple("x", dtype_t::float_, x.dims(),
+                               mkldnn::memory::format::nc),
+               std::make_tuple("t", dtype_t::float_, t.dims(),
+                               mkldnn::memory::format::nc)},
+              {"y", "z"});
+            std::copy(fbegin(x), fend(x), fbegin(model.input("x")));
+            std::copy(fbegin(t), fend(t), fbegin(model.input("t")));
+            auto const& output_table = model.run();
+
+            auto w = make_test_array({4, 5}, 1);
+            auto b = make_test_array({4}, 2);
+            auto c = make_test_array({1, 4}, 3);
+            auto true_y = array(dtype_t::float_, {3, 4});
+            auto true_z = array(dtype_t::float_, {3, 4});
+            calc_true_matmul(fbegin(x), 5, 1, fbegin(w), 1, 5, fbegin(true_y),
+                             3, 4, 5);
+            calc_true_matmul(fbegin(t), 1, 3, fbegin(w), 1, 5, fbegin(true_z),
+                             3, 4, 5);
+            for(int i = 0; i < 3 * 4; ++i) {
+                fat(true_y, i) += fat(b, i % 4);
+                fat(true_z, i) = 0.5f * fat(true_z, i) + 2.f * fat(c, i % 4);
+            }
+            auto const& y = find_value(output_table, "y");
+            auto const& z = find_value(output_table, "z");
+            assert_near_list(fbegin(y), fend(y), fbegin(true_y), fend(true_y),
+                             10.e-4);
+            assert_near_list(fbegin(z), fend(z), fbegin(true_z), fend(true_z),
+                             10.e-4);
+        }
+
+        TEST_F(ModelTest, run_matmul) {
+            // y = a * b of batches (2, 3) broadcast from (2, 1) and (3).
+            // z = x * w and u = relu(v * w) run the inner product, the
+            // latter with the batch dim of v folded into M
+            onnx::ModelProto onnx_model;
+            auto& graph = *onnx_model.mutable_graph();
+            add_initializer(graph, "w", make_test_array({5, 6}, 1));
+            add_node(graph, "MatMul", {"a", "b"}, {"y"});
+            add_node(graph, "MatMul", {"x", "w"}, {"z"});
+            add_node(graph, "MatMul", {"v", "w"}, {"vw"});
+            add_node(graph, "Relu", {"vw"}, {"u"});
+            auto a = make_test_array({2, 1, 4, 5});
+            auto b = make_test_array({3, 5, 6}, 2);
+            auto x = make_test_array({4, 5}, 3);
+            auto v = make_test_array({2, 3, 5}, 4);
+            auto model = make_model(
+              onnx_model,
+              {std::make_tuple("a", dtype_t::float_, a.dims(),
+                               mkldnn::memory::format::nchw),
+               std::make_tuple("b", dtype_t::float_, b.dims(),
+                               mkldnn::memory::format::tnc),
+               std::make_tuple("x", dtype_t::float_, x.dims(),
+                               mkldnn::memory::format::nc),
+               std::make_tuple("v", dtype_t::float_, v.dims(),
+                               mkldnn::memory::format::tnc)},
+              {"y", "z", "u"});
+            std::copy(fbegin(a), fend(a), fbegin(model.input("a")));
+            std::copy(fbegin(b), fend(b), fbegin(model.input("b")));
+            std::copy(fbegin(x), fend(x), fbegin(model.input("x")));
+            std::copy(fbegin(v), fend(v), fbegin(model.input("v")));
+            auto const& output_table = model.run();
+
+            auto w = make_test_array({5, 6}, 1);
+            auto true_y = array(dtype_t::float_, {2, 3, 4, 6});
+            auto true_z = array(dtype_t::float_, {4, 6});
+            auto true_u = array(dtype_t::float_, {2, 3, 6});
+            for(int i = 0; i < 2; ++i) {
+                for(int j = 0; j < 3; ++j) {
+                    calc_true_matmul(fbegin(a) + i * 4 * 5, 5, 1,
+                                     fbegin(b) + j * 5 * 6, 6, 1,
+                                     fbegin(true_y) + (i * 3 + j) * 4 * 6, 4,
+                                     6, 5);
+                }
+            }
+            calc_true_matmul(fbegin(x), 5, 1, fbegin(w), 6, 1, fbegin(true_z),
+                             4, 6, 5);
+            calc_true_matmul(fbegin(v), 5, 1, fbegin(w), 6, 1, fbegin(true_u),
+                             2 * 3, 6, 5);
+            std::transform(fbegin(true_u), fend(true_u), fbegin(true_u),
+                           [](float e) { return std::max(e, 0.f); });
+            auto const& y = find_value(output_table, "y");
+            auto const& z = find_value(output_table, "z");
+            auto const& u = find_value(output_table, "u");
+            assert_eq_list(y.dims(), true_y.dims());
+            assert_near_list(fbegin(y), fend(y), fbegin(true_y), fend(true_y),
+                             10.e-4);
+            assert_near_list(fbegin(z), fend(z), fbegin(true_z), fend(true_z),
+                             10.e-4);
+            assert_eq_list(u.dims(), true_u.dims());
+            assert_near_list(fbegin(u), fend(u), fbegin(true_u), fend(true_u),
+                             10.e-4);
+        }
+
+        TEST_F(ModelTest, run_eltwise_in_blocked_format) {
+            // each node takes x of nChw8c and keeps the format
+            using attribute_list = std::vector<onnx::AttributeProto>;
+            std::vector<std::tuple<std::string, attribute_list, eltwise_op>>
+              node_list{
+                std::make_tuple("Abs", attribute_list{},
+                                eltwise_op{eltwise_kind::abs, 0.f, 0.f}),
+                std::make_tuple("Clip",
+                                attribute_list{
+                                  make_float_attribute("min", -0.5f),
+                                  make_float_attribute("max", 0.5f)},
+                                eltwise_op{eltwise_kind::clip, -0.5f, 0.5f}),
+                std::make_tuple("Exp", attribute_list{},
+                                eltwise_op{eltwise_kind::exp, 0.f, 0.f}),
+                std::make_tuple(
+                  "HardSigmoid", attribute_list{},
+                  eltwise_op{eltwise_kind::hard_sigmoid, 0.2f, 0.5f}),
+                std::make_tuple("Neg", attribute_list{},
+                                eltwise_op{eltwise_kind::neg, 0.f, 0.f}),
+                std::make_tuple("Sigmoid", attribute_list{},
+                                eltwise_op{eltwise_kind::sigmoid, 0.f, 0.f}),
+                std::make_tuple("Tanh", attribute_list{},
+                                eltwise_op{eltwise_kind::tanh, 0.f, 0.f})};
+            onnx::ModelProto onnx_model;
+            auto& graph = *onnx_model.mutable_graph();
+            std::vector<std::string> output_name_list;
+            for(auto const& node : node_list) {
+                output_name_list.push_back(std::get<0>(node) + "_y");
+                add_node(graph, std::get<0>(node), {"x"},
+                         {output_name_list.back()}, std::get<1>(node));
+            }
+            auto input = make_test_array({2, 16, 4, 4});
+            auto model = make_model(
+              onnx_model,
+              {std::make_tuple("x", dtype_t::float_, input.dims(),
+                               mkldnn::memory::format::nChw8c)},
+              output_name_list);
+            std::copy(fbegin(input), fend(input), fbegin(model.input("x")));
+            auto const& output_table = model.run();
+
+            for(auto const& node : node_list) {
+                auto const& y =
+                  find_value(output_table, std::get<0>(node) + "_y");
+                std::vector<float> true_y(total_size(input));
+                std::transform(fbegin(input), fend(input), true_y.begin(),
+                               [&node](float x) {
+                                   return apply_eltwise_op_reference(
+                                     std::get<2>(node), x);
+                               });
+                assert_near_list(fbegin(y), fend(y), true_y.begin(),
+                                 true_y.end(), 10.e-4);
+            }
+        }
+
+        TEST_F(ModelTest, run_eltwise_chain_in_blocked_format) {
+            // the chain is fused into one node (see fuse_eltwise_chain)
+            onnx::ModelProto onnx_model;
+            auto& graph = *onnx_model.mutable_graph();
+            add_node(graph, "Relu", {"x"}, {"a"});
+            add_node(graph, "Clip", {"a"}, {"b"},
+                     {make_float_attribute("min", 0.f),
+                      make_float_attribute("max", 0.5f)});
+            add_node(graph, "Neg", {"b"}, {"c"});
+            add_node(graph, "Sigmoid", {"c"}, {"y"});
+            auto input = make_test_array({2, 16, 4, 4});
+            auto model = make_model(
+              onnx_model,
+              {std::make_tuple("x", dtype_t::float_, input.dims(),
+                               mkldnn::memory::format::nChw8c)},
+              {"y"});
+            std::copy(fbegin(input), fend(input), fbegin(model.input("x")));
+            auto const& y = find_value(model.run(), "y");
+
+            std::vector<eltwise_op> op_list{
+              {eltwise_kind::relu, 0.f, 0.f},
+              {eltwise_kind::clip, 0.f, 0.5f},
+              {eltwise_kind::neg, 0.f, 0.f},
+              {eltwise_kind::sigmoid, 0.f, 0.f}};
+            std::vector<float> true_y(total_size(input));
+            run_eltwise_chain_reference(op_list, fbegin(input), true_y.data(),
+                                        true_y.size());
+            assert_near_list(fbegin(y), fend(y), true_y.begin(), true_y.end(),
+                             10.e-4);
+        }
+
+        TEST_F(ModelTest, run_eltwise_chain_as_unfused_nodes) {
+            // operators having MKL-DNN primitives give the same results in
+            // a chain as the primitives run node by node
+            onnx::ModelProto onnx_model;
+            auto& graph = *onnx_model.mutable_graph();
+            add_node(graph, "Tanh", {"x"}, {"a"});
+            add_node(graph, "Elu", {"a"}, {"b"},
+                     {make_float_attribute("alpha", 0.7f)});
+            add_node(graph, "LeakyRelu", {"b"}, {"c"},
+                     {make_float_attribute("alpha", 0.2f)});
+            add_node(graph, "Relu", {"c"}, {"d"});
+            add_node(graph, "Elu", {"x"}, {"e"});
+            add_node(graph, "Tanh", {"e"}, {"y"});
+            auto input = make_test_array({2, 16, 4, 4});
+            std::vector<std::tuple<std::string, dtype_t, std::vector<int>,
+                                   mkldnn::memory::format>>
+              input_list{std::make_tuple("x", dtype_t::float_, input.dims(),
+                                         mkldnn::memory::format::nchw)};
+            auto chained = make_model(onnx_model, input_list, {"d", "y"});
+            // intermediates required as outputs are not fused
+            auto unfused = make_model(onnx_model, input_list,
+                                      {"a", "b", "c", "d", "e", "y"});
+            ASSERT_LT(chained.compiled()->graph().node_size(),
+                      unfused.compiled()->graph().node_size());
+            std::copy(fbegin(input), fend(input), fbegin(chained.input("x")));
+            std::copy(fbegin(input), fend(input), fbegin(unfused.input("x")));
+            auto const& output_table = chained.run();
+            auto const& true_output_table = unfused.run();
+            for(auto const& name : {"d", "y"}) {
+                auto const& output = find_value(output_table, name);
+                auto const& true_output = find_value(true_output_table, name);
+                assert_near_list(fbegin(output), fend(output),
+                                 fbegin(true_output), fend(true_output),
+                                 10.e-4);
+            }
+        }
+
+        TEST_F(ModelTest, run_eltwise_chain_of_affine_steps) {
+            // Add, Mul and BatchNormalization of constants are chained as
+            // affine steps, per channel (blocked) or per width (plain)
+            auto c = make_test_array({16, 1, 1}, 1);
+            auto b = make_test_array({16, 1, 1}, 2);
+            auto scale = make_test_array({16}, 3);
+            auto bias = make_test_array({16}, 4);
+            auto mean = make_test_array({16}, 5);
+            auto var = make_test_array({16}, 6);
+            std::transform(fbegin(var), fend(var), fbegin(var),
+                           [](float e) { return std::abs(e) + 0.5f; });
+            auto d = make_test_array({4}, 7);
+            onnx::ModelProto onnx_model;
+            auto& graph = *onnx_model.mutable_graph();
+            add_initializer(graph, "s", uniforms(dtype_t::float_, {1}, 0.25f));
+            add_initializer(graph, "c", c);
+            add_initializer(graph, "b", b);
+            add_initializer(graph, "scale", scale);
+            add_initializer(graph, "bias", bias);
+            add_initializer(graph, "mean", mean);
+            add_initializer(graph, "var", var);
+            add_initializer(graph, "d", d);
+            add_node(graph, "Add", {"x", "s"}, {"a1"});
+            add_node(graph, "Relu", {"a1"}, {"a2"});
+            add_node(graph, "Clip", {"a2"}, {"y1"},
+                     {make_float_attribute("min", 0.f),
+                      make_float_attribute("max", 0.5f)});
+            add_node(graph, "Mul", {"c", "x"}, {"b1"});
+            add_node(graph, "Add", {"b1", "b"}, {"b2"});
+            add_node(graph, "Sigmoid", {"b2"}, {"y2"});
+            add_node(graph, "BatchNormalization",
+                     {"x", "scale", "bias", "mean", "var"}, {"c1"},
+                     {make_float_attribute("epsilon", 1e-3f)});
+            add_node(graph, "Relu", {"c1"}, {"y3"});
+            add_node(graph, "Mul", {"x", "d"}, {"d1"});
+            add_node(graph, "Tanh", {"d1"}, {"y4"});
+            auto input = make_test_array({2, 16, 4, 4});
+            std::vector<std::vector<float>> true_y_list(
+              4, std::vector<float>(total_size(input)));
+            for(int i = 0; i < total_size(input); ++i) {
+                auto x = fat(input, i);
+                auto channel = i / 16 % 16;
+                auto w = i % 4;
+                auto bn = fat(scale, channel) * (x - fat(mean, channel)) /
+                            std::sqrt(fat(var, channel) + 1e-3f) +
+                          fat(bias, channel);
+                true_y_list[0][i] = std::min(std::max(x + 0.25f, 0.f), 0.5f);
+                true_y_list[1][i] =
+                  1.f / (1.f + std::exp(-(fat(c, channel) * x +
+                                          fat(b, channel))));
+                true_y_list[2][i] = std::max(bn, 0.f);
+                true_y_list[3][i] = std::tanh(x * fat(d, w));
+            }
+            for(auto format : {mkldnn::memory::format::nChw8c,
+                               mkldnn::memory::format::nchw}) {
+                auto model = make_model(
+                  onnx_model,
+                  {std::make_tuple("x", dtype_t::float_, input.dims(),
+                                   format)},
+                  {"y1", "y2", "y3", "y4"});
+                ASSERT_EQ(model.compiled()->graph().node_size(), 4);
+                std::copy(fbegin(input), fend(input),
+                          fbegin(model.input("x")));
+                auto const& output_table = model.run();
+                for(int j = 0; j < 4; ++j) {
+                    auto const& y =
+                      find_value(output_table, "y" + std::to_string(j + 1));
+                    assert_near_list(fbegin(y), fend(y),
+                                     true_y_list[j].begin(),
+                                     true_y_list[j].end(), 10.e-4);
+                }
+            }
+        }
+
+        TEST_F(ModelTest, zero_channel_padding) {
+            // 3 channels in blocks of 4 lanes
+            std::vector<float> data(2 * 4 * 2, 1.f);
+            zero_channel_padding(data.data(), {2, 3, 1, 2}, 4);
+            for(std::size_t i = 0; i < data.size(); ++i) {
+                ASSERT_EQ(data[i], i % 4 == 3 ? 0.f : 1.f);
+            }
+        }
+
+    } // namespace
+} // namespace instant
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cstdio>
 #include <gtest/gtest.h>
 #include <onnx.pb.h>
 #include <fstream>
@@ -9,6 +11,9 @@
 #include <google/protobuf/io/coded_stream.h>
 #include <google/protobuf/io/zero_copy_stream_impl.h>
 
+#include "common.hpp"
+#include "onnx_builder.hpp"
+
 namespace instant {
 namespace {
 
@@ -138,5 +143,93 @@ TEST_F(ONNXTest, load_onnx_model) {
     }
 }
 
+TEST_F(ONNXTest, load_onnx_with_mapped_parameter_table) {
+    onnx::ModelProto onnx_model;
+    onnx_model.set_producer_name("instant_test");
+    auto& graph = *onnx_model.mutable_graph();
+    auto weight = make_test_array({16, 3, 3, 3}, 1);
+    auto bias = make_test_array({16}, 2);
+    auto odd = make_test_array({3, 5}, 3);
+    add_initializer(graph, "w", weight);
+    add_initializer(graph, "b", bias);
+    add_initializer(graph, "odd", odd);
+    add_node(graph, "Conv", {"x", "w", "b"}, {"y"},
+             {make_ints_attribute("strides", {1, 1}),
+              make_ints_attribute("kernel_shape", {3, 3}),
+              make_ints_attribute("pads", {1, 1, 1, 1})});
+    // raw_data is mapped when its offset in the file is aligned for
+    // float. The offsets of "w" and the second weight are aligned by
+    // padding doc_string and the name of the second weight
+    auto weight2 = make_test_array({16, 3, 3, 3}, 4);
+    auto find_offset = [](std::string const& serialized,
+                          instant::array const& arr) {
+        auto const* first = static_cast<char const*>(arr.data());
+        auto const* last = first + total_size(arr) * sizeof(float);
+        return std::search(serialized.begin(), serialized.end(), first,
+                           last) -
+               serialized.begin();
+    };
+    std::string serialized;
+    std::string weight2_name;
+    std::ptrdiff_t weight_offset = 0;
+    std::ptrdiff_t weight2_offset = 0;
+    for (int i = 0; i < 16; ++i) {
+        auto padded_model = onnx_model;
+        padded_model.set_doc_string(std::string(i % 4, ' '));
+        weight2_name = "w2" + std::string(i / 4, '_');
+        add_initializer(*padded_model.mutable_graph(), weight2_name,
+                        weight2);
+        serialized = padded_model.SerializeAsString();
+        weight_offset = find_offset(serialized, weight);
+        weight2_offset = find_offset(serialized, weight2);
+        if (weight_offset % alignof(float) == 0 &&
+            weight2_offset % alignof(float) == 0) {
+            break;
+        }
+    }
+    ASSERT_EQ(weight_offset % alignof(float), 0);
+    ASSERT_EQ(weight2_offset % alignof(float), 0);
+    {
+        std::ofstream ofs("mapped_test.onnx", std::ios::binary);
+        ofs.write(serialized.data(), serialized.size());
+        ASSERT_TRUE(ofs.good());
+    }
+
+    auto copied_model = instant::load_onnx("mapped_test.onnx");
+    auto copied_parameter_table = make_parameter_table(copied_model.graph());
+
+    onnx::ModelProto mapped_model;
+    std::unordered_map<std::string, instant::array> mapped_parameter_table;
+    std::tie(mapped_model, mapped_parameter_table) =
+        instant::load_onnx_with_mapped_parameter_table("mapped_test.onnx");
+    std::remove("mapped_test.onnx"); // mapping is still valid
+
+    EXPECT_EQ(mapped_model.producer_name(), "instant_test");
+    ASSERT_EQ(mapped_model.graph().node_size(), 1);
+    EXPECT_EQ(mapped_model.graph().node(0).op_type(), "Conv");
+    EXPECT_EQ(mapped_model.graph().node(0).attribute_size(), 3);
+    ASSERT_EQ(mapped_model.graph().initializer_size(), 4);
+    for (auto const& tensor : mapped_model.graph().initializer()) {
+        EXPECT_FALSE(tensor.has_raw_data());
+    }
+    ASSERT_EQ(mapped_parameter_table.size(), copied_parameter_table.size());
+    for (auto const& p : copied_parameter_table) {
+        auto const& arr = mapped_parameter_table.at(p.first);
+        EXPECT_EQ(reinterpret_cast<std::uintptr_t>(arr.data()) %
+                    alignof(float),
+                  0);
+        assert_eq_list(arr.dims(), p.second.dims());
+        assert_eq_list(fbegin(arr), fend(arr), fbegin(p.second),
+                       fend(p.second));
+    }
+
+    // both weights point into one mapping of the file
+    auto const* weight_data =
+        static_cast<char const*>(mapped_parameter_table.at("w").data());
+    auto const* weight2_data = static_cast<char const*>(
+        mapped_parameter_table.at(weight2_name).data());
+    EXPECT_EQ(weight2_data - weight_data, weight2_offset - weight_offset);
+}
+
 }  // namespace
 }  // namespace instant
@@ -0,0 +1,79 @@
+#ifndef INSTANT_TEST_ONNX_BUILDER_HPP
+#define INSTANT_TEST_ONNX_BUILDER_HPP
+
+#include <string>
+#include <vector>
+
+#include <instant/array.hpp>
+#include <instant/onnx.pb.h>
+
+namespace instant {
+
+    inline auto make_int_attribute(std::string const& name, int i) {
+        onnx::AttributeProto attr;
+        attr.set_name(name);
+        attr.set_i(i);
+        return attr;
+    }
+
+    inline auto make_float_attribute(std::string const& name, float f) {
+        onnx::AttributeProto attr;
+        attr.set_name(name);
+        attr.set_f(f);
+        return attr;
+    }
+
+    inline auto make_ints_attribute(std::string const& name,
+                                    std::vector<int> const& ints) {
+        onnx::AttributeProto attr;
+        attr.set_name(name);
+        for(auto i : ints) {
+            attr.add_ints(i);
+        }
+        return attr;
+    }
+
+    inline auto add_node(onnx::GraphProto& graph, std::string const& op_type,
+                         std::vector<std::string> const& input_name_list,
+                         std::vector<std::string> const& output_name_list,
+                         std::vector<onnx::AttributeProto> const&
+                           attribute_list = {}) {
+        auto* node = graph.add_node();
+        node->set_op_type(op_type);
+        for(auto const& name : input_name_list) {
+            node->add_input(name);
+        }
+        for(auto const& name : output_name_list) {
+            node->add_output(name);
+        }
+        for(auto const& attr : attribute_list) {
+            *node->add_attribute() = attr;
+        }
+        return node;
+    }
+
+    inline auto add_initializer(onnx::GraphProto& graph,
+                                std::string const& name, array const& arr) {
+        auto* tensor = graph.add_initializer();
+        tensor->set_name(name);
+        tensor->set_data_type(onnx::TensorProto_DataType_FLOAT);
+        for(auto d : arr.dims()) {
+            tensor->add_dims(d);
+        }
+        tensor->set_raw_data(static_cast<char const*>(arr.data()),
+                             total_size(arr) * sizeof(float));
+        return tensor;
+    }
+
+    // deterministic pseudo random values in [-1, 1)
+    inline auto make_test_array(std::vector<int> const& dims, int seed = 0) {
+        array arr(dtype_t::float_, dims);
+        for(int i = 0; i < total_size(arr); ++i) {
+            fat(arr, i) = ((i * 7919 + seed * 104729) % 2000) / 1000.f - 1.f;
+        }
+        return arr;
+    }
+
+} // namespace instant
+
+#endif // INSTANT_TEST_ONNX_BUILDER_HPP
@@ -0,0 +1,964 @@
+#include <gtest/gtest.h>
+
+#include "common.hpp"
+#include "onnx_builder.hpp"
+
+#include <instant/instant.hpp>
+
+namespace instant {
+    namespace {
+
+        auto make_conv_relu_graph() {
+            onnx::GraphProto graph;
+            add_initializer(graph, "w", make_test_array({8, 3, 3, 3}, 1));
+            add_initializer(graph, "b", make_test_array({8}, 2));
+            add_node(graph, "Conv", {"x", "w", "b"}, {"h"},
+                     {make_ints_attribute("strides", {1, 1}),
+                      make_ints_attribute("kernel_shape", {3, 3}),
+                      make_ints_attribute("pads", {1, 1, 1, 1})});
+            add_node(graph, "LeakyRelu", {"h"}, {"y"},
+                     {make_float_attribute("alpha", 0.1f)});
+            return graph;
+        }
+
+        TEST(PassTest, fuse_post_eltwise) {
+            auto graph = make_conv_relu_graph();
+            fuse_post_eltwise(graph, {"y"});
+            ASSERT_EQ(graph.node_size(), 1);
+            auto const& node = graph.node(0);
+            ASSERT_EQ(node.op_type(), "Conv");
+            ASSERT_EQ(node.output(0), "y");
+            auto attribute_table = make_attribute_table(node);
+            onnx::AttributeProto const& op_types_attr =
+              find_value(attribute_table, "post_eltwise_op_types");
+            onnx::AttributeProto const& alphas_attr =
+              find_value(attribute_table, "post_eltwise_alphas");
+            ASSERT_EQ(op_types_attr.strings_size(), 1);
+            ASSERT_EQ(op_types_attr.strings(0), "LeakyRelu");
+            ASSERT_FLOAT_EQ(alphas_attr.floats(0), 0.1f);
+        }
+
+        TEST(PassTest, fuse_post_eltwise_keeps_required_output) {
+            auto graph = make_conv_relu_graph();
+            fuse_post_eltwise(graph, {"h", "y"});
+            ASSERT_EQ(graph.node_size(), 2);
+        }
+
+        TEST(PassTest, run_fused_model) {
+            onnx::ModelProto fused_model;
+            *fused_model.mutable_graph() = make_conv_relu_graph();
+            onnx::ModelProto unfused_model = fused_model;
+
+            auto input = make_test_array({1, 3, 8, 8});
+            std::vector<std::tuple<std::string, dtype_t, std::vector<int>,
+                                   mkldnn::memory::format>>
+              input_list{std::make_tuple("x", dtype_t::float_, input.dims(),
+                                         mkldnn::memory::format::nchw)};
+
+            // "h" is required so that it is not fused
+            auto unfused = make_model(unfused_model, input_list, {"h", "y"});
+            auto fused = make_model(fused_model, input_list, {"y"});
+            std::copy(fbegin(input), fend(input), fbegin(unfused.input("x")));
+            std::copy(fbegin(input), fend(input), fbegin(fused.input("x")));
+            auto const& unfused_output = find_value(unfused.run(), "y");
+            auto const& fused_output = find_value(fused.run(), "y");
+            assert_near_list(fbegin(fused_output), fend(fused_output),
+                             fbegin(unfused_output), fend(unfused_output),
+                             10.e-4);
+        }
+
+        auto make_conv_batch_norm_model() {
+            onnx::ModelProto onnx_model;
+            auto& graph = *onnx_model.mutable_graph();
+            add_initializer(graph, "w", make_test_array({8, 3, 3, 3}, 1));
+            add_initializer(graph, "scale", make_test_array({8}, 2));
+            add_initializer(graph, "b", make_test_array({8}, 3));
+            add_initializer(graph, "mean", make_test_array({8}, 4));
+            auto var = make_test_array({8}, 5);
+            std::transform(fbegin(var), fend(var), fbegin(var),
+                           [](float v) { return v + 1.f; }); // positive
+            add_initializer(graph, "var", var);
+            add_node(graph, "Conv", {"x", "w"}, {"h"},
+                     {make_ints_attribute("strides", {1, 1}),
+                      make_ints_attribute("kernel_shape", {3, 3}),
+                      make_ints_attribute("pads", {1, 1, 1, 1})});
+            add_node(graph, "BatchNormalization",
+                     {"h", "scale", "b", "mean", "var"}, {"y"},
+                     {make_float_attribute("epsilon", 1e-5f),
+                      make_int_attribute("is_test", 1),
+                      make_int_attribute("spatial", 1)});
+            return onnx_model;
+        }
+
+        TEST(PassTest, fold_batch_norm) {
+            auto onnx_model = make_conv_batch_norm_model();
+            auto& graph = *onnx_model.mutable_graph();
+            // an unused parameter has the name of the folded weight
+            add_initializer(graph, "y_folded_weight",
+                            make_test_array({1}, 5));
+            auto parameter_table = make_parameter_table(graph);
+            fold_batch_norm(graph, parameter_table, {"y"});
+            ASSERT_EQ(graph.node_size(), 1);
+            auto const& node = graph.node(0);
+            ASSERT_EQ(node.op_type(), "Conv");
+            ASSERT_EQ(node.input_size(), 3); // bias is synthesized
+            ASSERT_EQ(node.output(0), "y");
+            ASSERT_EQ(node.input(1), "y_folded_weight_1");
+            ASSERT_EQ(node.input(2), "y_folded_bias");
+            // the parameters used only by Conv and BatchNormalization are
+            // released
+            ASSERT_EQ(parameter_table.size(), 3);
+            ASSERT_NE(parameter_table.find(node.input(1)),
+                      parameter_table.end());
+            ASSERT_NE(parameter_table.find(node.input(2)),
+                      parameter_table.end());
+            // initializers of the released parameters are dropped and the
+            // folded ones are added
+            ASSERT_EQ(graph.initializer_size(), 3);
+            auto initializer_parameter_table = make_parameter_table(graph);
+            for(auto const& p : parameter_table) {
+                auto const& arr = find_value(initializer_parameter_table,
+                                             p.first);
+                assert_eq_list(arr.dims(), p.second.dims());
+                assert_eq_list(fbegin(arr), fend(arr), fbegin(p.second),
+                               fend(p.second));
+            }
+        }
+
+        TEST(PassTest, run_batch_norm_folded_model) {
+            auto unfolded_model = make_conv_batch_norm_model();
+            auto folded_model = unfolded_model;
+            auto parameter_table = make_parameter_table(folded_model.graph());
+            fold_batch_norm(*folded_model.mutable_graph(), parameter_table,
+                            {"y"});
+            // parameters are loaded from initializers of the folded graph
+
+            auto input = make_test_array({1, 3, 8, 8});
+            std::vector<std::tuple<std::string, dtype_t, std::vector<int>,
+                                   mkldnn::memory::format>>
+              input_list{std::make_tuple("x", dtype_t::float_, input.dims(),
+                                         mkldnn::memory::format::nchw)};
+            auto unfolded = make_model(unfolded_model, input_list, {"y"});
+            auto folded = make_model(folded_model, input_list, {"y"});
+            std::copy(fbegin(input), fend(input), fbegin(unfolded.input("x")));
+            std::copy(fbegin(input), fend(input), fbegin(folded.input("x")));
+            auto const& unfolded_output = find_value(unfolded.run(), "y");
+            auto const& folded_output = find_value(folded.run(), "y");
+            assert_near_list(fbegin(folded_output), fend(folded_output),
+                             fbegin(unfolded_output), fend(unfolded_output),
+                             10.e-4);
+        }
+
+        // x -> Conv -> h -> Relu -> r -> Conv -> y
+        auto make_conv_chain_model() {
+            onnx::ModelProto onnx_model;
+            auto& graph = *onnx_model.mutable_graph();
+            std::vector<onnx::AttributeProto> conv_attribute_list{
+              make_ints_attribute("strides", {1, 1}),
+              make_ints_attribute("kernel_shape", {3, 3}),
+              make_ints_attribute("pads", {1, 1, 1, 1})};
+            add_initializer(graph, "w1", make_test_array({8, 3, 3, 3}, 1));
+            add_initializer(graph, "b1", make_test_array({8}, 2));
+            add_initializer(graph, "w2", make_test_array({16, 8, 3, 3}, 3));
+            add_initializer(graph, "b2", make_test_array({16}, 4));
+            add_node(graph, "Conv", {"x", "w1", "b1"}, {"h"},
+                     conv_attribute_list);
+            add_node(graph, "Relu", {"h"}, {"r"});
+            add_node(graph, "Conv", {"r", "w2", "b2"}, {"y"},
+                     conv_attribute_list);
+            graph.add_output()->set_name("y");
+            return onnx_model;
+        }
+
+        TEST(PassTest, eliminate_dead_nodes) {
+            auto onnx_model = make_conv_chain_model();
+            auto& graph = *onnx_model.mutable_graph();
+            auto parameter_table = make_parameter_table(graph);
+            ASSERT_EQ(eliminate_dead_nodes(graph, parameter_table, {"h"}), 2);
+            ASSERT_EQ(graph.node_size(), 1);
+            ASSERT_EQ(graph.node(0).op_type(), "Conv");
+            ASSERT_EQ(graph.initializer_size(), 2);
+            ASSERT_EQ(graph.output_size(), 0);
+            ASSERT_EQ(parameter_table.size(), 2); // "w2" and "b2" are released
+            ASSERT_EQ(parameter_table.find("w2"), parameter_table.end());
+        }
+
+        TEST(PassTest, eliminate_dead_nodes_keeps_all_when_required) {
+            auto onnx_model = make_conv_chain_model();
+            auto& graph = *onnx_model.mutable_graph();
+            ASSERT_EQ(eliminate_dead_nodes(graph, {"h", "y"}), 0);
+            ASSERT_EQ(graph.node_size(), 3);
+            ASSERT_EQ(graph.initializer_size(), 4);
+        }
+
+        TEST(PassTest, eliminate_dead_nodes_rejects_unknown_output) {
+            auto onnx_model = make_conv_chain_model();
+            auto& graph = *onnx_model.mutable_graph();
+            try {
+                eliminate_dead_nodes(graph, {"h", "yy"});
+                FAIL();
+            } catch(std::runtime_error const& e) {
+                ASSERT_NE(std::string(e.what()).find("yy"), std::string::npos);
+            }
+            ASSERT_EQ(graph.node_size(), 3); // nothing is removed
+        }
+
+        TEST(PassTest, run_feature_extractor) {
+            auto onnx_model = make_conv_chain_model();
+            auto input = make_test_array({1, 3, 8, 8});
+            std::vector<std::tuple<std::string, dtype_t, std::vector<int>,
+                                   mkldnn::memory::format>>
+              input_list{std::make_tuple("x", dtype_t::float_, input.dims(),
+                                         mkldnn::memory::format::nchw)};
+            auto full = make_model(onnx_model, input_list, {"h", "y"});
+            auto feature = make_model(onnx_model, input_list, {"h"});
+            ASSERT_EQ(feature.compiled()->graph().node_size(), 1);
+            ASSERT_LT(feature.compiled()->parameter_size(),
+                      full.compiled()->parameter_size());
+            std::copy(fbegin(input), fend(input), fbegin(full.input("x")));
+            std::copy(fbegin(input), fend(input), fbegin(feature.input("x")));
+            auto const& full_output = find_value(full.run(), "h");
+            auto const& feature_output = find_value(feature.run(), "h");
+            assert_near_list(fbegin(feature_output), fend(feature_output),
+                             fbegin(full_output), fend(full_output), 10.e-4);
+        }
+
+        // x -> Relu -> a -> Dropout -> d -> Identity -> i -> Relu -> y
+        auto make_identity_chain_graph() {
+            onnx::GraphProto graph;
+            add_node(graph, "Relu", {"x"}, {"a"});
+            add_node(graph, "Dropout", {"a"}, {"d"},
+                     {make_int_attribute("is_test", 1)});
+            add_node(graph, "Identity", {"d"}, {"i"});
+            add_node(graph, "Relu", {"i"}, {"y"});
+            return graph;
+        }
+
+        TEST(PassTest, eliminate_identity_nodes) {
+            auto graph = make_identity_chain_graph();
+            ASSERT_EQ(eliminate_identity_nodes(graph, {"y"}), 2);
+            ASSERT_EQ(graph.node_size(), 2);
+            ASSERT_EQ(graph.node(1).input(0), "a");
+        }
+
+        TEST(PassTest, eliminate_identity_nodes_keeps_required_output) {
+            auto graph = make_identity_chain_graph();
+            ASSERT_EQ(eliminate_identity_nodes(graph, {"d", "y"}), 1);
+            ASSERT_EQ(graph.node_size(), 3);
+            ASSERT_EQ(graph.node(1).op_type(), "Dropout");
+            ASSERT_EQ(graph.node(2).input(0), "d");
+        }
+
+        TEST(PassTest, eliminate_noop_reshape) {
+            onnx::GraphProto graph;
+            auto* input = graph.add_input();
+            input->set_name("x");
+            auto* shape =
+              input->mutable_type()->mutable_tensor_type()->mutable_shape();
+            for(auto d : {1, 32}) {
+                shape->add_dim()->set_dim_value(d);
+            }
+            add_node(graph, "Reshape", {"x"}, {"r0"},
+                     {make_ints_attribute("shape", {1, -1})});
+            add_node(graph, "Flatten", {"r0"}, {"r1"});
+            add_node(graph, "Reshape", {"r1"}, {"y"},
+                     {make_ints_attribute("shape", {1, 4, 8})});
+            // dims of "r0" are not declared, so Flatten is kept
+            ASSERT_EQ(eliminate_identity_nodes(graph, {"y"}), 1);
+            ASSERT_EQ(graph.node_size(), 2);
+            ASSERT_EQ(graph.node(0).op_type(), "Flatten");
+            ASSERT_EQ(graph.node(0).input(0), "x");
+        }
+
+        TEST(PassTest, identity_node_emits_no_primitive) {
+            auto graph = make_identity_chain_graph();
+            auto input = make_test_array({1, 8, 4, 4});
+            std::vector<
+              std::tuple<std::string, instant::array, mkldnn::memory::format>>
+              input_list{
+                std::make_tuple("x", input, mkldnn::memory::format::nchw)};
+            auto input_memory_table =
+              make_variable_memory_table(input_list, get_context().engine());
+            auto temp_tuple = make_nets(graph, {}, input_memory_table, {"y"});
+            auto const& node_net_range_list = std::get<8>(temp_tuple);
+            for(auto i : {1, 2}) { // Dropout and Identity
+                ASSERT_EQ(node_net_range_list[i].first,
+                          node_net_range_list[i].second);
+            }
+
+            // "a", "d" and "i" share one buffer
+            auto buffer_size = round_up(total_size(input) * sizeof(float), 64);
+            ASSERT_EQ(std::get<7>(temp_tuple), buffer_size);
+
+            mkldnn::stream(mkldnn::stream::kind::eager)
+              .submit(std::get<0>(temp_tuple))
+              .wait();
+            auto const& output = find_value(std::get<3>(temp_tuple), "y");
+            std::vector<float> true_output(fbegin(input), fend(input));
+            for(auto& e : true_output) {
+                e = std::max(e, 0.f);
+            }
+            assert_near_list(fbegin(output), fend(output), true_output.begin(),
+                             true_output.end(), 10.e-4);
+        }
+
+        // x -> Conv -> h -> Relu -> r -> Conv -> y -> Reshape -> s -> Relu
+        //   -> z
+        auto make_conv_reshape_model(int output_channel_num) {
+            onnx::ModelProto onnx_model;
+            auto& graph = *onnx_model.mutable_graph();
+            std::vector<onnx::AttributeProto> conv_attribute_list{
+              make_ints_attribute("strides", {1, 1}),
+              make_ints_attribute("kernel_shape", {3, 3}),
+              make_ints_attribute("pads", {1, 1, 1, 1})};
+            add_initializer(graph, "w1", make_test_array({8, 3, 3, 3}, 1));
+            add_initializer(graph, "w2",
+                            make_test_array({output_channel_num, 8, 3, 3}, 2));
+            add_node(graph, "Conv", {"x", "w1"}, {"h"}, conv_attribute_list);
+            add_node(graph, "Relu", {"h"}, {"r"});
+            add_node(graph, "Conv", {"r", "w2"}, {"y"}, conv_attribute_list);
+            add_node(graph, "Reshape", {"y"}, {"s"},
+                     {make_ints_attribute("shape", {1, -1})});
+            add_node(graph, "Relu", {"s"}, {"z"});
+            return onnx_model;
+        }
+
+        auto find_string_attribute(onnx::NodeProto const& node,
+                                   std::string const& name) {
+            for(auto const& attr : node.attribute()) {
+                if(attr.name() == name) {
+                    return attr.s();
+                }
+            }
+            return std::string();
+        }
+
+        auto set_conv_reshape_model_dims(graph_ir& ir,
+                                         int output_channel_num) {
+            ir.set_dims(ir.tensor_id("x"), {1, 3, 16, 16});
+            ir.set_dims(ir.tensor_id("h"), {1, 8, 16, 16});
+            ir.set_dims(ir.tensor_id("r"), {1, 8, 16, 16});
+            ir.set_dims(ir.tensor_id("y"), {1, output_channel_num, 16, 16});
+            ir.set_dims(ir.tensor_id("s"), {1, output_channel_num * 16 * 16});
+            ir.set_dims(ir.tensor_id("z"), {1, output_channel_num * 16 * 16});
+        }
+
+        TEST(PassTest, propagate_layouts) {
+            auto onnx_model = make_conv_reshape_model(16);
+            auto& graph = *onnx_model.mutable_graph();
+            auto parameter_table = make_parameter_table(graph);
+            graph_ir ir(graph);
+            set_conv_reshape_model_dims(ir, 16);
+            // "x" is reordered by nobody. "y" is reordered for Reshape
+            ASSERT_EQ(propagate_layouts(ir, parameter_table, {{"x", "nchw"}},
+                                        {"z"}, "nChw8c", 8),
+                      16 * 16 * 16 * sizeof(float));
+            // 3 input channels do not fit blocks
+            ASSERT_EQ(find_string_attribute(graph.node(0), "tuned_src_format"),
+                      "nchw");
+            ASSERT_EQ(find_string_attribute(graph.node(0), "tuned_dst_format"),
+                      "nChw8c");
+            ASSERT_EQ(find_string_attribute(graph.node(2), "tuned_src_format"),
+                      "nChw8c");
+            ASSERT_EQ(find_string_attribute(graph.node(2), "tuned_dst_format"),
+                      "nChw8c");
+        }
+
+        TEST(PassTest, propagate_layouts_avoids_reorder_for_reshape) {
+            auto onnx_model = make_conv_reshape_model(12);
+            auto& graph = *onnx_model.mutable_graph();
+            auto parameter_table = make_parameter_table(graph);
+            graph_ir ir(graph);
+            set_conv_reshape_model_dims(ir, 12);
+            ASSERT_EQ(propagate_layouts(ir, parameter_table, {{"x", "nchw"}},
+                                        {"z"}, "nChw8c", 8),
+                      0);
+            // 12 output channels do not fit blocks, so "y" is made in nchw
+            // for Reshape
+            ASSERT_EQ(find_string_attribute(graph.node(2), "tuned_dst_format"),
+                      "nchw");
+        }
+
+        TEST(PassTest, propagate_layouts_skips_unsupported_format) {
+            auto onnx_model = make_conv_reshape_model(16);
+            auto& graph = *onnx_model.mutable_graph();
+            auto parameter_table = make_parameter_table(graph);
+            graph_ir ir(graph);
+            set_conv_reshape_model_dims(ir, 16);
+            // Convs falling back to any would not save the reorders
+            ASSERT_EQ(propagate_layouts(
+                        ir, parameter_table, {{"x", "nchw"}}, {"z"},
+                        "nChw8c", 8,
+                        [](graph_node const&, std::string const&,
+                           std::string const&) { return false; }),
+                      0);
+            for(auto i : {0, 2}) {
+                ASSERT_EQ(
+                  find_string_attribute(graph.node(i), "tuned_src_format"),
+                  i == 0 ? "nchw" : "any");
+            }
+            ASSERT_EQ(find_string_attribute(graph.node(2), "tuned_dst_format"),
+                      "nchw");
+        }
+
+        // x -> Conv -> y -> MaxPool -> p -> Relu -> z
+        //                            -> p -> Reshape -> s
+        TEST(PassTest, propagate_layouts_weighs_reorders_by_bytes) {
+            onnx::ModelProto onnx_model;
+            auto& graph = *onnx_model.mutable_graph();
+            add_initializer(graph, "w", make_test_array({8, 3, 3, 3}, 1));
+            add_node(graph, "Conv", {"x", "w"}, {"y"},
+                     {make_ints_attribute("strides", {1, 1}),
+                      make_ints_attribute("kernel_shape", {3, 3}),
+                      make_ints_attribute("pads", {1, 1, 1, 1})});
+            add_node(graph, "MaxPool", {"y"}, {"p"},
+                     {make_ints_attribute("strides", {4, 4}),
+                      make_ints_attribute("kernel_shape", {4, 4}),
+                      make_ints_attribute("pads", {0, 0, 0, 0})});
+            add_node(graph, "Relu", {"p"}, {"z"});
+            add_node(graph, "Reshape", {"p"}, {"s"},
+                     {make_ints_attribute("shape", {1, -1})});
+            auto parameter_table = make_parameter_table(graph);
+            graph_ir ir(graph);
+            ir.set_dims(ir.tensor_id("x"), {1, 3, 32, 32});
+            ir.set_dims(ir.tensor_id("y"), {1, 8, 32, 32});
+            ir.set_dims(ir.tensor_id("p"), {1, 8, 8, 8});
+            ir.set_dims(ir.tensor_id("z"), {1, 8, 8, 8});
+            // reordering "z" and "p" for Reshape is cheaper than running
+            // Conv in nchw, though they are 2 reorders against 1
+            ASSERT_EQ(propagate_layouts(ir, parameter_table, {{"x", "nchw"}},
+                                        {"z", "s"}, "nChw8c", 8),
+                      2 * 8 * 8 * 8 * sizeof(float));
+            ASSERT_EQ(find_string_attribute(graph.node(0), "tuned_dst_format"),
+                      "nChw8c");
+        }
+
+        // Runs onnx_model compiled with and without propagate_layouts and
+        // returns their reorder stats after checking that the outputs match
+        auto compare_layout_propagated_model(
+          onnx::ModelProto const& onnx_model,
+          std::vector<std::string> const& required_output_name_list) {
+            auto input = make_test_array({1, 3, 8, 8});
+            std::vector<std::tuple<std::string, dtype_t, std::vector<int>,
+                                   mkldnn::memory::format>>
+              input_list{std::make_tuple("x", dtype_t::float_, input.dims(),
+                                         mkldnn::memory::format::nchw)};
+            auto unpropagated = make_execution_context(compile_optimized_model(
+              onnx_model, make_parameter_table(onnx_model.graph()), input_list,
+              std::set<std::string>(required_output_name_list.begin(),
+                                    required_output_name_list.end()),
+              get_context().engine()));
+            auto propagated = make_execution_context(make_compiled_model(
+              onnx_model, make_parameter_table(onnx_model.graph()), input_list,
+              required_output_name_list));
+            std::copy(fbegin(input), fend(input),
+                      fbegin(unpropagated.input("x")));
+            std::copy(fbegin(input), fend(input),
+                      fbegin(propagated.input("x")));
+            auto const& output_table = propagated.run();
+            auto const& true_output_table = unpropagated.run();
+            for(auto const& name : required_output_name_list) {
+                auto const& output = find_value(output_table, name);
+                auto const& true_output = find_value(true_output_table, name);
+                assert_near_list(fbegin(output), fend(output),
+                                 fbegin(true_output), fend(true_output),
+                                 10.e-4);
+            }
+            return std::make_pair(unpropagated.reorder_stats(),
+                                  propagated.reorder_stats());
+        }
+
+        TEST(PassTest, run_layout_propagated_model) {
+            for(auto output_channel_num : {12, 16}) {
+                auto before_and_after = compare_layout_propagated_model(
+                  make_conv_reshape_model(output_channel_num), {"z"});
+                auto const& before = before_and_after.first;
+                auto const& after = before_and_after.second;
+                ASSERT_LE(after.first, before.first);
+                ASSERT_LE(after.second, before.second);
+            }
+        }
+
+        // x -> Conv -> y -> Reshape -> s1 -> Relu -> z1
+        //           -> y -> Flatten -> s2 -> Relu -> z2
+        TEST(PassTest, propagate_layouts_removes_reorders) {
+            onnx::ModelProto onnx_model;
+            auto& graph = *onnx_model.mutable_graph();
+            add_initializer(graph, "w", make_test_array({16, 3, 3, 3}, 1));
+            add_node(graph, "Conv", {"x", "w"}, {"y"},
+                     {make_ints_attribute("strides", {1, 1}),
+                      make_ints_attribute("kernel_shape", {3, 3}),
+                      make_ints_attribute("pads", {1, 1, 1, 1})});
+            add_node(graph, "Reshape", {"y"}, {"s1"},
+                     {make_ints_attribute("shape", {1, -1})});
+            add_node(graph, "Relu", {"s1"}, {"z1"});
+            add_node(graph, "Flatten", {"y"}, {"s2"});
+            add_node(graph, "Relu", {"s2"}, {"z2"});
+            auto before_and_after =
+              compare_layout_propagated_model(onnx_model, {"z1", "z2"});
+            auto const& before = before_and_after.first;
+            auto const& after = before_and_after.second;
+            if(get_blocked_format(get_cpu_isa_name()).second == 1) {
+                // nothing is propagated
+                ASSERT_EQ(after, before);
+                return;
+            }
+            // "y" is made in blocked format and reordered for both Reshape
+            // and Flatten unless it is made in nchw
+            ASSERT_EQ(after.first, 0);
+            ASSERT_LT(after.first, before.first);
+            ASSERT_LT(after.second, before.second);
+        }
+
+        // x -> Conv -> a -> Concat -> c -> Relu -> y
+        //   -> Conv -> b ->
+        //   -> Conv -> d -> Concat -> e
+        //   -> Relu -> r ->
+        auto make_concat_graph(int b_channel_num) {
+            onnx::GraphProto graph;
+            std::vector<onnx::AttributeProto> conv_attribute_list{
+              make_ints_attribute("strides", {1, 1}),
+              make_ints_attribute("kernel_shape", {3, 3}),
+              make_ints_attribute("pads", {1, 1, 1, 1})};
+            add_initializer(graph, "wa", make_test_array({8, 3, 3, 3}, 1));
+            add_initializer(graph, "ba", make_test_array({8}, 2));
+            add_initializer(graph, "wb",
+                            make_test_array({b_channel_num, 3, 3, 3}, 3));
+            add_initializer(graph, "wd", make_test_array({8, 3, 3, 3}, 4));
+            add_node(graph, "Conv", {"x", "wa", "ba"}, {"a"},
+                     conv_attribute_list);
+            add_node(graph, "Conv", {"x", "wb"}, {"b"}, conv_attribute_list);
+            add_node(graph, "Concat", {"a", "b"}, {"c"},
+                     {make_int_attribute("axis", 1)});
+            add_node(graph, "Relu", {"c"}, {"y"});
+            add_node(graph, "Conv", {"x", "wd"}, {"d"}, conv_attribute_list);
+            add_node(graph, "Relu", {"x"}, {"r"});
+            add_node(graph, "Concat", {"d", "r"}, {"e"},
+                     {make_int_attribute("axis", 1)});
+            return graph;
+        }
+
+        TEST(PassTest, plan_in_place_concat) {
+            auto graph = make_concat_graph(16);
+            auto parameter_table = make_parameter_table(graph);
+            // "r" is not made by Conv
+            ASSERT_EQ(plan_in_place_concat(graph, parameter_table, {"y", "e"}),
+                      1);
+            graph_ir ir(graph);
+            for(auto i : {0, 1}) {
+                auto const& attribute_table = ir.node(i).attribute_table;
+                ASSERT_EQ(attribute_table.at("concat_output").get().s(), "c");
+                ASSERT_EQ(attribute_table.at("concat_channel_offset").get().i(),
+                          i * 8);
+                auto const& channel_nums =
+                  attribute_table.at("concat_channel_nums").get().ints();
+                assert_eq_list(
+                  std::vector<int>(channel_nums.begin(), channel_nums.end()),
+                  std::vector<int>{8, 16});
+            }
+            ASSERT_EQ(ir.node(2).attribute_table.count("concat_in_place"), 1);
+            ASSERT_EQ(ir.node(4).attribute_table.count("concat_output"), 0);
+            ASSERT_EQ(ir.node(6).attribute_table.count("concat_in_place"), 0);
+        }
+
+        TEST(PassTest, plan_in_place_concat_keeps_required_input) {
+            auto graph = make_concat_graph(16);
+            auto parameter_table = make_parameter_table(graph);
+            ASSERT_EQ(plan_in_place_concat(graph, parameter_table, {"a", "y"}),
+                      0);
+        }
+
+        TEST(PassTest, in_place_concat_moves_no_data) {
+            // 12 channels do not fit blocks, so the output is made in nchw
+            for(auto b_channel_num : {16, 12}) {
+                auto graph = make_concat_graph(b_channel_num);
+                auto parameter_table = make_parameter_table(graph);
+                auto engine = get_context().engine();
+                auto input = make_test_array({1, 3, 8, 8});
+                std::vector<std::tuple<std::string, instant::array,
+                                       mkldnn::memory::format>>
+                  input_list{
+                    std::make_tuple("x", input, mkldnn::memory::format::nchw)};
+                auto input_memory_table =
+                  make_variable_memory_table(input_list, engine);
+                std::set<std::string> required_output_set{"y", "e"};
+
+                // the unplanned graph runs the MKL-DNN concat primitive
+                auto true_output_table =
+                  run_model(graph,
+                            std::get<0>(make_parameter_memory_table(
+                              graph, parameter_table, engine)),
+                            input_memory_table, required_output_set);
+
+                plan_in_place_concat(graph, parameter_table,
+                                     required_output_set);
+                auto parameter_memory_table = std::get<0>(
+                  make_parameter_memory_table(graph, parameter_table, engine));
+                auto temp_tuple =
+                  make_nets(graph, parameter_memory_table, input_memory_table,
+                            required_output_set);
+                auto const& node_net_range_list = std::get<8>(temp_tuple);
+                ASSERT_EQ(node_net_range_list[2].first,
+                          node_net_range_list[2].second);
+
+                mkldnn::stream(mkldnn::stream::kind::eager)
+                  .submit(std::get<4>(temp_tuple))
+                  .wait();
+                mkldnn::stream(mkldnn::stream::kind::eager)
+                  .submit(std::get<0>(temp_tuple))
+                  .wait();
+                for(auto const& name : required_output_set) {
+                    auto const& output =
+                      find_value(std::get<3>(temp_tuple), name);
+                    auto const& true_output =
+                      find_value(true_output_table, name);
+                    assert_near_list(fbegin(output), fend(output),
+                                     fbegin(true_output), fend(true_output),
+                                     10.e-4);
+                }
+            }
+        }
+
+        // x -> Relu -> r -> Conv -> a -> Conv -> h -> Add -> s -> Relu -> y
+        //              r -----------------------------> Add
+        auto make_residual_model() {
+            onnx::ModelProto onnx_model;
+            auto& graph = *onnx_model.mutable_graph();
+            std::vector<onnx::AttributeProto> conv_attribute_list{
+              make_ints_attribute("strides", {1, 1}),
+              make_ints_attribute("kernel_shape", {3, 3}),
+              make_ints_attribute("pads", {1, 1, 1, 1})};
+            add_initializer(graph, "w0", make_test_array({8, 8, 3, 3}, 1));
+            add_initializer(graph, "b0", make_test_array({8}, 2));
+            add_initializer(graph, "w1", make_test_array({8, 8, 3, 3}, 3));
+            add_node(graph, "Relu", {"x"}, {"r"});
+            add_node(graph, "Conv", {"r", "w0", "b0"}, {"a"},
+                     conv_attribute_list);
+            add_node(graph, "Conv", {"a", "w1"}, {"h"}, conv_attribute_list);
+            add_node(graph, "Add", {"h", "r"}, {"s"});
+            add_node(graph, "Relu", {"s"}, {"y"});
+            return onnx_model;
+        }
+
+        TEST(PassTest, fuse_residual_add) {
+            auto onnx_model = make_residual_model();
+            auto& graph = *onnx_model.mutable_graph();
+            // takes the name a synthesized bias would take
+            add_initializer(graph, "h_bias", make_test_array({8}, 4));
+            auto parameter_table = make_parameter_table(graph);
+            ASSERT_EQ(fuse_residual_add(graph, parameter_table, {"y"}), 1);
+            ASSERT_EQ(graph.node_size(), 4);
+            graph_ir ir(graph);
+            auto const& conv = ir.node(2);
+            ASSERT_EQ(conv.proto->output(0), "s");
+            ASSERT_EQ(conv.proto->input_size(), 4);
+            ASSERT_EQ(conv.proto->input(3), "r");
+            // bias is synthesized as an initializer of a unique name
+            auto const& bias_name = conv.proto->input(2);
+            ASSERT_NE(bias_name, "h_bias");
+            ASSERT_NE(parameter_table.find(bias_name), parameter_table.end());
+            ASSERT_TRUE(std::any_of(graph.initializer().begin(),
+                                    graph.initializer().end(),
+                                    [&bias_name](auto const& initializer) {
+                                        return initializer.name() ==
+                                               bias_name;
+                                    }));
+            ASSERT_EQ(conv.attribute_table.count("post_sum"), 1);
+            // the other consumer of "r" runs before the Conv
+            ASSERT_EQ(conv.attribute_table.count("post_sum_in_place"), 1);
+
+            // Relu after the Add is fused as well
+            fuse_post_eltwise(graph, {"y"});
+            ASSERT_EQ(graph.node_size(), 3);
+            ASSERT_EQ(graph.node(2).output(0), "y");
+        }
+
+        TEST(PassTest, fuse_residual_add_keeps_required_output) {
+            auto onnx_model = make_residual_model();
+            auto& graph = *onnx_model.mutable_graph();
+            auto parameter_table = make_parameter_table(graph);
+            ASSERT_EQ(fuse_residual_add(graph, parameter_table, {"h", "y"}),
+                      0);
+            // the residual is copied since it is required
+            ASSERT_EQ(fuse_residual_add(graph, parameter_table, {"r", "y"}),
+                      1);
+            graph_ir ir(graph);
+            ASSERT_EQ(ir.node(2).attribute_table.count("post_sum"), 1);
+            ASSERT_EQ(ir.node(2).attribute_table.count("post_sum_in_place"),
+                      0);
+        }
+
+        TEST(PassTest, run_residual_fused_model) {
+            auto input = make_test_array({1, 8, 8, 8});
+            std::vector<std::tuple<std::string, dtype_t, std::vector<int>,
+                                   mkldnn::memory::format>>
+              input_list{std::make_tuple("x", dtype_t::float_, input.dims(),
+                                         mkldnn::memory::format::nchw)};
+
+            // "h" is required so that it is not fused
+            auto unfused =
+              make_model(make_residual_model(), input_list, {"h", "y"});
+            std::copy(fbegin(input), fend(input), fbegin(unfused.input("x")));
+            auto const& unfused_output = find_value(unfused.run(), "y");
+
+            // the Conv accumulates into "r" or "r" is copied
+            for(auto const& required_output_name_list :
+                {std::vector<std::string>{"y"},
+                 std::vector<std::string>{"r", "y"}}) {
+                auto fused = make_model(make_residual_model(), input_list,
+                                        required_output_name_list);
+                std::copy(fbegin(input), fend(input),
+                          fbegin(fused.input("x")));
+                auto const& fused_output = find_value(fused.run(), "y");
+                assert_near_list(fbegin(fused_output), fend(fused_output),
+                                 fbegin(unfused_output), fend(unfused_output),
+                                 10.e-4);
+            }
+        }
+
+        // x -> Sigmoid -> a -> Clip -> b -> HardSigmoid -> c -> Tanh -> y
+        //                          b -> Neg -> z
+        auto make_eltwise_chain_graph() {
+            onnx::GraphProto graph;
+            add_node(graph, "Sigmoid", {"x"}, {"a"});
+            add_node(graph, "Clip", {"a"}, {"b"},
+                     {make_float_attribute("min", 0.1f),
+                      make_float_attribute("max", 0.8f)});
+            add_node(graph, "HardSigmoid", {"b"}, {"c"},
+                     {make_float_attribute("alpha", 0.5f)});
+            add_node(graph, "Tanh", {"c"}, {"y"});
+            add_node(graph, "Neg", {"b"}, {"z"});
+            return graph;
+        }
+
+        TEST(PassTest, fuse_eltwise_chain) {
+            auto graph = make_eltwise_chain_graph();
+            std::unordered_map<std::string, array> parameter_table;
+            ASSERT_EQ(fuse_eltwise_chain(graph, parameter_table, {"y", "z"}),
+                      2);
+            ASSERT_EQ(graph.node_size(), 3);
+            // "b" has two consumers, so the chain ends at it
+            std::vector<std::tuple<std::string, std::string,
+                                   std::vector<std::string>,
+                                   std::vector<float>, std::vector<float>>>
+              expected_list{
+                std::make_tuple("x", "b",
+                                std::vector<std::string>{"Sigmoid", "Clip"},
+                                std::vector<float>{0.f, 0.1f},
+                                std::vector<float>{0.f, 0.8f}),
+                std::make_tuple("b", "y",
+                                std::vector<std::string>{"HardSigmoid",
+                                                         "Tanh"},
+                                std::vector<float>{0.5f, 0.f},
+                                std::vector<float>{0.5f, 0.f})};
+            for(int i = 0; i < 2; ++i) {
+                auto const& node = graph.node(i);
+                auto const& expected = expected_list[i];
+                ASSERT_EQ(node.op_type(), "EltwiseChain");
+                ASSERT_EQ(node.input(0), std::get<0>(expected));
+                ASSERT_EQ(node.output(0), std::get<1>(expected));
+                auto attribute_table = make_attribute_table(node);
+                onnx::AttributeProto const& op_types_attr =
+                  find_value(attribute_table, "eltwise_op_types");
+                onnx::AttributeProto const& alphas_attr =
+                  find_value(attribute_table, "eltwise_alphas");
+                onnx::AttributeProto const& betas_attr =
+                  find_value(attribute_table, "eltwise_betas");
+                ASSERT_EQ(std::vector<std::string>(
+                            op_types_attr.strings().begin(),
+                            op_types_attr.strings().end()),
+                          std::get<2>(expected));
+                for(int k = 0; k < 2; ++k) {
+                    ASSERT_FLOAT_EQ(alphas_attr.floats(k),
+                                    std::get<3>(expected)[k]);
+                    ASSERT_FLOAT_EQ(betas_attr.floats(k),
+                                    std::get<4>(expected)[k]);
+                }
+            }
+            ASSERT_EQ(graph.node(2).op_type(), "Neg");
+        }
+
+        TEST(PassTest, fuse_eltwise_chain_keeps_required_output) {
+            auto graph = make_eltwise_chain_graph();
+            std::unordered_map<std::string, array> parameter_table;
+            ASSERT_EQ(fuse_eltwise_chain(graph, parameter_table,
+                                         {"a", "c", "y", "z"}),
+                      0);
+            ASSERT_EQ(graph.node_size(), 5);
+        }
+
+        TEST(PassTest, fuse_eltwise_chain_keeps_int8_relu) {
+            for(auto data_type : {"u8", "f32"}) {
+                onnx::GraphProto graph;
+                add_initializer(graph, "w", make_test_array({8, 3, 3, 3}, 1));
+                auto* conv = add_node(graph, "Conv", {"x", "w"}, {"h"});
+                auto* attr = conv->add_attribute();
+                attr->set_name("quantized_output_data_type");
+                attr->set_type(onnx::AttributeProto_AttributeType_STRING);
+                attr->set_s(data_type);
+                add_node(graph, "Relu", {"h"}, {"r"});
+                add_node(graph, "Relu", {"r"}, {"y"});
+                // Relu of u8 "h" runs in int8 (see quantize)
+                auto parameter_table = make_parameter_table(graph);
+                ASSERT_EQ(fuse_eltwise_chain(graph, parameter_table, {"y"}),
+                          std::string(data_type) == "u8" ? 0 : 1);
+            }
+        }
+
+        // x -> Add(0.5) -> Relu -> Clip -> y1
+        // x -> Mul(c) -> Add(b) -> Sigmoid -> y2
+        // x -> BatchNormalization -> Relu -> y3
+        // c and b vary along the channels of x of (N, 4, H, W)
+        auto make_affine_chain_graph() {
+            onnx::GraphProto graph;
+            auto s = array(dtype_t::float_, {1});
+            fat(s, 0) = 0.5f;
+            add_initializer(graph, "s", s);
+            add_initializer(graph, "c", make_test_array({4, 1, 1}, 1));
+            add_initializer(graph, "b", make_test_array({4, 1, 1}, 2));
+            add_initializer(graph, "scale", make_test_array({4}, 3));
+            add_initializer(graph, "bias", make_test_array({4}, 4));
+            add_initializer(graph, "mean", make_test_array({4}, 5));
+            auto var = make_test_array({4}, 6);
+            std::transform(fbegin(var), fend(var), fbegin(var),
+                           [](float v) { return std::abs(v) + 0.5f; });
+            add_initializer(graph, "var", var);
+            add_node(graph, "Add", {"x", "s"}, {"a1"});
+            add_node(graph, "Relu", {"a1"}, {"r1"});
+            add_node(graph, "Clip", {"r1"}, {"y1"},
+                     {make_float_attribute("min", 0.f),
+                      make_float_attribute("max", 0.5f)});
+            add_node(graph, "Mul", {"c", "x"}, {"m2"});
+            add_node(graph, "Add", {"m2", "b"}, {"a2"});
+            add_node(graph, "Sigmoid", {"a2"}, {"y2"});
+            add_node(graph, "BatchNormalization",
+                     {"x", "scale", "bias", "mean", "var"}, {"n3"},
+                     {make_float_attribute("epsilon", 1e-3f)});
+            add_node(graph, "Relu", {"n3"}, {"y3"});
+            return graph;
+        }
+
+        TEST(PassTest, fuse_eltwise_chain_of_affine_steps) {
+            auto graph = make_affine_chain_graph();
+            auto parameter_table = make_parameter_table(graph);
+            ASSERT_EQ(fuse_eltwise_chain(graph, parameter_table,
+                                         {"y1", "y2", "y3"}),
+                      5);
+            ASSERT_EQ(graph.node_size(), 3);
+            std::vector<std::tuple<std::string, std::vector<std::string>,
+                                   std::vector<int>>>
+              expected_list{
+                std::make_tuple("y1",
+                                std::vector<std::string>{"Affine", "Relu",
+                                                         "Clip"},
+                                std::vector<int>{0, 0, 0}),
+                std::make_tuple("y2",
+                                std::vector<std::string>{"AxisAffine",
+                                                         "AxisAffine",
+                                                         "Sigmoid"},
+                                std::vector<int>{-3, -3, 0}),
+                std::make_tuple("y3",
+                                std::vector<std::string>{"AxisAffine",
+                                                         "Relu"},
+                                std::vector<int>{1, 0})};
+            for(int i = 0; i < 3; ++i) {
+                auto const& node = graph.node(i);
+                auto const& expected = expected_list[i];
+                ASSERT_EQ(node.op_type(), "EltwiseChain");
+                ASSERT_EQ(node.input(0), "x");
+                ASSERT_EQ(node.output(0), std::get<0>(expected));
+                auto attribute_table = make_attribute_table(node);
+                onnx::AttributeProto const& op_types_attr =
+                  find_value(attribute_table, "eltwise_op_types");
+                onnx::AttributeProto const& axes_attr =
+                  find_value(attribute_table, "eltwise_axes");
+                ASSERT_EQ(std::vector<std::string>(
+                            op_types_attr.strings().begin(),
+                            op_types_attr.strings().end()),
+                          std::get<1>(expected));
+                ASSERT_EQ(std::vector<int>(axes_attr.ints().begin(),
+                                           axes_attr.ints().end()),
+                          std::get<2>(expected));
+            }
+
+            // Add of the scalar is kept in the coefficients
+            auto y1_attribute_table = make_attribute_table(graph.node(0));
+            onnx::AttributeProto const& alphas_attr =
+              find_value(y1_attribute_table, "eltwise_alphas");
+            onnx::AttributeProto const& betas_attr =
+              find_value(y1_attribute_table, "eltwise_betas");
+            ASSERT_EQ(graph.node(0).input_size(), 1);
+            ASSERT_FLOAT_EQ(alphas_attr.floats(0), 1.f);
+            ASSERT_FLOAT_EQ(betas_attr.floats(0), 0.5f);
+
+            // constants are taken as scales and shifts
+            auto c = make_test_array({4, 1, 1}, 1);
+            auto b = make_test_array({4, 1, 1}, 2);
+            auto const& y2_node = graph.node(1);
+            ASSERT_EQ(y2_node.input_size(), 5);
+            for(int k = 0; k < 4; ++k) {
+                ASSERT_FLOAT_EQ(fat(parameter_table.at(y2_node.input(1)), k),
+                                fat(c, k));
+                ASSERT_FLOAT_EQ(fat(parameter_table.at(y2_node.input(2)), k),
+                                0.f);
+                ASSERT_FLOAT_EQ(fat(parameter_table.at(y2_node.input(3)), k),
+                                1.f);
+                ASSERT_FLOAT_EQ(fat(parameter_table.at(y2_node.input(4)), k),
+                                fat(b, k));
+            }
+
+            // BatchNormalization is folded
+            auto const& y3_node = graph.node(2);
+            ASSERT_EQ(y3_node.input_size(), 3);
+            auto const& folded_scale = parameter_table.at(y3_node.input(1));
+            auto const& folded_shift = parameter_table.at(y3_node.input(2));
+            auto scale = make_test_array({4}, 3);
+            auto bias = make_test_array({4}, 4);
+            auto mean = make_test_array({4}, 5);
+            auto var = make_test_array({4}, 6);
+            for(int k = 0; k < 4; ++k) {
+                auto factor =
+                  fat(scale, k) / std::sqrt(std::abs(fat(var, k)) + 0.5f +
+                                            1e-3f);
+                ASSERT_NEAR(fat(folded_scale, k), factor, 1e-6f);
+                ASSERT_NEAR(fat(folded_shift, k),
+                            fat(bias, k) - fat(mean, k) * factor, 1e-6f);
+            }
+
+            // the original constants are released
+            for(auto const& name :
+                {"s", "c", "b", "scale", "bias", "mean", "var"}) {
+                ASSERT_EQ(parameter_table.count(name), 0) << name;
+            }
+            ASSERT_EQ(graph.initializer_size(), 6);
+            for(auto const& initializer : graph.initializer()) {
+                ASSERT_EQ(parameter_table.count(initializer.name()), 1);
+            }
+        }
+
+        TEST(PassTest, fuse_eltwise_chain_skips_unmatched_constant) {
+            // a constant of two axes, or broadcasting x to more dims
+            for(auto const& dims :
+                {std::vector<int>{4, 2, 1}, std::vector<int>{1, 1, 1, 1, 4}}) {
+                onnx::GraphProto graph;
+                add_initializer(graph, "c", make_test_array(dims));
+                add_node(graph, "Mul", {"x", "c"}, {"m"});
+                add_node(graph, "Relu", {"m"}, {"y"});
+                auto* input = graph.add_input();
+                input->set_name("x");
+                for(auto d : {2, 4, 2, 3}) {
+                    input->mutable_type()
+                      ->mutable_tensor_type()
+                      ->mutable_shape()
+                      ->add_dim()
+                      ->set_dim_value(d);
+                }
+                auto parameter_table = make_parameter_table(graph);
+                ASSERT_EQ(fuse_eltwise_chain(graph, parameter_table, {"y"}),
+                          0);
+                ASSERT_EQ(parameter_table.count("c"), 1);
+            }
+        }
+
+    } // namespace
+} // namespace instant
@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "common.hpp"
+#include "onnx_builder.hpp"
+
+#include <instant/instant.hpp>
+
+namespace instant {
+    namespace {
+
+        TEST(ProfileTest, profile_conv) {
+            onnx::ModelProto onnx_model;
+            auto& graph = *onnx_model.mutable_graph();
+            add_initializer(graph, "w", make_test_array({16, 3, 3, 3}, 1));
+            add_initializer(graph, "b", make_test_array({16}, 2));
+            add_node(graph, "Conv", {"x", "w", "b"}, {"y"},
+                     {make_ints_attribute("strides", {1, 1}),
+                      make_ints_attribute("kernel_shape", {3, 3}),
+                      make_ints_attribute("pads", {1, 1, 1, 1})});
+            std::vector<int> input_dims{2, 3, 8, 8};
+            auto model = make_model(
+              onnx_model,
+              {std::make_tuple("x", dtype_t::float_, input_dims,
+                               mkldnn::memory::format::nchw)},
+              {"y"});
+
+            model.run(); // not profiled
+            model.set_profiling_enabled(true);
+            for(int i = 0; i < 3; ++i) {
+                model.run();
+            }
+            model.set_profiling_enabled(false);
+            model.run(); // not profiled
+
+            auto profile_list = model.profile();
+            ASSERT_FALSE(profile_list.empty());
+            int compute_num = 0;
+            for(auto const& p : profile_list) {
+                ASSERT_EQ(p.node_name, "y");
+                ASSERT_EQ(p.op_type, "Conv");
+                ASSERT_GE(p.time, 0.);
+                if(p.kind == "compute") {
+                    ++compute_num;
+                    ASSERT_DOUBLE_EQ(p.flops,
+                                     2. * (2 * 16 * 8 * 8) * (3 * 3 * 3));
+                } else {
+                    ASSERT_EQ(p.kind, "reorder");
+                    ASSERT_EQ(p.flops, 0.);
+                }
+            }
+            ASSERT_EQ(compute_num, 1);
+
+            // a header, a row per primitive in descending order of time
+            // and the total
+            std::ostringstream oss;
+            print_profile(oss, profile_list);
+            std::istringstream iss(oss.str());
+            std::string line;
+            ASSERT_TRUE(std::getline(iss, line));
+            std::vector<double> time_list;
+            double total_time = 0.;
+            double total_percentage = 0.;
+            for(std::size_t i = 0; i < profile_list.size(); ++i) {
+                ASSERT_TRUE(std::getline(iss, line));
+                std::istringstream row(line);
+                std::string node_name, op_type, kind;
+                double time, percentage, gflop, gflops_per_second;
+                ASSERT_TRUE(row >> node_name >> op_type >> kind >> time >>
+                            percentage >> gflop >> gflops_per_second)
+                  << line;
+                ASSERT_EQ(node_name, "y");
+                ASSERT_EQ(op_type, "Conv");
+                ASSERT_NEAR(gflop,
+                            kind == "compute"
+                              ? 2. * (2 * 16 * 8 * 8) * (3 * 3 * 3) * 1.e-9
+                              : 0.,
+                            1.e-6);
+                time_list.push_back(time);
+                total_time += time;
+                total_percentage += percentage;
+            }
+            ASSERT_TRUE(std::is_sorted(time_list.rbegin(), time_list.rend()));
+            ASSERT_TRUE(std::getline(iss, line));
+            std::istringstream total_row(line);
+            std::string total_label;
+            double printed_total_time;
+            ASSERT_TRUE(total_row >> total_label >> printed_total_time);
+            ASSERT_EQ(total_label, "total");
+            ASSERT_NEAR(printed_total_time, total_time,
+                        1.e-3 * std::max(1., total_time));
+            if(total_time > 0.) {
+                ASSERT_NEAR(total_percentage, 100., 0.1);
+            }
+            ASSERT_FALSE(std::getline(iss, line));
+
+            model.reset_profile();
+            for(auto const& p : model.profile()) {
+                ASSERT_EQ(p.time, 0.);
+            }
+        }
+
+    } // namespace
+} // namespace instant
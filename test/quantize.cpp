@@ -0,0 +1,219 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <tuple>
+#include <vector>
+
+#include "common.hpp"
+#include "onnx_builder.hpp"
+
+#include <instant/instant.hpp>
+
+namespace instant {
+    namespace {
+
+        // x -> Conv -> Relu -> MaxPool -> Conv -> y
+        auto make_conv_pool_model() {
+            onnx::ModelProto onnx_model;
+            auto& graph = *onnx_model.mutable_graph();
+            std::vector<onnx::AttributeProto> conv_attribute_list{
+              make_ints_attribute("strides", {1, 1}),
+              make_ints_attribute("kernel_shape", {3, 3}),
+              make_ints_attribute("pads", {1, 1, 1, 1})};
+            add_initializer(graph, "w1", make_test_array({8, 3, 3, 3}, 1));
+            add_initializer(graph, "b1", make_test_array({8}, 2));
+            add_initializer(graph, "w2", make_test_array({4, 8, 3, 3}, 3));
+            add_initializer(graph, "b2", make_test_array({4}, 4));
+            add_node(graph, "Conv", {"x", "w1", "b1"}, {"h"},
+                     conv_attribute_list);
+            add_node(graph, "Relu", {"h"}, {"r"});
+            add_node(graph, "MaxPool", {"r"}, {"p"},
+                     {make_ints_attribute("strides", {2, 2}),
+                      make_ints_attribute("kernel_shape", {2, 2}),
+                      make_ints_attribute("pads", {0, 0, 0, 0})});
+            add_node(graph, "Conv", {"p", "w2", "b2"}, {"y"},
+                     conv_attribute_list);
+            return onnx_model;
+        }
+
+        auto find_attribute(onnx::NodeProto const& node,
+                            std::string const& name) {
+            for(auto const& attr : node.attribute()) {
+                if(attr.name() == name) {
+                    return attr;
+                }
+            }
+            throw std::runtime_error("attribute not found: " + name);
+        }
+
+        TEST(QuantizeTest, quantize) {
+            auto onnx_model = make_conv_pool_model();
+            auto& graph = *onnx_model.mutable_graph();
+            auto parameter_table = make_parameter_table(graph);
+            range_table_t range_table{{"x", {0.f, 1.f}},
+                                      {"h", {-2.f, 2.f}},
+                                      {"r", {0.f, 2.f}},
+                                      {"p", {0.f, 1.5f}},
+                                      {"y", {-3.f, 3.f}}};
+            fuse_post_eltwise(graph, {"y"});
+            ASSERT_EQ(graph.node_size(), 3); // Relu is fused into Conv
+            quantize(graph, parameter_table, range_table, {"y"});
+
+            auto const& conv1 = graph.node(0);
+            ASSERT_EQ(find_attribute(conv1, "quantized_input_scale").f(),
+                      255.f);
+            ASSERT_EQ(find_attribute(conv1, "quantized_weight_scales")
+                        .floats_size(),
+                      8);
+            ASSERT_EQ(find_attribute(conv1, "quantized_output_scale").f(),
+                      255.f / 2.f);
+            ASSERT_EQ(find_attribute(conv1, "quantized_output_data_type").s(),
+                      "u8");
+
+            // MaxPool keeps the scale of "r", not the one of "p"
+            auto const& conv2 = graph.node(2);
+            ASSERT_EQ(find_attribute(conv2, "quantized_input_scale").f(),
+                      255.f / 2.f);
+            ASSERT_EQ(find_attribute(conv2, "quantized_output_scale").f(),
+                      1.f);
+            ASSERT_EQ(find_attribute(conv2, "quantized_output_data_type").s(),
+                      "f32");
+        }
+
+        TEST(QuantizeTest, quantize_skips_negative_input) {
+            auto onnx_model = make_conv_pool_model();
+            auto& graph = *onnx_model.mutable_graph();
+            auto parameter_table = make_parameter_table(graph);
+            range_table_t range_table{
+              {"x", {-1.f, 1.f}}, {"h", {-2.f, 2.f}}, {"r", {0.f, 2.f}},
+              {"p", {0.f, 2.f}},  {"y", {-3.f, 3.f}}};
+            quantize(graph, parameter_table, range_table, {"y"});
+            for(auto const& attr : graph.node(0).attribute()) {
+                ASSERT_NE(attr.name(), "quantized_input_scale");
+            }
+            // f32 "p" is quantized by the second Conv
+            ASSERT_EQ(
+              find_attribute(graph.node(3), "quantized_input_scale").f(),
+              255.f / 2.f);
+        }
+
+        TEST(QuantizeTest, save_and_load_range_table) {
+            range_table_t range_table{{"x", {0.f, 1.f}},
+                                      {"h", {-0.125f, 3.5f}}};
+            auto filename = "range_table_test.txt";
+            save_range_table(filename, range_table);
+            auto loaded_range_table = load_range_table(filename);
+            std::remove(filename);
+            ASSERT_EQ(loaded_range_table, range_table);
+        }
+
+        // Non-negative input of make_conv_pool_model with batch_size
+        // samples
+        auto make_conv_pool_input(int batch_size) {
+            auto input = make_test_array({batch_size, 3, 16, 16});
+            std::transform(fbegin(input), fend(input), fbegin(input),
+                           [](float v) { return std::abs(v); });
+            return input;
+        }
+
+        // Ranges of the tensors of make_conv_pool_model and its f32 output
+        // "y", calibrated with input itself
+        auto calibrate_conv_pool_model(onnx::ModelProto const& onnx_model,
+                                       array const& input) {
+            auto f32_model = make_model(
+              onnx_model,
+              {std::make_tuple("x", dtype_t::float_, input.dims(),
+                               mkldnn::memory::format::nchw)},
+              {"h", "r", "p", "y"});
+            std::copy(fbegin(input), fend(input), fbegin(f32_model.input("x")));
+            auto const& output_table = f32_model.run();
+            range_table_t range_table{{"x", {0.f, 1.f}}};
+            for(auto const& name : {"h", "r", "p", "y"}) {
+                auto const& arr = find_value(output_table, name);
+                auto min_max = std::minmax_element(fbegin(arr), fend(arr));
+                range_table[name] =
+                  std::make_pair(*min_max.first, *min_max.second);
+            }
+            auto const& y = find_value(output_table, "y");
+            return std::make_pair(range_table,
+                                  std::vector<float>(fbegin(y), fend(y)));
+        }
+
+        TEST(QuantizeTest, run_int8_model) {
+            auto onnx_model = make_conv_pool_model();
+            auto input = make_conv_pool_input(1);
+            std::vector<std::tuple<std::string, dtype_t, std::vector<int>,
+                                   mkldnn::memory::format>>
+              input_list{std::make_tuple("x", dtype_t::float_, input.dims(),
+                                         mkldnn::memory::format::nchw)};
+            range_table_t range_table;
+            std::vector<float> true_output;
+            std::tie(range_table, true_output) =
+              calibrate_conv_pool_model(onnx_model, input);
+
+            auto int8_context =
+              make_execution_context(make_int8_compiled_model(
+                onnx_model, make_parameter_table(onnx_model.graph()),
+                range_table, input_list, {"y"}));
+            std::copy(fbegin(input), fend(input),
+                      fbegin(int8_context.input("x")));
+            auto const& output = find_value(int8_context.run(), "y");
+            auto abs_max = std::max(std::abs(range_table.at("y").first),
+                                    std::abs(range_table.at("y").second));
+            assert_near_list(fbegin(output), fend(output),
+                             true_output.begin(), true_output.end(),
+                             abs_max * 0.05f);
+        }
+
+        TEST(QuantizeTest, run_int8_model_at_two_batch_sizes) {
+            // nets of the second batch size are made from parameters
+            // already quantized by the first, which must not be scaled
+            // again
+            auto onnx_model = make_conv_pool_model();
+            constexpr int batch_size = 16;
+            auto input = make_conv_pool_input(batch_size);
+            range_table_t range_table;
+            std::vector<float> true_output;
+            std::tie(range_table, true_output) =
+              calibrate_conv_pool_model(onnx_model, input);
+
+            auto sample_input_dims = input.dims();
+            sample_input_dims[0] = 1;
+            auto compiled = make_int8_compiled_model(
+              onnx_model, make_parameter_table(onnx_model.graph()),
+              range_table,
+              {std::make_tuple("x", dtype_t::float_, sample_input_dims,
+                               mkldnn::memory::format::nchw)},
+              {"y"});
+            auto sample_context = make_execution_context(compiled);
+            auto batch_context =
+              make_execution_context(compiled, {input.dims()});
+            std::copy(fbegin(input), fend(input),
+                      fbegin(batch_context.input("x")));
+            auto const& batch_output = find_value(batch_context.run(), "y");
+
+            auto abs_max = std::max(std::abs(range_table.at("y").first),
+                                    std::abs(range_table.at("y").second));
+            assert_near_list(fbegin(batch_output), fend(batch_output),
+                             true_output.begin(), true_output.end(),
+                             abs_max * 0.05f);
+            auto sample_size = calc_total_size(sample_input_dims);
+            auto output_sample_size = total_size(batch_output) / batch_size;
+            for(int b = 0; b < batch_size; ++b) {
+                std::copy(fbegin(input) + b * sample_size,
+                          fbegin(input) + (b + 1) * sample_size,
+                          fbegin(sample_context.input("x")));
+                auto const& sample_output =
+                  find_value(sample_context.run(), "y");
+                assert_near_list(
+                  fbegin(sample_output), fend(sample_output),
+                  true_output.begin() + b * output_sample_size,
+                  true_output.begin() + (b + 1) * output_sample_size,
+                  abs_max * 0.05f);
+            }
+        }
+
+    } // namespace
+} // namespace instant
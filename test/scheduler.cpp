@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+
+#include "common.hpp"
+#include "onnx_builder.hpp"
+
+#include <instant/instant.hpp>
+#include <instant/scheduler.hpp>
+
+namespace instant {
+    namespace {
+
+        // x -> a -> b -> y0
+        //   -> c -> d -> y1
+        auto make_branch_graph() {
+            onnx::GraphProto graph;
+            add_node(graph, "Relu", {"x"}, {"a"});
+            add_node(graph, "Relu", {"a"}, {"b"});
+            add_node(graph, "Relu", {"b"}, {"y0"});
+            add_node(graph, "Relu", {"x"}, {"c"});
+            add_node(graph, "Relu", {"c"}, {"d"});
+            add_node(graph, "Relu", {"d"}, {"y1"});
+            return graph;
+        }
+
+        TEST(SchedulerTest, serialize_nodes) {
+            auto dependency_list =
+              make_node_dependency_list(make_branch_graph());
+            assert_eq_list(dependency_list[0], std::vector<int>{});
+            assert_eq_list(dependency_list[2], std::vector<int>{1});
+            assert_eq_list(dependency_list[3], std::vector<int>{});
+
+            auto node_partial_order = serialize_nodes(dependency_list);
+            ASSERT_EQ(node_partial_order.size(), 3);
+            assert_eq_list(node_partial_order[0], std::vector<int>{0, 3});
+            assert_eq_list(node_partial_order[1], std::vector<int>{1, 4});
+            assert_eq_list(node_partial_order[2], std::vector<int>{2, 5});
+
+            auto thread_budget_list =
+              make_thread_budget_list(node_partial_order, 7);
+            assert_eq_list(thread_budget_list,
+                           std::vector<int>{3, 3, 3, 3, 3, 3});
+
+            auto ancestor_table = make_ancestor_table(dependency_list);
+            ASSERT_TRUE(ancestor_table[2][0]);
+            ASSERT_FALSE(ancestor_table[3][2]);
+            ASSERT_FALSE(ancestor_table[0][2]);
+        }
+
+        TEST(SchedulerTest, dag_executor_keeps_dependencies) {
+            // node i depends on i-1 and i-3
+            constexpr int node_num = 200;
+            std::vector<std::vector<int>> dependency_list(node_num);
+            for(int i = 0; i < node_num; ++i) {
+                for(auto d : {i - 3, i - 1}) {
+                    if(d >= 0) {
+                        dependency_list[i].push_back(d);
+                    }
+                }
+            }
+            dag_executor executor(4);
+            for(int iteration = 0; iteration < 10; ++iteration) {
+                std::atomic<int> clock(0);
+                std::vector<int> start_list(node_num), finish_list(node_num);
+                executor.run(dependency_list, [&](int i) {
+                    start_list[i] = clock++;
+                    finish_list[i] = clock++;
+                });
+                for(int i = 0; i < node_num; ++i) {
+                    for(auto d : dependency_list[i]) {
+                        ASSERT_LT(finish_list[d], start_list[i]);
+                    }
+                }
+            }
+        }
+
+        TEST(SchedulerTest, dag_executor_rethrows_exception) {
+            std::vector<std::vector<int>> dependency_list{{}, {0}, {}};
+            dag_executor executor(2);
+            std::atomic<int> run_count(0);
+            ASSERT_THROW(executor.run(dependency_list,
+                                      [&](int i) {
+                                          ++run_count;
+                                          if(i == 0) {
+                                              throw std::runtime_error("");
+                                          }
+                                      }),
+                         std::runtime_error);
+            ASSERT_EQ(run_count, 2); // node 1 is skipped
+            executor.run(dependency_list, [&](int) { ++run_count; });
+            ASSERT_EQ(run_count, 5);
+        }
+
+        TEST(SchedulerTest, run_branches_concurrently) {
+            onnx::ModelProto onnx_model;
+            *onnx_model.mutable_graph() = make_branch_graph();
+            std::vector<int> input_dims{1, 8, 16, 16};
+            auto compiled = make_compiled_model(
+              onnx_model, {},
+              {std::make_tuple("x", dtype_t::float_, input_dims,
+                               mkldnn::memory::format::nchw)},
+              {"y0", "y1"});
+            auto serial_context = make_execution_context(compiled);
+            auto concurrent_context = make_execution_context(compiled, 2);
+            ASSERT_EQ(concurrent_context.inter_op_thread_num(), 2);
+            // "c" can not reuse storage of "a" since they may be used at the
+            // same time
+            ASSERT_GT(concurrent_context.arena_size(),
+                      serial_context.arena_size());
+
+            auto input = make_test_array(input_dims);
+            for(auto* context : {&serial_context, &concurrent_context}) {
+                std::copy(fbegin(input), fend(input),
+                          fbegin(context->input("x")));
+            }
+            auto const& serial_output_table = serial_context.run();
+            for(int i = 0; i < 10; ++i) {
+                auto const& concurrent_output_table = concurrent_context.run();
+                for(auto const& name : {"y0", "y1"}) {
+                    auto const& output =
+                      find_value(concurrent_output_table, name);
+                    auto const& true_output =
+                      find_value(serial_output_table, name);
+                    assert_eq_list(fbegin(output), fend(output),
+                                   fbegin(true_output), fend(true_output));
+                }
+            }
+        }
+
+    } // namespace
+} // namespace instant
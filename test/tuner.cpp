@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+
+#include "common.hpp"
+#include "onnx_builder.hpp"
+
+#include <instant/instant.hpp>
+
+namespace instant {
+    namespace {
+
+        auto make_conv_relu_conv_model() {
+            onnx::ModelProto onnx_model;
+            auto& graph = *onnx_model.mutable_graph();
+            std::vector<onnx::AttributeProto> conv_attribute_list{
+              make_ints_attribute("strides", {1, 1}),
+              make_ints_attribute("kernel_shape", {3, 3}),
+              make_ints_attribute("pads", {1, 1, 1, 1})};
+            add_initializer(graph, "w1", make_test_array({16, 3, 3, 3}, 1));
+            add_initializer(graph, "b1", make_test_array({16}, 2));
+            add_initializer(graph, "w2", make_test_array({16, 16, 3, 3}, 3));
+            add_node(graph, "Conv", {"x", "w1", "b1"}, {"h"},
+                     conv_attribute_list);
+            add_node(graph, "Relu", {"h"}, {"r"});
+            add_node(graph, "Conv", {"r", "w2"}, {"y"}, conv_attribute_list);
+            return onnx_model;
+        }
+
+        auto find_string_attribute(onnx::NodeProto const& node,
+                                   std::string const& name) {
+            for(auto const& attr : node.attribute()) {
+                if(attr.name() == name) {
+                    return attr.s();
+                }
+            }
+            return std::string();
+        }
+
+        TEST(TunerTest, save_and_load_conv_tuning_cache) {
+            conv_tuning_cache_t cache{
+              {"avx2;1x3x8x8;nchw", std::make_tuple("direct", "any", "any")},
+              {"avx2;1x16x8x8;nChw8c",
+               std::make_tuple("winograd", "nChw8c", "nchw")}};
+            auto filename = "conv_tuning_cache_test.txt";
+            save_conv_tuning_cache(filename, cache);
+            auto loaded_cache = load_conv_tuning_cache(filename);
+            std::remove(filename);
+            ASSERT_EQ(loaded_cache, cache);
+        }
+
+        TEST(TunerTest, tune_conv) {
+            std::vector<std::tuple<std::string, dtype_t, std::vector<int>,
+                                   mkldnn::memory::format>>
+              input_list{std::make_tuple("x", dtype_t::float_,
+                                         std::vector<int>{1, 3, 16, 16},
+                                         mkldnn::memory::format::nchw)};
+            auto onnx_model = make_conv_relu_conv_model();
+            auto& graph = *onnx_model.mutable_graph();
+            auto parameter_table = make_parameter_table(graph);
+            conv_tuning_cache_t cache;
+            tune_conv(graph, parameter_table, input_list, {"y"}, cache,
+                      get_context().engine(), 2);
+            ASSERT_EQ(cache.size(), 2);
+            for(auto i : {0, 2}) {
+                ASSERT_NE(find_string_attribute(graph.node(i),
+                                                "tuned_conv_algorithm"),
+                          "");
+            }
+
+            // the same winners are taken from cache
+            auto cached_onnx_model = make_conv_relu_conv_model();
+            auto& cached_graph = *cached_onnx_model.mutable_graph();
+            tune_conv(cached_graph, parameter_table, input_list, {"y"}, cache,
+                      get_context().engine(), 2);
+            ASSERT_EQ(cache.size(), 2);
+            for(auto i : {0, 2}) {
+                for(auto const& name : {"tuned_conv_algorithm",
+                                        "tuned_src_format",
+                                        "tuned_dst_format"}) {
+                    ASSERT_EQ(find_string_attribute(cached_graph.node(i), name),
+                              find_string_attribute(graph.node(i), name));
+                }
+            }
+        }
+
+        TEST(TunerTest, run_tuned_model) {
+            auto onnx_model = make_conv_relu_conv_model();
+            auto input = make_test_array({1, 3, 16, 16});
+            std::vector<std::tuple<std::string, dtype_t, std::vector<int>,
+                                   mkldnn::memory::format>>
+              input_list{std::make_tuple("x", dtype_t::float_, input.dims(),
+                                         mkldnn::memory::format::nchw)};
+            auto filename = "conv_tuning_cache_test.txt";
+            std::remove(filename);
+            auto model = make_model(onnx_model, input_list, {"y"});
+            auto tuned_model = make_tuned_model(
+              onnx_model, make_parameter_table(onnx_model.graph()), input_list,
+              {"y"}, filename);
+            ASSERT_EQ(load_conv_tuning_cache(filename).size(), 2);
+            std::remove(filename);
+
+            std::copy(fbegin(input), fend(input), fbegin(model.input("x")));
+            std::copy(fbegin(input), fend(input),
+                      fbegin(tuned_model.input("x")));
+            auto const& output = find_value(model.run(), "y");
+            auto const& tuned_output = find_value(tuned_model.run(), "y");
+            // Winograd is a little less accurate than direct
+            assert_near_list(fbegin(tuned_output), fend(tuned_output),
+                             fbegin(output), fend(output), 10.e-3);
+        }
+
+    } // namespace
+} // namespace instant
@@ -0,0 +1,142 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include <instant/batching_server.hpp>
+
+#include "../external/cmdline.h"
+
+auto parse_int_list(std::string const& str) {
+    std::vector<int> int_list;
+    std::istringstream iss(str);
+    std::string token;
+    while(std::getline(iss, token, ',')) {
+        int_list.push_back(std::stoi(token));
+    }
+    return int_list;
+}
+
+auto calc_percentile(std::vector<double> sorted_list, double p) {
+    if(sorted_list.empty()) {
+        return 0.;
+    }
+    auto index = static_cast<std::size_t>(p * (sorted_list.size() - 1));
+    return sorted_list[index];
+}
+
+// Submits requests at a constant rate for duration and collects latencies
+auto generate_load(instant::batching_server& server,
+                   instant::batching_server::input_table_t const& input_table,
+                   int request_rate, std::chrono::milliseconds duration) {
+    using clock = std::chrono::steady_clock;
+    using request_t =
+      std::pair<clock::time_point,
+                std::future<instant::batching_server::output_table_t>>;
+    auto interval = std::chrono::duration_cast<clock::duration>(
+      std::chrono::duration<double>(1. / request_rate));
+    auto request_num = static_cast<int>(
+      request_rate * std::chrono::duration<double>(duration).count());
+
+    std::mutex mutex;
+    std::condition_variable submitted;
+    std::deque<request_t> request_queue;
+    std::vector<double> latency_list; // milliseconds
+
+    // Batches complete in submission order, so waiting futures in order
+    // records completion times of all requests
+    std::thread collector([&]() {
+        for(int i = 0; i < request_num; ++i) {
+            request_t r;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                submitted.wait(lock, [&]() { return !request_queue.empty(); });
+                r = std::move(request_queue.front());
+                request_queue.pop_front();
+            }
+            r.second.get();
+            latency_list.push_back(
+              std::chrono::duration<double, std::milli>(clock::now() - r.first)
+                .count());
+        }
+    });
+
+    auto start = clock::now();
+    for(int i = 0; i < request_num; ++i) {
+        std::this_thread::sleep_until(start + i * interval);
+        auto submit_time = clock::now();
+        auto future = server.submit(input_table);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            request_queue.emplace_back(submit_time, std::move(future));
+        }
+        submitted.notify_one();
+    }
+    collector.join();
+    auto elapsed =
+      std::chrono::duration<double>(clock::now() - start).count();
+
+    std::sort(latency_list.begin(), latency_list.end());
+    return std::make_tuple(request_num / elapsed,
+                           calc_percentile(latency_list, 0.5),
+                           calc_percentile(latency_list, 0.99));
+}
+
+int main(int argc, char** argv) {
+    cmdline::parser a;
+    a.add<std::string>("model", 'm', "onnx model path", true);
+    a.add<std::string>("input", 'i', "input name", true);
+    a.add<std::string>("output", 'o', "required output name", true);
+    a.add<int>("channel_num", 'c', "input channel num", false, 3);
+    a.add<int>("height", 'h', "input height", false, 224);
+    a.add<int>("width", 'w', "input width", false, 224);
+    a.add<int>("max_batch_size", 'b', "max batch size", false, 16);
+    a.add<int>("max_wait_time", 't', "max wait time [us]", false, 2000);
+    a.add<std::string>("rates", 'r', "request rates [req/s]", false,
+                       "10,50,100,200");
+    a.add<int>("duration", 'd', "duration for each rate [ms]", false, 5000);
+    a.parse_check(argc, argv);
+
+    auto input_name = a.get<std::string>("input");
+    std::vector<int> input_dims{1, a.get<int>("channel_num"),
+                                a.get<int>("height"), a.get<int>("width")};
+    auto max_batch_size = a.get<int>("max_batch_size");
+
+    onnx::ModelProto onnx_model;
+    std::unordered_map<std::string, instant::array> parameter_table;
+    std::tie(onnx_model, parameter_table) =
+      instant::load_onnx_with_mapped_parameter_table(
+        a.get<std::string>("model"));
+    auto compiled = instant::make_compiled_model(
+      onnx_model, std::move(parameter_table),
+      {std::make_tuple(input_name, instant::dtype_t::float_, input_dims,
+                       mkldnn::memory::format::nchw)},
+      {a.get<std::string>("output")});
+
+    instant::array input(instant::dtype_t::float_, input_dims);
+    std::fill(instant::fbegin(input), instant::fend(input), 1.f);
+
+    std::cout << std::setw(12) << "rate[req/s]" << std::setw(18)
+              << "throughput[req/s]" << std::setw(12) << "p50[ms]"
+              << std::setw(12) << "p99[ms]" << std::setw(16)
+              << "mean batch size" << "\n";
+    for(auto rate : parse_int_list(a.get<std::string>("rates"))) {
+        instant::batching_server server(
+          compiled, max_batch_size,
+          std::chrono::microseconds(a.get<int>("max_wait_time")));
+        double throughput, p50, p99;
+        std::tie(throughput, p50, p99) =
+          generate_load(server, {{input_name, input}}, rate,
+                        std::chrono::milliseconds(a.get<int>("duration")));
+        auto batch_size_histogram = server.batch_size_histogram();
+        std::size_t batch_num = 0, sample_num = 0;
+        for(std::size_t i = 0; i < batch_size_histogram.size(); ++i) {
+            batch_num += batch_size_histogram[i];
+            sample_num += i * batch_size_histogram[i];
+        }
+        std::cout << std::setw(12) << rate << std::setw(18) << throughput
+                  << std::setw(12) << p50 << std::setw(12) << p99
+                  << std::setw(16)
+                  << static_cast<double>(sample_num) / batch_num << "\n";
+    }
+}
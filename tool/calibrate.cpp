@@ -0,0 +1,156 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+#include <instant/instant.hpp>
+
+#include "../external/cmdline.h"
+
+// A sample is a raw float32 file of one input in nchw
+auto load_sample(std::string const& filename, std::vector<int> const& dims) {
+    instant::array arr(instant::dtype_t::float_, dims);
+    std::ifstream ifs(filename, std::ios::binary);
+    if(!ifs.read(reinterpret_cast<char*>(instant::fbegin(arr)),
+                 instant::total_size(arr) * sizeof(float))) {
+        throw std::runtime_error("Sample load error: " + filename);
+    }
+    return arr;
+}
+
+// Runs samples and records (min, max) of the input and all node outputs
+auto calibrate(
+  onnx::ModelProto const& onnx_model,
+  std::unordered_map<std::string, instant::array> const& parameter_table,
+  std::string const& input_name, std::vector<int> const& input_dims,
+  std::vector<instant::array> const& sample_list) {
+    // every tensor is a required output, so no node is fused
+    std::vector<std::string> output_name_list;
+    for(auto const& node : onnx_model.graph().node()) {
+        output_name_list.insert(output_name_list.end(), node.output().begin(),
+                                node.output().end());
+    }
+    auto model = instant::make_model(
+      onnx_model, parameter_table,
+      {std::make_tuple(input_name, instant::dtype_t::float_, input_dims,
+                       mkldnn::memory::format::nchw)},
+      output_name_list);
+
+    instant::range_table_t range_table;
+    auto update_range = [&range_table](std::string const& name,
+                                       instant::array const& arr) {
+        auto min_max =
+          std::minmax_element(instant::fbegin(arr), instant::fend(arr));
+        auto found = range_table.find(name);
+        if(found == range_table.end()) {
+            range_table.insert(
+              {name, std::make_pair(*min_max.first, *min_max.second)});
+        } else {
+            found->second.first = std::min(found->second.first, *min_max.first);
+            found->second.second =
+              std::max(found->second.second, *min_max.second);
+        }
+    };
+    for(auto const& sample : sample_list) {
+        std::copy(instant::fbegin(sample), instant::fend(sample),
+                  instant::fbegin(model.input(input_name)));
+        update_range(input_name, sample);
+        for(auto const& name_and_arr : model.run()) {
+            update_range(name_and_arr.first, name_and_arr.second);
+        }
+    }
+    return range_table;
+}
+
+// Runs samples and returns the top-1 index of each sample and the average
+// time of run() in milliseconds
+auto run_samples(std::shared_ptr<const instant::compiled_model> const& compiled,
+                 std::string const& input_name, std::string const& output_name,
+                 std::vector<instant::array> const& sample_list) {
+    auto context = instant::make_execution_context(compiled);
+    context.run(); // warm up
+    std::vector<int> top1_list;
+    double total_time = 0.;
+    for(auto const& sample : sample_list) {
+        std::copy(instant::fbegin(sample), instant::fend(sample),
+                  instant::fbegin(context.input(input_name)));
+        auto start = std::chrono::steady_clock::now();
+        auto const& output = instant::find_value(context.run(), output_name);
+        auto end = std::chrono::steady_clock::now();
+        total_time +=
+          std::chrono::duration<double, std::milli>(end - start).count();
+        top1_list.push_back(
+          std::max_element(instant::fbegin(output), instant::fend(output)) -
+          instant::fbegin(output));
+    }
+    return std::make_tuple(top1_list, total_time / sample_list.size());
+}
+
+int main(int argc, char** argv) {
+    cmdline::parser a;
+    a.add<std::string>("model", 'm', "onnx model path", true);
+    a.add<std::string>("input", 'i', "input name", true);
+    a.add<std::string>("output", 'o', "output name (for --evaluate)", false);
+    a.add<std::string>("table", 't', "range table path to write", false,
+                       "range_table.txt");
+    a.add<int>("channel_num", 'c', "input channel num", false, 3);
+    a.add<int>("height", 'h', "input height", false, 224);
+    a.add<int>("width", 'w', "input width", false, 224);
+    a.add("evaluate", 'e',
+          "compare top-1 and time of int8 model with f32 model");
+    a.footer("sample_file ... (raw float32 nchw input of batch size 1)");
+    a.parse_check(argc, argv);
+    if(a.rest().empty()) {
+        std::cerr << "no sample file is given" << std::endl << a.usage();
+        return 1;
+    }
+
+    auto input_name = a.get<std::string>("input");
+    std::vector<int> input_dims{1, a.get<int>("channel_num"),
+                                a.get<int>("height"), a.get<int>("width")};
+
+    onnx::ModelProto onnx_model;
+    std::unordered_map<std::string, instant::array> parameter_table;
+    std::tie(onnx_model, parameter_table) =
+      instant::load_onnx_with_mapped_parameter_table(
+        a.get<std::string>("model"));
+    std::vector<instant::array> sample_list;
+    for(auto const& filename : a.rest()) {
+        sample_list.push_back(load_sample(filename, input_dims));
+    }
+
+    auto range_table = calibrate(onnx_model, parameter_table, input_name,
+                                 input_dims, sample_list);
+    instant::save_range_table(a.get<std::string>("table"), range_table);
+    std::cout << "ranges of " << range_table.size()
+              << " tensors are written to " << a.get<std::string>("table")
+              << std::endl;
+
+    if(!a.exist("evaluate")) {
+        return 0;
+    }
+    auto output_name = a.get<std::string>("output");
+    std::vector<std::tuple<std::string, instant::dtype_t, std::vector<int>,
+                           mkldnn::memory::format>>
+      input_list{std::make_tuple(input_name, instant::dtype_t::float_,
+                                 input_dims, mkldnn::memory::format::nchw)};
+    std::vector<int> f32_top1_list, int8_top1_list;
+    double f32_time, int8_time;
+    std::tie(f32_top1_list, f32_time) = run_samples(
+      instant::make_compiled_model(onnx_model, parameter_table, input_list,
+                                   {output_name}),
+      input_name, output_name, sample_list);
+    std::tie(int8_top1_list, int8_time) = run_samples(
+      instant::make_int8_compiled_model(onnx_model, parameter_table,
+                                        range_table, input_list,
+                                        {output_name}),
+      input_name, output_name, sample_list);
+    auto agreement_num = 0;
+    for(std::size_t i = 0; i < sample_list.size(); ++i) {
+        agreement_num += f32_top1_list[i] == int8_top1_list[i];
+    }
+    std::cout << "top-1 agreement: " << agreement_num << "/"
+              << sample_list.size() << " ("
+              << 100. * agreement_num / sample_list.size() << "%)\n"
+              << "f32: " << f32_time << " ms, int8: " << int8_time
+              << " ms, speedup: " << f32_time / int8_time << "x" << std::endl;
+}
@@ -0,0 +1,156 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+#include <instant/instant.hpp>
+
+#include "../external/cmdline.h"
+
+// Measures the time of nets of each node
+auto measure_node_time_list(
+  onnx::GraphProto const& graph,
+  std::unordered_map<std::string, instant::array> const& parameter_table,
+  std::string const& input_name, std::vector<int> const& input_dims,
+  std::set<std::string> const& required_output_set, int iteration_num) {
+    auto engine = instant::get_context().engine();
+    auto parameter_memory_table = std::get<0>(
+      instant::make_parameter_memory_table(graph, parameter_table, engine));
+    instant::array input(instant::dtype_t::float_, input_dims);
+    std::fill(instant::fbegin(input), instant::fend(input), 1.f);
+    std::vector<
+      std::tuple<std::string, instant::array, mkldnn::memory::format>>
+      input_list{
+        std::make_tuple(input_name, input, mkldnn::memory::format::nchw)};
+    auto input_memory_table =
+      instant::make_variable_memory_table(input_list, engine);
+
+    auto temp_tuple = instant::make_nets(graph, parameter_memory_table,
+                                         input_memory_table,
+                                         required_output_set);
+    auto const& nets = std::get<0>(temp_tuple);
+    auto const& variable_memory_table = std::get<1>(temp_tuple);
+    auto const& parameter_nets = std::get<4>(temp_tuple);
+    auto const& node_net_range_list = std::get<8>(temp_tuple);
+    auto const& host_kernel_table = std::get<9>(temp_tuple);
+    mkldnn::stream(mkldnn::stream::kind::eager)
+      .submit(parameter_nets)
+      .wait();
+    // warm up
+    instant::run_nets(nets, host_kernel_table);
+
+    std::vector<double> node_time_list(graph.node_size(), 0.);
+    for(int n = 0; n < iteration_num; ++n) {
+        for(int i = 0; i < graph.node_size(); ++i) {
+            auto start = std::chrono::steady_clock::now();
+            instant::run_nets(nets, node_net_range_list[i].first,
+                              node_net_range_list[i].second,
+                              host_kernel_table);
+            auto end = std::chrono::steady_clock::now();
+            node_time_list[i] +=
+              std::chrono::duration<double, std::milli>(end - start).count() /
+              iteration_num;
+        }
+    }
+
+    std::unordered_map<std::string, std::size_t> variable_size_table;
+    for(auto const& p : variable_memory_table) {
+        variable_size_table.insert(
+          {p.first, std::get<0>(p.second).get_primitive_desc().get_size()});
+    }
+    return std::make_tuple(node_time_list, variable_size_table);
+}
+
+int main(int argc, char** argv) {
+    cmdline::parser a;
+    a.add<std::string>("model", 'm', "onnx model path", true);
+    a.add<std::string>("input", 'i', "input name", true);
+    a.add<std::string>("output", 'o', "required output name", true);
+    a.add<int>("batch_size", 'b', "batch size", false, 1);
+    a.add<int>("channel_num", 'c', "input channel num", false, 3);
+    a.add<int>("height", 'h', "input height", false, 224);
+    a.add<int>("width", 'w', "input width", false, 224);
+    a.add<int>("iteration", 'n', "iteration num", false, 10);
+    a.parse_check(argc, argv);
+
+    auto input_name = a.get<std::string>("input");
+    std::vector<int> input_dims{a.get<int>("batch_size"),
+                                a.get<int>("channel_num"), a.get<int>("height"),
+                                a.get<int>("width")};
+    std::set<std::string> required_output_set{a.get<std::string>("output")};
+    auto iteration_num = a.get<int>("iteration");
+
+    onnx::ModelProto onnx_model;
+    std::unordered_map<std::string, instant::array> parameter_table;
+    std::tie(onnx_model, parameter_table) =
+      instant::load_onnx_with_mapped_parameter_table(
+        a.get<std::string>("model"));
+    auto const& graph = onnx_model.graph();
+    auto fused_graph = graph;
+    auto fused_parameter_table = parameter_table;
+    instant::fuse_post_eltwise(fused_graph, required_output_set);
+    instant::fuse_eltwise_chain(fused_graph, fused_parameter_table,
+                                required_output_set);
+
+    std::vector<double> unfused_time_list, fused_time_list;
+    std::unordered_map<std::string, std::size_t> variable_size_table;
+    std::tie(unfused_time_list, variable_size_table) = measure_node_time_list(
+      graph, parameter_table, input_name, input_dims, required_output_set,
+      iteration_num);
+    std::tie(fused_time_list, std::ignore) = measure_node_time_list(
+      fused_graph, fused_parameter_table, input_name, input_dims,
+      required_output_set, iteration_num);
+
+    std::unordered_map<std::string, int> producer_index_table;
+    for(int i = 0; i < graph.node_size(); ++i) {
+        producer_index_table.insert({graph.node(i).output(0), i});
+    }
+
+    // Each fused eltwise no longer reads and writes its input
+    std::cout << std::setw(24) << "output" << std::setw(28) << "fused layer"
+              << std::setw(14) << "unfused[ms]" << std::setw(12) << "fused[ms]"
+              << std::setw(16) << "saved traffic[MB]" << "\n";
+    double total_unfused_time = 0., total_fused_time = 0.;
+    std::size_t total_saved_bytes = 0;
+    for(int i = 0; i < fused_graph.node_size(); ++i) {
+        auto const& node = fused_graph.node(i);
+        auto unfused_index = producer_index_table.at(node.output(0));
+        auto layer_name = graph.node(unfused_index).op_type();
+        double unfused_time = unfused_time_list[unfused_index];
+        std::size_t saved_bytes = 0;
+        for(auto const& attr : node.attribute()) {
+            // the first operator of a chain is the fused node itself
+            int fused_num = attr.strings_size();
+            if(attr.name() == "eltwise_op_types") {
+                --fused_num;
+            } else if(attr.name() != "post_eltwise_op_types") {
+                continue;
+            }
+            for(int j = 0; j < fused_num; ++j) {
+                // the other input of Add and Mul of a chain is a parameter
+                auto const& unfused_node = graph.node(unfused_index);
+                auto const& eltwise_input_name =
+                  *std::find_if(unfused_node.input().begin(),
+                                unfused_node.input().end(),
+                                [&parameter_table](std::string const& name) {
+                                    return parameter_table.find(name) ==
+                                           parameter_table.end();
+                                });
+                saved_bytes += 2 * variable_size_table.at(eltwise_input_name);
+                unfused_index = producer_index_table.at(eltwise_input_name);
+                unfused_time += unfused_time_list[unfused_index];
+                layer_name =
+                  graph.node(unfused_index).op_type() + "+" + layer_name;
+            }
+        }
+        total_unfused_time += unfused_time;
+        total_fused_time += fused_time_list[i];
+        total_saved_bytes += saved_bytes;
+        std::cout << std::setw(24) << node.output(0) << std::setw(28)
+                  << layer_name << std::setw(14) << unfused_time
+                  << std::setw(12) << fused_time_list[i] << std::setw(16)
+                  << saved_bytes / 1.e6 << "\n";
+    }
+    std::cout << std::setw(52) << "total" << std::setw(14)
+              << total_unfused_time << std::setw(12) << total_fused_time
+              << std::setw(16) << total_saved_bytes / 1.e6 << std::endl;
+}